@@ -558,6 +558,31 @@ public:
 	 */
 	void write(EFileFormat format, const fs::path &filename, int compression = -1) const;
 
+	/**
+	 * \brief Write an encoded form of the bitmap to a file on a
+	 * background thread
+	 *
+	 * The parameters are identical to \ref write(). The background thread
+	 * keeps a reference to the bitmap, which must not be modified until
+	 * the write has finished. Writes to the same file are carried out in
+	 * the order in which they were requested. At most four writes are
+	 * pending at any time; further calls block until one has finished.
+	 *
+	 * Failed writes are reported by throwing an exception from the next
+	 * call to this function or to \ref waitAsyncWrites() (after the new
+	 * write has been started).
+	 *
+	 * \sa waitAsyncWrites()
+	 */
+	void writeAsync(EFileFormat format, const fs::path &filename, int compression = -1) const;
+
+	/**
+	 * \brief Wait until all pending asynchronous writes have finished
+	 *
+	 * Throws an exception if any of them failed.
+	 */
+	static void waitAsyncWrites();
+
 	/**
 	 * Write an encoded form of the bitmap to a file (auto-detecting the file format)
 	 *
@@ -76,6 +76,22 @@ public:
 	/// Remove the current file
 	void remove();
 
+	/**
+	 * \brief Read the file asynchronously ahead of the current position
+	 *
+	 * A background thread fills two alternating buffers of the given size
+	 * with the data following the current position, so that disk accesses
+	 * overlap with decoding of the data that was already read. Seeking
+	 * within the prefetched range is free; seeking elsewhere discards it.
+	 * Only supported for files opened with \ref EReadOnly; files that fit
+	 * into a single block are read directly. A block size of zero turns
+	 * read-ahead off again.
+	 */
+	void setReadAhead(size_t blockSize = 2*1024*1024);
+
+	/// Return whether the file is currently being read ahead
+	bool getReadAhead() const;
+
 	/// Return a string representation
 	std::string toString() const;
 
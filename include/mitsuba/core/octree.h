@@ -25,8 +25,62 @@
 #include <mitsuba/core/timer.h>
 #include <mitsuba/core/aabb.h>
 
+/// Number of octree levels that \ref StaticOctree::build() splits serially before going parallel
+#define MTS_OCTREE_PARALLEL_LEVELS 2
+
+/// Number of subtrees (shards) below the levels that are split serially
+#define MTS_OCTREE_SHARD_COUNT (1 << (3*MTS_OCTREE_PARALLEL_LEVELS))
+
 MTS_NAMESPACE_BEGIN
 
+/**
+ * \brief Return the index of the octree child containing \c p
+ *
+ * The index encodes the half-space along the X, Y and Z axes in
+ * bits 2, 1 and 0, respectively.
+ */
+inline uint32_t getOctreeChild(const Point &center, const Point &p) {
+	uint32_t child = 0;
+	if (p.x > center.x) child |= 4;
+	if (p.y > center.y) child |= 2;
+	if (p.z > center.z) child |= 1;
+	return child;
+}
+
+/// Return the AABB of the octree child with the specified index
+inline AABB getOctreeChildBounds(uint32_t child, const AABB &nodeAABB, const Point &center) {
+	AABB childAABB;
+	childAABB.min.x = (child & 4) ? center.x : nodeAABB.min.x;
+	childAABB.max.x = (child & 4) ? nodeAABB.max.x : center.x;
+	childAABB.min.y = (child & 2) ? center.y : nodeAABB.min.y;
+	childAABB.max.y = (child & 2) ? nodeAABB.max.y : center.y;
+	childAABB.min.z = (child & 1) ? center.z : nodeAABB.min.z;
+	childAABB.max.z = (child & 1) ? nodeAABB.max.z : center.z;
+	return childAABB;
+}
+
+/**
+ * \brief Return the index of the \ref StaticOctree shard containing \c p
+ *
+ * Shards are numbered in the order in which \ref StaticOctree::build()
+ * lays out its subtrees. Producers that already know the octree bounds can
+ * use this to emit their items pre-sorted by shard, which lets the octree
+ * skip the serial partitioning of its top levels.
+ */
+inline uint32_t getOctreeShard(const AABB &aabb, const Point &p) {
+	AABB bounds(aabb);
+	uint32_t shard = 0;
+
+	for (int level=0; level<MTS_OCTREE_PARALLEL_LEVELS; ++level) {
+		Point center = bounds.getCenter();
+		uint32_t child = getOctreeChild(center, p);
+		bounds = getOctreeChildBounds(child, bounds, center);
+		shard = shard * 8 + child;
+	}
+
+	return shard;
+}
+
 /**
  * \brief Lock-free linked list data structure
  *
@@ -62,6 +116,7 @@ public:
 		return m_head;
 	}
 
+	/// Append an item to the end of the list (takes linear time)
 	void append(const T &value) {
 		ListItem *item = new ListItem(value);
 		ListItem **cur = &m_head;
@@ -69,6 +124,23 @@ public:
 		while (!atomicCompareAndExchangePtr<ListItem>(cur, item, NULL))
 			cur = &((*cur)->next);
 	}
+
+	/**
+	 * \brief Insert an item at the front of the list
+	 *
+	 * In contrast to \ref append(), this takes constant time and
+	 * concurrent writers only contend for the list head. Readers
+	 * that are traversing the list at the same time will either
+	 * see the new item or not, but the list is always consistent.
+	 */
+	void prepend(const T &value) {
+		ListItem *item = new ListItem(value), *head;
+
+		do {
+			head = m_head;
+			item->next = head;
+		} while (!atomicCompareAndExchangePtr<ListItem>(&m_head, item, head));
+	}
 private:
 	ListItem *m_head;
 };
@@ -129,7 +201,21 @@ public:
 			delete m_root;
 	}
 
-	void build() {
+	/**
+	 * \brief Build the octree over the contents of \c m_items
+	 *
+	 * The first \ref MTS_OCTREE_PARALLEL_LEVELS levels are partitioned
+	 * serially, after which the resulting subtrees (up to 64) are
+	 * constructed in parallel when OpenMP support is available.
+	 *
+	 * \param shards
+	 *     Optional array of <tt>MTS_OCTREE_SHARD_COUNT+1</tt> offsets. When
+	 *     specified, \c m_items must already be sorted by shard index (see
+	 *     \ref getOctreeShard()), and the items of shard \c i must occupy
+	 *     the range <tt>[shards[i], shards[i+1])</tt>. The serial partitioning
+	 *     of the top levels is then skipped.
+	 */
+	void build(const uint32_t *shards = NULL) {
 		SLog(EDebug, "Building an octree over " SIZE_T_FMT " data points (%s)..",
 			m_items.size(), memString(m_items.size() * sizeof(Item)).c_str());
 
@@ -139,8 +225,68 @@ public:
 		for (uint32_t i=0; i<m_items.size(); ++i)
 			perm[i] = i;
 
-		/* Build the kd-tree and compute a suitable permutation of the elements */
-		m_root = build(m_aabb, 0, &perm[0], &temp[0], &perm[0], &perm[0] + m_items.size());
+		m_root = NULL;
+		if (m_items.empty())
+			return;
+
+		uint32_t *base = &perm[0];
+
+		/* Split off the top levels of the tree serially */
+		std::vector<BuildTask> tasks, next;
+		tasks.push_back(BuildTask(m_aabb, 0, base, base + m_items.size(), &m_root,
+			0, MTS_OCTREE_SHARD_COUNT));
+
+		if (shards && (shards[0] != 0 || shards[MTS_OCTREE_SHARD_COUNT] != m_items.size()))
+			SLog(EError, "StaticOctree::build(): invalid shard offsets!");
+
+		for (int level=0; level<MTS_OCTREE_PARALLEL_LEVELS; ++level) {
+			next.clear();
+			for (size_t i=0; i<tasks.size(); ++i) {
+				const BuildTask &task = tasks[i];
+				if (isLeaf(task.depth, task.start, task.end)) {
+					*task.target = build(task.aabb, task.depth, base,
+						&temp[0], task.start, task.end);
+					continue;
+				}
+
+				Point center = task.aabb.getCenter();
+				uint32_t nestedCounts[8], shardSpan = task.shardSpan / 8;
+				if (shards) {
+					for (int j=0; j<8; ++j) {
+						uint32_t shard = task.shardStart + j * shardSpan;
+						nestedCounts[j] = shards[shard + shardSpan] - shards[shard];
+					}
+				} else {
+					partition(task.aabb, center, base, &temp[0],
+						task.start, task.end, nestedCounts);
+				}
+
+				OctreeNode *node = new OctreeNode();
+				node->leaf = false;
+				*task.target = node;
+
+				uint32_t *start = task.start;
+				for (int j=0; j<8; ++j) {
+					uint32_t *it = start + nestedCounts[j];
+					node->children[j] = NULL;
+					next.push_back(BuildTask(childBounds(j, task.aabb, center),
+						task.depth + 1, start, it, &node->children[j],
+						task.shardStart + j * shardSpan, shardSpan));
+					start = it;
+				}
+			}
+			tasks.swap(next);
+		}
+
+		/* Build the remaining subtrees (they touch disjoint index ranges) */
+		#if defined(MTS_OPENMP)
+			#pragma omp parallel for schedule(dynamic)
+		#endif
+		for (int i=0; i<(int) tasks.size(); ++i) {
+			const BuildTask &task = tasks[i];
+			*task.target = build(task.aabb, task.depth, base,
+				&temp[0], task.start, task.end);
+		}
 
 		/* Apply the permutation */
 		permute_inplace(&m_items[0], perm);
@@ -149,7 +295,22 @@ public:
 	}
 
 protected:
-	struct LabelOrdering : public std::binary_function<uint32_t, uint32_t, bool> {
+	/// Subtree whose construction has been deferred by \ref build()
+	struct BuildTask {
+		AABB aabb;
+		uint32_t depth;
+		uint32_t *start, *end;
+		OctreeNode **target;
+		uint32_t shardStart, shardSpan;
+
+		inline BuildTask(const AABB &aabb, uint32_t depth, uint32_t *start,
+			uint32_t *end, OctreeNode **target, uint32_t shardStart,
+			uint32_t shardSpan) : aabb(aabb), depth(depth), start(start),
+			end(end), target(target), shardStart(shardStart),
+			shardSpan(shardSpan) { }
+	};
+
+	struct LabelOrdering {
 		LabelOrdering(const std::vector<Item> &items) : m_items(items) { }
 
 		inline bool operator()(uint32_t a, uint32_t b) const {
@@ -161,30 +322,23 @@ protected:
 
 	/// Return the AABB for a child of the specified index
 	inline AABB childBounds(int child, const AABB &nodeAABB, const Point &center) const {
-		AABB childAABB;
-		childAABB.min.x = (child & 4) ? center.x : nodeAABB.min.x;
-		childAABB.max.x = (child & 4) ? nodeAABB.max.x : center.x;
-		childAABB.min.y = (child & 2) ? center.y : nodeAABB.min.y;
-		childAABB.max.y = (child & 2) ? nodeAABB.max.y : center.y;
-		childAABB.min.z = (child & 1) ? center.z : nodeAABB.min.z;
-		childAABB.max.z = (child & 1) ? nodeAABB.max.z : center.z;
-		return childAABB;
+		return getOctreeChildBounds((uint32_t) child, nodeAABB, center);
 	}
 
-	OctreeNode *build(const AABB &aabb, uint32_t depth, uint32_t *base,
-			uint32_t *temp, uint32_t *start, uint32_t *end) {
-		if (start == end) {
-			return NULL;
-		} else if ((uint32_t) (end-start) < m_maxItems || depth > m_maxDepth) {
-			OctreeNode *result = new OctreeNode();
-			result->count = (uint32_t) (end-start);
-			result->offset = (uint32_t) (start-base);
-			result->leaf = true;
-			return result;
-		}
+	/// Should the range <tt>[start, end)</tt> be turned into a leaf node?
+	inline bool isLeaf(uint32_t depth, const uint32_t *start, const uint32_t *end) const {
+		return start == end || (uint32_t) (end-start) < m_maxItems || depth > m_maxDepth;
+	}
 
-		Point center = aabb.getCenter();
-		uint32_t nestedCounts[8];
+	/**
+	 * \brief Sort the range <tt>[start, end)</tt> by child label
+	 *
+	 * Only the part of \c temp that corresponds to the given range is
+	 * used as scratch space, hence disjoint ranges can be partitioned
+	 * concurrently.
+	 */
+	void partition(const AABB &aabb, const Point &center, uint32_t *base,
+			uint32_t *temp, uint32_t *start, uint32_t *end, uint32_t *nestedCounts) {
 		memset(nestedCounts, 0, sizeof(uint32_t)*8);
 
 		/* Label all items */
@@ -192,10 +346,7 @@ protected:
 			Item &item = m_items[*it];
 			const Point &p = item.getPosition();
 
-			uint8_t label = 0;
-			if (p.x > center.x) label |= 4;
-			if (p.y > center.y) label |= 2;
-			if (p.z > center.z) label |= 1;
+			uint8_t label = (uint8_t) getOctreeChild(center, p);
 
 			AABB bounds = childBounds(label, aabb, center);
 			SAssert(bounds.contains(p));
@@ -210,11 +361,29 @@ protected:
 			nestedOffsets[i] = nestedOffsets[i-1] + nestedCounts[i-1];
 
 		/* Sort by label */
+		temp += start - base;
 		for (uint32_t *it = start; it != end; ++it) {
 			int offset = nestedOffsets[m_items[*it].label]++;
 			temp[offset] = *it;
 		}
 		memcpy(start, temp, (end-start) * sizeof(uint32_t));
+	}
+
+	OctreeNode *build(const AABB &aabb, uint32_t depth, uint32_t *base,
+			uint32_t *temp, uint32_t *start, uint32_t *end) {
+		if (start == end) {
+			return NULL;
+		} else if (isLeaf(depth, start, end)) {
+			OctreeNode *result = new OctreeNode();
+			result->count = (uint32_t) (end-start);
+			result->offset = (uint32_t) (start-base);
+			result->leaf = true;
+			return result;
+		}
+
+		Point center = aabb.getCenter();
+		uint32_t nestedCounts[8];
+		partition(aabb, center, base, temp, start, end, nestedCounts);
 
 		/* Recurse */
 		OctreeNode *result = new OctreeNode();
@@ -320,7 +489,7 @@ private:
 		   than the current node size */
 		if (depth == m_maxDepth ||
 			(nodeAABB.getExtents().lengthSquared() < diag2)) {
-			node->data.append(value);
+			node->data.prepend(value);
 			return;
 		}
 
@@ -0,0 +1,226 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#if !defined(__MITSUBA_CORE_PCG32_H_)
+#define __MITSUBA_CORE_PCG32_H_
+
+#include <mitsuba/mitsuba.h>
+
+#define PCG32_DEFAULT_STATE  0x853c49e6748fea9bULL
+#define PCG32_DEFAULT_STREAM 0xda3e39cb94b95bdbULL
+#define PCG32_MULT           0x5851f42d4c957f2dULL
+
+/// Number of independent lanes used by \ref PCG32::nextFloats()
+#define PCG32_LANES 4
+
+MTS_NAMESPACE_BEGIN
+
+/**
+ * \brief Compact permuted congruential generator (PCG32)
+ *
+ * Implements the XSH-RR variant of the PCG family by Melissa O'Neill
+ * (http://www.pcg-random.org). In contrast to \ref Random, the complete
+ * state of this generator consists of two 64-bit integers. Creating,
+ * copying and seeding it is therefore essentially free, which makes it
+ * suitable for per-pixel or per-pass seeding and for cloned samplers.
+ * Different \c initseq values passed to \ref seed() select independent
+ * streams of the generator.
+ *
+ * The class is deliberately not an \ref Object, so that it can be
+ * embedded by value and used from inner loops.
+ *
+ * \ingroup libcore
+ */
+struct PCG32 {
+	/// Initialize the generator with the default state and stream
+	inline PCG32() : state(PCG32_DEFAULT_STATE), inc(PCG32_DEFAULT_STREAM) { }
+
+	/// Initialize the generator with the given state and stream selector
+	inline PCG32(uint64_t initstate, uint64_t initseq = 1u) { seed(initstate, initseq); }
+
+	/**
+	 * \brief Seed the generator
+	 *
+	 * \param initstate
+	 *     Starting state of the generator
+	 * \param initseq
+	 *     Stream selector -- generators with different
+	 *     values produce independent sequences
+	 */
+	inline void seed(uint64_t initstate, uint64_t initseq = 1) {
+		state = 0U;
+		inc = (initseq << 1u) | 1u;
+		nextUInt();
+		state += initstate;
+		nextUInt();
+	}
+
+	/// Return a uniformly distributed 32-bit integer
+	inline uint32_t nextUInt() {
+		uint64_t oldstate = state;
+		state = oldstate * PCG32_MULT + inc;
+		return output(oldstate);
+	}
+
+	/// Return a uniformly distributed integer on the [0, bound)-interval
+	inline uint32_t nextUInt(uint32_t bound) {
+		/* Rejection sampling without bias, see the PCG reference implementation */
+		uint32_t threshold = (~bound + 1u) % bound;
+		while (true) {
+			uint32_t r = nextUInt();
+			if (r >= threshold)
+				return r % bound;
+		}
+	}
+
+	/// Return a uniformly distributed 64-bit integer
+	inline uint64_t nextULong() {
+		uint64_t high = nextUInt();
+		return (high << 32) | nextUInt();
+	}
+
+	/// Return a floating point value on the [0, 1) interval
+	inline Float nextFloat() {
+#if defined(SINGLE_PRECISION)
+		return toFloat(nextUInt());
+#else
+		return toFloat(nextULong());
+#endif
+	}
+
+	/**
+	 * \brief Fill an array with uniformly distributed
+	 * floating point values on the [0, 1) interval
+	 *
+	 * The values are identical to those of repeated \ref nextFloat()
+	 * calls. Internally, \ref PCG32_LANES consecutive states are
+	 * computed at once from the current one, which breaks up the
+	 * serial dependency chain of the generator and lets the compiler
+	 * process the lanes in parallel.
+	 */
+	inline void nextFloats(Float *dest, size_t count) {
+#if defined(SINGLE_PRECISION)
+		const size_t perValue = 1;
+#else
+		const size_t perValue = 2;
+#endif
+		const size_t stride = PCG32_LANES / perValue;
+
+		/* Multipliers and increments that advance the state by k steps */
+		uint64_t mult[PCG32_LANES], plus[PCG32_LANES];
+		uint64_t accMult = 1u, accPlus = 0u;
+		for (int k=0; k<PCG32_LANES; ++k) {
+			mult[k] = accMult; plus[k] = accPlus;
+			accPlus = accPlus * PCG32_MULT + inc;
+			accMult *= PCG32_MULT;
+		}
+
+		size_t i = 0;
+		for (; i + stride <= count; i += stride) {
+			uint32_t values[PCG32_LANES];
+			for (int k=0; k<PCG32_LANES; ++k)
+				values[k] = output(state * mult[k] + plus[k]);
+			state = state * accMult + accPlus;
+
+			for (size_t k=0; k<stride; ++k) {
+#if defined(SINGLE_PRECISION)
+				dest[i+k] = toFloat(values[k]);
+#else
+				dest[i+k] = toFloat(((uint64_t) values[2*k] << 32) | values[2*k+1]);
+#endif
+			}
+		}
+		for (; i<count; ++i)
+			dest[i] = nextFloat();
+	}
+
+	/**
+	 * \brief Multi-step advance function (jump-ahead, jump-back)
+	 *
+	 * The method used here is based on Brown, "Random Number Generation
+	 * with Arbitrary Stride", Transactions of the American Nuclear
+	 * Society (Nov. 1994). The algorithm is very similar to fast
+	 * exponentiation.
+	 */
+	inline void advance(int64_t delta_) {
+		uint64_t curMult = PCG32_MULT, curPlus = inc,
+		         accMult = 1u, accPlus = 0u;
+
+		/* Even though delta is an unsigned integer, we can pass a signed
+		   integer to go backwards, it just goes "the long way round". */
+		uint64_t delta = (uint64_t) delta_;
+
+		while (delta > 0) {
+			if (delta & 1) {
+				accMult *= curMult;
+				accPlus = accPlus * curMult + curPlus;
+			}
+			curPlus = (curMult + 1) * curPlus;
+			curMult *= curMult;
+			delta /= 2;
+		}
+		state = accMult * state + accPlus;
+	}
+
+	/// Draw a uniformly distributed permutation and permute the given container
+	template <typename Iterator> void shuffle(Iterator it1, Iterator it2) {
+		for (Iterator it = it2 - 1; it > it1; --it)
+			std::iter_swap(it, it1 + nextUInt((uint32_t) (it - it1 + 1)));
+	}
+
+	/// Equality operator
+	inline bool operator==(const PCG32 &other) const { return state == other.state && inc == other.inc; }
+
+	/// Inequality operator
+	inline bool operator!=(const PCG32 &other) const { return state != other.state || inc != other.inc; }
+
+	uint64_t state;  ///< RNG state.  All values are possible.
+	uint64_t inc;    ///< Controls which RNG sequence (stream) is selected. Must *always* be odd.
+
+private:
+	/// Output permutation (XSH-RR) applied to a generator state
+	static inline uint32_t output(uint64_t s) {
+		uint32_t xorshifted = (uint32_t) (((s >> 18u) ^ s) >> 27u);
+		uint32_t rot = (uint32_t) (s >> 59u);
+		return (xorshifted >> rot) | (xorshifted << ((~rot + 1u) & 31));
+	}
+
+	/* Same trick as in \ref Random: generate a number in [1, 2) and subtract 1 */
+	static inline float toFloat(uint32_t value) {
+		union {
+			uint32_t u;
+			float f;
+		} x;
+		x.u = (value >> 9) | 0x3f800000u;
+		return x.f - 1.0f;
+	}
+
+	static inline double toFloat(uint64_t value) {
+		union {
+			uint64_t u;
+			double d;
+		} x;
+		x.u = (value >> 12) | 0x3ff0000000000000ULL;
+		return x.d - 1.0;
+	}
+};
+
+MTS_NAMESPACE_END
+
+#endif /* __MITSUBA_CORE_PCG32_H_ */
@@ -134,6 +134,17 @@ public:
 	/// Return a floating point value on the [0, 1) interval
 	Float nextFloat();
 
+	/**
+	 * \brief Fill an array with floating point values on the [0, 1) interval
+	 *
+	 * Produces the same values as repeated calls to \ref nextFloat(),
+	 * but avoids the per-call overhead.
+	 *
+	 * \remark This function is currently not exposed
+	 * by the Python bindings
+	 */
+	void nextFloats(Float *dest, size_t count);
+
 	/// Return a normally distributed value
 	Float nextStandardNormal();
 
@@ -117,6 +117,7 @@ protected:
  */
 class MTS_EXPORT_CORE WorkProcessor : public SerializableObject {
 	friend class Scheduler;
+	friend class TaggedWorkProcessor;
 public:
 	/// Create a work unit of the proper type and size.
 	virtual ref<WorkUnit> createWorkUnit() const = 0;
@@ -504,6 +505,9 @@ public:
 		ref<WaitFlag> done;
 		/* Log level for events associated with this process */
 		ELogLevel logLevel;
+		/* Work units that were lost (e.g. due to a network failure)
+		   and must be handed out again before generating new ones */
+		std::deque<ref<WorkUnit> > reissued;
 
 		inline ProcessRecord(int id, ELogLevel logLevel, Mutex *mutex)
 		 : id(id), inflight(0), morework(true), cancelled(false),
@@ -604,10 +608,22 @@ protected:
 		LockGuard lock(m_mutex);
 		--rec->inflight;
 		rec->cond->signal();
-		if (rec->inflight == 0 && !rec->morework && !item.stop)
+		if (rec->inflight == 0 && !rec->morework && !item.stop && rec->reissued.empty())
 			signalProcessTermination(item.proc, item.rec);
 	}
 
+	/**
+	 * \brief Hand out an in-flight work unit of the given process again
+	 *
+	 * Used by remote workers when the node responsible for the work
+	 * unit has failed or timed out. The in-flight count of the process
+	 * is reduced by one; the work unit will be acquired by the next
+	 * available worker before any new work is generated. Returns
+	 * \c false if the process does not exist (anymore) or is being
+	 * cancelled, in which case the work unit is simply dropped.
+	 */
+	bool reissueWork(int id, WorkUnit *workUnit);
+
 	/**
 	 * Cancel the execution of a parallelizable process. Upon
 	 * return, no more work from this process is running. When
@@ -729,6 +745,11 @@ protected:
 		m_scheduler->releaseWork(item);
 	}
 
+	/// Return a lost work unit to the scheduler (see \ref Scheduler::reissueWork())
+	inline bool reissueWork(int id, WorkUnit *workUnit) {
+		return m_scheduler->reissueWork(id, workUnit);
+	}
+
 	/// Initialize the m_schedItem data structure when only the process ID is known
 	void setProcessByID(Scheduler::Item &item, int id) {
 		return m_scheduler->setProcessByID(item, id);
@@ -21,6 +21,7 @@
 #define __MITSUBA_CORE_SCHED_REMOTE_H_
 
 #include <mitsuba/core/sched.h>
+#include <mitsuba/core/timer.h>
 #include <set>
 
 /// Default port of <tt>mtssrv</tt>
@@ -35,10 +36,31 @@
    continue sending batches of work units */
 #define MTS_CONTINUE_FACTOR 2
 
+/** Resources are split into content-defined chunks, which are
+   compressed and deduplicated individually. These are the minimum,
+   and maximum chunk sizes in bytes */
+#define MTS_BLOB_MIN_SIZE (256*1024)
+#define MTS_BLOB_MAX_SIZE (4*1024*1024)
+
+/// Bit mask that determines the average chunk size (1 MiB)
+#define MTS_BLOB_MASK ((1 << 20) - 1)
+
+/// zlib compression level used for resource transfers (fast)
+#define MTS_BLOB_COMPRESSION 1
+
+/** Batches of work results that are larger than this many
+   bytes are compressed before being sent back to the client */
+#define MTS_RESULT_COMPRESSION_THRESHOLD 4096
+
+/** Interval (in milliseconds) at which a \ref RemoteWorker checks
+   for work units that have timed out */
+#define MTS_REMOTE_POLL_INTERVAL 250
+
 MTS_NAMESPACE_BEGIN
 
 class RemoteWorkerReader;
 class StreamBackend;
+class PreparedResource;
 
 /**
  * \brief Acquires work from the scheduler and forwards
@@ -50,6 +72,9 @@ class StreamBackend;
 class MTS_EXPORT_CORE RemoteWorker : public Worker {
 	friend class RemoteWorkerReader;
 public:
+	/// Identifies a resource chunk by its content hash and size
+	typedef std::pair<uint64_t, uint32_t> BlobKey;
+
 	/**
 	 * \brief Construct a new remote worker with the given name and
 	 * communication stream
@@ -59,6 +84,36 @@ public:
 	/// Return the name of the node on the other side
 	inline const std::string &getNodeName() const { return m_nodeName; }
 
+	/**
+	 * \brief Set the maximum number of work units that may be
+	 * in flight to the remote node at any time
+	 *
+	 * Larger windows hide more network latency. Once the window is
+	 * full, sending resumes when one third of it has been processed.
+	 * The default is <tt>MTS_BACKLOG_FACTOR</tt> times the core
+	 * count of the node.
+	 */
+	void setWindowSize(size_t size);
+
+	/// Return the maximum number of work units that may be in flight
+	inline size_t getWindowSize() const { return m_windowSize; }
+
+	/**
+	 * \brief Set a timeout (in seconds) after which unfinished work units
+	 * are handed to other workers
+	 *
+	 * Results that arrive after a work unit has been reissued are ignored.
+	 * A value of zero (the default) disables the timeout; work units are
+	 * then only reissued when the connection to the node is lost.
+	 */
+	void setTimeout(Float timeout);
+
+	/// Return the work unit timeout in seconds (or zero if disabled)
+	inline Float getTimeout() const { return m_timeout; }
+
+	/// Has the connection to the remote node been lost?
+	inline bool hasFailed() const { return m_failed; }
+
 	MTS_DECLARE_CLASS()
 protected:
 	/// Virtual destructor
@@ -72,11 +127,60 @@ protected:
 	virtual void start(Scheduler *scheduler, int workerIndex, int coreOffset);
 	void flush();
 
+	/// Append the current work unit to the message buffer (the lock must be held)
+	void sendWorkUnit(int id);
+
+	/**
+	 * \brief Append a resource to the message buffer
+	 *
+	 * Chunks that the remote node already holds in its blob
+	 * cache are only referenced by their key.
+	 */
+	void sendResource(int msg, int id, const void *data, size_t size, bool reuse);
+
+	/// Append an already chunked resource to the message buffer (the lock must be held)
+	void sendPreparedResource(int msg, int id, const PreparedResource *prepared);
+
+	/**
+	 * \brief Send a resource again after the node reported that some
+	 * of its chunks are missing from its blob cache
+	 */
+	void resendResource(int id, const std::vector<BlobKey> &missing);
+
 	inline void signalCompletion() {
 		LockGuard lock(m_mutex);
+		updateUtilization();
 		m_inFlight--;
+		m_unitsDone++;
 		m_finishCond->signal();
 	}
+
+	/// Accumulate busy time (the lock must be held)
+	void updateUtilization();
+
+	/**
+	 * \brief Remove a work unit from the list of outstanding ones
+	 *
+	 * Returns \c false if the work unit is unknown, i.e. when it has
+	 * already been reissued to another worker.
+	 */
+	bool claimWorkUnit(uint32_t seq);
+
+	/// Reissue all outstanding work units after a connection failure
+	void handleFailure(const std::string &reason);
+
+	/// Reissue work units that have exceeded the timeout
+	void checkTimeouts();
+
+	/// Reissue the given work units (the lock must not be held)
+	void reissue(std::vector<std::pair<int, ref<WorkUnit> > > &units);
+
+	/// Record of a work unit that was sent to the remote node
+	struct OutstandingWork {
+		int id;
+		ref<WorkUnit> workUnit;
+		uint64_t time;
+	};
 protected:
 	ref<Mutex> m_mutex;
 	ref<ConditionVariable> m_finishCond;
@@ -91,6 +195,28 @@ protected:
 	std::set<std::string> m_plugins;
 	std::string m_nodeName;
 	size_t m_inFlight;
+	size_t m_windowSize, m_continueSize;
+
+	/* Utilization statistics (busy core-nanoseconds since the first work unit) */
+	ref<Timer> m_timer;
+	uint64_t m_busyTime, m_lastEvent, m_firstEvent;
+	size_t m_unitsDone;
+
+	/* Work units that have been sent, but not yet returned */
+	std::map<uint32_t, OutstandingWork> m_outstanding;
+	uint32_t m_nextSeq;
+	Float m_timeout;
+	bool m_failed;
+
+	/* Chunks that are available in the node's blob cache */
+	std::set<BlobKey> m_nodeBlobs;
+	bool m_nodeCache;
+
+	/* Per-core resources that were sent, in case the node asks for them again */
+	std::map<int, ref<PreparedResource> > m_multiResources;
+
+	/* Transfer statistics (in bytes) */
+	uint64_t m_statsRaw, m_statsSent, m_statsReused;
 };
 
 /**
@@ -111,6 +237,9 @@ protected:
 	virtual ~RemoteWorkerReader() { }
 	/// Thread body
 	void run();
+
+	/// Handle a message from the given stream (which is not necessarily \c m_stream)
+	void handleMessage(Stream *stream, short msg);
 private:
 	std::vector<Thread *> m_joinThreads;
 	RemoteWorker *m_parent;
@@ -118,6 +247,7 @@ private:
 	bool m_shutdown;
 	int m_currentID;
 	Scheduler::Item m_schedItem;
+	std::vector<uint8_t> m_skipBuffer;
 };
 
 /**
@@ -160,10 +290,11 @@ public:
 		return wu;
 	}
 
-	/// Make a full work unit available to the process
-	inline void putFullWorkUnit(WorkUnit *wu) {
+	/// Make a full work unit with the given sequence number available to the process
+	inline void putFullWorkUnit(WorkUnit *wu, uint32_t seq) {
 		LockGuard lock(m_mutex);
 		m_full.push_back(wu);
+		m_fullSeq.push_back(seq);
 	}
 
 	/// Mark the process as finished
@@ -181,6 +312,7 @@ private:
 	ref<StreamBackend> m_backend;
 	std::vector<WorkUnit *> m_empty;
 	std::deque<WorkUnit *> m_full;
+	std::deque<uint32_t> m_fullSeq;
 	ref<WorkProcessor> m_wp;
 	ref<Mutex> m_mutex;
 	bool m_done;
@@ -216,6 +348,27 @@ public:
 	StreamBackend(const std::string &name, Scheduler *scheduler,
 		const std::string &nodeName, Stream *stream, bool detach);
 
+	/**
+	 * \brief Enable a persistent blob cache shared by all stream backends
+	 * of this process
+	 *
+	 * Resource chunks received from a \ref RemoteWorker are stored in the
+	 * given directory, and the client is informed about their presence when
+	 * it connects. Unchanged chunks (e.g. meshes and textures that are
+	 * shared by consecutive renderings) are then never transmitted again.
+	 * The directory may be shared by several processes.
+	 *
+	 * \param maxSize
+	 *     When nonzero, the least recently used blobs are evicted whenever
+	 *     the directory contents exceed this many bytes, both here and
+	 *     while new blobs are written. Blobs that were advertised to a
+	 *     client may thus disappear (also when another process prunes a
+	 *     shared directory); the backend then asks the client to send the
+	 *     affected resource again. With <tt>maxSize=0</tt>, the cache
+	 *     grows without bound and must be cleaned up manually.
+	 */
+	static void setBlobCacheDirectory(const fs::path &path, uint64_t maxSize = 0);
+
 	MTS_DECLARE_CLASS()
 protected:
 	enum EMessage {
@@ -233,14 +386,40 @@ protected:
 		EResourceExpired,
 		EQuit,
 		EIncompatible,
+		ECompressedBatch,
+		EResendResource,
 		EHello = 0x1bcd
 	};
 
 	/// Virtual destructor
 	virtual ~StreamBackend();
 	virtual void run();
-	void sendWorkResult(int id, const WorkResult *result, bool cancelled);
-	void sendCancellation(int id, int numLost);
+	/**
+	 * \brief Queue a work result for transmission
+	 *
+	 * Results are batched and sent when \c flush is set or enough
+	 * of them have accumulated.
+	 */
+	void sendWorkResult(int id, uint32_t seq, const WorkResult *result,
+		bool cancelled, bool flush);
+	void sendCancellation(int id, const std::vector<uint32_t> &lost);
+
+	/// Send all queued messages (the send lock must be held)
+	void flushResults();
+
+	/**
+	 * \brief Receive a resource sent by \ref RemoteWorker::sendResource()
+	 *
+	 * Returns \c NULL when chunks that the client expected to be in the
+	 * blob cache are missing. Their keys are then stored in \c missing.
+	 */
+	ref<MemoryStream> receiveResource(std::vector<RemoteWorker::BlobKey> &missing);
+
+	/// Ask the client to send a resource again (bindings to it are deferred)
+	void requestResource(int id, const std::vector<RemoteWorker::BlobKey> &missing);
+
+	/// Apply the bindings that were waiting for a resource to arrive
+	void resourceReceived(int id);
 private:
 	Scheduler *m_scheduler;
 	std::string m_nodeName;
@@ -248,7 +427,14 @@ private:
 	ref<MemoryStream> m_memStream;
 	std::map<int, RemoteProcess *> m_processes;
 	std::map<int, int> m_resources;
+	/* Resources that have been requested again, bindings that wait for them,
+	   and the processes that cannot be scheduled until then */
+	std::set<int> m_requestedResources;
+	std::multimap<int, std::pair<int, std::string> > m_deferredBindings;
+	std::map<int, std::pair<ref<RemoteProcess>, int> > m_blockedProcesses;
 	ref<Mutex> m_sendMutex;
+	ref<MemoryStream> m_compressedStream, m_resultStream;
+	size_t m_pendingResults;
 	bool m_detach;
 };
 
@@ -120,6 +120,16 @@ extern MTS_EXPORT_CORE size_t getTotalSystemMemory();
 /// Return the fully qualified domain name of this machine
 extern MTS_EXPORT_CORE std::string getFQDN();
 
+/**
+ * \brief Compute a 64-bit FNV-1a hash of a region of memory
+ *
+ * This is not a cryptographic hash function -- it is meant for detecting
+ * changes to cached data. Several regions of memory can be hashed in
+ * sequence by passing the previous result as the \c seed parameter.
+ */
+extern MTS_EXPORT_CORE uint64_t hashBuffer(const void *data, size_t size,
+	uint64_t seed = 0xcbf29ce484222325ULL);
+
 /**
  * \brief Enable floating point exceptions (to catch NaNs, overflows,
  * arithmetic with infinity).
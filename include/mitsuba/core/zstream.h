@@ -26,6 +26,9 @@
 /// Buffer size used to communicate with zlib. The larger, the better.
 #define ZSTREAM_BUFSIZE 32768
 
+/// Uncompressed size of the independently compressed blocks of an \c EBlockStream
+#define ZSTREAM_BLOCKSIZE 524288
+
 MTS_NAMESPACE_BEGIN
 
 /**
@@ -34,6 +37,12 @@ MTS_NAMESPACE_BEGIN
  * This class transparently decompresses and compresses reads and writes
  * to a nested stream, respectively.
  *
+ * Streams of type \ref EBlockStream are split into blocks that are
+ * compressed independently, which lets several cores work on them at the
+ * same time and makes it possible to seek within the uncompressed data.
+ * When reading, this format is recognized automatically, so that a
+ * stream created with \ref EDeflateStream can read both.
+ *
  * \ingroup libcore
  */
 class MTS_EXPORT_CORE ZStream : public Stream {
@@ -45,7 +54,9 @@ public:
 		/// A raw deflate stream
 		EDeflateStream,
 		/// A gzip-compatible stream
-		EGZipStream
+		EGZipStream,
+		/// A sequence of independently deflated blocks
+		EBlockStream
 	};
 
 	/// Create a new compression stream
@@ -72,12 +83,27 @@ public:
 	//! @{ \name Implementation of the Stream interface
 	// =============================================================
 
+	/**
+	 * \brief Read from the stream
+	 *
+	 * Block-compressed data is decompressed in parallel, in groups
+	 * of as many blocks as there are cores.
+	 */
 	void read(void *ptr, size_t size);
 	void write(const void *ptr, size_t size);
+	/**
+	 * \brief Seek to a position in the uncompressed data
+	 *
+	 * Only supported when reading block-compressed data from a seekable
+	 * child stream: the block headers are scanned to find the block
+	 * that contains the requested position.
+	 */
 	void seek(size_t pos);
+	/// Return the uncompressed position (only supported by block streams)
 	size_t getPos() const;
 	size_t getSize() const;
 	void truncate(size_t size);
+	/// Compress and write out pending blocks (only supported by block streams)
 	void flush();
 	bool canWrite() const;
 	bool canRead() const;
@@ -92,12 +118,29 @@ public:
 protected:
 	// \brief Virtual destructor
 	virtual ~ZStream();
+
+	/// Check whether the child stream contains block-compressed data
+	void detectFormat();
+
+	/// Compress all buffered blocks in parallel and write them out
+	void writeBlocks();
+
+	/// Read and decompress the next group of blocks
+	bool readBlocks();
 private:
 	ref<Stream> m_childStream;
 	z_stream m_deflateStream, m_inflateStream;
 	uint8_t m_deflateBuffer[ZSTREAM_BUFSIZE];
 	uint8_t m_inflateBuffer[ZSTREAM_BUFSIZE];
-	bool m_didWrite;
+	bool m_didWrite, m_didRead;
+
+	/* State of block-compressed streams */
+	EStreamType m_streamType;
+	int m_level;
+	bool m_blockMode, m_endOfBlocks;
+	std::vector<std::vector<uint8_t> > m_blocks;
+	size_t m_blockIndex, m_blockOffset;
+	size_t m_blocksPos, m_pos, m_firstBlock;
 };
 
 MTS_NAMESPACE_END
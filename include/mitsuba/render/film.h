@@ -88,9 +88,32 @@ public:
 	 */
 	inline bool hasHighQualityEdges() const { return m_highQualityEdges; }
 
+	/**
+	 * \brief Should \ref develop() write the image file asynchronously?
+	 *
+	 * When enabled, the film converts its contents to the output format
+	 * and hands the encoding and file output to a background thread
+	 * (see \ref Bitmap::writeAsync()). This lets the next render job start
+	 * while the image is still being written.
+	 */
+	inline void setAsyncWrite(bool value) { m_asyncWrite = value; }
+
+	/// Does \ref develop() write the image file asynchronously?
+	inline bool getAsyncWrite() const { return m_asyncWrite; }
+
 	/// Return whether or not this film records the alpha channel
 	virtual bool hasAlpha() const = 0;
 
+	/**
+	 * \brief Return the image block that accumulates the film's samples
+	 *
+	 * This provides access to the raw (unnormalized) accumulation buffer,
+	 * e.g. to save and restore the state of a progressive rendering. Films
+	 * that do not keep the image in memory return \c NULL, which is also
+	 * what the default implementation does.
+	 */
+	virtual ImageBlock *getImageBlock();
+
 	/// Return the image reconstruction filter
 	inline ReconstructionFilter *getReconstructionFilter() { return m_filter.get(); }
 
@@ -130,6 +153,7 @@ protected:
 	Point2i m_cropOffset;
 	Vector2i m_size, m_cropSize;
 	bool m_highQualityEdges;
+	bool m_asyncWrite;
 	ref<ReconstructionFilter> m_filter;
 };
 
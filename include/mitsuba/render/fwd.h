@@ -36,6 +36,7 @@ class HemisphereSampler;
 class HWResource;
 class ImageBlock;
 class Instanced;
+class InstanceBVH;
 class Integrator;
 struct Intersection;
 class IrradianceCache;
@@ -0,0 +1,212 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#if !defined(__MITSUBA_RENDER_IBVH_H_)
+#define __MITSUBA_RENDER_IBVH_H_
+
+#include <mitsuba/render/shape.h>
+
+/// Maximum number of shapes stored in a BVH leaf
+#define MTS_IBVH_LEAF_SIZE 4
+
+/// Maximum depth of the 4-wide tree (limits the traversal stack)
+#define MTS_IBVH_MAX_DEPTH 64
+
+/// Number of parts of the time range that are bounded separately for moving shapes
+#define MTS_IBVH_TIME_SEGMENTS 4
+
+MTS_NAMESPACE_BEGIN
+
+/**
+ * \brief Top-level bounding volume hierarchy over a large number
+ * of geometry instances
+ *
+ * The scene's \ref ShapeKDTree handles instances like any other
+ * non-triangle shape, i.e. through their bounding boxes. A full SAH
+ * kd-tree construction over millions of such boxes (e.g. for vegetation
+ * or crowds) is slow and memory-hungry, and it has to be repeated
+ * whenever an instance moves. This class instead collects the instances
+ * into a 4-wide BVH, which is built using binned SAH splits in a
+ * fraction of the time, tests the ray against all four child boxes of a
+ * node at once (using SSE when available), and supports refitting the
+ * node bounds in linear time after instance transformations changed.
+ *
+ * Instances with animated transformations sweep large regions over the
+ * shutter interval. When a time range is provided, the node bounds of
+ * such hierarchies are computed for several consecutive parts of it
+ * (using \ref Shape::getMotionAABB()), and rays only visit the boxes of
+ * the part containing their time value. The tree topology is shared.
+ *
+ * The whole hierarchy is inserted into the scene's kd-tree as a
+ * single shape and forwards intersection queries to the instances.
+ * Although meant for the \c instance plugin, it works with any shape
+ * that implements the ray intersection routines.
+ *
+ * \sa Scene::setShapeTransform()
+ * \ingroup librender
+ */
+class MTS_EXPORT_RENDER InstanceBVH : public Shape {
+public:
+	/// Create an empty hierarchy
+	InstanceBVH();
+
+	/// Add a shape to the hierarchy (only allowed before \ref build())
+	void addShape(const Shape *shape);
+
+	/// Return the number of shapes stored in the hierarchy
+	inline size_t getShapeCount() const { return m_shapes.size(); }
+
+	/// Return one of the shapes stored in the hierarchy
+	inline const Shape *getShape(size_t index) const { return m_shapes[index]; }
+
+	/// Return the number of 4-wide nodes
+	inline size_t getNodeCount() const { return m_nodeCount; }
+
+	/**
+	 * \brief Specify the time range of the rays traced against the
+	 * hierarchy (e.g. the shutter interval of the sensor)
+	 *
+	 * When some of the shapes move during this range, \ref build()
+	 * bounds them separately for \ref MTS_IBVH_TIME_SEGMENTS parts of
+	 * it. Must be called before \ref build().
+	 */
+	void setTimeRange(Float start, Float end);
+
+	/// Return the number of time segments with separate node bounds
+	inline int getTimeSegmentCount() const { return m_timeSegments; }
+
+	/// Construct the hierarchy
+	void build();
+
+	/// Has the hierarchy been built?
+	inline bool isBuilt() const { return m_nodes != NULL; }
+
+	/**
+	 * \brief Recompute the node bounds after shapes have moved
+	 *
+	 * This is much faster than \ref build() but keeps the topology,
+	 * so the hierarchy degrades when shapes move far from their
+	 * original positions.
+	 */
+	void refit();
+
+	// =============================================================
+	//! @{ \name Implementation of the Shape interface
+	// =============================================================
+
+	AABB getAABB() const;
+
+	bool rayIntersect(const Ray &ray, Float mint,
+			Float maxt, Float &t, void *temp) const;
+
+	bool rayIntersect(const Ray &ray, Float mint, Float maxt) const;
+
+	void fillIntersectionRecord(const Ray &ray,
+		const void *temp, Intersection &its) const;
+
+	size_t getPrimitiveCount() const;
+
+	size_t getEffectivePrimitiveCount() const;
+
+	std::string toString() const;
+
+	//! @}
+	// =============================================================
+
+	MTS_DECLARE_CLASS()
+protected:
+	/// Virtual destructor
+	virtual ~InstanceBVH();
+
+	/// Build range of shape indices
+	struct BuildRange {
+		uint32_t start, end;
+		AABB aabb;
+
+		inline BuildRange() { }
+		inline BuildRange(uint32_t start, uint32_t end, const AABB &aabb)
+			: start(start), end(end), aabb(aabb) { }
+		inline uint32_t size() const { return end - start; }
+	};
+
+	/**
+	 * \brief A node with four children, whose bounding boxes are
+	 * stored in a structure-of-arrays layout
+	 *
+	 * A child with a nonzero \c count is a leaf referencing \c count
+	 * entries of \ref m_indices starting at \c child. Otherwise,
+	 * \c child is the index of an interior node or \c EEmpty.
+	 * Every node is stored once per time segment, i.e. the bounds
+	 * of node \c i for segment \c s are found at index
+	 * <tt>i * m_timeSegments + s</tt>.
+	 */
+	struct Node {
+		enum {
+			EEmpty = 0xFFFFFFFF
+		};
+
+		/// Bounding boxes indexed by [min/max][axis][child]
+		float bounds[2][3][4];
+		uint32_t child[4];
+		uint32_t count[4];
+
+		void setEmpty(int i);
+		void setBounds(int i, const AABB &aabb);
+		AABB getBounds() const;
+	};
+
+	/// Find a binned SAH split, returns \c false if the range should become a leaf
+	bool split(const BuildRange &range, BuildRange &left, BuildRange &right);
+
+	/// Recursively build the subtree for the given range
+	void buildNode(uint32_t nodeIndex, const BuildRange &range, int depth);
+
+	/// Compute the bounding boxes of all shapes
+	void computeShapeBounds();
+
+	/**
+	 * \brief Compute the bounding boxes of all shapes for each time
+	 * segment. Returns \c false if none of the shapes move.
+	 */
+	bool computeSegmentBounds();
+
+	/// Recompute the node bounds of one time segment, bottom-up
+	void refitNodes(int segment);
+
+	/// Return the time segment containing the given time value
+	inline int getTimeSegment(Float time) const {
+		int segment = (int) ((time - m_timeStart) * m_timeScale);
+		return std::min(std::max(segment, 0), m_timeSegments - 1);
+	}
+private:
+	std::vector<const Shape *> m_shapes;
+	std::vector<AABB> m_shapeAABBs;
+	std::vector<AABB> m_segmentAABBs;
+	std::vector<Point> m_centroids;
+	std::vector<uint32_t> m_indices;
+	Node *m_nodes;
+	size_t m_nodeCount, m_nodeCapacity;
+	AABB m_aabb;
+	Float m_timeStart, m_timeEnd, m_timeScale;
+	int m_timeSegments;
+};
+
+MTS_NAMESPACE_END
+
+#endif /* __MITSUBA_RENDER_IBVH_H_ */
@@ -96,14 +96,72 @@ public:
 	/// Return a pointer to the underlying bitmap representation (const version)
 	inline const Bitmap *getBitmap() const { return m_bitmap.get(); }
 
+	/**
+	 * \brief Enable or disable per-pixel variance tracking
+	 *
+	 * When enabled, the block maintains an additional bitmap (without
+	 * border region) that records the sample count along with the sum
+	 * and sum of squares of each linear RGB channel of the samples
+	 * that were deposited in every pixel. Since these statistics are
+	 * additive, they can be accumulated across blocks and passes.
+	 *
+	 * \sa putVariance()
+	 */
+	void setVarianceTracking(bool enabled);
+
+	/// Does the block track per-pixel sample statistics?
+	inline bool hasVariance() const { return m_variance.get() != NULL; }
+
+	/// Return the per-pixel sample statistics (or \c NULL if not tracked)
+	inline Bitmap *getVarianceBitmap() { return m_variance; }
+
+	/// Return the per-pixel sample statistics (const version)
+	inline const Bitmap *getVarianceBitmap() const { return m_variance.get(); }
+
 	/// Clear everything to zero
-	inline void clear() { m_bitmap->clear(); }
+	inline void clear() {
+		m_bitmap->clear();
+		if (m_variance)
+			m_variance->clear();
+	}
 
 	/// Accumulate another image block into this one
 	inline void put(const ImageBlock *block) {
 		m_bitmap->accumulate(block->getBitmap(),
 			Point2i(block->getOffset() - m_offset
 				- Vector2i(block->getBorderSize() - m_borderSize)));
+		if (m_variance && block->hasVariance())
+			m_variance->accumulate(block->getVarianceBitmap(), Point2i(0),
+				Point2i(block->getOffset() - m_offset), block->getSize());
+	}
+
+	/**
+	 * \brief Record a sample in the per-pixel variance statistics
+	 *
+	 * Unlike \ref put(), this does not apply the reconstruction filter:
+	 * the sample only counts towards the pixel that contains \c pos.
+	 * This function must only be called when variance tracking is enabled.
+	 *
+	 * \param pos
+	 *    Denotes the sample position in fractional pixel coordinates
+	 * \param spec
+	 *    Spectrum value assocated with the sample
+	 */
+	FINLINE void putVariance(const Point2 &pos, const Spectrum &spec) {
+		const int x = math::floorToInt(pos.x) - m_offset.x,
+		          y = math::floorToInt(pos.y) - m_offset.y;
+
+		if (x < 0 || y < 0 || x >= m_size.x || y >= m_size.y)
+			return;
+
+		Float r, g, b;
+		spec.toLinearRGB(r, g, b);
+
+		Float *dest = m_variance->getFloatData()
+			+ (y * (size_t) m_variance->getWidth() + x) * 7;
+		dest[0] += 1;
+		dest[1] += r; dest[2] += g; dest[3] += b;
+		dest[4] += r*r; dest[5] += g*g; dest[6] += b*b;
 	}
 
 	/**
@@ -207,6 +265,7 @@ public:
 	ref<ImageBlock> clone() const {
 		ref<ImageBlock> clone = new ImageBlock(m_bitmap->getPixelFormat(),
 			m_bitmap->getSize() - Vector2i(2*m_borderSize, 2*m_borderSize), m_filter, m_bitmap->getChannelCount());
+		clone->setVarianceTracking(hasVariance());
 		copyTo(clone);
 		return clone;
 	}
@@ -214,6 +273,9 @@ public:
 	/// Copy the contents of this image block to another one with the same configuration
 	void copyTo(ImageBlock *copy) const {
 		memcpy(copy->getBitmap()->getUInt8Data(), m_bitmap->getUInt8Data(), m_bitmap->getBufferSize());
+		if (hasVariance() && copy->hasVariance())
+			memcpy(copy->getVarianceBitmap()->getUInt8Data(),
+				m_variance->getUInt8Data(), m_variance->getBufferSize());
 		copy->m_size = m_size;
 		copy->m_offset = m_offset;
 		copy->m_warn = m_warn;
@@ -236,6 +298,7 @@ protected:
 	virtual ~ImageBlock();
 protected:
 	ref<Bitmap> m_bitmap;
+	ref<Bitmap> m_variance;
 	Point2i m_offset;
 	Vector2i m_size;
 	int m_borderSize;
@@ -43,6 +43,19 @@ public:
 	//! @}
 	// ======================================================================
 
+	/**
+	 * \brief Restrict the process to an explicit list of blocks
+	 *
+	 * The entries are block indices (i.e. block offsets divided by the
+	 * block size), which are processed in the given order instead of
+	 * the default spiral pattern. An empty list restores the default
+	 * behavior. This function must be called before \ref init().
+	 */
+	void setBlockList(const std::vector<Point2i> &blocks);
+
+	/// Return the list of blocks to be processed (empty if all)
+	inline const std::vector<Point2i> &getBlockList() const { return m_blockList; }
+
 	MTS_DECLARE_CLASS()
 protected:
 	/**
@@ -70,6 +83,7 @@ protected:
 	};
 
 	Point2i m_offset;
+	std::vector<Point2i> m_blockList;
 	Vector2i m_size, m_numBlocks;
 	Point2i m_curBlock;
 	int m_direction, m_numSteps;
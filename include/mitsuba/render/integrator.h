@@ -358,6 +358,21 @@ public:
 	 * associated rays in a pixel region is then taken as an approximation
 	 * of that pixel's radiance value. For adaptive strategies, have a look at
 	 * the \c adaptive plugin, which is an extension of this class.
+	 *
+	 * When the \c passes parameter is set to a value greater than one,
+	 * the samples of each pixel are rendered progressively in that many
+	 * passes. In this mode, the film's accumulation buffer is periodically
+	 * written to a checkpoint file (every \c checkpointInterval seconds,
+	 * \c 60 by default), and an interrupted render job resumes from the
+	 * last checkpoint when it is started again (unless \c resume is set
+	 * to \c false). Checkpoints record a hash of the scene contents and
+	 * of the sensor placement and are ignored when they no longer match,
+	 * so an edited scene is never merged with an outdated image. The
+	 * \c timeBudget parameter (in seconds) stops the rendering at the end
+	 * of the last pass that is expected to finish within the budget, after
+	 * which a checkpoint is written as well. Since the passes preserve the sample
+	 * indices, deterministic samplers produce the same image as an
+	 * uninterrupted render (up to the order of floating point additions).
 	 */
 	bool render(Scene *scene, RenderQueue *queue, const RenderJob *job,
 		int sceneResID, int sensorResID, int samplerResID);
@@ -433,6 +448,12 @@ protected:
 protected:
 	/// Used to temporarily cache a parallel process while it is in operation
 	ref<ParallelProcess> m_process;
+
+	/// Progressive rendering: number of passes, time budget and checkpointing
+	size_t m_passCount;
+	Float m_timeBudget, m_checkpointInterval;
+	std::string m_checkpointFile;
+	bool m_resume;
 };
 
 /*
@@ -22,6 +22,7 @@
 
 #include <mitsuba/render/scene.h>
 #include <mitsuba/core/octree.h>
+#include <mitsuba/core/tls.h>
 
 MTS_NAMESPACE_BEGIN
 
@@ -212,7 +213,14 @@ public:
 	 */
 	bool get(const Intersection &its, Spectrum &E) const;
 
-	/// Manually insert an irradiance record
+	/**
+	 * \brief Manually insert an irradiance record
+	 *
+	 * This function can safely be called from multiple threads. The
+	 * record becomes visible to \ref get() immediately, while its
+	 * bookkeeping entry (needed for serialization) is staged in a
+	 * thread-local buffer and published in batches.
+	 */
 	void insert(Record *rec);
 
 	/**
@@ -220,6 +228,38 @@ public:
 	 */
 	void serialize(Stream *stream, InstanceManager *manager) const;
 
+	/**
+	 * \brief Write the irradiance records to a cache file on disk
+	 *
+	 * The records are stored in their in-memory representation, hence
+	 * the cache can only be loaded by a Mitsuba build with the same
+	 * floating point precision, spectral representation and byte order.
+	 * This function must not be called while records are being added.
+	 *
+	 * \param filename
+	 *     Destination file (will be overwritten)
+	 * \param hash
+	 *     Hash value identifying the cache contents (usually
+	 *     \ref Scene::computeContentHash() combined with the integrator
+	 *     configuration), which is checked by \ref readCache().
+	 */
+	void writeCache(const fs::path &filename, uint64_t hash) const;
+
+	/**
+	 * \brief Load an irradiance cache written by \ref writeCache()
+	 *
+	 * The file is memory-mapped, and the octree is rebuilt from
+	 * the stored records.
+	 *
+	 * \return The irradiance cache, or \c NULL if the file does not
+	 *     exist, is incompatible with this build, or was created with
+	 *     a different \c hash value.
+	 */
+	static ref<IrradianceCache> readCache(const fs::path &filename, uint64_t hash);
+
+	/// Return the number of stored irradiance records
+	size_t size() const;
+
 	/// Return a string representation
 	std::string toString() const;
 
@@ -324,18 +364,37 @@ public:
 protected:
 	/// Release all memory
 	virtual ~IrradianceCache();
+
+	/// Return all records, including ones in the thread-local staging buffers
+	void getRecords(std::vector<const Record *> &records) const;
 protected:
     /* ===================================================================== */
     /*                        Protected attributes                           */
     /* ===================================================================== */
 
+	/**
+	 * \brief Per-thread list of records that have not yet been
+	 * moved to \ref m_records.
+	 *
+	 * The lock is only contended while another thread enumerates
+	 * the records, hence insertion does not serialize on \ref m_mutex.
+	 */
+	struct StagingBuffer {
+		std::vector<Record *> records;
+		mutable ref<Mutex> mutex;
+
+		inline StagingBuffer() : mutex(new Mutex()) { }
+	};
+
 	DynamicOctree<Record *> m_octree;
 	std::vector<Record *> m_records;
+	std::vector<StagingBuffer *> m_stagingBuffers;
+	PrimitiveThreadLocal<StagingBuffer *> m_staging;
 	Float m_kappa;
 	Float m_sceneSize;
 	Float m_minDist, m_maxDist;
 	bool m_clampScreen, m_clampNeighbor, m_useGradients;
-	ref<Mutex> m_mutex;
+	mutable ref<Mutex> m_mutex;
 };
 
 MTS_NAMESPACE_END
@@ -183,6 +183,35 @@ public:
 	/// Serialize a photon map to a binary data stream
 	void serialize(Stream *stream, InstanceManager *manager) const;
 
+	/**
+	 * \brief Write the photon map to a cache file on disk
+	 *
+	 * The photons are stored in their in-memory representation, hence
+	 * the photon map should already have been built. The cache can only
+	 * be loaded by a Mitsuba build with the same floating point precision,
+	 * spectral representation and byte order.
+	 *
+	 * \param filename
+	 *     Destination file (will be overwritten)
+	 * \param hash
+	 *     Hash value identifying the photon map's contents (usually
+	 *     \ref Scene::computeContentHash() combined with the integrator
+	 *     configuration), which is checked by \ref readCache().
+	 */
+	void writeCache(const fs::path &filename, uint64_t hash) const;
+
+	/**
+	 * \brief Load a photon map written by \ref writeCache()
+	 *
+	 * The file is memory-mapped and its contents are bulk-copied into
+	 * an already built photon map.
+	 *
+	 * \return The photon map, or \c NULL if the file does not exist, is
+	 *     incompatible with this build, or was created with a different
+	 *     \c hash value.
+	 */
+	static ref<PhotonMap> readCache(const fs::path &filename, uint64_t hash);
+
 	/// Dump the photons to an OBJ file to analyze their spatial distribution
 	void dumpOBJ(const std::string &filename);
 
@@ -198,6 +227,144 @@ protected:
 	Float m_scale;
 };
 
+/** \brief Uniform spatial hash grid over the photons of a \ref PhotonMap
+ *
+ * This is an alternative lookup structure for progressive photon mapping
+ * techniques, which issue a very large number of fixed-radius queries
+ * against a photon map that is discarded after every pass. Compared to
+ * the kd-tree, the grid is much cheaper to (re-)build, since it only
+ * requires a parallel counting sort of the photons by their cell hash.
+ * Photons are stored contiguously per cell, which keeps the queries
+ * cache-friendly.
+ *
+ * The cell size is chosen by the caller and should usually be set to
+ * twice the largest query radius, in which case every query touches
+ * at most 8 cells.
+ *
+ * \ingroup librender
+ * \sa PhotonMap
+ */
+class MTS_EXPORT_RENDER PhotonHashGrid : public Object {
+public:
+	/// Create an empty hash grid
+	PhotonHashGrid();
+
+	/**
+	 * \brief (Re-)build the hash grid over the photons of a photon map
+	 *
+	 * The photon map does not need to be built (i.e. its kd-tree is
+	 * never accessed). Construction is parallelized using OpenMP.
+	 *
+	 * \param photonMap
+	 *     Photon map, whose photons should be inserted into the grid
+	 * \param cellSize
+	 *     Side length of a grid cell in world space units
+	 */
+	void build(const PhotonMap *photonMap, Float cellSize);
+
+	/**
+	 * \brief Compute scattered contributions from all photons within
+	 * the specified radius.
+	 *
+	 * Equivalent to \ref PhotonMap::estimateRadianceRaw(), see its
+	 * documentation for details.
+	 */
+	size_t estimateRadianceRaw(const Intersection &its,
+		Float searchRadius, Spectrum &result, int maxDepth) const;
+
+	/**
+	 * \brief Run a search query
+	 *
+	 * \param p Search position
+	 * \param searchRadius Search radius
+	 * \param functor Functor to be called on each photon within the radius
+	 * \return The number of functor invocations
+	 */
+	template <typename Functor> size_t executeQuery(const Point &p,
+			Float searchRadius, Functor &functor) const {
+		if (m_photons.empty())
+			return 0;
+
+		Vector offset(searchRadius);
+		Point3i min = getCell(p - offset),
+		        max = getCell(p + offset);
+		size_t nCells = (size_t) (max.x - min.x + 1)
+		              * (size_t) (max.y - min.y + 1)
+		              * (size_t) (max.z - min.z + 1);
+
+		/* Distinct cells may map to the same hash table entry -- make
+		   sure that each one is only visited once */
+		uint32_t *visited = (uint32_t *) alloca(nCells * sizeof(uint32_t));
+		Float distSquared = searchRadius*searchRadius;
+		size_t nVisited = 0, found = 0;
+
+		for (int z=min.z; z<=max.z; ++z) {
+			for (int y=min.y; y<=max.y; ++y) {
+				for (int x=min.x; x<=max.x; ++x) {
+					uint32_t entry = hash(x, y, z);
+
+					bool duplicate = false;
+					for (size_t i=0; i<nVisited; ++i) {
+						if (visited[i] == entry) {
+							duplicate = true;
+							break;
+						}
+					}
+					if (duplicate)
+						continue;
+					visited[nVisited++] = entry;
+
+					for (uint32_t i=m_cellStarts[entry]; i<m_cellStarts[entry+1]; ++i) {
+						const Photon &photon = m_photons[i];
+						if ((photon.getPosition() - p).lengthSquared() > distSquared)
+							continue;
+						functor(photon);
+						++found;
+					}
+				}
+			}
+		}
+		return found;
+	}
+
+	/// Return the number of photons stored in the grid
+	inline size_t size() const { return m_photons.size(); }
+
+	/// Return the side length of a grid cell
+	inline Float getCellSize() const { return m_cellSize; }
+
+	/// Return the number of hash table entries
+	inline size_t getTableSize() const { return m_cellStarts.empty() ? 0 : m_cellStarts.size() - 1; }
+
+	/// Return a string representation
+	std::string toString() const;
+
+	MTS_DECLARE_CLASS()
+protected:
+	/// Virtual destructor
+	virtual ~PhotonHashGrid();
+
+	/// Return the integer coordinates of the cell containing \c p
+	inline Point3i getCell(const Point &p) const {
+		return Point3i(
+			math::floorToInt((p.x - m_origin.x) * m_invCellSize),
+			math::floorToInt((p.y - m_origin.y) * m_invCellSize),
+			math::floorToInt((p.z - m_origin.z) * m_invCellSize));
+	}
+
+	/// Map integer cell coordinates to a hash table entry
+	inline uint32_t hash(int x, int y, int z) const {
+		return (((uint32_t) x * 73856093u) ^ ((uint32_t) y * 19349663u)
+			^ ((uint32_t) z * 83492791u)) & m_tableMask;
+	}
+protected:
+	std::vector<Photon> m_photons;
+	std::vector<uint32_t> m_cellStarts;
+	Point m_origin;
+	Float m_cellSize, m_invCellSize;
+	uint32_t m_tableMask;
+};
+
 MTS_NAMESPACE_END
 
 #endif /* __MITSUBA_RENDER_PHOTONMAP_H_ */
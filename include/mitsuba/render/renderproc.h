@@ -62,6 +62,23 @@ public:
 	void setPixelFormat(Bitmap::EPixelFormat pixelFormat,
 		int channelCount = -1, bool warnInvalid = false);
 
+	/**
+	 * \brief Accumulate per-pixel sample statistics into a bitmap
+	 *
+	 * When set, the rendered image blocks track per-pixel variance
+	 * information (see \ref ImageBlock::setVarianceTracking()), which is
+	 * accumulated into the provided bitmap as blocks are completed. The
+	 * bitmap must have 7 channels and match the film's crop size.
+	 */
+	void setVarianceBuffer(Bitmap *variance);
+
+	/**
+	 * \brief Only render a subset of the samples of each pixel
+	 *
+	 * \sa Sampler::setSampleRange()
+	 */
+	void setSampleRange(size_t start, size_t count);
+
 	// ======================================================================
 	//! @{ \name Implementation of the ParallelProcess interface
 	// ======================================================================
@@ -82,6 +99,7 @@ protected:
 	ref<RenderQueue> m_queue;
 	ref<Scene> m_scene;
 	ref<Film> m_film;
+	ref<Bitmap> m_variance;
 	const RenderJob *m_parent;
 	int m_resultCount;
 	ref<Mutex> m_resultMutex;
@@ -90,6 +108,7 @@ protected:
 	Bitmap::EPixelFormat m_pixelFormat;
 	int m_channelCount;
 	bool m_warnInvalid;
+	size_t m_sampleRangeStart, m_sampleRangeCount;
 };
 
 MTS_NAMESPACE_END
@@ -152,12 +152,60 @@ public:
 	/// Same as \ref request2DArray(), but in 1D
 	virtual void request1DArray(size_t size);
 
+	/**
+	 * \brief Generate the leading 2D dimensions of all samples
+	 * of the current pixel in one call
+	 *
+	 * This function may only be called directly after \ref generate().
+	 * Upon success, <tt>dest[i*dimCount + j]</tt> contains the value
+	 * that the <tt>j</tt>-th call to \ref next2D() would have returned for
+	 * sample <tt>i</tt>, and \c dest must thus have space for
+	 * <tt>getSampleCount() * dimCount</tt> entries. Subsequent calls to
+	 * \ref next1D() and \ref next2D() continue after these dimensions
+	 * for every sample of the pixel.
+	 *
+	 * Samplers that can compute their samples in closed form implement
+	 * this without any per-sample virtual calls and process one dimension
+	 * of all samples at a time. The default implementation does nothing
+	 * and returns \c false, in which case the caller should draw the
+	 * samples individually using \ref next2D().
+	 */
+	virtual bool generate2DBlock(Point2 *dest, size_t dimCount);
+
 	/// Return total number of samples
 	inline size_t getSampleCount() const { return m_sampleCount; }
 
 	/// Return the current sample index
 	inline size_t getSampleIndex() const { return m_sampleIndex; }
 
+	/**
+	 * \brief Restrict block rendering to a range of sample indices
+	 *
+	 * Progressive rendering uses this to split the \ref getSampleCount()
+	 * samples of each pixel into several passes: during a pass,
+	 * \ref SamplingIntegrator::renderBlock() only renders the samples
+	 * with indices in <tt>[start, start+count)</tt>. Since the sample
+	 * indices are preserved, deterministic samplers produce the same
+	 * set of samples as when rendering all of them at once. Random
+	 * samplers may use the start index to select a separate random
+	 * number stream for every pass.
+	 */
+	virtual void setSampleRange(size_t start, size_t count) {
+		m_sampleRangeStart = start;
+		m_sampleRangeEnd = count > std::numeric_limits<size_t>::max() - start
+			? std::numeric_limits<size_t>::max() : start + count;
+	}
+
+	/// Return the first sample index of the current sample range
+	inline size_t getSampleRangeStart() const {
+		return std::min(m_sampleRangeStart, m_sampleCount);
+	}
+
+	/// Return the end (exclusive) of the current sample range
+	inline size_t getSampleRangeEnd() const {
+		return std::min(m_sampleRangeEnd, m_sampleCount);
+	}
+
 	/// Serialize this sampler to a binary data stream
 	virtual void serialize(Stream *stream, InstanceManager *manager) const;
 
@@ -174,6 +222,7 @@ protected:
 protected:
 	size_t m_sampleCount;
 	size_t m_sampleIndex;
+	size_t m_sampleRangeStart, m_sampleRangeEnd;
 	std::vector<size_t> m_req1D, m_req2D;
 	std::vector<Float *> m_sampleArrays1D;
 	std::vector<Point2 *> m_sampleArrays2D;
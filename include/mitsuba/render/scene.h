@@ -25,6 +25,7 @@
 #include <mitsuba/core/aabb.h>
 #include <mitsuba/render/trimesh.h>
 #include <mitsuba/render/skdtree.h>
+#include <mitsuba/render/ibvh.h>
 #include <mitsuba/render/sensor.h>
 #include <mitsuba/render/integrator.h>
 #include <mitsuba/render/bsdf.h>
@@ -89,6 +90,73 @@ public:
 	 */
 	void initializeBidirectional();
 
+	// =============================================================
+	//! @{ \name Incremental scene updates
+	// =============================================================
+
+	/**
+	 * \brief Enable or disable incremental scene updates
+	 *
+	 * When enabled, \ref initialize() places each ordinary shape into
+	 * a private shape group with its own kd-tree and references it from
+	 * the scene through an \c instance. The scene's kd-tree is then only
+	 * a small top-level structure over these instances, which can be
+	 * rebuilt in a fraction of the time needed for the full geometry
+	 * after calls to \ref setShapeTransform(), \ref insertShape(),
+	 * or \ref removeShape().
+	 *
+	 * Shapes with attached emitters, sensors, or subsurface integrators
+	 * cannot be instanced and are left as they are. This setting must
+	 * be chosen before the scene is initialized; it corresponds to the
+	 * boolean scene parameter \c incremental.
+	 */
+	inline void setIncremental(bool incremental) { m_incremental = incremental; }
+
+	/// Are incremental scene updates enabled?
+	inline bool isIncremental() const { return m_incremental; }
+
+	/**
+	 * \brief Change the object-to-world transformation of a shape
+	 *
+	 * \c shape may either be a shape that was added to an incremental
+	 * scene (in which case the transformation is applied to its original
+	 * world-space geometry) or an \c instance. The change takes effect
+	 * after the next call to \ref update().
+	 */
+	void setShapeTransform(Shape *shape, const AnimatedTransform *trafo);
+
+	/// \copydoc setShapeTransform()
+	void setShapeTransform(Shape *shape, const Transform &trafo);
+
+	/**
+	 * \brief Add a shape to an already initialized scene
+	 *
+	 * Only the new shape's own kd-tree is constructed; the change
+	 * takes effect after the next call to \ref update().
+	 */
+	void insertShape(Shape *shape);
+
+	/**
+	 * \brief Remove a shape from an already initialized scene
+	 *
+	 * The change takes effect after the next call to \ref update().
+	 */
+	void removeShape(Shape *shape);
+
+	/**
+	 * \brief Rebuild the top-level kd-tree after shapes were moved,
+	 * added or removed
+	 *
+	 * Must not be called while the scene is being rendered.
+	 */
+	void update();
+
+	/// Are there pending changes that require a call to \ref update()?
+	inline bool isDirty() const { return m_dirty; }
+
+	//! @}
+	// =============================================================
+
 	/**
 	 * \brief Perform any pre-processing steps before rendering
 	 *
@@ -1120,6 +1188,17 @@ public:
 	/// Return the block resolution used to split images into parallel workloads
 	inline uint32_t getBlockSize() const { return m_blockSize; }
 
+	/**
+	 * \brief Compute a hash value summarizing the scene's geometry,
+	 * materials, emitters and participating media
+	 *
+	 * The sensor, film and sampler are deliberately left out, since
+	 * view-independent precomputations (e.g. photon maps) remain valid
+	 * when only they change. This is used to detect stale on-disk caches;
+	 * the value is not guaranteed to be stable across Mitsuba versions.
+	 */
+	uint64_t computeContentHash() const;
+
 	/// Serialize the whole scene to a network/file stream
 	void serialize(Stream *stream, InstanceManager *manager) const;
 
@@ -1142,6 +1221,18 @@ protected:
 	/// \cond
 	/// Add a shape to the scene
 	void addShape(Shape *shape);
+
+	/// Wrap a shape into a shape group and instance (incremental scenes only)
+	ref<Shape> createInstance(Shape *shape);
+
+	/// Replace the kd-tree by a new one with the same parameters over \ref m_shapes
+	void rebuildKDTree();
+
+	/// Fill the given kd-tree with \ref m_shapes (collecting instances into a BVH) and build it
+	void buildKDTree(ShapeKDTree *kdtree);
+
+	/// Look up the top-level shape that represents \c shape
+	Shape *getTopLevelShape(Shape *shape);
 	/// \endcond
 private:
 	ref<ShapeKDTree> m_kdtree;
@@ -1158,6 +1249,10 @@ private:
 	ref_vector<Subsurface> m_ssIntegrators;
 	ref_vector<Medium> m_media;
 	std::vector<TriMesh *> m_meshes;
+	std::map<const Shape *, Shape *> m_instances;
+	ref<InstanceBVH> m_instanceBVH;
+	AABB m_instanceBVHBounds;
+	size_t m_instanceBVHThreshold;
 	fs::path *m_sourceFile;
 	fs::path *m_destinationFile;
 	DiscreteDistribution m_emitterPDF;
@@ -1165,6 +1260,9 @@ private:
 	uint32_t m_blockSize;
 	bool m_degenerateSensor;
 	bool m_degenerateEmitters;
+	bool m_incremental;
+	bool m_dirty;
+	bool m_rebuild;
 };
 
 MTS_NAMESPACE_END
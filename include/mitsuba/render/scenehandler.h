@@ -25,6 +25,7 @@
 #include <mitsuba/core/plugin.h>
 #include <mitsuba/core/properties.h>
 #include <mitsuba/core/version.h>
+#include <mitsuba/core/timer.h>
 #include <boost/unordered_map.hpp>
 #include <stack>
 #include <map>
@@ -97,12 +98,37 @@ public:
 	static ref<Scene> loadSceneFromString(const std::string &string,
 		const ParameterMap &params= ParameterMap());
 
+	/**
+	 * \brief Load a scene from a given filename, using a binary
+	 * cache of the parsed scene description when possible
+	 *
+	 * The cache stores the elements and attributes of the scene file
+	 * and of all files it includes. When it was created by the same
+	 * version of Mitsuba with the same parameters, and none of the
+	 * source files has changed (according to their size and time
+	 * stamp), the scene is instantiated from the cache without
+	 * invoking the XML parser. Otherwise, the scene is parsed and
+	 * the cache is (re-)created.
+	 */
+	static ref<Scene> loadSceneCached(const fs::path &filename,
+		const fs::path &cacheFile, const ParameterMap &params = ParameterMap());
+
 	/// Initialize Xerces-C++ (needs to be called once at program startup)
 	static void staticInitialization();
 
 	/// Free the memory taken up by staticInitialization()
 	static void staticShutdown();
 
+	/**
+	 * \brief Enable or disable the construction of expensive objects
+	 * (meshes loaded from disk and bitmap textures) on worker threads
+	 * while the scene file is being parsed. Enabled by default.
+	 */
+	static void setParallelLoading(bool value);
+
+	/// Is parallel construction of scene objects enabled?
+	static bool getParallelLoading();
+
 	// -----------------------------------------------------------------------
 	//  Implementation of the SAX DocumentHandler interface
 	// -----------------------------------------------------------------------
@@ -134,6 +160,26 @@ protected:
 	void clear();
 
 private:
+	/// An object that is being constructed on a worker thread
+	class DeferredObject;
+	/// Worker threads that construct \ref DeferredObject instances
+	class WorkerPool;
+	/// Recorded elements of a scene description (see \ref loadSceneCached())
+	class SceneCache;
+	typedef std::vector<std::pair<std::string, std::string> > AttributeVector;
+
+	/// Timing information that is reported once the scene has been loaded
+	struct LoadStatistics {
+		Float constructionTime; ///< Time spent in object constructors (all threads)
+		Float waitTime;         ///< Time the parser waited for worker threads
+		Float configureTime;    ///< Time spent in configure() calls
+		size_t objectCount;     ///< Number of constructed objects
+		size_t deferredCount;   ///< .. of which were constructed by worker threads
+
+		inline LoadStatistics() : constructionTime(0), waitTime(0),
+			configureTime(0), objectCount(0), deferredCount(0) { }
+	};
+
 	/**
 	 * Enumeration of all possible tags that can be encountered in a
 	 * Mitsuba scene file
@@ -160,12 +206,40 @@ private:
 		Properties properties;
 		std::map<std::string, std::string> attributes;
 		std::vector<std::pair<std::string, ConfigurableObject *> > children;
+		/// Entries of \c children that are still under construction
+		std::vector<std::pair<size_t, ref<DeferredObject> > > deferred;
 	};
 
 
+
 	typedef std::pair<ETag, const Class *> TagEntry;
 	typedef boost::unordered_map<std::string, TagEntry> TagMap;
 
+	/// Should the object for the given tag be constructed on a worker thread?
+	bool isDeferrable(const TagEntry &tag, const Properties &props) const;
+
+	/// Wait for the deferred children of a context and insert them into \c children
+	void resolveDeferred(ParseContext &context);
+
+	/// Wait for a deferred object, then attach its children and configure it
+	ConfigurableObject *finishDeferred(DeferredObject *deferred);
+
+	/// Called once an object has been created: attach its children and configure it
+	void setupObject(ref<ConfigurableObject> &object, const std::string &name,
+		std::vector<std::pair<std::string, ConfigurableObject *> > &children);
+
+	/// Ensure that a deferred object with the given ID (if any) has been finished
+	void resolveNamedObject(const std::string &id);
+
+	/// Handle an opening tag (with its attributes before parameter substitution)
+	void processStartElement(const std::string &name, const AttributeVector &attributes);
+
+	/// Handle a closing tag
+	void processEndElement(const std::string &name);
+
+	/// Feed recorded elements from \c m_replay into the handler
+	void replay();
+
 	const xercesc::Locator *m_locator;
 	xercesc::XMLTranscoder* m_transcoder;
 	ref<Scene> m_scene;
@@ -177,6 +251,13 @@ private:
 	Transform m_transform;
 	ref<AnimatedTransform> m_animatedTransform;
 	bool m_isIncludedFile;
+	ref<WorkerPool> m_pool;
+	/// Named objects that are still being constructed (shared with included files)
+	std::map<std::string, ref<DeferredObject> > m_localDeferredNamed, *m_deferredNamed;
+	ref<SceneCache> m_recording, m_replay;
+	LoadStatistics m_localStats, *m_stats;
+	ref<Timer> m_timer;
+	static bool m_parallelLoading;
 };
 
 MTS_NAMESPACE_END
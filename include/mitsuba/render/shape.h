@@ -196,6 +196,32 @@ public:
 	 */
 	virtual Shape *getElement(int i);
 
+	/**
+	 * \brief Replace the object-to-world transformation of
+	 * an instanced shape
+	 *
+	 * Used by \ref Scene::setShapeTransform() to move geometry
+	 * without rebuilding its acceleration data structure.
+	 *
+	 * The default implementation throws an exception
+	 */
+	virtual void setWorldTransform(const AnimatedTransform *trafo);
+
+	/**
+	 * \brief Return the object-to-world transformation of an
+	 * instanced shape
+	 *
+	 * The default implementation returns \c NULL
+	 */
+	virtual const AnimatedTransform *getWorldTransform() const;
+
+	/**
+	 * \brief Return the shape group referenced by an instance
+	 *
+	 * The default implementation returns \c NULL
+	 */
+	virtual const Shape *getShapeGroup() const;
+
 	/**
 	 * \brief Return the shape's surface area
 	 *
@@ -219,6 +245,17 @@ public:
 	 */
 	virtual AABB getClippedAABB(const AABB &box) const;
 
+	/**
+	 * \brief Return a bounding box containing the shape during
+	 * the time interval <tt>[start, end]</tt>
+	 *
+	 * Acceleration data structures use this to bound motion-blurred
+	 * geometry separately for shorter parts of the shutter interval.
+	 * The default implementation returns \ref getAABB(), which is
+	 * the right choice for shapes that do not move.
+	 */
+	virtual AABB getMotionAABB(Float start, Float end) const;
+
 	/**
 	 * \brief Create a triangle mesh approximation of this shape
 	 *
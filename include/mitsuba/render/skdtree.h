@@ -348,8 +348,6 @@ protected:
 			const TriMesh *trimesh = static_cast<const TriMesh *>(shape);
 			const Triangle &tri = trimesh->getTriangles()[cache->primIndex];
 			const Point *vertexPositions = trimesh->getVertexPositions();
-			const Normal *vertexNormals = trimesh->getVertexNormals();
-			const Point2 *vertexTexcoords = trimesh->getVertexTexcoords();
 			const Color3 *vertexColors = trimesh->getVertexColors();
 			const TangentSpace *vertexTangents = trimesh->getUVTangents();
 			const Vector b(1 - cache->u - cache->v, cache->u, cache->v);
@@ -374,16 +372,22 @@ protected:
 				const TangentSpace &ts = vertexTangents[cache->primIndex];
 				its.dpdu = ts.dpdu;
 				its.dpdv = ts.dpdv;
+			} else if (EXPECT_NOT_TAKEN(trimesh->isQuantized() && trimesh->hasVertexTexcoords())) {
+				const TangentSpace ts = trimesh->computeUVTangent(cache->primIndex);
+				its.dpdu = ts.dpdu;
+				its.dpdv = ts.dpdv;
 			} else {
 				its.dpdu = side1;
 				its.dpdv = side2;
 			}
 
-			if (EXPECT_TAKEN(vertexNormals)) {
+			/* The vertex attributes may be stored in quantized form
+			   (see TriMesh::quantize()), which is decoded here */
+			if (EXPECT_TAKEN(trimesh->hasVertexNormals())) {
 				const Normal
-					&n0 = vertexNormals[idx0],
-					&n1 = vertexNormals[idx1],
-					&n2 = vertexNormals[idx2];
+					n0 = trimesh->getVertexNormal(idx0),
+					n1 = trimesh->getVertexNormal(idx1),
+					n2 = trimesh->getVertexNormal(idx2);
 
 				its.shFrame.n = normalize(n0 * b.x + n1 * b.y + n2 * b.z);
 
@@ -395,10 +399,10 @@ protected:
 			}
 			its.geoFrame = Frame(faceNormal);
 
-			if (EXPECT_TAKEN(vertexTexcoords)) {
-				const Point2 &t0 = vertexTexcoords[idx0];
-				const Point2 &t1 = vertexTexcoords[idx1];
-				const Point2 &t2 = vertexTexcoords[idx2];
+			if (EXPECT_TAKEN(trimesh->hasVertexTexcoords())) {
+				const Point2 t0 = trimesh->getVertexTexcoord(idx0);
+				const Point2 t1 = trimesh->getVertexTexcoord(idx1);
+				const Point2 t2 = trimesh->getVertexTexcoord(idx2);
 				its.uv = t0 * b.x + t1 * b.y + t2 * b.z;
 			} else {
 				its.uv = Point2(b.y, b.z);
@@ -133,12 +133,23 @@ public:
 	/// Return the vertex positions
 	inline Point *getVertexPositions() { return m_positions; };
 
-	/// Return the vertex normals (const version)
+	/**
+	 * \brief Return the vertex normals (const version)
+	 *
+	 * Returns \c NULL when the normals are stored in quantized
+	 * form (see \ref quantize()). Use \ref getVertexNormal() to
+	 * access them in either case.
+	 */
 	inline const Normal *getVertexNormals() const { return m_normals; };
-	/// Return the vertex normals
+	/// Return the vertex normals (or \c NULL for a quantized mesh)
 	inline Normal *getVertexNormals() { return m_normals; };
-	/// Does the mesh have vertex normals?
-	inline bool hasVertexNormals() const { return m_normals != NULL; };
+	/// Does the mesh have vertex normals (in full or quantized form)?
+	inline bool hasVertexNormals() const { return m_normals != NULL || m_packedNormals != NULL; };
+	/// Return the normal of a vertex, decoding it if necessary
+	inline Normal getVertexNormal(uint32_t index) const {
+		return EXPECT_TAKEN(m_normals) ? m_normals[index]
+			: decodeNormal(m_packedNormals[index]);
+	}
 
 	/// Return the vertex colors (const version)
 	inline const Color3 *getVertexColors() const { return m_colors; };
@@ -147,12 +158,27 @@ public:
 	/// Does the mesh have vertex colors?
 	inline bool hasVertexColors() const { return m_colors != NULL; };
 
-	/// Return the vertex texture coordinates (const version)
+	/**
+	 * \brief Return the vertex texture coordinates (const version)
+	 *
+	 * Returns \c NULL when the texture coordinates are stored in
+	 * quantized form (see \ref quantize()). Use \ref getVertexTexcoord()
+	 * to access them in either case.
+	 */
 	inline const Point2 *getVertexTexcoords() const { return m_texcoords; };
-	/// Return the vertex texture coordinates
+	/// Return the vertex texture coordinates (or \c NULL for a quantized mesh)
 	inline Point2 *getVertexTexcoords() { return m_texcoords; };
-	/// Does the mesh have vertex texture coordinates?
-	inline bool hasVertexTexcoords() const { return m_texcoords != NULL; };
+	/// Does the mesh have vertex texture coordinates (in full or quantized form)?
+	inline bool hasVertexTexcoords() const { return m_texcoords != NULL || m_packedTexcoords != NULL; };
+	/// Return the texture coordinates of a vertex, decoding them if necessary
+	inline Point2 getVertexTexcoord(uint32_t index) const {
+		if (EXPECT_TAKEN(m_texcoords))
+			return m_texcoords[index];
+		uint32_t uv = m_packedTexcoords[index];
+		return Point2(
+			m_uvOffset.x + (Float) (uv & 0xFFFF) * m_uvScale.x,
+			m_uvOffset.y + (Float) (uv >> 16) * m_uvScale.y);
+	}
 
 	/// Return the per-triangle UV tangents (const version)
 	inline const TangentSpace *getUVTangents() const { return m_tangents; };
@@ -209,10 +235,19 @@ public:
 	 * a user-specified set of UV coordinates
 	 *
 	 * Will throw an exception when no UV coordinates are
-	 * associated with the mesh.
+	 * associated with the mesh. Quantized meshes don't store
+	 * these vectors (see \ref computeUVTangent()).
 	 */
 	void computeUVTangents();
 
+	/**
+	 * \brief Compute the space basis vectors of a single triangle
+	 *
+	 * Used to generate them on demand for quantized meshes. Returns
+	 * zero vectors for degenerate triangles.
+	 */
+	TangentSpace computeUVTangent(size_t index) const;
+
 	/**
 	 * \brief Generate smooth vertex normals?
 	 *
@@ -239,6 +274,49 @@ public:
 	 */
 	void rebuildTopology(Float maxAngle);
 
+	/**
+	 * \brief Store the vertex normals and texture coordinates in a
+	 * compact quantized form
+	 *
+	 * Normals are converted into an octahedral encoding with two 16-bit
+	 * components (4 instead of 12 bytes), and texture coordinates are
+	 * converted to 16-bit fixed point values relative to their bounding
+	 * rectangle (4 instead of 8 bytes). The full precision arrays and the
+	 * per-triangle UV tangents are released, and intersection queries
+	 * decode or recompute the data on the fly. This is useful for very
+	 * large scenes, whose geometry would not otherwise fit into memory.
+	 * Vertex positions and triangle indices are not affected, since the
+	 * kd-tree accesses them directly.
+	 *
+	 * Can also be requested by setting the \c quantize parameter of
+	 * the mesh plugins, in which case it is done by \ref configure().
+	 */
+	void quantize();
+
+	/// Are the normals and texture coordinates stored in quantized form?
+	inline bool isQuantized() const { return m_packedNormals != NULL || m_packedTexcoords != NULL; }
+
+	/// Return the approximate amount of memory used by the mesh data (in bytes)
+	size_t getMemoryUsage() const;
+
+	/// Convert a unit vector into a 32-bit octahedral representation
+	static uint32_t encodeNormal(const Normal &n);
+
+	/// Convert a 32-bit octahedral representation back into a unit vector
+	static inline Normal decodeNormal(uint32_t value) {
+		Float x = (int16_t) (value & 0xFFFF) * (1.0f / 32767.0f),
+		      y = (int16_t) (value >> 16) * (1.0f / 32767.0f),
+		      z = 1.0f - std::abs(x) - std::abs(y);
+
+		if (z < 0) {
+			Float tmp = x;
+			x = math::signum(x) * (1.0f - std::abs(y));
+			y = math::signum(y) * (1.0f - std::abs(tmp));
+		}
+
+		return normalize(Normal(x, y, z));
+	}
+
 	/// Serialize to a file/network stream
 	void serialize(Stream *stream, InstanceManager *manager) const;
 
@@ -358,12 +436,17 @@ protected:
 	Point *m_positions;
 	Normal *m_normals;
 	Point2 *m_texcoords;
+	uint32_t *m_packedNormals;
+	uint32_t *m_packedTexcoords;
+	Point2 m_uvOffset;
+	Vector2 m_uvScale;
 	TangentSpace *m_tangents;
 	Color3 *m_colors;
 	size_t m_triangleCount;
 	size_t m_vertexCount;
 	bool m_flipNormals;
 	bool m_faceNormals;
+	bool m_quantize;
 
 	/* Surface and distribution -- generated on demand */
 	DiscreteDistribution m_areaDistr;
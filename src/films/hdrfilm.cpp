@@ -519,7 +519,6 @@ public:
 			filename.replace_extension(properExtension);
 
 		Log(EInfo, "Writing image to \"%s\" ..", filename.string().c_str());
-		ref<FileStream> stream = new FileStream(filename, FileStream::ETruncWrite);
 
 		if (m_pixelFormats.size() == 1)
 			annotate(scene, m_properties, bitmap, renderTime, 1.0f);
@@ -533,7 +532,16 @@ public:
 			bitmap->setMetadataString("log", log);
 		}
 
-		bitmap->write(m_fileFormat, stream);
+		if (m_asyncWrite) {
+			bitmap->writeAsync(m_fileFormat, filename);
+		} else {
+			ref<FileStream> stream = new FileStream(filename, FileStream::ETruncWrite);
+			bitmap->write(m_fileFormat, stream);
+		}
+	}
+
+	ImageBlock *getImageBlock() {
+		return m_storage;
 	}
 
 	bool hasAlpha() const {
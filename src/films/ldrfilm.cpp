@@ -345,11 +345,19 @@ public:
 			filename.replace_extension(expectedExtension);
 
 		Log(EInfo, "Writing image to \"%s\" ..", filename.string().c_str());
-		ref<FileStream> stream = new FileStream(filename, FileStream::ETruncWrite);
 
 		annotate(scene, m_properties, bitmap, renderTime, m_gamma);
 
-		bitmap->write(m_fileFormat, stream);
+		if (m_asyncWrite) {
+			bitmap->writeAsync(m_fileFormat, filename);
+		} else {
+			ref<FileStream> stream = new FileStream(filename, FileStream::ETruncWrite);
+			bitmap->write(m_fileFormat, stream);
+		}
+	}
+
+	ImageBlock *getImageBlock() {
+		return m_storage;
 	}
 
 	bool hasAlpha() const {
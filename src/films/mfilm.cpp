@@ -363,6 +363,10 @@ public:
 		return fs::exists(filename);
 	}
 
+	ImageBlock *getImageBlock() {
+		return m_storage;
+	}
+
 	bool hasAlpha() const {
 		return
 			m_pixelFormat == Bitmap::ELuminanceAlpha ||
@@ -17,8 +17,11 @@
 */
 
 #include <mitsuba/render/scene.h>
+#include <mitsuba/render/renderproc.h>
 #include <mitsuba/core/statistics.h>
+#include <mitsuba/core/timer.h>
 #include <boost/math/distributions/normal.hpp>
+#include <boost/algorithm/string.hpp>
 
 MTS_NAMESPACE_BEGIN
 
@@ -40,6 +43,25 @@ MTS_NAMESPACE_BEGIN
  *         the \code{sampler}, this means that the adaptive integrator
  *         will give up after 32*64=2048 samples}
  *     }
+ *     \parameter{mode}{\String}{
+ *         Specifies how samples are distributed over the image.
+ *         \begin{enumerate}[(i)]
+ *             \item \code{pixel}: each pixel is sampled until it satisfies
+ *             the error criterion, independently of all other pixels.
+ *             \item \code{film}: the image is rendered in several passes
+ *             of \code{sampleCount} samples per pixel. After every pass,
+ *             the per-pixel variance of all blocks is analyzed, and the
+ *             following pass only revisits the blocks that have not yet
+ *             converged, starting with those that have the highest error.
+ *         \end{enumerate}
+ *         \default{\code{pixel}}
+ *     }
+ *     \parameter{timeLimit}{\Float}{
+ *         Only used in \code{film} mode: stop rendering after this many
+ *         seconds, even if the error criterion has not yet been satisfied
+ *         everywhere. The pass that is running when the limit is reached
+ *         is cut short. A value of zero disables the limit \default{0}
+ *     }
  * }
  *
  * This ``meta-integrator'' repeatedly invokes a provided sub-integrator
@@ -56,7 +78,18 @@ MTS_NAMESPACE_BEGIN
  * </integrator>
  * \end{xml}
  *
+ * In \code{film} mode, the error of a pixel is determined separately for
+ * each linear RGB channel, and a block counts as converged once all
+ * of its pixels satisfy the error bound. Here, the \code{maxSampleFactor}
+ * parameter bounds the number of passes. Since samples are no longer spent
+ * on converged regions of the image, this mode is usually preferable when
+ * only a few parts of the scene are noisy, and it can be combined with a
+ * time budget.
+ *
  * \remarks{
+ *    \item Both modes require the \pluginref{independent} sampler. Deterministic
+ *    samplers generate the same samples whenever a pixel is revisited, which
+ *    would add no information in later passes of the \code{film} mode.
  *    \item The adaptive integrator needs a variance estimate to work
  *     correctly. Hence, the underlying sample generator should be set to a reasonably
  *     large number of pixel samples (e.g. 64 or higher) so that this estimate can be obtained.
@@ -78,6 +111,19 @@ public:
 		/* Required P-value to accept a sample. */
 		m_pValue = props.getFloat("pValue", 0.05f);
 		m_verbose = props.getBoolean("verbose", false);
+
+		std::string mode = boost::to_lower_copy(props.getString("mode", "pixel"));
+		if (mode == "pixel")
+			m_filmMode = false;
+		else if (mode == "film")
+			m_filmMode = true;
+		else
+			Log(EError, "Unknown adaptive sampling mode \"%s\"!", mode.c_str());
+
+		/* Time limit in seconds for the 'film' mode (0 = unlimited) */
+		m_timeLimit = props.getFloat("timeLimit", 0.0f);
+		if (m_timeLimit < 0)
+			Log(EError, "'timeLimit' must be nonnegative!");
 	}
 
 	AdaptiveIntegrator(Stream *stream, InstanceManager *manager)
@@ -88,6 +134,8 @@ public:
 		m_quantile = stream->readFloat();
 		m_averageLuminance = stream->readFloat();
 		m_pValue = stream->readFloat();
+		m_filmMode = stream->readBool();
+		m_timeLimit = stream->readFloat();
 		m_verbose = false;
 	}
 
@@ -116,9 +164,17 @@ public:
 			Log(EError, "No sub-integrator was specified!");
 		Sampler *sampler = static_cast<Sampler *>(Scheduler::getInstance()->getResource(samplerResID, 0));
 		Sensor *sensor = static_cast<Sensor *>(Scheduler::getInstance()->getResource(sensorResID));
+		/* Both modes take more than 'sampleCount' samples in some pixels:
+		   the pixel mode within a single call to renderBlock(), and the film
+		   mode by revisiting blocks in later passes with the same per-core
+		   sampler instances. Deterministic samplers would simply repeat the
+		   samples of the first pass, while the stream of the independent
+		   sampler continues where it left off */
 		if (sampler->getClass()->getName() != "IndependentSampler")
 			Log(EError, "The error-controlling integrator should only be "
-				"used in conjunction with the independent sampler");
+				"used in conjunction with the independent sampler%s",
+				m_filmMode ? " (deterministic samplers would produce the same "
+				"samples in every pass of the 'film' mode)" : "");
 		if (!m_subIntegrator->preprocess(scene, queue, job, sceneResID, sensorResID, samplerResID))
 			return false;
 
@@ -165,11 +221,146 @@ public:
 		return true;
 	}
 
+	bool render(Scene *scene, RenderQueue *queue, const RenderJob *job,
+			int sceneResID, int sensorResID, int samplerResID) {
+		if (!m_filmMode)
+			return SamplingIntegrator::render(scene, queue, job,
+				sceneResID, sensorResID, samplerResID);
+
+		ref<Scheduler> sched = Scheduler::getInstance();
+		ref<Sensor> sensor = static_cast<Sensor *>(sched->getResource(sensorResID));
+		ref<Film> film = sensor->getFilm();
+
+		size_t nCores = sched->getCoreCount();
+		const Sampler *sampler = static_cast<const Sampler *>(sched->getResource(samplerResID, 0));
+		size_t sampleCount = sampler->getSampleCount();
+
+		if (sampleCount < 2)
+			Log(EError, "The film-level adaptive sampling mode requires at "
+				"least 2 samples per pixel and pass!");
+
+		Log(EInfo, "Starting adaptive render job (%ix%i, " SIZE_T_FMT " %s per pass, "
+			SIZE_T_FMT " %s, " SSE_STR ") ..", film->getCropSize().x, film->getCropSize().y,
+			sampleCount, sampleCount == 1 ? "sample" : "samples", nCores,
+			nCores == 1 ? "core" : "cores");
+
+		/* Replicate the block layout of BlockedRenderProcess */
+		int blockSize = (int) scene->getBlockSize(),
+		    borderSize = film->getReconstructionFilter()->getBorderSize();
+		Point2i offset(0);
+		Vector2i size = film->getCropSize();
+		if (film->hasHighQualityEdges()) {
+			offset -= Vector2i(borderSize);
+			size += Vector2i(2 * borderSize);
+		}
+		Vector2i numBlocks(
+			(size.x + blockSize - 1) / blockSize,
+			(size.y + blockSize - 1) / blockSize);
+
+		ref<Bitmap> variance = new Bitmap(Bitmap::EMultiChannel,
+			Bitmap::EFloat, film->getCropSize(), 7);
+		variance->clear();
+
+		int integratorResID = sched->registerResource(this);
+		std::vector<Point2i> blocks;
+		std::vector<std::pair<Float, Point2i> > errors;
+		ref<Timer> timer = new Timer();
+		bool success = true;
+
+		for (int pass = 0; ; ++pass) {
+			ref<BlockedRenderProcess> proc = new BlockedRenderProcess(job,
+				queue, blockSize);
+			proc->setVarianceBuffer(variance);
+			proc->setBlockList(blocks);
+			proc->bindResource("integrator", integratorResID);
+			proc->bindResource("scene", sceneResID);
+			proc->bindResource("sensor", sensorResID);
+			proc->bindResource("sampler", samplerResID);
+			scene->bindUsedResources(proc);
+			bindUsedResources(proc);
+			sched->schedule(proc);
+
+			m_process = proc;
+			bool timeout = false;
+			if (m_timeLimit > 0) {
+				while (proc->getReturnStatus() == ParallelProcess::EUnknown) {
+					if (timer->getSeconds() >= m_timeLimit) {
+						timeout = true;
+						sched->cancel(proc);
+						break;
+					}
+					Thread::sleep(50);
+				}
+			}
+			sched->wait(proc);
+			m_process = NULL;
+
+			if (timeout) {
+				Log(EInfo, "Adaptive rendering: reached the time limit of %s "
+					"during pass %i", timeString(m_timeLimit).c_str(), pass+1);
+				break;
+			} else if (proc->getReturnStatus() != ParallelProcess::ESuccess) {
+				success = false;
+				break;
+			}
+
+			/* Determine the blocks that require further work */
+			errors.clear();
+			for (int by=0; by<numBlocks.y; ++by) {
+				for (int bx=0; bx<numBlocks.x; ++bx) {
+					Point2i min = offset + Vector2i(bx, by) * blockSize;
+					Point2i max = min + Vector2i(blockSize);
+					Float maxError = 0, avgError = 0;
+					int pixelCount = 0;
+
+					for (int y=std::max(min.y, 0); y<std::min(max.y, variance->getHeight()); ++y) {
+						for (int x=std::max(min.x, 0); x<std::min(max.x, variance->getWidth()); ++x) {
+							Float error = pixelError(variance->getFloatData()
+								+ (y * (size_t) variance->getWidth() + x) * 7);
+							maxError = std::max(maxError, error);
+							avgError += error;
+							++pixelCount;
+						}
+					}
+
+					if (pixelCount > 0 && maxError > m_maxError)
+						errors.push_back(std::make_pair(avgError / pixelCount,
+							Point2i(bx, by)));
+				}
+			}
+
+			Log(EInfo, "Adaptive rendering: pass %i done after %s, %i/%i blocks "
+				"have not converged", pass+1, timeString(timer->getSeconds()).c_str(),
+				(int) errors.size(), numBlocks.x * numBlocks.y);
+
+			if (errors.empty() || (m_maxSampleFactor >= 0 && pass+1 >= m_maxSampleFactor)
+					|| (m_timeLimit > 0 && timer->getSeconds() >= m_timeLimit))
+				break;
+
+			/* Visit the blocks with the highest error first */
+			std::sort(errors.begin(), errors.end(), ErrorOrdering());
+			blocks.clear();
+			for (size_t i=0; i<errors.size(); ++i)
+				blocks.push_back(errors[i].second);
+		}
+
+		sched->unregisterResource(integratorResID);
+
+		return success;
+	}
+
 	void renderBlock(const Scene *scene, const Sensor *sensor,
 			Sampler *sampler, ImageBlock *block, const bool &stop,
 			const std::vector< TPoint2<uint8_t> > &points) const {
 		typedef TSpectrum<Float, SPECTRUM_SAMPLES + 2> SpectrumAlphaWeight;
 
+		if (m_filmMode) {
+			/* Film-level mode: render a regular pass with the sub-integrator
+			   and let the block collect the per-pixel statistics */
+			m_subIntegrator->renderBlock(scene, sensor, sampler, block, stop, points);
+			return;
+		}
+
 		bool needsApertureSample = sensor->needsApertureSample();
 		bool needsTimeSample = sensor->needsTimeSample();
 
@@ -303,6 +494,8 @@ public:
 		stream->writeFloat(m_quantile);
 		stream->writeFloat(m_averageLuminance);
 		stream->writeFloat(m_pValue);
+		stream->writeBool(m_filmMode);
+		stream->writeFloat(m_timeLimit);
 	}
 
 	void bindUsedResources(ParallelProcess *proc) const {
@@ -332,16 +525,53 @@ public:
 			<< "  maxError = " << m_maxError << "," << endl
 			<< "  quantile = " << m_quantile << "," << endl
 			<< "  pvalue = " << m_pValue << "," << endl
+			<< "  mode = " << (m_filmMode ? "film" : "pixel") << "," << endl
+			<< "  timeLimit = " << m_timeLimit << "," << endl
 			<< "  subIntegrator = " << indent(m_subIntegrator->toString()) << endl
 			<< "]";
 		return oss.str();
 	}
 
 	MTS_DECLARE_CLASS()
+private:
+	/// Sorts blocks by decreasing error
+	struct ErrorOrdering {
+		inline bool operator()(const std::pair<Float, Point2i> &a,
+				const std::pair<Float, Point2i> &b) const {
+			return a.first > b.first;
+		}
+	};
+
+	/**
+	 * \brief Compute the relative error of a pixel from its sample statistics
+	 *
+	 * Returns the largest half width of the confidence interval over all
+	 * RGB channels, relative to the channel mean (but never relative to
+	 * less than 1% of the average image luminance)
+	 */
+	Float pixelError(const Float *stats) const {
+		const Float n = stats[0];
+		if (n < 2)
+			return std::numeric_limits<Float>::infinity();
+
+		Float error = 0;
+		for (int c=0; c<3; ++c) {
+			Float mean = stats[1+c] / n;
+			Float variance = std::max((Float) 0,
+				(stats[4+c] - stats[1+c] * mean) / (n - 1));
+			Float ciWidth = std::sqrt(variance / n) * m_quantile;
+			Float base = std::max(mean, m_averageLuminance * 0.01f);
+			if (base > 0)
+				error = std::max(error, ciWidth / base);
+		}
+		return error;
+	}
 private:
 	ref<SamplingIntegrator> m_subIntegrator;
 	Float m_maxError, m_quantile, m_pValue, m_averageLuminance;
+	Float m_timeLimit;
 	int m_maxSampleFactor;
+	bool m_filmMode;
 	bool m_verbose;
 };
 
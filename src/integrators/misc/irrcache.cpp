@@ -17,6 +17,7 @@
 */
 
 #include <mitsuba/core/plugin.h>
+#include <mitsuba/core/fresolver.h>
 #include "irrcache_proc.h"
 
 MTS_NAMESPACE_BEGIN
@@ -39,6 +40,8 @@ MTS_NAMESPACE_BEGIN
  *     \parameter{indirectOnly}{\Boolean}{Only show the indirect illumination? This can be useful to check
  *      the interpolation quality. \default{\code{false}}}
  *     \parameter{debug}{\Boolean}{Visualize the sample placement? \default{\code{false}}}
+ *     \parameter{cacheFile}{\String}{Filename of an on-disk irradiance cache, see below.
+ *      \default{none, i.e. the cache is never persisted}}
  * }
  * \renderings{
  *  \unframedbigrendering{Illustration of the effect of the different optimizatations
@@ -78,6 +81,14 @@ MTS_NAMESPACE_BEGIN
  * improve the achieved interpolation quality, namely irradiance gradients
  * \cite{Ward1992Irradiance}, neighbor clamping \cite{Krivanek2006Making}, a screen-space
  * clamping metric and an improved error function \cite{Tabellion2004Approximate}.
+ *
+ * When the \code{cacheFile} parameter is specified, the irradiance records are written
+ * to this file after rendering. Subsequent renderings load them instead of performing
+ * an overture pass, and any records that are added while rendering are written back.
+ * This is useful for walkthrough animations of static scenes. The file is tagged with a
+ * hash of the scene's geometry, materials, emitters and media as well as the parameters
+ * of this plugin and its sub-integrator; it is discarded automatically when any of these
+ * change. The sensor is not part of the hash.
  */
 
 class IrradianceCacheIntegrator : public SamplingIntegrator {
@@ -115,6 +126,10 @@ public:
 		/* If set to true, direct illumination will be suppressed -
 		   useful for checking the interpolation quality */
 		m_indirectOnly = props.getBoolean("indirectOnly", false);
+		/* Filename of the on-disk irradiance cache (empty = disabled) */
+		if (props.hasProperty("cacheFile"))
+			m_cacheFile = Thread::getThread()->getFileResolver()->resolve(
+				props.getString("cacheFile"));
 
 		if (m_debug)
 			m_overture = false;
@@ -192,6 +207,22 @@ public:
 		if (!m_subIntegrator->preprocess(scene, queue, job, sceneResID, sensorResID, samplerResID))
 			return false;
 
+		if (!m_cacheFile.empty()) {
+			std::string config = formatString("%i, %f, %f, %i, %i, %i, %i, %s",
+				m_resolution, m_quality, m_qualityAdjustment, m_overture, m_gradients,
+				m_clampNeighbor, m_clampScreen, m_subIntegrator->toString().c_str());
+			m_cacheHash = hashBuffer(config.c_str(), config.length(),
+				scene->computeContentHash());
+
+			m_irrCache = IrradianceCache::readCache(m_cacheFile, m_cacheHash);
+			if (m_irrCache.get()) {
+				Log(EInfo, "Loaded " SIZE_T_FMT " irradiance samples from \"%s\", "
+					"skipping the overture pass", m_irrCache->size(),
+					m_cacheFile.string().c_str());
+				return true;
+			}
+		}
+
 		ref<Scheduler> sched = Scheduler::getInstance();
 		m_irrCache = new IrradianceCache(scene->getAABB());
 		m_irrCache->clampNeighbor(m_clampNeighbor);
@@ -244,6 +275,13 @@ public:
 		return true;
 	}
 
+	void postprocess(const Scene *scene, RenderQueue *queue, const RenderJob *job,
+			int sceneResID, int sensorResID, int samplerResID) {
+		SamplingIntegrator::postprocess(scene, queue, job, sceneResID, sensorResID, samplerResID);
+		if (!m_cacheFile.empty() && m_irrCache.get())
+			m_irrCache->writeCache(m_cacheFile, m_cacheHash);
+	}
+
 	void cancel() {
 		if (m_proc) {
 			Scheduler::getInstance()->cancel(m_proc);
@@ -382,6 +420,8 @@ private:
 	bool m_clampScreen, m_clampNeighbor;
 	bool m_overture, m_gradients, m_debug, m_indirectOnly;
 	int m_resolution;
+	fs::path m_cacheFile;
+	uint64_t m_cacheHash;
 };
 
 MTS_IMPLEMENT_CLASS_S(IrradianceCacheIntegrator, false, SamplingIntegrator)
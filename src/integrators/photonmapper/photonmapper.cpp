@@ -17,6 +17,7 @@
 */
 
 #include <mitsuba/core/plugin.h>
+#include <mitsuba/core/fresolver.h>
 #include <mitsuba/render/common.h>
 #include <mitsuba/render/gatherproc.h>
 #include "bre.h"
@@ -54,6 +55,8 @@ MTS_NAMESPACE_BEGIN
  *	      which the implementation will start to use the ``russian roulette''
  *	      path termination criterion. \default{\code{5}}
  *	   }
+ *     \parameter{cacheFile}{\String}{Base filename of an on-disk photon map
+ *        cache, see below. \default{none, i.e. photon maps are never cached}}
  * }
  * This plugin implements the two-pass photon mapping algorithm as proposed by Jensen \cite{Jensen1996Global}.
  * The implementation partitions the illumination into three different classes (diffuse, caustic, and volumetric),
@@ -81,6 +84,14 @@ MTS_NAMESPACE_BEGIN
  * When the scene contains participating media, the Beam Radiance Estimate \cite{Jarosz2008Beam}
  * by Jarosz et al. is used to estimate the illumination due to volumetric scattering.
  *
+ * When the \code{cacheFile} parameter is specified, the global, caustic and volumetric
+ * photon maps are written to the files \code{<cacheFile>.global}, \code{<cacheFile>.caustic}
+ * and \code{<cacheFile>.volume} after they have been built. Subsequent renderings (e.g. the
+ * frames of a walkthrough animation of a static scene) load them from there instead of
+ * tracing photons again. The cache files are tagged with a hash of the scene's geometry,
+ * materials, emitters and media as well as the photon mapping parameters, and they are
+ * regenerated automatically when any of these change. The sensor is not part of the hash.
+ *
  * \remarks{
  *     \item Currently, only homogeneous participating media are supported by this implementation
  * }
@@ -134,6 +145,10 @@ public:
 		/* When this flag is set to true, contributions from directly
 		 * visible emitters will not be included in the rendered image */
 		m_hideEmitters = props.getBoolean("hideEmitters", false);
+		/* Base filename of the on-disk photon map cache (empty = disabled) */
+		if (props.hasProperty("cacheFile"))
+			m_cacheFile = Thread::getThread()->getFileResolver()->resolve(
+				props.getString("cacheFile"));
 
 		if (m_maxDepth == 0) {
 			Log(EError, "maxDepth must be greater than zero!");
@@ -252,6 +267,37 @@ public:
 				Log(EError, "Inhomogeneous media are currently not supported by the photon mapper!");
 		}
 
+		size_t volumePhotons = scene->getMedia().size() == 0 ? 0 : m_volumePhotons;
+		uint64_t cacheHash = 0;
+		if (!m_cacheFile.empty()) {
+			/* Try to load previously generated photon maps */
+			uint64_t config[] = { (uint64_t) m_maxDepth, (uint64_t) m_rrDepth,
+				(uint64_t) m_globalPhotons, (uint64_t) m_causticPhotons,
+				(uint64_t) volumePhotons };
+			cacheHash = hashBuffer(config, sizeof(config), scene->computeContentHash());
+
+			if (m_globalPhotonMap.get() == NULL && m_globalPhotons > 0) {
+				m_globalPhotonMap = PhotonMap::readCache(getCacheFile("global"), cacheHash);
+				if (m_globalPhotonMap.get())
+					m_globalPhotonMapID = sched->registerResource(m_globalPhotonMap);
+			}
+
+			if (m_causticPhotonMap.get() == NULL && m_causticPhotons > 0) {
+				m_causticPhotonMap = PhotonMap::readCache(getCacheFile("caustic"), cacheHash);
+				if (m_causticPhotonMap.get())
+					m_causticPhotonMapID = sched->registerResource(m_causticPhotonMap);
+			}
+
+			if (m_bre.get() == NULL && volumePhotons > 0) {
+				ref<PhotonMap> volumePhotonMap =
+					PhotonMap::readCache(getCacheFile("volume"), cacheHash);
+				if (volumePhotonMap.get()) {
+					m_bre = new BeamRadianceEstimator(volumePhotonMap, m_volumeLookupSize);
+					m_breID = sched->registerResource(m_bre);
+				}
+			}
+		}
+
 		if (m_globalPhotonMap.get() == NULL && m_globalPhotons > 0) {
 			/* Generate the global photon map */
 			ref<GatherPhotonProcess> proc = new GatherPhotonProcess(
@@ -280,6 +326,8 @@ public:
 				m_globalPhotonMap->setScaleFactor(1 / (Float) proc->getShotParticles());
 				m_globalPhotonMap->build();
 				m_globalPhotonMapID = sched->registerResource(m_globalPhotonMap);
+				if (!m_cacheFile.empty())
+					m_globalPhotonMap->writeCache(getCacheFile("global"), cacheHash);
 			}
 		}
 
@@ -311,11 +359,12 @@ public:
 				m_causticPhotonMap->setScaleFactor(1 / (Float) proc->getShotParticles());
 				m_causticPhotonMap->build();
 				m_causticPhotonMapID = sched->registerResource(m_causticPhotonMap);
+				if (!m_cacheFile.empty())
+					m_causticPhotonMap->writeCache(getCacheFile("caustic"), cacheHash);
 			}
 		}
 
-		size_t volumePhotons = scene->getMedia().size() == 0 ? 0 : m_volumePhotons;
-		if (m_volumePhotonMap.get() == NULL && volumePhotons > 0) {
+		if (m_bre.get() == NULL && volumePhotons > 0) {
 			/* Generate the volume photon map */
 			ref<GatherPhotonProcess> proc = new GatherPhotonProcess(
 				GatherPhotonProcess::EVolumePhotons, volumePhotons,
@@ -341,6 +390,8 @@ public:
 
 				volumePhotonMap->setScaleFactor(1 / (Float) proc->getShotParticles());
 				volumePhotonMap->build();
+				if (!m_cacheFile.empty())
+					volumePhotonMap->writeCache(getCacheFile("volume"), cacheHash);
 				m_bre = new BeamRadianceEstimator(volumePhotonMap, m_volumeLookupSize);
 				m_breID = sched->registerResource(m_bre);
 			}
@@ -355,6 +406,11 @@ public:
 		return true;
 	}
 
+	/// Return the cache filename for the given photon map type
+	fs::path getCacheFile(const std::string &type) const {
+		return m_cacheFile.parent_path() / (m_cacheFile.filename().string() + "." + type);
+	}
+
 	void setParent(ConfigurableObject *parent) {
 		if (parent->getClass()->derivesFrom(MTS_CLASS(SamplingIntegrator)))
 			m_parentIntegrator = static_cast<SamplingIntegrator *>(parent);
@@ -688,6 +744,7 @@ private:
 	int m_rrDepth, m_maxDepth, m_maxSpecularDepth;
 	bool m_gatherLocally, m_autoCancelGathering;
 	bool m_hideEmitters;
+	fs::path m_cacheFile;
 };
 
 MTS_IMPLEMENT_CLASS_S(PhotonMapIntegrator, false, SamplingIntegrator)
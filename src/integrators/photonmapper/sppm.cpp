@@ -20,6 +20,8 @@
 #include <mitsuba/core/bitmap.h>
 #include <mitsuba/render/gatherproc.h>
 #include <mitsuba/render/renderqueue.h>
+#include <mitsuba/core/timer.h>
+#include <boost/algorithm/string.hpp>
 
 #if defined(MTS_OPENMP)
 # include <omp.h>
@@ -50,6 +52,17 @@ MTS_NAMESPACE_BEGIN
  *	   }
  *     \parameter{maxPasses}{\Integer}{Maximum number of passes to render (where \code{-1}
  *        corresponds to rendering until stopped manually). \default{\code{-1}}}
+ *     \parameter{lookup}{\String}{Spatial data structure used to find the photons
+ *        near each gather point. Must be one of
+ *        \begin{enumerate}[(i)]
+ *            \item \code{kdtree}: Build a kd-tree over the photons of each pass
+ *            \item \code{hashgrid}: Build a uniform hash grid, whose cell size is
+ *                 twice the current maximum gather radius. This is cheaper to rebuild
+ *                 in every pass and usually faster to query, particularly once the
+ *                 radii have shrunk.
+ *        \end{enumerate}
+ *        \default{\code{kdtree}}
+ *     }
  * }
  * This plugin implements stochastic progressive photon mapping by Hachisuka et al.
  * \cite{Hachisuka2009Stochastic}. This algorithm is an extension of progressive photon
@@ -105,6 +118,15 @@ public:
 		m_autoCancelGathering = props.getBoolean("autoCancelGathering", true);
 		/* Maximum number of passes to render. -1 renders until the process is stopped. */
 		m_maxPasses = props.getInteger("maxPasses", -1);
+		/* Photon lookup data structure (kd-tree or hash grid) */
+		std::string lookup = boost::to_lower_copy(props.getString("lookup", "kdtree"));
+		if (lookup == "kdtree")
+			m_useHashGrid = false;
+		else if (lookup == "hashgrid")
+			m_useHashGrid = true;
+		else
+			Log(EError, "The \"lookup\" parameter must be equal to either "
+				"\"kdtree\" or \"hashgrid\"!");
 		m_mutex = new Mutex();
 		if (m_maxDepth <= 1 && m_maxDepth != -1)
 			Log(EError, "Maximum depth must be set to \"2\" or higher!");
@@ -197,6 +219,10 @@ public:
 		Thread::initializeOpenMP(nCores);
 #endif
 
+		if (m_useHashGrid)
+			m_hashGrid = new PhotonHashGrid();
+
+		ref<Timer> timer = new Timer();
 		int it = 0;
 		while (m_running && (m_maxPasses == -1 || it < m_maxPasses)) {
 			distributedRTPass(scene, samplers);
@@ -204,6 +230,11 @@ public:
 					sensorResID, samplerResID);
 		}
 
+		Float seconds = timer->getSeconds();
+		Log(EInfo, "Rendered %i passes in %s (%.2f passes per minute)", it,
+			timeString(seconds, true).c_str(), seconds > 0 ? it * 60 / seconds : 0.0f);
+		m_hashGrid = NULL;
+
 #ifdef MTS_DEBUG_FP
 		disableFPExceptions();
 #endif
@@ -325,11 +356,29 @@ public:
 		proc->bindResource("sensor", sensorResID);
 		proc->bindResource("sampler", samplerResID);
 
+		ref<Timer> timer = new Timer();
 		sched->schedule(proc);
 		sched->wait(proc);
+		unsigned int shootingTime = timer->getMilliseconds();
+		timer->reset();
 
 		ref<PhotonMap> photonMap = proc->getPhotonMap();
-		photonMap->build();
+		if (m_useHashGrid) {
+			/* The cell size must accommodate the largest gather radius */
+			Float maxRadius = 0;
+			for (size_t i=0; i<m_gatherBlocks.size(); ++i) {
+				const std::vector<GatherPoint> &gatherPoints = m_gatherBlocks[i];
+				for (size_t j=0; j<gatherPoints.size(); ++j) {
+					if (gatherPoints[j].depth != -1)
+						maxRadius = std::max(maxRadius, gatherPoints[j].radius);
+				}
+			}
+			m_hashGrid->build(photonMap, 2 * std::max(maxRadius, Epsilon));
+		} else {
+			photonMap->build();
+		}
+		unsigned int buildTime = timer->getMilliseconds();
+		timer->reset();
 		Log(EDebug, "Photon map full. Shot " SIZE_T_FMT " particles, excess photons due to parallelism: "
 			SIZE_T_FMT, proc->getShotParticles(), proc->getExcessPhotons());
 
@@ -350,8 +399,13 @@ public:
 				Spectrum flux, contrib;
 
 				if (gp.depth != -1) {
-					M = (Float) photonMap->estimateRadianceRaw(
-						gp.its, gp.radius, flux, m_maxDepth == -1 ? INT_MAX : m_maxDepth-gp.depth);
+					int maxDepth = m_maxDepth == -1 ? INT_MAX : m_maxDepth-gp.depth;
+					if (m_useHashGrid)
+						M = (Float) m_hashGrid->estimateRadianceRaw(
+							gp.its, gp.radius, flux, maxDepth);
+					else
+						M = (Float) photonMap->estimateRadianceRaw(
+							gp.its, gp.radius, flux, maxDepth);
 				} else {
 					M = 0;
 					flux = Spectrum(0.0f);
@@ -376,6 +430,11 @@ public:
 				target[gp.pos.y * m_bitmap->getWidth() + gp.pos.x] = contrib;
 			}
 		}
+		unsigned int gatherTime = timer->getMilliseconds();
+		Log(EDebug, "Pass %i: photon tracing took %i ms, building the %s took %i ms, "
+			"gathering took %i ms", it, shootingTime, m_useHashGrid ? "hash grid"
+			: "kd-tree", buildTime, gatherTime);
+
 		film->setBitmap(m_bitmap);
 		queue->signalRefresh(job);
 	}
@@ -389,7 +448,8 @@ public:
 			<< "  alpha = " << m_alpha << "," << endl
 			<< "  photonCount = " << m_photonCount << "," << endl
 			<< "  granularity = " << m_granularity << "," << endl
-			<< "  maxPasses = " << m_maxPasses << endl
+			<< "  maxPasses = " << m_maxPasses << "," << endl
+			<< "  lookup = " << (m_useHashGrid ? "hashgrid" : "kdtree") << endl
 			<< "]";
 		return oss.str();
 	}
@@ -407,6 +467,8 @@ private:
 	bool m_running;
 	bool m_autoCancelGathering;
 	int m_maxPasses;
+	bool m_useHashGrid;
+	ref<PhotonHashGrid> m_hashGrid;
 };
 
 MTS_IMPLEMENT_CLASS_S(SPPMIntegrator, false, Integrator)
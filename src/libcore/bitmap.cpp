@@ -20,6 +20,7 @@
 #include <mitsuba/core/version.h>
 #include <mitsuba/core/plugin.h>
 #include <mitsuba/core/fstream.h>
+#include <mitsuba/core/thread.h>
 #include <boost/algorithm/string.hpp>
 #include <boost/scoped_array.hpp>
 #include <boost/thread/mutex.hpp>
@@ -52,6 +53,7 @@
 
 #if defined(MTS_HAS_LIBPNG)
 #include <png.h>
+#include <zlib.h>
 #endif
 
 #if defined(MTS_HAS_LIBJPEG)
@@ -174,6 +176,185 @@ static void png_warn_func(png_structp png_ptr, png_const_charp msg) {
 		return;
 	SLog(EWarn, "libpng warning: %s\n", msg);
 }
+
+/// PNG images larger than this many bytes are compressed using multiple threads
+#define MTS_PNG_PARALLEL_THRESHOLD (4 * 1024 * 1024)
+
+/// Approximate amount of filtered image data that is compressed per task
+#define MTS_PNG_CHUNK_SIZE (256 * 1024)
+
+/**
+ * \brief Apply a PNG scanline filter
+ *
+ * When \c adaptive is set, all five filters are tried, and the one with
+ * the smallest sum of absolute (signed) values is chosen. This is the same
+ * heuristic that libpng uses by default. Otherwise, no filter is applied.
+ * \c prev should point to a row of zeros for the first scanline.
+ */
+static void png_filter_row(const uint8_t *row, const uint8_t *prev,
+		size_t rowBytes, size_t bpp, bool adaptive, uint8_t *out, uint8_t *temp) {
+	out[0] = 0;
+	memcpy(out + 1, row, rowBytes);
+	if (!adaptive)
+		return;
+
+	size_t bestSum = 0;
+	for (size_t i=0; i<rowBytes; ++i)
+		bestSum += std::abs((int) (int8_t) row[i]);
+
+	for (uint8_t type=1; type<=4; ++type) {
+		size_t sum = 0;
+		temp[0] = type;
+		for (size_t i=0; i<rowBytes; ++i) {
+			int a = i >= bpp ? row[i-bpp] : 0,
+			    b = prev[i],
+			    c = i >= bpp ? prev[i-bpp] : 0,
+			    pred;
+
+			switch (type) {
+				case 1: pred = a; break;
+				case 2: pred = b; break;
+				case 3: pred = (a + b) / 2; break;
+				default: {
+					int p = a + b - c, pa = std::abs(p - a),
+					    pb = std::abs(p - b), pc = std::abs(p - c);
+					pred = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+				}
+			}
+
+			uint8_t value = (uint8_t) (row[i] - pred);
+			temp[i+1] = value;
+			sum += std::abs((int) (int8_t) value);
+		}
+
+		if (sum < bestSum) {
+			bestSum = sum;
+			memcpy(out, temp, rowBytes + 1);
+		}
+	}
+}
+
+/**
+ * \brief Filter and compress the scanlines of a PNG image using
+ * multiple threads
+ *
+ * Similar to \c pigz, the filtered data is split into chunks that
+ * are compressed independently (each using the tail of the preceding
+ * chunk as a dictionary) and then concatenated into a single zlib stream.
+ * The result can be written to the file as a sequence of IDAT chunks.
+ */
+static void png_compress_parallel(const uint8_t *data, size_t rowBytes,
+		int height, size_t bpp, bool adaptive, bool swap16, int level,
+		std::vector<uint8_t> &result) {
+	const size_t filteredRowBytes = rowBytes + 1;
+	std::vector<uint8_t> filtered(filteredRowBytes * (size_t) height);
+
+	/* Filter all scanlines */
+	#if defined(MTS_OPENMP)
+		#pragma omp parallel
+	#endif
+	{
+		std::vector<uint8_t> current(rowBytes), previous(rowBytes), zeros(rowBytes, 0);
+		std::vector<uint8_t> temp(filteredRowBytes);
+
+		#if defined(MTS_OPENMP)
+			#pragma omp for schedule(static)
+		#endif
+		for (int y=0; y<height; ++y) {
+			const uint8_t *row = data + y * rowBytes,
+			              *prev = y > 0 ? (row - rowBytes) : &zeros[0];
+
+			if (swap16) {
+				/* PNG stores 16 bit values in big endian byte order */
+				for (size_t i=0; i<rowBytes; i += 2) {
+					current[i] = row[i+1]; current[i+1] = row[i];
+					if (y > 0) {
+						previous[i] = prev[i+1]; previous[i+1] = prev[i];
+					}
+				}
+				row = &current[0];
+				if (y > 0)
+					prev = &previous[0];
+			}
+
+			png_filter_row(row, prev, rowBytes, bpp, adaptive,
+				&filtered[y * filteredRowBytes], &temp[0]);
+		}
+	}
+
+	/* Compress the filtered data in chunks */
+	const size_t windowSize = 32768, totalSize = filtered.size();
+	const int chunkCount = (int) std::max((size_t) 1,
+		(totalSize + MTS_PNG_CHUNK_SIZE - 1) / MTS_PNG_CHUNK_SIZE);
+	std::vector<std::vector<uint8_t> > chunks(chunkCount);
+	std::vector<uLong> checksums(chunkCount);
+	bool failed = false;
+
+	#if defined(MTS_OPENMP)
+		#pragma omp parallel for schedule(dynamic)
+	#endif
+	for (int i=0; i<chunkCount; ++i) {
+		size_t start = (size_t) i * MTS_PNG_CHUNK_SIZE,
+		       size = std::min((size_t) MTS_PNG_CHUNK_SIZE, totalSize - start);
+		bool last = i == chunkCount - 1;
+
+		z_stream zs;
+		memset(&zs, 0, sizeof(z_stream));
+		if (deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+			failed = true;
+			continue;
+		}
+
+		if (i > 0) {
+			size_t dictSize = std::min(windowSize, start);
+			deflateSetDictionary(&zs, &filtered[start - dictSize], (uInt) dictSize);
+		}
+
+		std::vector<uint8_t> &chunk = chunks[i];
+		chunk.resize(deflateBound(&zs, (uLong) size) + 16);
+		zs.next_in = &filtered[start];
+		zs.avail_in = (uInt) size;
+		zs.next_out = &chunk[0];
+		zs.avail_out = (uInt) chunk.size();
+
+		int retval = deflate(&zs, last ? Z_FINISH : Z_SYNC_FLUSH);
+		if (retval != (last ? Z_STREAM_END : Z_OK) || zs.avail_in != 0)
+			failed = true;
+		chunk.resize(chunk.size() - zs.avail_out);
+		deflateEnd(&zs);
+
+		checksums[i] = adler32(adler32(0, NULL, 0), &filtered[start], (uInt) size);
+	}
+
+	if (failed)
+		SLog(EError, "writePNG(): zlib compression failed!");
+
+	/* zlib header (32K window), compression level hint and check bits */
+	uint8_t cmf = 0x78, flg = (uint8_t) ((level <= 1 ? 0 : (level <= 5 ? 1 :
+		(level == 6 ? 2 : 3))) << 6);
+	flg = (uint8_t) (flg + 31 - ((cmf * 256 + flg) % 31));
+
+	size_t resultSize = 6;
+	for (int i=0; i<chunkCount; ++i)
+		resultSize += chunks[i].size();
+	result.clear();
+	result.reserve(resultSize);
+	result.push_back(cmf);
+	result.push_back(flg);
+
+	uLong checksum = checksums[0];
+	for (int i=0; i<chunkCount; ++i) {
+		result.insert(result.end(), chunks[i].begin(), chunks[i].end());
+		if (i > 0) {
+			size_t start = (size_t) i * MTS_PNG_CHUNK_SIZE;
+			checksum = adler32_combine(checksum, checksums[i],
+				(z_off_t) std::min((size_t) MTS_PNG_CHUNK_SIZE, totalSize - start));
+		}
+	}
+
+	for (int i=3; i>=0; --i)
+		result.push_back((uint8_t) (checksum >> (8*i)));
+}
 #endif
 
 #if defined(MTS_HAS_LIBJPEG)
@@ -299,6 +480,7 @@ Bitmap::Bitmap(EFileFormat format, Stream *stream, const std::string &prefix) :
 
 Bitmap::Bitmap(const fs::path &path, const std::string &prefix) : m_data(NULL), m_ownsData(false) {
 	ref<FileStream> fs = new FileStream(path, FileStream::EReadOnly);
+	fs->setReadAhead();
 	readStream(EAuto, fs, prefix);
 }
 
@@ -381,6 +563,96 @@ void Bitmap::write(EFileFormat format, const fs::path &path, int compression) co
 	write(format, fs, compression);
 }
 
+/// Background thread that writes a bitmap to disk (used by Bitmap::writeAsync())
+class BitmapWriter : public Thread {
+public:
+	BitmapWriter(const Bitmap *bitmap, Bitmap::EFileFormat format,
+			const fs::path &filename, int compression)
+		: Thread("bwrite"), m_bitmap(bitmap), m_format(format),
+		  m_filename(filename), m_compression(compression) { }
+
+	void run() {
+		try {
+			m_bitmap->write(m_format, m_filename, m_compression);
+		} catch (const std::exception &ex) {
+			/* Reported by the thread that collects this writer */
+			m_error = ex.what();
+		}
+	}
+
+	inline const fs::path &getFilename() const { return m_filename; }
+
+	/// Return the reason why the write failed (or an empty string)
+	inline const std::string &getError() const { return m_error; }
+
+	MTS_DECLARE_CLASS()
+protected:
+	virtual ~BitmapWriter() { }
+private:
+	ref<const Bitmap> m_bitmap;
+	Bitmap::EFileFormat m_format;
+	fs::path m_filename;
+	int m_compression;
+	std::string m_error;
+};
+
+/// Maximum number of background writes that may be in progress at any time
+#define MTS_MAX_ASYNC_WRITES 4
+
+static boost::mutex __asyncWriteMutex;
+static std::vector<ref<BitmapWriter> > __asyncWriters;
+
+/// Join a finished writer and record its error message (if any)
+static void joinWriter(BitmapWriter *writer, std::string &errors) {
+	writer->join();
+	if (!writer->getError().empty())
+		errors += formatString("%sCould not write \"%s\": %s", errors.empty() ? "" : "\n",
+			writer->getFilename().string().c_str(), writer->getError().c_str());
+}
+
+void Bitmap::writeAsync(EFileFormat format, const fs::path &path, int compression) const {
+	std::string errors;
+	{
+		boost::mutex::scoped_lock lock(__asyncWriteMutex);
+
+		/* Release finished writers and wait for pending writes to the same file */
+		std::vector<ref<BitmapWriter> > writers;
+		writers.swap(__asyncWriters);
+		for (size_t i=0; i<writers.size(); ++i) {
+			if (!writers[i]->isRunning() || writers[i]->getFilename() == path)
+				joinWriter(writers[i], errors);
+			else
+				__asyncWriters.push_back(writers[i]);
+		}
+
+		/* Limit the number of threads (and bitmaps) held by pending writes */
+		while (__asyncWriters.size() >= MTS_MAX_ASYNC_WRITES) {
+			joinWriter(__asyncWriters.front(), errors);
+			__asyncWriters.erase(__asyncWriters.begin());
+		}
+
+		ref<BitmapWriter> writer = new BitmapWriter(this, format, path, compression);
+		writer->start();
+		__asyncWriters.push_back(writer);
+	}
+
+	if (!errors.empty())
+		Log(EError, "%s", errors.c_str());
+}
+
+void Bitmap::waitAsyncWrites() {
+	std::vector<ref<BitmapWriter> > writers;
+	{
+		boost::mutex::scoped_lock lock(__asyncWriteMutex);
+		writers.swap(__asyncWriters);
+	}
+	std::string errors;
+	for (size_t i=0; i<writers.size(); ++i)
+		joinWriter(writers[i], errors);
+	if (!errors.empty())
+		Log(EError, "%s", errors.c_str());
+}
+
 void Bitmap::write(EFileFormat format, Stream *stream, int compression) const {
 	switch (format) {
 		case EJPEG:
@@ -1532,6 +1804,44 @@ Spectrum Bitmap::getPixel(const Point2i &pos) const {
 	return result;
 }
 
+/// Conversions of images with more than this many pixels use multiple threads
+#define MTS_CONVERT_PARALLEL_THRESHOLD (1 << 19)
+
+/// Number of pixels that are converted per task
+#define MTS_CONVERT_CHUNK_SIZE (1 << 18)
+
+/**
+ * \brief Run a format conversion over \c count pixels, splitting
+ * large images into chunks that are converted in parallel.
+ *
+ * The chunks are large enough that the lookup tables used by
+ * the converter for 8- and 16-bit sources are still worthwhile.
+ */
+static void convertChunked(const FormatConverter *cvt,
+		Bitmap::EPixelFormat sourceFormat, Float sourceGamma, const uint8_t *source,
+		size_t sourcePixelBytes, Bitmap::EPixelFormat destFormat, Float destGamma,
+		uint8_t *dest, size_t destPixelBytes, size_t count, Float multiplier,
+		Spectrum::EConversionIntent intent, int channelCount) {
+	if (count <= MTS_CONVERT_PARALLEL_THRESHOLD || getCoreCount() == 1) {
+		cvt->convert(sourceFormat, sourceGamma, source, destFormat, destGamma,
+			dest, count, multiplier, intent, channelCount);
+		return;
+	}
+
+	int nChunks = (int) ((count + MTS_CONVERT_CHUNK_SIZE - 1) / MTS_CONVERT_CHUNK_SIZE);
+
+#if defined(MTS_OPENMP)
+	#pragma omp parallel for schedule(dynamic)
+#endif
+	for (int i=0; i<nChunks; ++i) {
+		size_t start = (size_t) i * MTS_CONVERT_CHUNK_SIZE,
+		       size = std::min((size_t) MTS_CONVERT_CHUNK_SIZE, count - start);
+		cvt->convert(sourceFormat, sourceGamma, source + start * sourcePixelBytes,
+			destFormat, destGamma, dest + start * destPixelBytes, size,
+			multiplier, intent, channelCount);
+	}
+}
+
 void Bitmap::convert(Bitmap *target, Float multiplier, Spectrum::EConversionIntent intent) const {
 	if (m_componentFormat == EBitmask || target->getComponentFormat() == EBitmask)
 		Log(EError, "Conversions involving bitmasks are currently not supported!");
@@ -1552,10 +1862,10 @@ void Bitmap::convert(Bitmap *target, Float multiplier, Spectrum::EConversionInte
 
 	Assert(cvt != NULL);
 
-	cvt->convert(m_pixelFormat, m_gamma, m_data,
-		target->getPixelFormat(), target->getGamma(), target->getData(),
-		(size_t) m_size.x * (size_t) m_size.y, multiplier, intent,
-		m_channelCount);
+	convertChunked(cvt, m_pixelFormat, m_gamma, m_data, getBytesPerPixel(),
+		target->getPixelFormat(), target->getGamma(), target->getUInt8Data(),
+		target->getBytesPerPixel(), (size_t) m_size.x * (size_t) m_size.y,
+		multiplier, intent, m_channelCount);
 }
 
 ref<Bitmap> Bitmap::convert(EPixelFormat pixelFormat,
@@ -1584,8 +1894,8 @@ ref<Bitmap> Bitmap::convert(EPixelFormat pixelFormat,
 		target->setChannelNames(m_channelNames);
 	target->setGamma(gamma);
 
-	cvt->convert(m_pixelFormat, m_gamma, m_data,
-		pixelFormat, gamma, target->getData(),
+	convertChunked(cvt, m_pixelFormat, m_gamma, m_data, getBytesPerPixel(),
+		pixelFormat, gamma, target->getUInt8Data(), target->getBytesPerPixel(),
 		(size_t) m_size.x * (size_t) m_size.y, multiplier, intent,
 		m_channelCount);
 
@@ -1612,10 +1922,28 @@ void Bitmap::convertMultiSpectrumAlphaWeight(const Bitmap *source,
 	if (source->getComponentFormat() != EFloat && source->getPixelFormat() != EMultiSpectrumAlphaWeight)
 		Log(EError, "convertMultiSpectrumAlphaWeight(): unsupported!");
 
-	Float *temp = new Float[count * target->getChannelCount()], *dst = temp;
+	for (size_t i=0; i<pixelFormats.size(); ++i) {
+		switch (pixelFormats[i]) {
+			case Bitmap::ELuminance: case Bitmap::ELuminanceAlpha:
+			case Bitmap::EXYZ: case Bitmap::EXYZA:
+			case Bitmap::ERGB: case Bitmap::ERGBA:
+			case Bitmap::ESpectrum: case Bitmap::ESpectrumAlpha:
+				break;
+			default:
+				Log(EError, "Unknown pixel format!");
+		}
+	}
+
+	const int targetChannels = target->getChannelCount();
+	Float *temp = new Float[count * targetChannels];
 
-	for (size_t k = 0; k<count; ++k) {
+	/* Convert the pixels in parallel (this is part of every film development) */
+	#if defined(MTS_OPENMP)
+		#pragma omp parallel for schedule(static)
+	#endif
+	for (ptrdiff_t k = 0; k<(ptrdiff_t) count; ++k) {
 		const Float *srcData = (const Float *) sourcePtr + k * source->getChannelCount();
+		Float *dst = temp + k * targetChannels;
 		Float weight = srcData[source->getChannelCount()-1],
 			  invWeight = weight == 0 ? 0 : (Float) 1 / weight;
 		Float alpha = srcData[source->getChannelCount()-2] * invWeight;
@@ -1667,7 +1995,7 @@ void Bitmap::convertMultiSpectrumAlphaWeight(const Bitmap *source,
 					*dst++ = alpha;
 					break;
 				default:
-					Log(EError, "Unknown pixel format!");
+					break;
 			}
 		}
 	}
@@ -1702,8 +2030,12 @@ void Bitmap::convert(void *target, EPixelFormat pixelFormat,
 
 	Assert(cvt != NULL);
 
-	cvt->convert(m_pixelFormat, m_gamma, m_data,
-		pixelFormat, gamma, target,
+	/* Determine the size of a target pixel using a bitmap that wraps the target buffer */
+	ref<Bitmap> wrapper = new Bitmap(pixelFormat, componentFormat, Vector2i(1),
+		m_channelCount, static_cast<uint8_t *>(target));
+
+	convertChunked(cvt, m_pixelFormat, m_gamma, m_data, getBytesPerPixel(),
+		pixelFormat, gamma, static_cast<uint8_t *>(target), wrapper->getBytesPerPixel(),
 		(size_t) m_size.x * (size_t) m_size.y, multiplier, intent,
 		m_channelCount);
 }
@@ -2639,20 +2971,44 @@ void Bitmap::writePNG(Stream *stream, int compression) const {
 
 	png_write_info(png_ptr, info_ptr);
 
-	rows = new png_bytep[m_size.y];
-
 	size_t rowBytes = png_get_rowbytes(png_ptr, info_ptr);
 	Assert(rowBytes == getBufferSize() / m_size.y);
-	for (int i=0; i<m_size.y; i++)
-		rows[i] = &m_data[rowBytes * i];
 
-	png_write_image(png_ptr, rows);
-	png_write_end(png_ptr, info_ptr);
+#if defined(MTS_OPENMP)
+	bool parallel = getBufferSize() > MTS_PNG_PARALLEL_THRESHOLD && getCoreCount() > 1;
+#else
+	bool parallel = false;
+#endif
+
+	if (parallel) {
+		/* Large image: filter and compress the image data using multiple
+		   threads and write the result as a sequence of IDAT chunks */
+		std::vector<uint8_t> compressed;
+		size_t bpp = std::max((size_t) 1, (size_t) (bitDepth * getChannelCount()) / 8);
+		png_compress_parallel(m_data, rowBytes, m_size.y, bpp, bitDepth >= 8,
+			m_componentFormat == EUInt16 && Stream::getHostByteOrder() == Stream::ELittleEndian,
+			compression, compressed);
+
+		const size_t maxChunkSize = 1024 * 1024;
+		for (size_t offset = 0; offset < compressed.size(); offset += maxChunkSize)
+			png_write_chunk(png_ptr, (png_bytep) "IDAT", &compressed[offset],
+				std::min(maxChunkSize, compressed.size() - offset));
+		png_write_chunk(png_ptr, (png_bytep) "IEND", NULL, 0);
+	} else {
+		rows = new png_bytep[m_size.y];
+		for (int i=0; i<m_size.y; i++)
+			rows[i] = &m_data[rowBytes * i];
+
+		png_write_image(png_ptr, rows);
+		png_write_end(png_ptr, info_ptr);
+	}
+
 	png_destroy_write_struct(&png_ptr, &info_ptr);
 
 	if (text)
 		delete[] text;
-	delete[] rows;
+	if (rows)
+		delete[] rows;
 }
 #else
 void Bitmap::readPNG(Stream *stream) {
@@ -3922,6 +4278,13 @@ void Bitmap::staticInitialization() {
 }
 
 void Bitmap::staticShutdown() {
+	/* Make sure that all images have been written */
+	try {
+		waitAsyncWrites();
+	} catch (const std::exception &ex) {
+		SLog(EWarn, "%s", ex.what());
+	}
+
 	FormatConverter::staticShutdown();
 
 #if defined(MTS_HAS_FFTW)
@@ -4032,4 +4395,5 @@ std::ostream &operator<<(std::ostream &os, const Bitmap::EComponentFormat &value
 }
 
 MTS_IMPLEMENT_CLASS(Bitmap, false, Object)
+MTS_IMPLEMENT_CLASS(BitmapWriter, false, Thread)
 MTS_NAMESPACE_END
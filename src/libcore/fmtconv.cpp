@@ -20,6 +20,7 @@
 #define BOOST_MPL_LIMIT_VECTOR_SIZE 40
 
 #include <mitsuba/core/bitmap.h>
+#include <mitsuba/core/sse.h>
 #include <boost/mpl/vector.hpp>
 #include <boost/mpl/for_each.hpp>
 #include <boost/mpl/fold.hpp>
@@ -27,6 +28,10 @@
 #include <boost/mpl/pair.hpp>
 #include <boost/mpl/transform.hpp>
 
+#if defined(__F16C__)
+# include <immintrin.h>
+#endif
+
 MTS_NAMESPACE_BEGIN
 
 namespace mpl = boost::mpl;
@@ -38,8 +43,10 @@ namespace mpl = boost::mpl;
 /*  formats. The switch() and Boost MPL craziness below does exactly this:  */
 /*  it produces code for each possible pair                                 */
 /****************************************************************************/
-/*  Note that some cases in this file really scream for SSE optimization    */
-/*  (in case they ever become a bottleneck, that is..)                      */
+/*  Conversions which preserve the channel layout and are frequently used   */
+/*  (float->uint8 for LDR output, float<->half for OpenEXR) are handled by  */
+/*  dedicated kernels (see FormatConverterImpl::convertChannels()). These   */
+/*  produce exactly the same values as the generic code below.              */
 /****************************************************************************/
 
 namespace detail {
@@ -148,6 +155,39 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 		const Float invDestGamma = 1.0f / destGamma;
 		const size_t maxValue = (size_t) std::numeric_limits<SourceFormat>::max();
 
+		if (sourceFormat == destFormat) {
+			/* Try a specialized kernel when the channel layout is unchanged */
+			int stride = 0, colorChannels = 0;
+			switch (sourceFormat) {
+				case Bitmap::ELuminance:            stride = 1; colorChannels = 1; break;
+				case Bitmap::ELuminanceAlpha:       stride = 2; colorChannels = 1; break;
+				case Bitmap::ERGB:
+				case Bitmap::EXYZ:                  stride = 3; colorChannels = 3; break;
+				case Bitmap::EXYZA:
+				case Bitmap::ERGBA:                 stride = 4; colorChannels = 3; break;
+				case Bitmap::ESpectrum:             stride = colorChannels = SPECTRUM_SAMPLES; break;
+				case Bitmap::ESpectrumAlpha:        stride = SPECTRUM_SAMPLES + 1; colorChannels = SPECTRUM_SAMPLES; break;
+				case Bitmap::ESpectrumAlphaWeight:  stride = SPECTRUM_SAMPLES + 2; colorChannels = SPECTRUM_SAMPLES; break;
+				case Bitmap::EMultiChannel:         stride = colorChannels = channelCount; break;
+				default: break;
+			}
+
+			if (stride > 0 && convertChannels(source, dest, count * stride, sourceGamma,
+					multiplier, invDestGamma)) {
+				/* The kernel processed all channels as color values --
+				   redo the alpha and weight channels, which are linear */
+				if (colorChannels != stride) {
+					for (size_t i=0; i<count; ++i) {
+						for (int j=colorChannels; j<stride; ++j) {
+							size_t idx = i * stride + j;
+							dest[idx] = convertScalar<DestFormat>(source[idx]);
+						}
+					}
+				}
+				return;
+			}
+		}
+
 		DestFormat *precomp = NULL;
 		if (format_traits<SourceFormat>::is_compact && count > maxValue) {
 			/* When transforming an uint8_t or uint16_t-based image, it
@@ -1089,7 +1129,163 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 		}
 	}
 
+	/// Precompute the tables used by the specialized conversion kernels
+	static void staticInitialization() {
+		#if defined(SINGLE_PRECISION)
+			/* For every 8-bit value k, find the smallest linear value that
+			   is mapped to k or higher by the sRGB curve. Since the curve
+			   is monotonic, a binary search over the bit patterns of
+			   non-negative floats finds these thresholds exactly */
+			const uint32_t one = floatToBits(1.0f);
+			m_srgbThresholds[0] = 0.0f;
+			for (int k=1; k<256; ++k) {
+				uint32_t lo = 0, hi = one;
+				while (lo < hi) {
+					uint32_t mid = lo + (hi - lo) / 2;
+					if ((int) convertScalar<uint8_t>(bitsToFloat(mid), 1.0f, (uint8_t *) NULL, 1.0f, -1.0f) >= k)
+						hi = mid;
+					else
+						lo = mid + 1;
+				}
+				m_srgbThresholds[k] = bitsToFloat(lo);
+			}
+			m_srgbThresholds[256] = std::numeric_limits<float>::infinity();
+
+			/* Starting point of the search for values in [0, 1), indexed
+			   by the exponent and upper 7 mantissa bits */
+			for (uint32_t i=0; i < (one >> 16); ++i)
+				m_srgbBuckets[i] = convertScalar<uint8_t>(bitsToFloat(i << 16), 1.0f, (uint8_t *) NULL, 1.0f, -1.0f);
+		#endif
+	}
+
 private:
+	/**
+	 * \brief Kernels for frequently used conversions, which process
+	 * \c count values while treating all of them as color channels.
+	 *
+	 * The generic version declines, in which case \ref convert()
+	 * falls back to the switch-based implementation.
+	 */
+	template <typename SourceFmt, typename DestFmt>
+	inline static bool convertChannels(const SourceFmt *, DestFmt *, size_t,
+			Float, Float, Float) {
+		return false;
+	}
+
+#if defined(SINGLE_PRECISION)
+	/// float -> uint8_t with a linear or sRGB response curve
+	static bool convertChannels(const float *source, uint8_t *dest, size_t count,
+			Float sourceGamma, Float multiplier, Float invDestGamma) {
+		if (sourceGamma != 1.0f)
+			return false;
+
+		size_t i = 0;
+		if (invDestGamma == -1.0f) {
+			/* Look up the value of the sRGB curve at the start of the
+			   surrounding bucket, and then step across the (rarely more
+			   than one) thresholds that lie between it and the value */
+			const float *t = m_srgbThresholds;
+			for (; i<count; ++i) {
+				float value = source[i] * multiplier;
+				uint8_t result;
+				if (!(value > 0.0f)) { /* Also catches NaNs */
+					result = 0;
+				} else if (value >= 1.0f) {
+					result = 255;
+				} else {
+					int k = m_srgbBuckets[floatToBits(value) >> 16];
+					while (value >= t[k+1])
+						++k;
+					result = (uint8_t) k;
+				}
+				dest[i] = result;
+			}
+			return true;
+		} else if (invDestGamma != 1.0f) {
+			return false;
+		}
+
+		#if defined(MTS_SSE)
+			/* Same sequence of operations as convertScalar(). Note that
+			   _mm_max_ps() returns its second argument if either is NaN */
+			const __m128 mult = _mm_set1_ps(multiplier),
+			             scale = _mm_set1_ps(255.0f),
+			             offset = _mm_set1_ps(0.5f),
+			             zero = _mm_setzero_ps();
+
+			for (; i+16 <= count; i += 16) {
+				__m128i v[4];
+				for (int j=0; j<4; ++j) {
+					__m128 value = _mm_mul_ps(_mm_loadu_ps(source + i + 4*j), mult);
+					value = _mm_add_ps(_mm_mul_ps(value, scale), offset);
+					value = _mm_min_ps(_mm_max_ps(value, zero), scale);
+					v[j] = _mm_cvttps_epi32(value);
+				}
+				__m128i packed = _mm_packus_epi16(
+					_mm_packs_epi32(v[0], v[1]), _mm_packs_epi32(v[2], v[3]));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i), packed);
+			}
+		#endif
+
+		for (; i<count; ++i)
+			dest[i] = convertScalar<uint8_t>(source[i], 1.0f, (uint8_t *) NULL, multiplier, 1.0f);
+
+		return true;
+	}
+#endif
+
+#if defined(SINGLE_PRECISION) && defined(__F16C__)
+	/// float -> half using the F16C instruction set extension
+	static bool convertChannels(const float *source, half *dest, size_t count,
+			Float sourceGamma, Float multiplier, Float invDestGamma) {
+		if (sourceGamma != 1.0f || invDestGamma != 1.0f)
+			return false;
+
+		const __m128 mult = _mm_set1_ps(multiplier);
+		size_t i = 0;
+		for (; i+4 <= count; i += 4) {
+			__m128 value = _mm_mul_ps(_mm_loadu_ps(source + i), mult);
+			_mm_storel_epi64(reinterpret_cast<__m128i *>(dest + i),
+				_mm_cvtps_ph(value, _MM_FROUND_TO_NEAREST_INT));
+		}
+		for (; i<count; ++i)
+			dest[i] = convertScalar<half>(source[i], 1.0f, (half *) NULL, multiplier, 1.0f);
+
+		return true;
+	}
+
+	/// half -> float using the F16C instruction set extension
+	static bool convertChannels(const half *source, float *dest, size_t count,
+			Float sourceGamma, Float multiplier, Float invDestGamma) {
+		if (sourceGamma != 1.0f || invDestGamma != 1.0f)
+			return false;
+
+		const __m128 mult = _mm_set1_ps(multiplier);
+		size_t i = 0;
+		for (; i+4 <= count; i += 4) {
+			__m128 value = _mm_cvtph_ps(_mm_loadl_epi64(
+				reinterpret_cast<const __m128i *>(source + i)));
+			_mm_storeu_ps(dest + i, _mm_mul_ps(value, mult));
+		}
+		for (; i<count; ++i)
+			dest[i] = convertScalar<float>(source[i], 1.0f, (float *) NULL, multiplier, 1.0f);
+
+		return true;
+	}
+#endif
+
+	inline static uint32_t floatToBits(float value) {
+		union { float f; uint32_t i; } u;
+		u.f = value;
+		return u.i;
+	}
+
+	inline static float bitsToFloat(uint32_t value) {
+		union { float f; uint32_t i; } u;
+		u.i = value;
+		return u.f;
+	}
+
 	static Float undoGamma(Float value, Float gamma) {
 		if (gamma == -1) {
 			if (value <= (Float) 0.04045)
@@ -1158,8 +1354,16 @@ private:
 			return detail::safe_cast<DestFmt> (std::min(static_cast<Float>(std::numeric_limits<DestFmt>::max()),
 				std::max((Float) 0, value * (Float) std::numeric_limits<DestFmt>::max() + (Float) 0.5f)));
 	}
+
+	/// Smallest linear values that map to each 8-bit sRGB value (and a sentinel)
+	static float m_srgbThresholds[257];
+	/// sRGB-encoded 8-bit values at the start of intervals of [0, 1)
+	static uint8_t m_srgbBuckets[0x3F80];
 };
 
+template <typename T> float FormatConverterImpl<T>::m_srgbThresholds[257];
+template <typename T> uint8_t FormatConverterImpl<T>::m_srgbBuckets[0x3F80];
+
 /* ================================================
     The following Boost MPL magic is responsible
     for generating code that efficiently converts
@@ -1206,6 +1410,7 @@ FormatConverter::ConverterMap FormatConverter::m_converters;
 
 void FormatConverter::staticInitialization() {
 	mpl::for_each<ConverterImplementations>(RegisterConverter(m_converters));
+	FormatConverterImpl<mpl::pair<float, uint8_t> >::staticInitialization();
 }
 
 void FormatConverter::staticShutdown() {
@@ -17,6 +17,8 @@
 */
 
 #include <mitsuba/core/fstream.h>
+#include <mitsuba/core/thread.h>
+#include <mitsuba/core/lock.h>
 #include <cerrno>
 
 #if !defined(__WINDOWS__)
@@ -28,6 +30,194 @@
 
 MTS_NAMESPACE_BEGIN
 
+/**
+ * Background thread that reads a file sequentially into two alternating
+ * buffers, while the owning \ref FileStream consumes the other one.
+ * The reads are positional (pread / overlapped ReadFile) so that they
+ * never disturb the position of the stream's own file handle.
+ */
+class ReadAheadThread : public Thread {
+public:
+#if defined(__WINDOWS__)
+	typedef HANDLE handle_t;
+#else
+	typedef int handle_t;
+#endif
+
+	ReadAheadThread(handle_t handle, const fs::path &path, size_t blockSize, size_t pos)
+		: Thread("rdah"), m_handle(handle), m_path(path), m_blockSize(blockSize),
+		  m_generation(0), m_nextOffset(pos), m_fill(0), m_consume(0),
+		  m_done(false), m_quit(false), m_current(NULL), m_currentOffset(0),
+		  m_currentSize(0) {
+		m_mutex = new Mutex();
+		m_cond = new ConditionVariable(m_mutex);
+		for (int i=0; i<2; ++i) {
+			m_blocks[i].data.resize(blockSize);
+			m_blocks[i].full = false;
+		}
+	}
+
+	/// Copy data at the given position to \c ptr and advance the position
+	void read(uint8_t *ptr, size_t size, size_t &pos) {
+		/* Fast path: the buffer being consumed cannot change until it
+		   is handed back, so small reads from it need no locking */
+		if (pos >= m_currentOffset && pos + size <= m_currentOffset + m_currentSize) {
+			memcpy(ptr, m_current + (pos - m_currentOffset), size);
+			pos += size;
+			return;
+		}
+
+		size_t completed = 0;
+		LockGuard lock(m_mutex);
+		while (completed < size) {
+			Block &block = m_blocks[m_consume];
+			while (!block.full && m_error.empty())
+				m_cond->wait();
+			if (!m_error.empty())
+				Log(EError, "%s", m_error.c_str());
+
+			m_current = &block.data[0];
+			m_currentOffset = block.offset;
+			m_currentSize = block.size;
+
+			size_t end = block.offset + block.size;
+			if (pos >= block.offset && pos < end) {
+				size_t amount = std::min(size - completed, end - pos);
+				memcpy(ptr + completed, &block.data[pos - block.offset], amount);
+				completed += amount;
+				pos += amount;
+			} else if (pos >= end && block.size < m_blockSize) {
+				throw EOFException(formatString("Read less data than expected (%i bytes required) "
+					"from file \"%s\"", size, m_path.string().c_str()), completed);
+			} else if (pos < block.offset || pos >= end + m_blockSize) {
+				/* Seek outside of the prefetched range */
+				restart(pos);
+				continue;
+			}
+
+			if (pos >= end && block.size == m_blockSize) {
+				/* Hand the buffer back to the reader thread */
+				block.full = false;
+				m_consume = 1 - m_consume;
+				m_currentSize = 0;
+				m_cond->broadcast();
+			}
+		}
+	}
+
+	void run() {
+		LockGuard lock(m_mutex);
+		while (!m_quit) {
+			Block &block = m_blocks[m_fill];
+			if (block.full || m_done || !m_error.empty()) {
+				m_cond->wait();
+				continue;
+			}
+
+			size_t offset = m_nextOffset, generation = m_generation;
+			size_t size = 0;
+			std::string error;
+			m_mutex->unlock();
+			try {
+				size = readAt(&block.data[0], m_blockSize, offset);
+			} catch (const std::exception &ex) {
+				error = ex.what();
+			}
+			m_mutex->lock();
+			if (generation != m_generation)
+				continue; /* Discard -- the consumer has seeked */
+
+			if (!error.empty()) {
+				m_error = error;
+			} else {
+				block.offset = offset;
+				block.size = size;
+				block.full = true;
+				m_nextOffset += size;
+				m_done = size < m_blockSize;
+				m_fill = 1 - m_fill;
+			}
+			m_cond->broadcast();
+		}
+	}
+
+	/// Stop and join the reader thread
+	void quit() {
+		{
+			LockGuard lock(m_mutex);
+			m_quit = true;
+			m_cond->broadcast();
+		}
+		join();
+	}
+
+protected:
+	virtual ~ReadAheadThread() { }
+
+	/// Discard prefetched data and continue reading at \c pos (lock must be held)
+	void restart(size_t pos) {
+		m_generation++;
+		m_blocks[0].full = m_blocks[1].full = false;
+		m_nextOffset = pos;
+		m_fill = m_consume = 0;
+		m_done = false;
+		m_currentSize = 0;
+		m_cond->broadcast();
+	}
+
+	/// Read up to \c size bytes at the given offset, only stopping early at EOF
+	size_t readAt(uint8_t *ptr, size_t size, size_t offset) const {
+		size_t total = 0;
+		while (total < size) {
+#if defined(__WINDOWS__)
+			OVERLAPPED overlapped;
+			memset(&overlapped, 0, sizeof(OVERLAPPED));
+			overlapped.Offset = (DWORD) (offset + total);
+			overlapped.OffsetHigh = (DWORD) ((uint64_t) (offset + total) >> 32);
+			DWORD bytesRead = 0;
+			if (!ReadFile(m_handle, ptr + total, (DWORD) (size - total), &bytesRead, &overlapped)
+				&& GetLastError() != ERROR_HANDLE_EOF)
+				SLog(EError, "Error while reading from file \"%s\": %s",
+					m_path.string().c_str(), lastErrorText().c_str());
+#else
+			ssize_t bytesRead = pread(m_handle, ptr + total, size - total, (off_t) (offset + total));
+			if (bytesRead < 0) {
+				if (errno == EINTR)
+					continue;
+				SLog(EError, "Error while reading from file \"%s\": %s",
+					m_path.string().c_str(), strerror(errno));
+			}
+#endif
+			if (bytesRead == 0)
+				break;
+			total += (size_t) bytesRead;
+		}
+		return total;
+	}
+
+private:
+	struct Block {
+		std::vector<uint8_t> data;
+		size_t offset, size;
+		bool full;
+	};
+
+	handle_t m_handle;
+	fs::path m_path;
+	size_t m_blockSize;
+	ref<Mutex> m_mutex;
+	ref<ConditionVariable> m_cond;
+	Block m_blocks[2];
+	size_t m_generation, m_nextOffset;
+	int m_fill, m_consume;
+	bool m_done, m_quit;
+	std::string m_error;
+
+	/* Buffer being consumed (only accessed by the consumer) */
+	const uint8_t *m_current;
+	size_t m_currentOffset, m_currentSize;
+};
+
 struct FileStream::FileStreamPrivate
 {
 #if defined(__WINDOWS__)
@@ -40,8 +230,10 @@ struct FileStream::FileStreamPrivate
 	bool deleteOnClose;
 	FileStream::EFileMode mode;
 	fs::path path;
+	ref<ReadAheadThread> readAhead;
+	size_t pos; ///< Logical position while reading ahead
 
-	FileStreamPrivate() : file(NULL) {}
+	FileStreamPrivate() : file(NULL), pos(0) {}
 };
 
 FileStream::FileStream()
@@ -166,6 +358,11 @@ void FileStream::close() {
 	AssertEx(d->file != 0, "No file is currently open");
 	Log(ETrace, "Closing \"%s\"", d->path.string().c_str());
 
+	if (d->readAhead) {
+		d->readAhead->quit();
+		d->readAhead = NULL;
+	}
+
 #if defined(__WINDOWS__)
 	if (!CloseHandle(d->file)) {
 		Log(EError, "Error while trying to close file \"%s\": %s",
@@ -195,9 +392,45 @@ void FileStream::remove() {
 	fs::remove(d->path);
 }
 
+void FileStream::setReadAhead(size_t blockSize) {
+	AssertEx(d->file != 0, "No file is currently open");
+	AssertEx(d->mode == EReadOnly, "Read-ahead requires a file opened with EReadOnly");
+
+	if (d->readAhead) {
+		size_t pos = d->pos;
+		d->readAhead->quit();
+		d->readAhead = NULL;
+		seek(pos);
+	}
+
+	/* Files that fit into a single block are read directly, as
+	   are files opened by threads not managed by Mitsuba */
+	if (blockSize == 0 || getSize() <= blockSize || !Thread::getThread())
+		return;
+
+	d->pos = getPos();
+#if defined(__WINDOWS__)
+	ReadAheadThread::handle_t handle = d->file;
+#else
+	ReadAheadThread::handle_t handle = fileno(d->file);
+#endif
+	d->readAhead = new ReadAheadThread(handle, d->path, blockSize, d->pos);
+	d->readAhead->start();
+}
+
+bool FileStream::getReadAhead() const {
+	return d->readAhead.get() != NULL;
+}
+
 void FileStream::seek(size_t pos) {
 	AssertEx(d->file != 0, "No file is currently open");
 
+	if (d->readAhead) {
+		/* Resolved lazily by the next read() */
+		d->pos = pos;
+		return;
+	}
+
 #if defined(__WINDOWS__)
 	LARGE_INTEGER fpos;
 	fpos.QuadPart = pos;
@@ -215,6 +448,8 @@ void FileStream::seek(size_t pos) {
 
 size_t FileStream::getPos() const {
 	AssertEx(d->file != 0, "No file is currently open");
+	if (d->readAhead)
+		return d->pos;
 #if defined(__WINDOWS__)
 	DWORD pos = SetFilePointer(d->file, 0, 0, FILE_CURRENT);
 	if (pos == INVALID_SET_FILE_POINTER) {
@@ -307,6 +542,11 @@ void FileStream::read(void *pPtr, size_t size) {
 
 	if (size == 0)
 		return;
+
+	if (d->readAhead) {
+		d->readAhead->read((uint8_t *) pPtr, size, d->pos);
+		return;
+	}
 #if defined(__WINDOWS__)
 	DWORD lpNumberOfBytesRead;
 	if (!ReadFile(d->file, pPtr, (DWORD) size, &lpNumberOfBytesRead, 0)) {
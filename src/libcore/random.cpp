@@ -639,6 +639,26 @@ Float Random::nextFloat() {
 }
 #endif
 
+void Random::nextFloats(Float *dest, size_t count) {
+	for (size_t i=0; i<count; ++i) {
+#if defined(DOUBLE_PRECISION)
+		union {
+			uint64_t u;
+			double d;
+		} x;
+		x.u = (mt->gen_rand64() >> 12) | 0x3ff0000000000000ULL;
+		dest[i] = x.d - 1.0;
+#else
+		union {
+			uint32_t u;
+			float f;
+		} x;
+		x.u = ((mt->gen_rand64() & 0xFFFFFFFF) >> 9) | 0x3f800000UL;
+		dest[i] = x.f - 1.0f;
+#endif
+	}
+}
+
 Float Random::nextStandardNormal() {
 	/* Marsaglia polar method for generating two standard
 	   normal variates. One is subsequently thrown away */
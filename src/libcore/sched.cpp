@@ -117,9 +117,10 @@ int Scheduler::registerResource(SerializableObject *object) {
 	int resourceID = m_resourceCounter++;
 	ResourceRecord *rec = new ResourceRecord(object);
 	if (hasRemoteWorkers()) {
+		/* Serialized in the host byte order, which remote
+		   connections use once their handshake is complete */
 		ref<InstanceManager> manager = new InstanceManager();
 		rec->stream = new MemoryStream();
-		rec->stream->setByteOrder(Stream::ENetworkByteOrder);
 		manager->serialize(rec->stream, rec->resources[0]);
 	}
 	m_resources[resourceID] = rec;
@@ -223,7 +224,6 @@ const MemoryStream *Scheduler::getResourceStream(int id) {
 	if (!rec->stream) {
 		ref<InstanceManager> manager = new InstanceManager();
 		rec->stream = new MemoryStream();
-		rec->stream->setByteOrder(Stream::ENetworkByteOrder);
 		manager->serialize(rec->stream, rec->resources[0]);
 	}
 	return rec->stream;
@@ -454,7 +454,17 @@ Scheduler::EStatus Scheduler::acquireWork(Item &item,
 				setProcessByID(item, id);
 			}
 
-			wStatus = item.proc->generateWork(item.workUnit, item.workerIndex);
+			if (!item.rec->reissued.empty()) {
+				/* Lost work units take precedence */
+				item.workUnit->set(item.rec->reissued.front());
+				item.rec->reissued.pop_front();
+				wStatus = ParallelProcess::ESuccess;
+			} else if (!item.rec->morework) {
+				/* The process was only requeued to hand out lost work units */
+				wStatus = ParallelProcess::EFailure;
+			} else {
+				wStatus = item.proc->generateWork(item.workUnit, item.workerIndex);
+			}
 		} catch (const std::exception &ex) {
 			Log(EWarn, "Caught an exception - canceling process %i: %s",
 				item.id, ex.what());
@@ -495,6 +505,31 @@ Scheduler::EStatus Scheduler::acquireWork(Item &item,
 	return EOK;
 }
 
+bool Scheduler::reissueWork(int id, WorkUnit *workUnit) {
+	LockGuard lock(m_mutex);
+	std::map<int, ParallelProcess *>::iterator it = m_idToProcess.find(id);
+	if (it == m_idToProcess.end())
+		return false;
+
+	ParallelProcess *proc = (*it).second;
+	ProcessRecord *rec = m_processes[proc];
+	--rec->inflight;
+	rec->cond->signal();
+
+	if (rec->cancelled)
+		return false;
+
+	rec->reissued.push_back(workUnit);
+	if (!rec->active) {
+		rec->active = true;
+		m_localQueue.push_back(rec->id);
+		if (!proc->isLocal())
+			m_remoteQueue.push_back(rec->id);
+	}
+	m_workAvailable->broadcast();
+	return true;
+}
+
 void Scheduler::signalProcessTermination(ParallelProcess *proc, ProcessRecord *rec) {
 #if defined(DEBUG_SCHED)
 	Log(rec->logLevel, "Process %i is complete.", rec->id);
@@ -21,9 +21,147 @@
 #include <mitsuba/core/mstream.h>
 #include <mitsuba/core/plugin.h>
 #include <mitsuba/core/version.h>
+#include <mitsuba/core/zstream.h>
+#include <mitsuba/core/fstream.h>
+#include <mitsuba/core/timer.h>
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+/* Flag in the configuration byte of the hello message: the client
+   requests its own (little-endian) byte order on the connection */
+#define MTS_HELLO_LITTLE_ENDIAN 0x02
 
 MTS_NAMESPACE_BEGIN
 
+/* ==================================================================== */
+/*                  Chunked, compressed resource transfer               */
+/* ==================================================================== */
+
+/// Random table used by the "gear" rolling hash for content-defined chunking
+struct GearTable {
+	uint64_t value[256];
+
+	GearTable() {
+		uint64_t state = 0x9E3779B97F4A7C15ULL;
+		for (int i=0; i<256; ++i) {
+			state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+			value[i] = state ^ (state >> 29);
+		}
+	}
+};
+
+static GearTable __gearTable;
+
+/// A resource that has been split into compressed chunks
+class PreparedResource : public Object {
+public:
+	struct Chunk {
+		RemoteWorker::BlobKey key;
+		ref<MemoryStream> data;
+	};
+
+	std::vector<Chunk> chunks;
+	size_t size;
+protected:
+	virtual ~PreparedResource() { }
+};
+
+/**
+ * Split a resource into content-defined chunks and compress them. Since
+ * chunk boundaries only depend on the local content, an unchanged mesh
+ * or texture embedded in an otherwise modified scene still produces
+ * the same chunks.
+ */
+static ref<PreparedResource> prepareResource(const uint8_t *data, size_t size) {
+	ref<PreparedResource> result = new PreparedResource();
+	result->size = size;
+
+	size_t start = 0;
+	while (start < size) {
+		size_t end = std::min(start + MTS_BLOB_MIN_SIZE, size),
+		       limit = std::min(start + MTS_BLOB_MAX_SIZE, size);
+		uint64_t hash = 0;
+
+		while (end < limit) {
+			hash = (hash << 1) + __gearTable.value[data[end++]];
+			if ((hash & MTS_BLOB_MASK) == 0)
+				break;
+		}
+
+		PreparedResource::Chunk chunk;
+		chunk.key = RemoteWorker::BlobKey(hashBuffer(data + start, end - start),
+			(uint32_t) (end - start));
+		chunk.data = new MemoryStream((end - start) / 2 + 64);
+		ref<ZStream> zstream = new ZStream(chunk.data,
+			ZStream::EDeflateStream, MTS_BLOB_COMPRESSION);
+		zstream->write(data + start, end - start);
+		zstream = NULL; /* Finishes the deflate stream */
+
+		result->chunks.push_back(chunk);
+		start = end;
+	}
+
+	return result;
+}
+
+/* Resources are chunked and compressed once, and then shared by all remote workers */
+static std::map<int, ref<PreparedResource> > __preparedResources;
+static boost::mutex __preparedMutex;
+
+/* Optional persistent blob cache of the server side */
+static fs::path __blobCacheDir;
+static uint64_t __blobCacheLimit = 0, __blobCacheSize = 0;
+static boost::mutex __blobCacheMutex;
+
+static fs::path getBlobPath(const RemoteWorker::BlobKey &key) {
+	return __blobCacheDir / formatString("%016llx-%08x.blob",
+		(unsigned long long) key.first, key.second);
+}
+
+static bool isBlobPath(const fs::path &path) {
+	std::string name = path.filename().string();
+	return name.length() == 30 && name.compare(25, 5, ".blob") == 0;
+}
+
+/**
+ * Evict the least recently used blobs (by modification time, which
+ * is refreshed on every cache hit) until the cache fits into \c maxSize.
+ * Returns the size of the remaining blobs.
+ */
+static uint64_t pruneBlobCache(const fs::path &dir, uint64_t maxSize) {
+	typedef std::pair<std::time_t, fs::path> Entry;
+	std::vector<Entry> entries;
+	uint64_t totalSize = 0;
+	boost::system::error_code ec;
+
+	for (fs::directory_iterator it(dir), end; it != end; ++it) {
+		if (!isBlobPath(it->path()))
+			continue;
+		uint64_t size = (uint64_t) fs::file_size(it->path(), ec);
+		if (ec)
+			continue;
+		entries.push_back(Entry(fs::last_write_time(it->path(), ec), it->path()));
+		totalSize += size;
+	}
+
+	if (totalSize <= maxSize)
+		return totalSize;
+
+	std::sort(entries.begin(), entries.end());
+	size_t removed = 0;
+	for (size_t i=0; i<entries.size() && totalSize > maxSize; ++i) {
+		uint64_t size = (uint64_t) fs::file_size(entries[i].second, ec);
+		if (ec || !fs::remove(entries[i].second, ec))
+			continue;
+		totalSize -= size;
+		++removed;
+	}
+	SLog(EInfo, "Evicted " SIZE_T_FMT " resources from the blob cache \"%s\" (%s remaining)",
+		removed, dir.string().c_str(), memString((size_t) totalSize).c_str());
+	return totalSize;
+}
+
 class CancelThread : public Thread {
 public:
 	CancelThread(ParallelProcess *proc) : Thread("cthr"), m_proc(proc) { }
@@ -48,6 +186,11 @@ RemoteWorker::RemoteWorker(const std::string &name, Stream *stream) : Worker(nam
 #else
 	data[dataLength-1] = 0;
 #endif
+	/* Ask the server to use the byte order of this machine instead of
+	   big-endian network byte order once the handshake has completed.
+	   Servers that predate this flag reject little-endian clients. */
+	if (Stream::getHostByteOrder() == Stream::ELittleEndian)
+		data[dataLength-1] |= MTS_HELLO_LITTLE_ENDIAN;
 	m_stream->writeShort(StreamBackend::EHello);
 	m_stream->write(data, dataLength);
 	m_stream->flush();
@@ -57,18 +200,36 @@ RemoteWorker::RemoteWorker(const std::string &name, Stream *stream) : Worker(nam
 		Log(EError, "The server reported a version or configuration mismatch -- unable to connect!");
 	else if (msg != StreamBackend::EHello)
 		Log(EError, "Received an invalid response!");
+	m_stream->setByteOrder(Stream::getHostByteOrder());
 	m_coreCount = m_stream->readShort();
 	m_nodeName = m_stream->readString();
+
+	/* Find out which resource chunks the node already has */
+	m_nodeCache = m_stream->readBool();
+	uint32_t blobCount = m_stream->readUInt();
+	for (uint32_t i=0; i<blobCount; ++i) {
+		uint64_t hash = m_stream->readULong();
+		uint32_t size = m_stream->readUInt();
+		m_nodeBlobs.insert(BlobKey(hash, size));
+	}
+	m_statsRaw = m_statsSent = m_statsReused = 0;
 	m_mutex = new Mutex();
 	m_finishCond = new ConditionVariable(m_mutex);
 	m_memStream = new MemoryStream();
-	m_memStream->setByteOrder(Stream::ENetworkByteOrder);
 	m_reader = new RemoteWorkerReader(this);
 	m_reader->start();
 	m_inFlight = 0;
+	m_windowSize = MTS_BACKLOG_FACTOR * m_coreCount;
+	m_continueSize = MTS_CONTINUE_FACTOR * m_coreCount;
+	m_timer = new Timer();
+	m_busyTime = m_lastEvent = m_firstEvent = 0;
+	m_unitsDone = 0;
+	m_nextSeq = 0;
+	m_timeout = 0;
+	m_failed = false;
 	m_isRemote = true;
-	Log(EDebug, "Connection to \"%s\" established (%i cores).",
-		m_nodeName.c_str(), m_coreCount);
+	Log(EDebug, "Connection to \"%s\" established (%i cores, %i cached blobs).",
+		m_nodeName.c_str(), m_coreCount, (int) blobCount);
 }
 
 RemoteWorker::~RemoteWorker() {
@@ -76,17 +237,46 @@ RemoteWorker::~RemoteWorker() {
 	if (!m_reader || !m_mutex || !m_memStream)
 		return;
 
+	if (m_statsRaw > 0)
+		Log(EInfo, "Resource transfer to \"%s\": %s of resource data, %s sent "
+			"after compression, %s served from the node's blob cache", m_nodeName.c_str(),
+			memString(m_statsRaw).c_str(), memString(m_statsSent).c_str(),
+			memString(m_statsReused).c_str());
+
 	LockGuard lock(m_mutex);
 	m_reader->shutdown();
-	m_memStream->writeShort(StreamBackend::EQuit);
-	try {
-		flush();
-	} catch (std::runtime_error &e) {
-		Log(EWarn, "Could not flush buffer: %s", e.what());
+	if (!m_failed) {
+		m_memStream->writeShort(StreamBackend::EQuit);
+		try {
+			flush();
+		} catch (std::runtime_error &e) {
+			Log(EWarn, "Could not flush buffer: %s", e.what());
+		}
 	}
 	m_reader->join();
 }
 
+void RemoteWorker::setWindowSize(size_t size) {
+	LockGuard lock(m_mutex);
+	m_windowSize = std::max((size_t) 1, size);
+	m_continueSize = m_windowSize - std::max((size_t) 1, m_windowSize / 3);
+}
+
+void RemoteWorker::setTimeout(Float timeout) {
+	LockGuard lock(m_mutex);
+	m_timeout = timeout;
+}
+
+void RemoteWorker::updateUtilization() {
+	/* Every in-flight work unit up to the core count keeps one core busy */
+	uint64_t now = m_timer->getNanoseconds();
+	if (m_firstEvent == 0)
+		m_firstEvent = now;
+	else
+		m_busyTime += (now - m_lastEvent) * std::min(m_inFlight, m_coreCount);
+	m_lastEvent = now;
+}
+
 void RemoteWorker::start(Scheduler *scheduler, int workerIndex, int coreOffset) {
 	Worker::start(scheduler, workerIndex, coreOffset);
 	m_reader->m_schedItem.coreOffset = coreOffset;
@@ -99,131 +289,354 @@ void RemoteWorker::flush() {
 	m_stream->flush();
 }
 
+void RemoteWorker::sendResource(int msg, int id, const void *data, size_t size, bool reuse) {
+	ref<PreparedResource> prepared;
+	if (reuse) {
+		boost::lock_guard<boost::mutex> lock(__preparedMutex);
+		std::map<int, ref<PreparedResource> >::iterator it = __preparedResources.find(id);
+		if (it == __preparedResources.end()) {
+			ref<Timer> timer = new Timer();
+			prepared = prepareResource((const uint8_t *) data, size);
+			__preparedResources[id] = prepared;
+			Log(EDebug, "Compressed resource %i (%s, " SIZE_T_FMT " chunks) in %i ms",
+				id, memString(size).c_str(), prepared->chunks.size(), timer->getMilliseconds());
+		} else {
+			prepared = it->second;
+		}
+	} else {
+		prepared = prepareResource((const uint8_t *) data, size);
+		m_multiResources[id] = prepared;
+	}
+
+	sendPreparedResource(msg, id, prepared);
+}
+
+void RemoteWorker::sendPreparedResource(int msg, int id, const PreparedResource *prepared) {
+	size_t sent = 0, reused = 0;
+	m_memStream->writeShort((short) msg);
+	m_memStream->writeInt(id);
+	m_memStream->writeSize(prepared->size);
+	m_memStream->writeUInt((uint32_t) prepared->chunks.size());
+	for (size_t i=0; i<prepared->chunks.size(); ++i) {
+		const PreparedResource::Chunk &chunk = prepared->chunks[i];
+		m_memStream->writeULong(chunk.key.first);
+		m_memStream->writeUInt(chunk.key.second);
+
+		if (m_nodeBlobs.find(chunk.key) != m_nodeBlobs.end()) {
+			m_memStream->writeBool(true);
+			reused += chunk.key.second;
+		} else {
+			size_t compressedSize = chunk.data->getPos();
+			m_memStream->writeBool(false);
+			m_memStream->writeUInt((uint32_t) compressedSize);
+			m_memStream->write(chunk.data->getData(), compressedSize);
+			sent += compressedSize;
+			if (m_nodeCache)
+				m_nodeBlobs.insert(chunk.key);
+		}
+	}
+
+	Log(EDebug, "Sending resource %i to \"%s\" (%s, %s after compression, %s cached)",
+		id, m_nodeName.c_str(), memString(prepared->size).c_str(), memString(sent).c_str(),
+		memString(reused).c_str());
+
+	m_statsRaw += prepared->size;
+	m_statsSent += sent;
+	m_statsReused += reused;
+}
+
+void RemoteWorker::resendResource(int id, const std::vector<BlobKey> &missing) {
+	LockGuard lock(m_mutex);
+	if (m_failed || m_resources.find(id) == m_resources.end())
+		return; /* Expired in the meantime */
+
+	ref<PreparedResource> prepared;
+	int msg = StreamBackend::ENewMultiResource;
+	std::map<int, ref<PreparedResource> >::iterator it = m_multiResources.find(id);
+	if (it != m_multiResources.end()) {
+		prepared = it->second;
+	} else {
+		boost::lock_guard<boost::mutex> preparedLock(__preparedMutex);
+		std::map<int, ref<PreparedResource> >::iterator it2 = __preparedResources.find(id);
+		if (it2 != __preparedResources.end())
+			prepared = it2->second;
+		msg = StreamBackend::ENewResource;
+	}
+	if (!prepared)
+		Log(EError, "Node \"%s\" requested resource %i again, which is no longer "
+			"available!", m_nodeName.c_str(), id);
+
+	Log(EInfo, SIZE_T_FMT " chunks of resource %i are missing from the blob cache "
+		"of \"%s\" -- sending them again", missing.size(), id, m_nodeName.c_str());
+	for (size_t i=0; i<missing.size(); ++i)
+		m_nodeBlobs.erase(missing[i]);
+	sendPreparedResource(msg, id, prepared);
+	flush();
+}
+
 void RemoteWorker::run() {
 	Scheduler::EStatus status;
 
 	while ((status = acquireWork(false, true, true)) != Scheduler::EStop) {
 		if (status == Scheduler::ENone) {
-			flush();
-			if ((status = acquireWork(false, false, true)) == Scheduler::EStop)
+			try {
+				LockGuard lock(m_mutex);
+				if (!m_failed)
+					flush();
+			} catch (const std::exception &e) {
+				handleFailure(e.what());
+			}
+
+			if (m_timeout > 0) {
+				/* Poll, so that work units which have timed out are noticed */
+				while ((status = acquireWork(false, true, true)) == Scheduler::ENone) {
+					checkTimeouts();
+					LockGuard lock(m_mutex);
+					m_finishCond->wait(MTS_REMOTE_POLL_INTERVAL);
+				}
+			} else {
+				status = acquireWork(false, false, true);
+			}
+			if (status == Scheduler::EStop)
 				break;
 		}
-		/* Acquire the lock each iteration, release it at the end of each one */
-		LockGuard lock(m_mutex);
 
 		const int id = m_schedItem.rec->id;
-		if (m_processes.find(id) == m_processes.end()) {
-			/* The backend has not yet seen this process - submit
-			   all information required to receive and execute work
-			   units on the other side */
-			std::vector<std::pair<int, const MemoryStream *> > resources;
-			std::vector<std::pair<int, const SerializableObject *> > multiResources;
-
-			/* First, look up all resources required by this process (the scheduler lock
-			   needs to be held for that, so do it quickly) */
-			const ParallelProcess::ResourceBindings &bindings = m_schedItem.proc->getResourceBindings();
-			for (ParallelProcess::ResourceBindings::const_iterator it = bindings.begin();
-				it != bindings.end(); ++it) {
-				int resID = (*it).second;
-
-				if (m_resources.find(resID) == m_resources.end()) {
-					if (!m_scheduler->isMultiResource(resID)) {
-						resources.push_back(std::pair<int, const MemoryStream *>(resID,
-							m_scheduler->getResourceStream(resID)));
-					} else {
-						for (size_t i=0; i<m_coreCount; ++i)
-							multiResources.push_back(std::pair<int, const SerializableObject *>(resID,
-								m_scheduler->getResource(resID, (int) (m_schedItem.coreOffset + i))));
-					}
-				}
-				m_resources.insert(resID);
-			}
-			/* We can safely release the scheduler lock now. The local message buffer lock is still
-			   held and thus, there is no danger of sending a cancellation message for a process which
-			   the remote side has not even seen yet. */
-			releaseSchedulerLock();
-
-			std::vector<std::string> plugins = m_schedItem.proc->getRequiredPlugins();
-			for (size_t i=0; i<plugins.size(); ++i) {
-				if (m_plugins.find(plugins[i]) == m_plugins.end()) {
-					/* Ask the remote side to load any plugins, which might be required first */
-					m_memStream->writeShort(StreamBackend::EEnsurePluginLoaded);
-					m_memStream->writeString(plugins[i]);
-					m_plugins.insert(plugins[i]);
-				}
+		bool lost = false;
+		try {
+			/* Acquire the lock each iteration, release it at the end of each one */
+			LockGuard lock(m_mutex);
+			if (m_failed) {
+				releaseSchedulerLock();
+				lost = true;
+			} else {
+				sendWorkUnit(id);
 			}
+		} catch (const std::exception &e) {
+			handleFailure(e.what());
+		}
 
-			m_memStream->writeShort(StreamBackend::ENewProcess);
-			m_memStream->writeInt(id);
-			m_memStream->writeInt(m_schedItem.proc->getLogLevel());
+		if (lost) {
+			/* The node is gone -- hand the work unit to another worker */
+			ref<WorkUnit> workUnit = m_schedItem.wp->createWorkUnit();
+			workUnit->set(m_schedItem.workUnit);
+			reissueWork(id, workUnit);
+		}
+		if (m_failed)
+			break;
+	}
 
-			ref<InstanceManager> manager = new InstanceManager();
-			manager->serialize(m_memStream, m_schedItem.wp);
-			m_processes.insert(id);
-
-			for (size_t i=0; i<resources.size(); ++i) {
-				int resID = resources[i].first;
-				const MemoryStream *resStream = resources[i].second;
-				Log(EDebug, "Sending resource %i to \"%s\" (%i KB)", resID, m_nodeName.c_str(),
-					resStream->getPos() / 1024);
-				m_memStream->writeShort(StreamBackend::ENewResource);
-				m_memStream->writeInt(resID);
-				m_memStream->writeSize(resStream->getPos());
-				m_memStream->write(resStream->getData(), resStream->getPos());
-			}
+	try {
+		LockGuard lock(m_mutex);
+		if (!m_failed)
+			flush();
+	} catch (const std::exception &e) {
+		handleFailure(e.what());
+	}
+}
 
-			for (size_t i=0; i<multiResources.size(); i += m_coreCount) {
-				int resID = multiResources[i].first;
-				ref<MemoryStream> resStream = new MemoryStream();
-				ref<InstanceManager> manager = new InstanceManager();
-				resStream->setByteOrder(Stream::ENetworkByteOrder);
-				for (size_t j=0; j<m_coreCount; ++j)
-					manager->serialize(resStream, multiResources[i+j].second);
-				Log(EDebug, "Sending multi resource %i to \"%s\" (%i KB)", resID, m_nodeName.c_str(),
-					resStream->getPos() / 1024);
-				m_memStream->writeShort(StreamBackend::ENewMultiResource);
-				m_memStream->writeInt(resID);
-				m_memStream->writeSize(resStream->getPos());
-				m_memStream->write(resStream->getData(), resStream->getPos());
+void RemoteWorker::sendWorkUnit(int id) {
+	if (m_processes.find(id) == m_processes.end()) {
+		/* The backend has not yet seen this process - submit
+		   all information required to receive and execute work
+		   units on the other side */
+		std::vector<std::pair<int, const MemoryStream *> > resources;
+		std::vector<std::pair<int, const SerializableObject *> > multiResources;
+
+		/* First, look up all resources required by this process (the scheduler lock
+		   needs to be held for that, so do it quickly) */
+		const ParallelProcess::ResourceBindings &bindings = m_schedItem.proc->getResourceBindings();
+		for (ParallelProcess::ResourceBindings::const_iterator it = bindings.begin();
+			it != bindings.end(); ++it) {
+			int resID = (*it).second;
+
+			if (m_resources.find(resID) == m_resources.end()) {
+				if (!m_scheduler->isMultiResource(resID)) {
+					resources.push_back(std::pair<int, const MemoryStream *>(resID,
+						m_scheduler->getResourceStream(resID)));
+				} else {
+					for (size_t i=0; i<m_coreCount; ++i)
+						multiResources.push_back(std::pair<int, const SerializableObject *>(resID,
+							m_scheduler->getResource(resID, (int) (m_schedItem.coreOffset + i))));
+				}
 			}
-
-			for (ParallelProcess::ResourceBindings::const_iterator it = bindings.begin();
-				it != bindings.end(); ++it) {
-				m_memStream->writeShort(StreamBackend::EBindResource);
-				m_memStream->writeInt(id);
-				m_memStream->writeString((*it).first);
-				m_memStream->writeInt((*it).second);
+			m_resources.insert(resID);
+		}
+		/* We can safely release the scheduler lock now. The local message buffer lock is still
+		   held and thus, there is no danger of sending a cancellation message for a process which
+		   the remote side has not even seen yet. */
+		releaseSchedulerLock();
+
+		std::vector<std::string> plugins = m_schedItem.proc->getRequiredPlugins();
+		for (size_t i=0; i<plugins.size(); ++i) {
+			if (m_plugins.find(plugins[i]) == m_plugins.end()) {
+				/* Ask the remote side to load any plugins, which might be required first */
+				m_memStream->writeShort(StreamBackend::EEnsurePluginLoaded);
+				m_memStream->writeString(plugins[i]);
+				m_plugins.insert(plugins[i]);
 			}
-		} else {
-			releaseSchedulerLock();
 		}
 
-		m_memStream->writeShort(StreamBackend::EWorkUnit);
+		m_memStream->writeShort(StreamBackend::ENewProcess);
 		m_memStream->writeInt(id);
-		m_schedItem.workUnit->save(m_memStream);
+		m_memStream->writeInt(m_schedItem.proc->getLogLevel());
 
-		if (++m_inFlight == MTS_BACKLOG_FACTOR * m_coreCount) {
-			flush();
-			/* There are now too many packets in transit. Wait
-			   until this clears up a bit before attempting to
-			   send more work */
-			while (m_inFlight > MTS_CONTINUE_FACTOR * m_coreCount)
+		ref<InstanceManager> manager = new InstanceManager();
+		manager->serialize(m_memStream, m_schedItem.wp);
+		m_processes.insert(id);
+
+		for (size_t i=0; i<resources.size(); ++i) {
+			int resID = resources[i].first;
+			const MemoryStream *resStream = resources[i].second;
+			sendResource(StreamBackend::ENewResource, resID,
+				resStream->getData(), resStream->getPos(), true);
+		}
+
+		for (size_t i=0; i<multiResources.size(); i += m_coreCount) {
+			int resID = multiResources[i].first;
+			ref<MemoryStream> resStream = new MemoryStream();
+			ref<InstanceManager> manager = new InstanceManager();
+			for (size_t j=0; j<m_coreCount; ++j)
+				manager->serialize(resStream, multiResources[i+j].second);
+			sendResource(StreamBackend::ENewMultiResource, resID,
+				resStream->getData(), resStream->getPos(), false);
+		}
+
+		for (ParallelProcess::ResourceBindings::const_iterator it = bindings.begin();
+			it != bindings.end(); ++it) {
+			m_memStream->writeShort(StreamBackend::EBindResource);
+			m_memStream->writeInt(id);
+			m_memStream->writeString((*it).first);
+			m_memStream->writeInt((*it).second);
+		}
+	} else {
+		releaseSchedulerLock();
+	}
+
+	/* Keep a copy of the work unit, so that it can be reissued */
+	uint32_t seq = m_nextSeq++;
+	OutstandingWork &work = m_outstanding[seq];
+	work.id = id;
+	work.workUnit = m_schedItem.wp->createWorkUnit();
+	work.workUnit->set(m_schedItem.workUnit);
+	work.time = m_timer->getNanoseconds();
+
+	m_memStream->writeShort(StreamBackend::EWorkUnit);
+	m_memStream->writeInt(id);
+	m_memStream->writeUInt(seq);
+	m_schedItem.workUnit->save(m_memStream);
+
+	updateUtilization();
+	if (++m_inFlight >= m_windowSize) {
+		flush();
+		/* There are now too many packets in transit. Wait
+		   until this clears up a bit before attempting to
+		   send more work */
+		while (m_inFlight > m_continueSize && !m_failed) {
+			if (m_timeout > 0) {
+				m_finishCond->wait(MTS_REMOTE_POLL_INTERVAL);
+				m_mutex->unlock();
+				checkTimeouts();
+				m_mutex->lock();
+			} else {
 				m_finishCond->wait();
+			}
 		}
 	}
+}
+
+bool RemoteWorker::claimWorkUnit(uint32_t seq) {
 	LockGuard lock(m_mutex);
-	flush();
+	std::map<uint32_t, OutstandingWork>::iterator it = m_outstanding.find(seq);
+	if (it == m_outstanding.end())
+		return false;
+	m_outstanding.erase(it);
+	return true;
+}
+
+void RemoteWorker::handleFailure(const std::string &reason) {
+	std::vector<std::pair<int, ref<WorkUnit> > > units;
+	{
+		LockGuard lock(m_mutex);
+		if (m_failed)
+			return;
+		m_failed = true;
+
+		for (std::map<uint32_t, OutstandingWork>::iterator it = m_outstanding.begin();
+				it != m_outstanding.end(); ++it)
+			units.push_back(std::make_pair(it->second.id, it->second.workUnit));
+		m_outstanding.clear();
+		updateUtilization();
+		m_inFlight = 0;
+		m_finishCond->broadcast();
+
+		Log(EWarn, "Lost the connection to \"%s\" (%s) -- reissuing " SIZE_T_FMT
+			" work units to the remaining workers", m_nodeName.c_str(), reason.c_str(),
+			units.size());
+	}
+	reissue(units);
+}
+
+void RemoteWorker::checkTimeouts() {
+	std::vector<std::pair<int, ref<WorkUnit> > > units;
+	{
+		LockGuard lock(m_mutex);
+		if (m_timeout <= 0 || m_failed)
+			return;
+
+		uint64_t now = m_timer->getNanoseconds(),
+		         limit = (uint64_t) (m_timeout * 1e9);
+		std::map<uint32_t, OutstandingWork>::iterator it = m_outstanding.begin();
+		while (it != m_outstanding.end()) {
+			if (now - it->second.time > limit) {
+				units.push_back(std::make_pair(it->second.id, it->second.workUnit));
+				m_outstanding.erase(it++);
+				updateUtilization();
+				--m_inFlight;
+			} else {
+				++it;
+			}
+		}
+		if (units.empty())
+			return;
+
+		m_finishCond->broadcast();
+		Log(EWarn, SIZE_T_FMT " work units sent to \"%s\" have timed out -- reissuing them",
+			units.size(), m_nodeName.c_str());
+	}
+	reissue(units);
+}
+
+void RemoteWorker::reissue(std::vector<std::pair<int, ref<WorkUnit> > > &units) {
+	for (size_t i=0; i<units.size(); ++i) {
+		if (!reissueWork(units[i].first, units[i].second))
+			Log(EDebug, "Dropping a work unit of process %i (no longer active)",
+				units[i].first);
+	}
 }
 
 void RemoteWorker::signalResourceExpiration(int id) {
+	{
+		boost::lock_guard<boost::mutex> lock(__preparedMutex);
+		__preparedResources.erase(id);
+	}
+
 	LockGuard lock(m_mutex);
 	if (m_resources.find(id) == m_resources.end()) {
 		return;
 	}
+	m_resources.erase(id);
+	m_multiResources.erase(id);
+	if (m_failed)
+		return;
 	m_memStream->writeShort(StreamBackend::EResourceExpired);
 	m_memStream->writeInt(id);
-	flush();
-	m_resources.erase(id);
+	try {
+		flush();
+	} catch (const std::exception &e) {
+		/* Handled by the reader thread, which will notice the failure as well */
+		Log(EWarn, "Could not flush buffer: %s", e.what());
+	}
 }
 
 void RemoteWorker::signalProcessCancellation(int id) {
@@ -231,10 +644,17 @@ void RemoteWorker::signalProcessCancellation(int id) {
 	if (m_processes.find(id) == m_processes.end()) {
 		return;
 	}
+	m_processes.erase(id);
+	if (m_failed)
+		return;
 	m_memStream->writeShort(StreamBackend::EProcessCancelled);
 	m_memStream->writeInt(id);
-	flush();
-	m_processes.erase(id);
+	try {
+		flush();
+	} catch (const std::exception &e) {
+		/* Handled by the reader thread, which will notice the failure as well */
+		Log(EWarn, "Could not flush buffer: %s", e.what());
+	}
 }
 
 void RemoteWorker::signalProcessTermination(int id) {
@@ -242,10 +662,29 @@ void RemoteWorker::signalProcessTermination(int id) {
 	if (m_processes.find(id) == m_processes.end()) {
 		return;
 	}
+
+	updateUtilization();
+	if (m_unitsDone > 0 && m_lastEvent > m_firstEvent) {
+		Float span = (Float) (m_lastEvent - m_firstEvent);
+		Log(EInfo, "Node \"%s\": processed " SIZE_T_FMT " work units in %s, "
+			"utilization %.1f%% (window: " SIZE_T_FMT " work units)",
+			m_nodeName.c_str(), m_unitsDone, timeString(span * 1e-9f).c_str(),
+			100.0f * m_busyTime / (span * m_coreCount), m_windowSize);
+	}
+	m_busyTime = m_firstEvent = m_lastEvent = 0;
+	m_unitsDone = 0;
+
+	m_processes.erase(id);
+	if (m_failed)
+		return;
 	m_memStream->writeShort(StreamBackend::EProcessTerminated);
 	m_memStream->writeInt(id);
-	flush();
-	m_processes.erase(id);
+	try {
+		flush();
+	} catch (const std::exception &e) {
+		/* Handled by the reader thread, which will notice the failure as well */
+		Log(EWarn, "Could not flush buffer: %s", e.what());
+	}
 }
 
 void RemoteWorker::clear() {
@@ -265,48 +704,38 @@ RemoteWorkerReader::RemoteWorkerReader(RemoteWorker *worker)
 }
 
 void RemoteWorkerReader::run() {
-	int id=-1; short msg=-1;
+	short msg=-1;
+	std::vector<uint8_t> buffer;
 
 	while (true) {
 		try {
 			msg = m_stream->readShort();
-			id = m_stream->readInt();
 
-			if (id != m_currentID) {
-				m_parent->setProcessByID(m_schedItem, id);
-				m_currentID = id;
+			if (msg == StreamBackend::ECompressedBatch) {
+				/* Several messages that were compressed together */
+				uint32_t size = m_stream->readUInt(),
+				         compressedSize = m_stream->readUInt();
+				ref<MemoryStream> compressed = new MemoryStream(compressedSize);
+				m_stream->copyTo(compressed, compressedSize);
+				compressed->seek(0);
+
+				buffer.resize(size);
+				ref<ZStream> zstream = new ZStream(compressed);
+				zstream->read(&buffer[0], size);
+
+				ref<MemoryStream> batch = new MemoryStream(size);
+				batch->write(&buffer[0], size);
+				batch->seek(0);
+				while (batch->getPos() < size)
+					handleMessage(batch, batch->readShort());
+			} else {
+				handleMessage(m_stream, msg);
 			}
-
-			switch (msg) {
-				case StreamBackend::EWorkResult:
-					m_schedItem.workResult->load(m_stream);
-					m_schedItem.stop = false;
-					m_parent->releaseWork(m_schedItem);
-					m_parent->signalCompletion();
-					break;
-				case StreamBackend::ECancelledWorkResult:
-					m_schedItem.stop = true;
-					m_parent->releaseWork(m_schedItem);
-					m_parent->signalCompletion();
-					break;
-				case StreamBackend::EProcessCancelled: {
-						Log(EWarn, "Process %i encountered a problem on node \"%s\"."
-							" - Cancelling the process..", id, m_parent->getNodeName().c_str());
-						/* We can't block here waiting for the process to terminate, since
-						we need to listen for canceled in-flight work units. Handle
-						the cancellation notification in a separate thread */
-						CancelThread *thr = new CancelThread(m_schedItem.proc);
-						thr->incRef();
-						thr->start();
-						m_joinThreads.push_back(thr);
-					}
-					break;
-				default:
-					Log(EError, "Received an unknown message (type %i)", id);
-			};
 		} catch (std::runtime_error &e) {
+			/* The node has died or become unreachable. Other workers
+			   take over whatever it was working on */
 			if (!m_shutdown)
-				throw e;
+				m_parent->handleFailure(e.what());
 			break;
 		}
 	}
@@ -316,6 +745,68 @@ void RemoteWorkerReader::run() {
 	}
 }
 
+void RemoteWorkerReader::handleMessage(Stream *stream, short msg) {
+	int id = stream->readInt();
+
+	if (msg == StreamBackend::EResendResource) {
+		/* Some chunks of a resource were evicted from the node's blob cache */
+		std::vector<RemoteWorker::BlobKey> missing(stream->readUInt());
+		for (size_t i=0; i<missing.size(); ++i) {
+			missing[i].first = stream->readULong();
+			missing[i].second = stream->readUInt();
+		}
+		m_parent->resendResource(id, missing);
+		return;
+	}
+
+	if (msg == StreamBackend::EWorkResult || msg == StreamBackend::ECancelledWorkResult) {
+		uint32_t seq = stream->readUInt();
+		uint32_t size = (msg == StreamBackend::EWorkResult) ? stream->readUInt() : 0;
+
+		if (!m_parent->claimWorkUnit(seq)) {
+			/* This work unit timed out and was reissued to another worker */
+			Log(EDebug, "Ignoring a late result from \"%s\" (process %i)",
+				m_parent->getNodeName().c_str(), id);
+			m_skipBuffer.resize(std::max(size, (uint32_t) 1));
+			stream->read(&m_skipBuffer[0], size);
+			return;
+		}
+	}
+
+	if (id != m_currentID) {
+		m_parent->setProcessByID(m_schedItem, id);
+		m_currentID = id;
+	}
+
+	switch (msg) {
+		case StreamBackend::EWorkResult:
+			m_schedItem.workResult->load(stream);
+			m_schedItem.stop = false;
+			m_parent->releaseWork(m_schedItem);
+			m_parent->signalCompletion();
+			break;
+		case StreamBackend::ECancelledWorkResult:
+			m_schedItem.stop = true;
+			m_parent->releaseWork(m_schedItem);
+			m_parent->signalCompletion();
+			break;
+		case StreamBackend::EProcessCancelled: {
+				Log(EWarn, "Process %i encountered a problem on node \"%s\"."
+					" - Cancelling the process..", id, m_parent->getNodeName().c_str());
+				/* We can't block here waiting for the process to terminate, since
+				we need to listen for canceled in-flight work units. Handle
+				the cancellation notification in a separate thread */
+				CancelThread *thr = new CancelThread(m_schedItem.proc);
+				thr->incRef();
+				thr->start();
+				m_joinThreads.push_back(thr);
+			}
+			break;
+		default:
+			Log(EError, "Received an unknown message (type %i)", msg);
+	};
+}
+
 /* ==================================================================== */
 /*                         Stream server backend                        */
 /* ==================================================================== */
@@ -326,10 +817,152 @@ StreamBackend::StreamBackend(const std::string &thrName, Scheduler *scheduler,
 	m_sendMutex = new Mutex();
 	m_memStream = new MemoryStream();
 	m_memStream->setByteOrder(Stream::ENetworkByteOrder);
+	m_compressedStream = new MemoryStream();
+	m_resultStream = new MemoryStream();
+	m_pendingResults = 0;
 }
 
 StreamBackend::~StreamBackend() { }
 
+void StreamBackend::setBlobCacheDirectory(const fs::path &path, uint64_t maxSize) {
+	boost::lock_guard<boost::mutex> lock(__blobCacheMutex);
+	__blobCacheSize = 0;
+	if (!path.empty()) {
+		if (!fs::exists(path))
+			fs::create_directories(path);
+		else if (maxSize > 0)
+			__blobCacheSize = pruneBlobCache(path, maxSize);
+	}
+	__blobCacheDir = path;
+	__blobCacheLimit = maxSize;
+}
+
+ref<MemoryStream> StreamBackend::receiveResource(std::vector<RemoteWorker::BlobKey> &missing) {
+	size_t size = m_stream->readSize();
+	uint32_t chunkCount = m_stream->readUInt();
+
+	ref<MemoryStream> result = new MemoryStream(size);
+	result->setByteOrder(m_stream->getByteOrder());
+	std::vector<uint8_t> buffer;
+
+	for (uint32_t i=0; i<chunkCount; ++i) {
+		uint64_t hash = m_stream->readULong();
+		uint32_t chunkSize = m_stream->readUInt();
+		RemoteWorker::BlobKey key(hash, chunkSize);
+		bool cached = m_stream->readBool();
+
+		ref<MemoryStream> compressed;
+		if (cached) {
+			fs::path path;
+			{
+				boost::lock_guard<boost::mutex> lock(__blobCacheMutex);
+				if (!__blobCacheDir.empty())
+					path = getBlobPath(key);
+			}
+
+			/* The blob may have been evicted since the client was told
+			   about it (possibly by another process sharing the cache) */
+			ref<FileStream> fstream;
+			if (!path.empty() && fs::exists(path)) {
+				try {
+					fstream = new FileStream(path, FileStream::EReadOnly);
+				} catch (const std::exception &) { }
+			}
+			if (!fstream) {
+				missing.push_back(key);
+				continue;
+			}
+
+			/* Mark the blob as recently used for pruneBlobCache() */
+			boost::system::error_code ec;
+			fs::last_write_time(path, std::time(NULL), ec);
+			compressed = new MemoryStream(fstream->getSize());
+			fstream->copyTo(compressed);
+		} else {
+			uint32_t compressedSize = m_stream->readUInt();
+			compressed = new MemoryStream(compressedSize);
+			m_stream->copyTo(compressed, compressedSize);
+
+			boost::lock_guard<boost::mutex> lock(__blobCacheMutex);
+			if (!__blobCacheDir.empty()) {
+				/* Write to a temporary file first, since other processes
+				   may be using the same cache directory */
+				fs::path path = getBlobPath(key),
+				         tmpPath = path.string() + fs::unique_path(".%%%%-%%%%-%%%%-%%%%.tmp").string();
+				ref<FileStream> fstream = new FileStream(tmpPath, FileStream::ETruncWrite);
+				fstream->write(compressed->getData(), compressed->getPos());
+				fstream->close();
+				fs::rename(tmpPath, path);
+
+				/* Keep the cache within its limit. Prune a bit more than
+				   necessary, so that this does not happen on every write */
+				__blobCacheSize += compressed->getPos();
+				if (__blobCacheLimit > 0 && __blobCacheSize > __blobCacheLimit)
+					__blobCacheSize = pruneBlobCache(__blobCacheDir,
+						__blobCacheLimit - __blobCacheLimit / 4);
+			}
+		}
+
+		if (!missing.empty())
+			continue; /* The rest of the message still has to be read */
+
+		compressed->seek(0);
+		buffer.resize(chunkSize);
+		ref<ZStream> zstream = new ZStream(compressed);
+		zstream->read(&buffer[0], chunkSize);
+
+		if (hashBuffer(&buffer[0], chunkSize) != hash)
+			Log(EError, "Resource chunk %i/%i is corrupt!", i+1, chunkCount);
+		result->write(&buffer[0], chunkSize);
+	}
+
+	if (!missing.empty())
+		return NULL;
+	if (result->getPos() != size)
+		Log(EError, "Received a resource with an invalid size!");
+	result->seek(0);
+	return result;
+}
+
+void StreamBackend::requestResource(int id, const std::vector<RemoteWorker::BlobKey> &missing) {
+	Log(EInfo, SIZE_T_FMT " chunks of resource %i are missing from the blob cache "
+		"-- requesting them again", missing.size(), id);
+	m_requestedResources.insert(id);
+
+	LockGuard lock(m_sendMutex);
+	m_memStream->writeShort(EResendResource);
+	m_memStream->writeInt(id);
+	m_memStream->writeUInt((uint32_t) missing.size());
+	for (size_t i=0; i<missing.size(); ++i) {
+		m_memStream->writeULong(missing[i].first);
+		m_memStream->writeUInt(missing[i].second);
+	}
+	flushResults();
+}
+
+void StreamBackend::resourceReceived(int id) {
+	if (m_requestedResources.erase(id) == 0)
+		return;
+
+	typedef std::multimap<int, std::pair<int, std::string> >::iterator BindingIterator;
+	std::pair<BindingIterator, BindingIterator> range = m_deferredBindings.equal_range(id);
+	for (BindingIterator it = range.first; it != range.second; ++it) {
+		std::map<int, std::pair<ref<RemoteProcess>, int> >::iterator blocked =
+			m_blockedProcesses.find(it->second.first);
+		if (blocked == m_blockedProcesses.end())
+			continue; /* Cancelled in the meantime */
+
+		ref<RemoteProcess> rp = blocked->second.first;
+		rp->bindResource(it->second.second, m_resources[id]);
+		if (--blocked->second.second == 0) {
+			/* All resources are available -- release the queued work units */
+			m_blockedProcesses.erase(blocked);
+			m_scheduler->schedule(rp);
+		}
+	}
+	m_deferredBindings.erase(range.first, range.second);
+}
+
 void StreamBackend::run() {
 	if (m_detach)
 		detach();
@@ -357,6 +990,11 @@ void StreamBackend::run() {
 #endif
 	m_stream->read(data, dataLength);
 
+	/* After the handshake, all data is exchanged in the client's byte order */
+	Stream::EByteOrder byteOrder = (data[dataLength-1] & MTS_HELLO_LITTLE_ENDIAN)
+		? Stream::ELittleEndian : Stream::EBigEndian;
+	data[dataLength-1] &= ~MTS_HELLO_LITTLE_ENDIAN;
+
 	if (memcmp(data, refData, dataLength) != 0) {
 		m_stream->writeShort(EIncompatible);
 		m_stream->flush();
@@ -365,13 +1003,41 @@ void StreamBackend::run() {
 		return;
 	}
 
-	Log(EDebug, "Program versions match.");
+	Log(EDebug, "Program versions match (%s byte order).",
+		byteOrder == Stream::getHostByteOrder() ? "native" : "swapped");
 	m_memStream->writeShort(EHello);
+	m_stream->setByteOrder(byteOrder);
+	m_memStream->setByteOrder(byteOrder);
+	m_compressedStream->setByteOrder(byteOrder);
+	m_resultStream->setByteOrder(byteOrder);
 	m_memStream->writeShort((short) m_scheduler->getCoreCount());
 	m_memStream->writeString(m_nodeName);
+
+	/* Inform the client about the contents of the blob cache */
+	std::vector<RemoteWorker::BlobKey> blobs;
+	{
+		boost::lock_guard<boost::mutex> lock(__blobCacheMutex);
+		m_memStream->writeBool(!__blobCacheDir.empty());
+		if (!__blobCacheDir.empty()) {
+			for (fs::directory_iterator it(__blobCacheDir), end; it != end; ++it) {
+				unsigned long long hash;
+				unsigned int size;
+				std::string name = it->path().filename().string();
+				if (isBlobPath(it->path()) &&
+					sscanf(name.c_str(), "%16llx-%8x", &hash, &size) == 2)
+					blobs.push_back(RemoteWorker::BlobKey(hash, size));
+			}
+		}
+	}
+	m_memStream->writeUInt((uint32_t) blobs.size());
+	for (size_t i=0; i<blobs.size(); ++i) {
+		m_memStream->writeULong(blobs[i].first);
+		m_memStream->writeUInt(blobs[i].second);
+	}
 	m_memStream->seek(0);
 	m_memStream->copyTo(m_stream);
 	m_stream->flush();
+	m_memStream->reset();
 	bool running = true;
 
 	try {
@@ -390,29 +1056,33 @@ void StreamBackend::run() {
 					break;
 				case ENewResource: {
 						int id = m_stream->readInt();
-						size_t size = m_stream->readSize();
+						std::vector<RemoteWorker::BlobKey> missing;
+						ref<MemoryStream> mstream = receiveResource(missing);
+						if (!mstream) {
+							requestResource(id, missing);
+							break;
+						}
 						ref<InstanceManager> manager = new InstanceManager();
-						ref<MemoryStream> mstream = new MemoryStream(size);
-						mstream->setByteOrder(Stream::ENetworkByteOrder);
-						m_stream->copyTo(mstream, size);
-						mstream->seek(0);
 						ref<SerializableObject> res = static_cast<SerializableObject *>(manager->getInstance(mstream));
 						m_resources[id] = m_scheduler->registerResource(res);
+						resourceReceived(id);
 					}
 					break;
 				case ENewMultiResource: {
 						int id = m_stream->readInt();
-						size_t size = m_stream->readSize();
+						std::vector<RemoteWorker::BlobKey> missing;
+						ref<MemoryStream> mstream = receiveResource(missing);
+						if (!mstream) {
+							requestResource(id, missing);
+							break;
+						}
 						ref<InstanceManager> manager = new InstanceManager();
-						ref<MemoryStream> mstream = new MemoryStream(size);
-						mstream->setByteOrder(Stream::ENetworkByteOrder);
-						m_stream->copyTo(mstream, size);
-						mstream->seek(0);
 						size_t coreCount = m_scheduler->getCoreCount();
 						std::vector<SerializableObject *> objects(coreCount);
 						for (size_t i=0; i<coreCount; ++i)
 							objects[i] = static_cast<SerializableObject *>(manager->getInstance(mstream));
 						m_resources[id] = m_scheduler->registerMultiResource(objects);
+						resourceReceived(id);
 					}
 					break;
 				case EEnsurePluginLoaded: {
@@ -425,24 +1095,36 @@ void StreamBackend::run() {
 						std::string resName = m_stream->readString();
 						int resID = m_stream->readInt();
 						RemoteProcess *rp = m_processes[procID];
-						rp->bindResource(resName, m_resources[resID]);
+						if (m_requestedResources.find(resID) != m_requestedResources.end()) {
+							/* Wait until the resource has been sent again */
+							m_deferredBindings.insert(std::make_pair(resID,
+								std::make_pair(procID, resName)));
+							std::pair<ref<RemoteProcess>, int> &blocked = m_blockedProcesses[procID];
+							blocked.first = rp;
+							blocked.second++;
+						} else {
+							rp->bindResource(resName, m_resources[resID]);
+						}
 					}
 					break;
 				case EWorkUnit : {
 						int id = m_stream->readInt();
+						uint32_t seq = m_stream->readUInt();
 						RemoteProcess *rp = m_processes[id];
 						WorkUnit *wu = rp->getEmptyWorkUnit();
 						wu->load(m_stream);
-						rp->putFullWorkUnit(wu);
-						m_scheduler->schedule(rp);
+						rp->putFullWorkUnit(wu, seq);
+						if (m_blockedProcesses.find(id) == m_blockedProcesses.end())
+							m_scheduler->schedule(rp);
 					}
 					break;
 				case EProcessTerminated : {
 						int id = m_stream->readInt();
 						RemoteProcess *rp = m_processes[id];
 						rp->setDone();
+						if (m_blockedProcesses.find(id) == m_blockedProcesses.end())
+							m_scheduler->schedule(rp);
 						rp->decRef();
-						m_scheduler->schedule(rp);
 						m_processes.erase(id);
 					}
 					break;
@@ -450,12 +1132,17 @@ void StreamBackend::run() {
 						int id = m_stream->readInt();
 						RemoteProcess *rp = m_processes[id];
 						m_scheduler->cancel(rp);
+						m_blockedProcesses.erase(id);
 						m_processes.erase(id);
 						rp->decRef();
 					}
 					break;
 				case EResourceExpired: {
 						int id = m_stream->readInt();
+						if (m_requestedResources.erase(id) > 0) {
+							m_deferredBindings.erase(id);
+							break;
+						}
 						int localID = m_resources[id];
 						m_scheduler->unregisterResource(localID);
 						m_resources.erase(id);
@@ -471,6 +1158,7 @@ void StreamBackend::run() {
 		Log(EWarn, "Uncaught exception (unknown type) - cleaning up!");
 	}
 
+	m_blockedProcesses.clear();
 	for (std::map<int, RemoteProcess *>::const_iterator it = m_processes.begin();
 		it != m_processes.end(); ++it) {
 
@@ -494,50 +1182,196 @@ void StreamBackend::run() {
 	}
 }
 
-void StreamBackend::sendCancellation(int id, int numLost) {
+void StreamBackend::sendCancellation(int id, const std::vector<uint32_t> &lost) {
 	Log(EInfo, "Notifying the remote side about the cancellation of process %i", id);
 
 	LockGuard lock(m_sendMutex);
-	m_memStream->reset();
 	m_memStream->writeShort(EProcessCancelled);
 	m_memStream->writeInt(id);
-	for (int i=0; i<numLost; ++i) {
+	for (size_t i=0; i<lost.size(); ++i) {
 		m_memStream->writeShort(ECancelledWorkResult);
 		m_memStream->writeInt(id);
+		m_memStream->writeUInt(lost[i]);
 	}
-	try {
-		m_memStream->seek(0);
-		m_memStream->copyTo(m_stream);
-		m_stream->flush();
-	} catch (std::exception &) {
-		Log(EWarn, "Connection error - could not submit cancellation notification");
-		/* A connection failure occurred - this will eventually be
-		   caught and handled in run() and is therefore ignored for now */
-	}
+	flushResults();
 }
 
-void StreamBackend::sendWorkResult(int id, const WorkResult *result, bool cancelled) {
+void StreamBackend::sendWorkResult(int id, uint32_t seq, const WorkResult *result,
+		bool cancelled, bool flush) {
 	LockGuard lock(m_sendMutex);
-	m_memStream->reset();
 	m_memStream->writeShort(cancelled ? ECancelledWorkResult : EWorkResult);
 	m_memStream->writeInt(id);
-	if (!cancelled)
-		result->save(m_memStream);
+	m_memStream->writeUInt(seq);
+	if (!cancelled) {
+		/* Prefix the result with its size, so that the client can
+		   skip it if the work unit has been reissued in the meantime */
+		m_resultStream->reset();
+		result->save(m_resultStream);
+		m_memStream->writeUInt((uint32_t) m_resultStream->getPos());
+		m_memStream->write(m_resultStream->getData(), m_resultStream->getPos());
+	}
+
+	/* Batch results while the local queue is well-stocked */
+	size_t batchSize = std::max((size_t) 1, m_scheduler->getCoreCount() / 2);
+	if (flush || ++m_pendingResults >= batchSize)
+		flushResults();
+}
+
+void StreamBackend::flushResults() {
+	size_t size = m_memStream->getPos();
+	if (size == 0)
+		return;
+
 	try {
-		m_memStream->seek(0);
-		m_memStream->copyTo(m_stream);
+		if (size >= MTS_RESULT_COMPRESSION_THRESHOLD) {
+			m_compressedStream->reset();
+			ref<ZStream> zstream = new ZStream(m_compressedStream,
+				ZStream::EDeflateStream, MTS_BLOB_COMPRESSION);
+			zstream->write(m_memStream->getData(), size);
+			zstream = NULL; /* Finishes the deflate stream */
+
+			size_t compressedSize = m_compressedStream->getPos();
+			m_stream->writeShort(ECompressedBatch);
+			m_stream->writeUInt((uint32_t) size);
+			m_stream->writeUInt((uint32_t) compressedSize);
+			m_stream->write(m_compressedStream->getData(), compressedSize);
+		} else {
+			m_stream->write(m_memStream->getData(), size);
+		}
 		m_stream->flush();
 	} catch (std::exception &) {
-		Log(EWarn, "Connection error - could not submit work result");
+		Log(EWarn, "Connection error - could not submit work results");
 		/* A connection failure occurred - this will eventually be
 		   caught and handled in run() and is therefore ignored for now */
 	}
+
+	m_memStream->reset();
+	m_pendingResults = 0;
 }
 
 /* ==================================================================== */
 /*                            Remote process                            */
 /* ==================================================================== */
 
+/* The work processor of a remote process is wrapped so that the sequence
+   number assigned by the client travels along with each work unit and
+   its result -- this also works when the node forwards the work units
+   to further nodes */
+class TaggedWorkUnit : public WorkUnit {
+public:
+	inline TaggedWorkUnit(WorkUnit *workUnit)
+		: m_workUnit(workUnit), m_seq(0) { }
+
+	inline WorkUnit *getWorkUnit() { return m_workUnit; }
+	inline const WorkUnit *getWorkUnit() const { return m_workUnit.get(); }
+	inline uint32_t getSequenceNumber() const { return m_seq; }
+	inline void setSequenceNumber(uint32_t seq) { m_seq = seq; }
+
+	void set(const WorkUnit *workUnit) {
+		const TaggedWorkUnit *tagged = static_cast<const TaggedWorkUnit *>(workUnit);
+		m_workUnit->set(tagged->m_workUnit.get());
+		m_seq = tagged->m_seq;
+	}
+
+	void load(Stream *stream) {
+		m_seq = stream->readUInt();
+		m_workUnit->load(stream);
+	}
+
+	void save(Stream *stream) const {
+		stream->writeUInt(m_seq);
+		m_workUnit->save(stream);
+	}
+
+	std::string toString() const {
+		std::ostringstream oss;
+		oss << "TaggedWorkUnit[seq=" << m_seq << ", "
+			<< indent(m_workUnit->toString()) << "]";
+		return oss.str();
+	}
+
+	MTS_DECLARE_CLASS()
+private:
+	ref<WorkUnit> m_workUnit;
+	uint32_t m_seq;
+};
+
+class TaggedWorkResult : public WorkResult {
+public:
+	inline TaggedWorkResult(WorkResult *workResult)
+		: m_workResult(workResult), m_seq(0) { }
+
+	inline WorkResult *getWorkResult() { return m_workResult; }
+	inline const WorkResult *getWorkResult() const { return m_workResult.get(); }
+	inline uint32_t getSequenceNumber() const { return m_seq; }
+	inline void setSequenceNumber(uint32_t seq) { m_seq = seq; }
+
+	void load(Stream *stream) {
+		m_seq = stream->readUInt();
+		m_workResult->load(stream);
+	}
+
+	void save(Stream *stream) const {
+		stream->writeUInt(m_seq);
+		m_workResult->save(stream);
+	}
+
+	std::string toString() const {
+		std::ostringstream oss;
+		oss << "TaggedWorkResult[seq=" << m_seq << ", "
+			<< indent(m_workResult->toString()) << "]";
+		return oss.str();
+	}
+
+	MTS_DECLARE_CLASS()
+private:
+	ref<WorkResult> m_workResult;
+	uint32_t m_seq;
+};
+
+class TaggedWorkProcessor : public WorkProcessor {
+public:
+	inline TaggedWorkProcessor(WorkProcessor *wp) : m_wp(wp) { }
+
+	TaggedWorkProcessor(Stream *stream, InstanceManager *manager)
+		: WorkProcessor(stream, manager) {
+		m_wp = static_cast<WorkProcessor *>(manager->getInstance(stream));
+	}
+
+	void serialize(Stream *stream, InstanceManager *manager) const {
+		manager->serialize(stream, m_wp.get());
+	}
+
+	ref<WorkUnit> createWorkUnit() const {
+		return new TaggedWorkUnit(m_wp->createWorkUnit());
+	}
+
+	ref<WorkResult> createWorkResult() const {
+		return new TaggedWorkResult(m_wp->createWorkResult());
+	}
+
+	ref<WorkProcessor> clone() const {
+		return new TaggedWorkProcessor(m_wp->clone());
+	}
+
+	void prepare() {
+		m_wp->m_resources = m_resources;
+		m_wp->prepare();
+	}
+
+	void process(const WorkUnit *workUnit, WorkResult *workResult, const bool &stop) {
+		const TaggedWorkUnit *tu = static_cast<const TaggedWorkUnit *>(workUnit);
+		TaggedWorkResult *tr = static_cast<TaggedWorkResult *>(workResult);
+		tr->setSequenceNumber(tu->getSequenceNumber());
+		m_wp->process(tu->getWorkUnit(), tr->getWorkResult(), stop);
+	}
+
+	MTS_DECLARE_CLASS()
+private:
+	ref<WorkProcessor> m_wp;
+};
+
+
 RemoteProcess::RemoteProcess(int id, ELogLevel logLevel,
 		StreamBackend *backend, WorkProcessor *wp)
 		: m_id(id), m_backend(backend), m_wp(wp) {
@@ -561,9 +1395,12 @@ ParallelProcess::EStatus RemoteProcess::generateWork(WorkUnit *unit, int worker)
 
 	LockGuard lock(m_mutex);
 	if (m_full.size() > 0) {
-		unit->set(m_full.front());
+		TaggedWorkUnit *tagged = static_cast<TaggedWorkUnit *>(unit);
+		tagged->getWorkUnit()->set(m_full.front());
+		tagged->setSequenceNumber(m_fullSeq.front());
 		m_empty.push_back(m_full.front());
 		m_full.pop_front();
+		m_fullSeq.pop_front();
 		status = ESuccess;
 	} else {
 		status = m_done ? EFailure : EPause;
@@ -572,11 +1409,20 @@ ParallelProcess::EStatus RemoteProcess::generateWork(WorkUnit *unit, int worker)
 }
 
 void RemoteProcess::processResult(const WorkResult *result, bool cancelled) {
-	m_backend->sendWorkResult(m_id, result, cancelled);
+	/* Send results immediately once the local queue is running low,
+	   since the client will otherwise hold back new work units */
+	bool flush;
+	{
+		LockGuard lock(m_mutex);
+		flush = m_full.size() < m_backend->m_scheduler->getCoreCount();
+	}
+	const TaggedWorkResult *tagged = static_cast<const TaggedWorkResult *>(result);
+	m_backend->sendWorkResult(m_id, tagged->getSequenceNumber(),
+		tagged->getWorkResult(), cancelled, flush);
 }
 
 ref<WorkProcessor> RemoteProcess::createWorkProcessor() const {
-	return m_wp->clone();
+	return new TaggedWorkProcessor(m_wp->clone());
 }
 
 /* Executed while the main scheduler lock is held. */
@@ -584,13 +1430,17 @@ void RemoteProcess::handleCancellation() {
 	/* Also acquire the local queue mutex, purge all queued
 	   work units and inform the remote side how many were lost */
 	LockGuard lock(m_mutex);
-	m_backend->sendCancellation(m_id, (int) m_full.size());
+	m_backend->sendCancellation(m_id, std::vector<uint32_t>(m_fullSeq.begin(), m_fullSeq.end()));
 	m_empty.insert(m_empty.end(), m_full.begin(), m_full.end());
 	m_full.clear();
+	m_fullSeq.clear();
 }
 
 MTS_IMPLEMENT_CLASS(RemoteWorker, false, Worker)
 MTS_IMPLEMENT_CLASS(RemoteWorkerReader, false, Thread)
 MTS_IMPLEMENT_CLASS(StreamBackend, false, Thread)
 MTS_IMPLEMENT_CLASS(RemoteProcess, false, ParallelProcess)
+MTS_IMPLEMENT_CLASS(TaggedWorkUnit, false, WorkUnit)
+MTS_IMPLEMENT_CLASS(TaggedWorkResult, false, WorkResult)
+MTS_IMPLEMENT_CLASS_S(TaggedWorkProcessor, false, WorkProcessor)
 MTS_NAMESPACE_END
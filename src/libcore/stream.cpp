@@ -18,9 +18,61 @@
 
 #include <mitsuba/mitsuba.h>
 #include <mitsuba/core/stream.h>
+#include <mitsuba/core/sse.h>
 
 MTS_NAMESPACE_BEGIN
 
+/* Size of the stack buffer used to byte-swap arrays before writing them */
+#define MTS_STREAM_SWAP_BUFFER 16384
+
+#if defined(MTS_SSE)
+/* Reverse the bytes of the 16, 32 or 64 bit values in an SSE register
+   (SSE2 lacks a byte shuffle -- reorder 16-bit words, then swap their bytes) */
+static FINLINE __m128i swapBytes(__m128i value, uint16_t) {
+	return _mm_or_si128(_mm_slli_epi16(value, 8), _mm_srli_epi16(value, 8));
+}
+
+static FINLINE __m128i swapBytes(__m128i value, uint32_t) {
+	value = _mm_shufflehi_epi16(_mm_shufflelo_epi16(value,
+		_MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+	return swapBytes(value, uint16_t());
+}
+
+static FINLINE __m128i swapBytes(__m128i value, uint64_t) {
+	value = _mm_shufflehi_epi16(_mm_shufflelo_epi16(value,
+		_MM_SHUFFLE(0, 1, 2, 3)), _MM_SHUFFLE(0, 1, 2, 3));
+	return swapBytes(value, uint16_t());
+}
+#endif
+
+/// Reverse the byte order of an array of values in place
+template <typename T> static void swapArray(T *data, size_t size) {
+	size_t i = 0;
+#if defined(MTS_SSE)
+	const size_t width = sizeof(__m128i) / sizeof(T);
+	for (; i + width <= size; i += width) {
+		__m128i *ptr = (__m128i *) (data + i);
+		_mm_storeu_si128(ptr, swapBytes(_mm_loadu_si128(ptr), T()));
+	}
+#endif
+	for (; i<size; ++i)
+		data[i] = endianness_swap(data[i]);
+}
+
+/// Write an array in swapped byte order, one buffer-sized chunk at a time
+template <typename T> static void writeSwapped(Stream *stream, const T *data, size_t size) {
+	const size_t chunkSize = MTS_STREAM_SWAP_BUFFER / sizeof(T);
+	T buffer[chunkSize];
+	while (size > 0) {
+		size_t count = std::min(size, chunkSize);
+		memcpy(buffer, data, count * sizeof(T));
+		swapArray(buffer, count);
+		stream->write(buffer, count * sizeof(T));
+		data += count;
+		size -= count;
+	}
+}
+
 static Stream::EByteOrder getByteOrder() {
 	union {
 		uint8_t  charValue[2];
@@ -54,15 +106,10 @@ void Stream::writeInt(int value) {
 }
 
 void Stream::writeIntArray(const int *data, size_t size) {
-	if (m_byteOrder != m_hostByteOrder) {
-		int *temp = new int[size];
-		for (size_t i=0; i<size; ++i)
-			temp[i] = endianness_swap(data[i]);
-		write(temp, sizeof(int)*size);
-		delete[] temp;
-	} else {
+	if (m_byteOrder != m_hostByteOrder)
+		writeSwapped(this, (const uint32_t *) data, size);
+	else
 		write(data, sizeof(int)*size);
-	}
 }
 
 void Stream::writeUInt(unsigned int value) {
@@ -72,15 +119,10 @@ void Stream::writeUInt(unsigned int value) {
 }
 
 void Stream::writeUIntArray(const unsigned int *data, size_t size) {
-	if (m_byteOrder != m_hostByteOrder) {
-		unsigned int *temp = new unsigned int[size];
-		for (size_t i=0; i<size; ++i)
-			temp[i] = endianness_swap(data[i]);
-		write(temp, sizeof(unsigned int)*size);
-		delete[] temp;
-	} else {
+	if (m_byteOrder != m_hostByteOrder)
+		writeSwapped(this, (const uint32_t *) data, size);
+	else
 		write(data, sizeof(unsigned int)*size);
-	}
 }
 
 void Stream::writeLong(int64_t value) {
@@ -90,15 +132,10 @@ void Stream::writeLong(int64_t value) {
 }
 
 void Stream::writeLongArray(const int64_t *data, size_t size) {
-	if (m_byteOrder != m_hostByteOrder) {
-		int64_t *temp = new int64_t[size];
-		for (size_t i=0; i<size; ++i)
-			temp[i] = endianness_swap(data[i]);
-		write(temp, sizeof(int64_t)*size);
-		delete[] temp;
-	} else {
+	if (m_byteOrder != m_hostByteOrder)
+		writeSwapped(this, (const uint64_t *) data, size);
+	else
 		write(data, sizeof(int64_t)*size);
-	}
 }
 
 void Stream::writeULong(uint64_t value) {
@@ -108,15 +145,10 @@ void Stream::writeULong(uint64_t value) {
 }
 
 void Stream::writeULongArray(const uint64_t *data, size_t size) {
-	if (m_byteOrder != m_hostByteOrder) {
-		uint64_t *temp = new uint64_t[size];
-		for (size_t i=0; i<size; ++i)
-			temp[i] = endianness_swap(data[i]);
-		write(temp, sizeof(uint64_t)*size);
-		delete[] temp;
-	} else {
+	if (m_byteOrder != m_hostByteOrder)
+		writeSwapped(this, (const uint64_t *) data, size);
+	else
 		write(data, sizeof(uint64_t)*size);
-	}
 }
 
 void Stream::writeShort(short value) {
@@ -126,15 +158,10 @@ void Stream::writeShort(short value) {
 }
 
 void Stream::writeShortArray(const short *data, size_t size) {
-	if (m_byteOrder != m_hostByteOrder) {
-		short *temp = new short[size];
-		for (size_t i=0; i<size; ++i)
-			temp[i] = endianness_swap(data[i]);
-		write(temp, sizeof(short)*size);
-		delete[] temp;
-	} else {
+	if (m_byteOrder != m_hostByteOrder)
+		writeSwapped(this, (const uint16_t *) data, size);
+	else
 		write(data, sizeof(short)*size);
-	}
 }
 
 void Stream::writeUShort(unsigned short value) {
@@ -144,15 +171,10 @@ void Stream::writeUShort(unsigned short value) {
 }
 
 void Stream::writeUShortArray(const unsigned short *data, size_t size) {
-	if (m_byteOrder != m_hostByteOrder) {
-		unsigned short *temp = new unsigned short[size];
-		for (size_t i=0; i<size; ++i)
-			temp[i] = endianness_swap(data[i]);
-		write(temp, sizeof(unsigned short)*size);
-		delete[] temp;
-	} else {
+	if (m_byteOrder != m_hostByteOrder)
+		writeSwapped(this, (const uint16_t *) data, size);
+	else
 		write(data, sizeof(unsigned short)*size);
-	}
 }
 
 void Stream::writeChar(char value) {
@@ -172,15 +194,10 @@ void Stream::writeHalf(half halfValue) {
 
 void Stream::writeHalfArray(const half *data, size_t size) {
 	BOOST_STATIC_ASSERT(sizeof(half) == 2);
-	if (m_byteOrder != m_hostByteOrder) {
-		short *temp = new short[size];
-		for (size_t i=0; i<size; ++i)
-			temp[i] = endianness_swap(data[i].bits());
-		write(temp, sizeof(short)*size);
-		delete[] temp;
-	} else {
+	if (m_byteOrder != m_hostByteOrder)
+		writeSwapped(this, (const uint16_t *) data, size);
+	else
 		write(data, sizeof(half)*size);
-	}
 }
 
 void Stream::writeSingle(float value) {
@@ -190,27 +207,17 @@ void Stream::writeSingle(float value) {
 }
 
 void Stream::writeSingleArray(const float *data, size_t size) {
-	if (m_byteOrder != m_hostByteOrder) {
-		float *temp = new float[size];
-		for (size_t i=0; i<size; ++i)
-			temp[i] = endianness_swap(data[i]);
-		write(temp, sizeof(float)*size);
-		delete[] temp;
-	} else {
+	if (m_byteOrder != m_hostByteOrder)
+		writeSwapped(this, (const uint32_t *) data, size);
+	else
 		write(data, sizeof(float)*size);
-	}
 }
 
 void Stream::writeDoubleArray(const double *data, size_t size) {
-	if (m_byteOrder != m_hostByteOrder) {
-		double *temp = new double[size];
-		for (size_t i=0; i<size; ++i)
-			temp[i] = endianness_swap(data[i]);
-		write(temp, sizeof(double)*size);
-		delete[] temp;
-	} else {
+	if (m_byteOrder != m_hostByteOrder)
+		writeSwapped(this, (const uint64_t *) data, size);
+	else
 		write(data, sizeof(double)*size);
-	}
 }
 
 void Stream::writeDouble(double pDouble) {
@@ -242,10 +249,8 @@ int64_t Stream::readLong() {
 
 void Stream::readLongArray(int64_t *dest, size_t size) {
 	read(dest, sizeof(int64_t)*size);
-	if (m_byteOrder != m_hostByteOrder) {
-		for (size_t i=0; i<size; ++i)
-			dest[i] = endianness_swap(dest[i]);
-	}
+	if (m_byteOrder != m_hostByteOrder)
+		swapArray((uint64_t *) dest, size);
 }
 
 uint64_t Stream::readULong() {
@@ -258,10 +263,8 @@ uint64_t Stream::readULong() {
 
 void Stream::readULongArray(uint64_t *dest, size_t size) {
 	read(dest, sizeof(uint64_t)*size);
-	if (m_byteOrder != m_hostByteOrder) {
-		for (size_t i=0; i<size; ++i)
-			dest[i] = endianness_swap(dest[i]);
-	}
+	if (m_byteOrder != m_hostByteOrder)
+		swapArray((uint64_t *) dest, size);
 }
 
 int Stream::readInt() {
@@ -274,10 +277,8 @@ int Stream::readInt() {
 
 void Stream::readIntArray(int *dest, size_t size) {
 	read(dest, sizeof(int)*size);
-	if (m_byteOrder != m_hostByteOrder) {
-		for (size_t i=0; i<size; ++i)
-			dest[i] = endianness_swap(dest[i]);
-	}
+	if (m_byteOrder != m_hostByteOrder)
+		swapArray((uint32_t *) dest, size);
 }
 
 unsigned int Stream::readUInt() {
@@ -290,10 +291,8 @@ unsigned int Stream::readUInt() {
 
 void Stream::readUIntArray(unsigned int *dest, size_t size) {
 	read(dest, sizeof(unsigned int)*size);
-	if (m_byteOrder != m_hostByteOrder) {
-		for (size_t i=0; i<size; ++i)
-			dest[i] = endianness_swap(dest[i]);
-	}
+	if (m_byteOrder != m_hostByteOrder)
+		swapArray((uint32_t *) dest, size);
 }
 
 short Stream::readShort() {
@@ -306,10 +305,8 @@ short Stream::readShort() {
 
 void Stream::readShortArray(short *dest, size_t size) {
 	read(dest, sizeof(short)*size);
-	if (m_byteOrder != m_hostByteOrder) {
-		for (size_t i=0; i<size; ++i)
-			dest[i] = endianness_swap(dest[i]);
-	}
+	if (m_byteOrder != m_hostByteOrder)
+		swapArray((uint16_t *) dest, size);
 }
 
 unsigned short Stream::readUShort() {
@@ -322,10 +319,8 @@ unsigned short Stream::readUShort() {
 
 void Stream::readUShortArray(unsigned short *dest, size_t size) {
 	read(dest, sizeof(unsigned short)*size);
-	if (m_byteOrder != m_hostByteOrder) {
-		for (size_t i=0; i<size; ++i)
-			dest[i] = endianness_swap(dest[i]);
-	}
+	if (m_byteOrder != m_hostByteOrder)
+		swapArray((uint16_t *) dest, size);
 }
 
 char Stream::readChar() {
@@ -349,11 +344,10 @@ half Stream::readHalf() {
 }
 
 void Stream::readHalfArray(half *data, size_t size) {
+	BOOST_STATIC_ASSERT(sizeof(half) == 2);
 	read(data, sizeof(half)*size);
-	if (m_byteOrder != m_hostByteOrder) {
-		for (size_t i=0; i<size; ++i)
-			data[i].setBits(endianness_swap(data[i].bits()));
-	}
+	if (m_byteOrder != m_hostByteOrder)
+		swapArray((uint16_t *) data, size);
 }
 
 float Stream::readSingle() {
@@ -366,10 +360,8 @@ float Stream::readSingle() {
 
 void Stream::readSingleArray(float *data, size_t size) {
 	read(data, sizeof(float)*size);
-	if (m_byteOrder != m_hostByteOrder) {
-		for (size_t i=0; i<size; ++i)
-			data[i] = endianness_swap(data[i]);
-	}
+	if (m_byteOrder != m_hostByteOrder)
+		swapArray((uint32_t *) data, size);
 }
 
 
@@ -383,10 +375,8 @@ double Stream::readDouble() {
 
 void Stream::readDoubleArray(double *data, size_t size) {
 	read(data, sizeof(double)*size);
-	if (m_byteOrder != m_hostByteOrder) {
-		for (size_t i=0; i<size; ++i)
-			data[i] = endianness_swap(data[i]);
-	}
+	if (m_byteOrder != m_hostByteOrder)
+		swapArray((uint64_t *) data, size);
 }
 
 std::string Stream::readLine() {
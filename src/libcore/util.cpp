@@ -400,6 +400,16 @@ std::string getFQDN() {
 	return fqdn;
 }
 
+uint64_t hashBuffer(const void *data, size_t size, uint64_t seed) {
+	const uint8_t *ptr = (const uint8_t *) data;
+	uint64_t hash = seed;
+	for (size_t i=0; i<size; ++i) {
+		hash ^= ptr[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
 std::string formatString(const char *fmt, ...) {
 	char tmp[512];
 	va_list iterator;
@@ -18,10 +18,37 @@
 
 #include <mitsuba/core/zstream.h>
 
+/* Largest block size accepted when reading a block stream */
+#define ZSTREAM_MAX_BLOCKSIZE (64*1024*1024)
+
 MTS_NAMESPACE_BEGIN
 
+/* Header of block streams. The first byte cannot start a zlib stream,
+   which allows telling the two formats apart. It is followed by the
+   format version, the codec (0 = zlib), and two reserved bytes. Each
+   block then starts with its uncompressed and compressed size (both
+   uint32, little endian). Blocks that do not compress are stored as-is,
+   and an uncompressed size of zero marks the end of the stream. */
+static const uint8_t __blockMagic[4] = { 'M', 'T', 'S', 'Z' };
+static const uint8_t __blockVersion = 1;
+
+static inline void encodeUInt(uint8_t *ptr, uint32_t value) {
+	for (int i=0; i<4; ++i)
+		ptr[i] = (uint8_t) (value >> (8*i));
+}
+
+static inline uint32_t decodeUInt(const uint8_t *ptr) {
+	uint32_t value = 0;
+	for (int i=0; i<4; ++i)
+		value |= (uint32_t) ptr[i] << (8*i);
+	return value;
+}
+
 ZStream::ZStream(Stream *childStream, EStreamType streamType, int level)
-		: m_childStream(childStream), m_didWrite(false) {
+		: m_childStream(childStream), m_didWrite(false), m_didRead(false),
+		  m_streamType(streamType), m_level(level), m_blockMode(false),
+		  m_endOfBlocks(false), m_blockIndex(0), m_blockOffset(0),
+		  m_blocksPos(0), m_pos(0), m_firstBlock(0) {
 	m_deflateStream.zalloc = Z_NULL;
 	m_deflateStream.zfree = Z_NULL;
 	m_deflateStream.opaque = Z_NULL;
@@ -54,12 +81,61 @@ bool ZStream::canRead() const {
 }
 
 void ZStream::seek(size_t pos) {
-	Log(EError, "seek(): unsupported in a ZLIB stream!");
+	if (!m_didRead && !m_didWrite)
+		detectFormat();
+	if (!m_blockMode || m_didWrite)
+		Log(EError, "seek(): only supported when reading a block-compressed stream!");
+
+	size_t decoded = 0;
+	for (size_t i=0; i<m_blocks.size(); ++i)
+		decoded += m_blocks[i].size();
+
+	if (pos < m_blocksPos || pos > m_blocksPos + decoded) {
+		/* Walk the block headers, starting from the beginning of the
+		   stream or from the end of the blocks decoded so far */
+		if (pos < m_blocksPos) {
+			m_childStream->seek(m_firstBlock);
+			m_blocksPos = 0;
+		} else {
+			m_blocksPos += decoded;
+		}
+		m_blocks.clear();
+		m_endOfBlocks = false;
+
+		uint8_t header[8];
+		while (true) {
+			m_childStream->read(header, sizeof(header));
+			uint32_t size = decodeUInt(header),
+			         compressedSize = decodeUInt(header + 4);
+			if (size == 0 || m_blocksPos + size > pos) {
+				m_childStream->seek(m_childStream->getPos() - sizeof(header));
+				break;
+			}
+			m_childStream->skip(compressedSize);
+			m_blocksPos += size;
+		}
+		readBlocks();
+
+		decoded = m_blocks.empty() ? 0 : m_blocks[0].size();
+		if (pos > m_blocksPos + decoded)
+			Log(EError, "seek(): attempting to seek past the end of the stream!");
+	}
+
+	/* Locate the position within the decoded blocks */
+	m_blockIndex = 0;
+	m_blockOffset = pos - m_blocksPos;
+	while (m_blockIndex < m_blocks.size() && m_blockOffset >= m_blocks[m_blockIndex].size()) {
+		m_blockOffset -= m_blocks[m_blockIndex].size();
+		++m_blockIndex;
+	}
+	m_pos = pos;
 }
 
 size_t ZStream::getPos() const {
-	Log(EError, "getPos(): unsupported in a ZLIB stream!");
-	return 0;
+	bool blockStream = m_didRead ? m_blockMode : (m_streamType == EBlockStream);
+	if (!blockStream)
+		Log(EError, "getPos(): unsupported in a ZLIB stream!");
+	return m_pos;
 }
 
 size_t ZStream::getSize() const {
@@ -72,10 +148,146 @@ void ZStream::truncate(size_t size) {
 }
 
 void ZStream::flush() {
-	Log(EError, "flush(): not implemented!");
+	if (m_streamType != EBlockStream)
+		Log(EError, "flush(): not implemented!");
+	if (m_didWrite)
+		writeBlocks();
+}
+
+void ZStream::writeBlocks() {
+	int count = (int) m_blocks.size();
+	std::vector<std::vector<uint8_t> > compressed(count);
+	std::vector<int> status(count, Z_OK);
+
+#if defined(MTS_OPENMP)
+	#pragma omp parallel for schedule(dynamic) if (count > 1)
+#endif
+	for (int i=0; i<count; ++i) {
+		const std::vector<uint8_t> &block = m_blocks[i];
+		uLongf size = compressBound((uLong) block.size());
+		compressed[i].resize(size);
+		status[i] = compress2(&compressed[i][0], &size, &block[0],
+			(uLong) block.size(), m_level);
+		compressed[i].resize(size);
+	}
+
+	for (int i=0; i<count; ++i) {
+		if (status[i] != Z_OK)
+			Log(EError, "compress2(): error code %i!", status[i]);
+		const std::vector<uint8_t> &block = m_blocks[i];
+		bool stored = compressed[i].size() >= block.size();
+		const std::vector<uint8_t> &data = stored ? block : compressed[i];
+		uint8_t header[8];
+		encodeUInt(header, (uint32_t) block.size());
+		encodeUInt(header + 4, (uint32_t) data.size());
+		m_childStream->write(header, sizeof(header));
+		m_childStream->write(&data[0], data.size());
+	}
+	m_blocks.clear();
+}
+
+bool ZStream::readBlocks() {
+	for (size_t i=0; i<m_blocks.size(); ++i)
+		m_blocksPos += m_blocks[i].size();
+	m_blocks.clear();
+	m_blockIndex = m_blockOffset = 0;
+
+	/* Fetch as many blocks as there are cores */
+	size_t maxCount = (size_t) getCoreCount();
+	std::vector<std::vector<uint8_t> > compressed;
+	while (compressed.size() < maxCount && !m_endOfBlocks) {
+		uint8_t header[8];
+		m_childStream->read(header, sizeof(header));
+		uint32_t size = decodeUInt(header),
+		         compressedSize = decodeUInt(header + 4);
+		if (size == 0) {
+			m_endOfBlocks = true;
+			break;
+		}
+		if (size > ZSTREAM_MAX_BLOCKSIZE || compressedSize > compressBound(size))
+			Log(EError, "readBlocks(): encountered an invalid block header!");
+		compressed.push_back(std::vector<uint8_t>(compressedSize));
+		m_childStream->read(&compressed.back()[0], compressedSize);
+		m_blocks.push_back(std::vector<uint8_t>(size));
+	}
+
+	int count = (int) compressed.size();
+	std::vector<int> status(count, Z_OK);
+
+#if defined(MTS_OPENMP)
+	#pragma omp parallel for schedule(dynamic) if (count > 1)
+#endif
+	for (int i=0; i<count; ++i) {
+		std::vector<uint8_t> &block = m_blocks[i];
+		if (compressed[i].size() == block.size()) {
+			memcpy(&block[0], &compressed[i][0], block.size());
+			continue;
+		}
+		uLongf size = (uLongf) block.size();
+		status[i] = uncompress(&block[0], &size, &compressed[i][0],
+			(uLong) compressed[i].size());
+		if (status[i] == Z_OK && size != block.size())
+			status[i] = Z_DATA_ERROR;
+	}
+
+	for (int i=0; i<count; ++i) {
+		if (status[i] != Z_OK)
+			Log(EError, "uncompress(): error code %i!", status[i]);
+	}
+
+	return count > 0;
+}
+
+void ZStream::detectFormat() {
+	m_didRead = true;
+	if (m_streamType == EGZipStream)
+		return;
+
+	uint8_t header[4];
+	m_childStream->read(header, sizeof(header));
+	if (memcmp(header, __blockMagic, sizeof(header)) != 0) {
+		/* A plain zlib stream -- hand the bytes to inflate() */
+		memcpy(m_inflateBuffer, header, sizeof(header));
+		m_inflateStream.next_in = m_inflateBuffer;
+		m_inflateStream.avail_in = sizeof(header);
+		return;
+	}
+
+	m_childStream->read(header, sizeof(header));
+	if (header[0] != __blockVersion || header[1] != 0)
+		Log(EError, "Encountered a block-compressed stream with an "
+			"unsupported version (%i) or codec (%i)!", header[0], header[1]);
+	m_blockMode = true;
+	m_firstBlock = m_childStream->getPos();
 }
 
 void ZStream::write(const void *ptr, size_t size) {
+	if (m_streamType == EBlockStream) {
+		if (!m_didWrite) {
+			uint8_t header[8] = { __blockMagic[0], __blockMagic[1],
+				__blockMagic[2], __blockMagic[3], __blockVersion, 0, 0, 0 };
+			m_childStream->write(header, sizeof(header));
+			m_didWrite = true;
+		}
+
+		const uint8_t *data = (const uint8_t *) ptr;
+		while (size > 0) {
+			if (m_blocks.empty() || m_blocks.back().size() == ZSTREAM_BLOCKSIZE) {
+				if (m_blocks.size() >= (size_t) getCoreCount())
+					writeBlocks();
+				m_blocks.push_back(std::vector<uint8_t>());
+				m_blocks.back().reserve(ZSTREAM_BLOCKSIZE);
+			}
+			std::vector<uint8_t> &block = m_blocks.back();
+			size_t amount = std::min(size, (size_t) ZSTREAM_BLOCKSIZE - block.size());
+			block.insert(block.end(), data, data + amount);
+			data += amount;
+			size -= amount;
+			m_pos += amount;
+		}
+		return;
+	}
+
 	m_deflateStream.avail_in = (uInt) size;
 	m_deflateStream.next_in = (uint8_t *) ptr;
 
@@ -100,6 +312,29 @@ void ZStream::write(const void *ptr, size_t size) {
 
 void ZStream::read(void *ptr, size_t size) {
 	uint8_t *targetPtr = (uint8_t *) ptr;
+
+	if (!m_didRead)
+		detectFormat();
+
+	if (m_blockMode) {
+		while (size > 0) {
+			if (m_blockIndex == m_blocks.size() && !readBlocks())
+				Log(EError, "Read less data than expected (%i more bytes required)", size);
+			const std::vector<uint8_t> &block = m_blocks[m_blockIndex];
+			size_t amount = std::min(size, block.size() - m_blockOffset);
+			memcpy(targetPtr, &block[m_blockOffset], amount);
+			targetPtr += amount;
+			size -= amount;
+			m_pos += amount;
+			m_blockOffset += amount;
+			if (m_blockOffset == block.size()) {
+				m_blockIndex++;
+				m_blockOffset = 0;
+			}
+		}
+		return;
+	}
+
 	while (size > 0) {
 		if (m_inflateStream.avail_in == 0) {
 			size_t remaining = m_childStream->getSize() - m_childStream->getPos();
@@ -135,7 +370,11 @@ void ZStream::read(void *ptr, size_t size) {
 }
 
 ZStream::~ZStream() {
-	if (m_didWrite) {
+	if (m_didWrite && m_streamType == EBlockStream) {
+		writeBlocks();
+		uint8_t marker[8] = { 0 };
+		m_childStream->write(marker, sizeof(marker));
+	} else if (m_didWrite) {
 		m_deflateStream.avail_in = 0;
 		m_deflateStream.next_in = NULL;
 		int outputSize = 0;
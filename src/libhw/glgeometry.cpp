@@ -62,8 +62,8 @@ void GLGeometry::refresh() {
 	GLfloat *vertices = new GLfloat[vertexCount * m_stride/sizeof(GLfloat)];
 	GLuint *indices = (GLuint *) m_mesh->getTriangles();
 	const Point *sourcePositions = m_mesh->getVertexPositions();
-	const Normal *sourceNormals = m_mesh->getVertexNormals();
-	const Point2 *sourceTexcoords = m_mesh->getVertexTexcoords();
+	bool hasNormals = m_mesh->hasVertexNormals();
+	bool hasTexcoords = m_mesh->hasVertexTexcoords();
 	const Color3 *sourceColors = m_mesh->getVertexColors();
 	Vector *sourceTangents = NULL;
 
@@ -97,14 +97,17 @@ void GLGeometry::refresh() {
 		vertices[pos++] = (GLfloat) sourcePositions[i].x;
 		vertices[pos++] = (GLfloat) sourcePositions[i].y;
 		vertices[pos++] = (GLfloat) sourcePositions[i].z;
-		if (sourceNormals) {
-			vertices[pos++] = (GLfloat) sourceNormals[i].x;
-			vertices[pos++] = (GLfloat) sourceNormals[i].y;
-			vertices[pos++] = (GLfloat) sourceNormals[i].z;
+		if (hasNormals) {
+			/* (decodes the normals of quantized meshes) */
+			Normal n = m_mesh->getVertexNormal((uint32_t) i);
+			vertices[pos++] = (GLfloat) n.x;
+			vertices[pos++] = (GLfloat) n.y;
+			vertices[pos++] = (GLfloat) n.z;
 		}
-		if (sourceTexcoords) {
-			vertices[pos++] = (GLfloat) sourceTexcoords[i].x;
-			vertices[pos++] = (GLfloat) sourceTexcoords[i].y;
+		if (hasTexcoords) {
+			Point2 uv = m_mesh->getVertexTexcoord((uint32_t) i);
+			vertices[pos++] = (GLfloat) uv.x;
+			vertices[pos++] = (GLfloat) uv.y;
 		}
 		if (sourceTangents) {
 			vertices[pos++] = (GLfloat) sourceTangents[i].x;
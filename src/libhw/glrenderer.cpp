@@ -298,8 +298,10 @@ void GLRenderer::drawMesh(const TriMesh *mesh) {
 
 		glVertexPointer(3, dataType, 0, positions);
 
+		/* Quantized normals and texture coordinates are not available
+		   as arrays in this case and are simply left out */
 		if (!m_transmitOnlyPositions) {
-			if (mesh->hasVertexNormals()) {
+			if (normals) {
 				if (!m_normalsEnabled) {
 					glEnableClientState(GL_NORMAL_ARRAY);
 					m_normalsEnabled = true;
@@ -311,7 +313,7 @@ void GLRenderer::drawMesh(const TriMesh *mesh) {
 			}
 
 			glClientActiveTexture(GL_TEXTURE0);
-			if (mesh->hasVertexTexcoords()) {
+			if (texcoords) {
 				if (!m_texcoordsEnabled) {
 					glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 					m_texcoordsEnabled = true;
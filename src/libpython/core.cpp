@@ -1776,7 +1776,12 @@ void export_core() {
 		.def(bp::init<int, const std::string, Thread::EThreadPriority>());
 
 	BP_CLASS(RemoteWorker, Worker, (bp::init<const std::string, Stream *>()))
-		.def("getNodeName", &RemoteWorker::getNodeName, BP_RETURN_VALUE);
+		.def("getNodeName", &RemoteWorker::getNodeName, BP_RETURN_VALUE)
+		.def("setWindowSize", &RemoteWorker::setWindowSize)
+		.def("getWindowSize", &RemoteWorker::getWindowSize)
+		.def("setTimeout", &RemoteWorker::setTimeout)
+		.def("getTimeout", &RemoteWorker::getTimeout)
+		.def("hasFailed", &RemoteWorker::hasFailed);
 
 	bp::class_<SerializableObjectVector>("SerializableObjectVector")
 		.def(bp::vector_indexing_suite<SerializableObjectVector>());
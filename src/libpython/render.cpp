@@ -354,6 +354,8 @@ void export_render() {
 	Sampler *(Scene::*scene_getSampler)(void) = &Scene::getSampler;
 	Film *(Scene::*scene_getFilm)(void) = &Scene::getFilm;
 	ShapeKDTree *(Scene::*scene_getKDTree)(void) = &Scene::getKDTree;
+	void (Scene::*scene_setShapeTransform1)(Shape *, const AnimatedTransform *) = &Scene::setShapeTransform;
+	void (Scene::*scene_setShapeTransform2)(Shape *, const Transform &) = &Scene::setShapeTransform;
 
 	BP_CLASS(Scene, NetworkedObject, bp::init<>())
 		.def(bp::init<Properties>())
@@ -361,6 +363,14 @@ void export_render() {
 		.def(bp::init<Stream *, InstanceManager *>())
 		.def("initialize", &Scene::initialize)
 		.def("invalidate", &Scene::invalidate)
+		.def("setIncremental", &Scene::setIncremental)
+		.def("isIncremental", &Scene::isIncremental)
+		.def("setShapeTransform", scene_setShapeTransform1)
+		.def("setShapeTransform", scene_setShapeTransform2)
+		.def("insertShape", &Scene::insertShape)
+		.def("removeShape", &Scene::removeShape)
+		.def("update", &Scene::update)
+		.def("isDirty", &Scene::isDirty)
 		.def("preprocess", &Scene::preprocess)
 		.def("render", &Scene::render)
 		.def("postprocess", &Scene::postprocess)
@@ -527,6 +537,7 @@ void export_render() {
 		.def("getSurfaceArea", &Shape::getSurfaceArea)
 		.def("getAABB", &Shape::getAABB, BP_RETURN_VALUE)
 		.def("getClippedAABB", &Shape::getClippedAABB, BP_RETURN_VALUE)
+		.def("getMotionAABB", &Shape::getMotionAABB, BP_RETURN_VALUE)
 		.def("createTriMesh", &Shape::createTriMesh, BP_RETURN_VALUE)
 		.def("rayIntersect", &shape_rayIntersect)
 		.def("getNormalDerivative", &shape_getNormalDerivative)
@@ -571,6 +582,11 @@ void export_render() {
 		.def("getVertexTexcoords", trimesh_getVertexTexcoords, BP_RETURN_VALUE)
 		.def("hasUVTangents", &TriMesh::hasUVTangents)
 		.def("getUVTangents", trimesh_getUVTangents, BP_RETURN_VALUE)
+		.def("getVertexNormal", &TriMesh::getVertexNormal, BP_RETURN_VALUE)
+		.def("getVertexTexcoord", &TriMesh::getVertexTexcoord, BP_RETURN_VALUE)
+		.def("quantize", &TriMesh::quantize)
+		.def("isQuantized", &TriMesh::isQuantized)
+		.def("getMemoryUsage", &TriMesh::getMemoryUsage)
 		.def("computeUVTangents", &TriMesh::computeUVTangents)
 		.def("computeNormals", &TriMesh::computeNormals)
 		.def("rebuildTopology", &TriMesh::rebuildTopology)
@@ -52,6 +52,10 @@ Film::Film(const Properties &props)
 	   quality at the edges especially with large reconstruction
 	   filters. */
 	m_highQualityEdges = props.getBoolean("highQualityEdges", false);
+
+	/* If set to true, develop() encodes and writes the image
+	   on a background thread (see Bitmap::writeAsync()) */
+	m_asyncWrite = props.getBoolean("asyncWrite", false);
 }
 
 Film::Film(Stream *stream, InstanceManager *manager)
@@ -61,10 +65,15 @@ Film::Film(Stream *stream, InstanceManager *manager)
 	m_cropSize = Vector2i(stream);
 	m_highQualityEdges = stream->readBool();
 	m_filter = static_cast<ReconstructionFilter *>(manager->getInstance(stream));
+	m_asyncWrite = false;
 }
 
 Film::~Film() { }
 
+ImageBlock *Film::getImageBlock() {
+	return NULL;
+}
+
 void Film::serialize(Stream *stream, InstanceManager *manager) const {
 	ConfigurableObject::serialize(stream, manager);
 	m_size.serialize(stream);
@@ -0,0 +1,576 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/ibvh.h>
+#include <mitsuba/core/timer.h>
+
+#if defined(MTS_SSE)
+#include <mitsuba/core/sse.h>
+#endif
+
+/// Number of bins used to find SAH splits
+#define MTS_IBVH_BINS 16
+
+MTS_NAMESPACE_BEGIN
+
+/* Node bounds are stored in single precision -- round them outwards */
+static inline float roundDown(Float value) {
+	float result = (float) value;
+	if ((Float) result > value)
+		result = std::nextafter(result, -std::numeric_limits<float>::infinity());
+	return result;
+}
+
+static inline float roundUp(Float value) {
+	float result = (float) value;
+	if ((Float) result < value)
+		result = std::nextafter(result, std::numeric_limits<float>::infinity());
+	return result;
+}
+
+void InstanceBVH::Node::setEmpty(int i) {
+	for (int axis=0; axis<3; ++axis) {
+		bounds[0][axis][i] = std::numeric_limits<float>::infinity();
+		bounds[1][axis][i] = -std::numeric_limits<float>::infinity();
+	}
+	child[i] = EEmpty;
+	count[i] = 0;
+}
+
+void InstanceBVH::Node::setBounds(int i, const AABB &aabb) {
+	for (int axis=0; axis<3; ++axis) {
+		bounds[0][axis][i] = roundDown(aabb.min[axis]);
+		bounds[1][axis][i] = roundUp(aabb.max[axis]);
+	}
+}
+
+AABB InstanceBVH::Node::getBounds() const {
+	AABB aabb;
+	for (int axis=0; axis<3; ++axis) {
+		aabb.min[axis] = std::min(std::min(bounds[0][axis][0], bounds[0][axis][1]),
+		                          std::min(bounds[0][axis][2], bounds[0][axis][3]));
+		aabb.max[axis] = std::max(std::max(bounds[1][axis][0], bounds[1][axis][1]),
+		                          std::max(bounds[1][axis][2], bounds[1][axis][3]));
+	}
+	return aabb;
+}
+
+/// Ray data shared by all node intersection tests of a query
+struct BVHRay {
+#if defined(MTS_SSE)
+	__m128 o[3], dRcp[3];
+#else
+	Float o[3], dRcp[3];
+#endif
+	int neg[3];
+
+	inline BVHRay(const Ray &ray) {
+		for (int axis=0; axis<3; ++axis) {
+#if defined(MTS_SSE)
+			o[axis] = _mm_set1_ps(ray.o[axis]);
+			dRcp[axis] = _mm_set1_ps(ray.dRcp[axis]);
+#else
+			o[axis] = ray.o[axis];
+			dRcp[axis] = ray.dRcp[axis];
+#endif
+			neg[axis] = ray.d[axis] < 0 ? 1 : 0;
+		}
+	}
+};
+
+/**
+ * Intersect a ray segment against the four child boxes of a node. Returns
+ * a bit mask of the children that were hit and their entry distances.
+ * NaNs due to rays in the plane of a box face are resolved conservatively.
+ */
+static FINLINE int intersectNode(const float (&bounds)[2][3][4], const BVHRay &ray,
+		Float mint, Float maxt, Float *tNear) {
+	const float robust = 1.0f + 4 * std::numeric_limits<float>::epsilon();
+#if defined(MTS_SSE)
+	__m128 tmin = _mm_set1_ps(mint), tmax = _mm_set1_ps(maxt);
+	for (int axis=0; axis<3; ++axis) {
+		__m128 near = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(bounds[ray.neg[axis]][axis]),
+			ray.o[axis]), ray.dRcp[axis]);
+		__m128 far = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(bounds[1-ray.neg[axis]][axis]),
+			ray.o[axis]), ray.dRcp[axis]);
+		tmin = _mm_max_ps(near, tmin);
+		tmax = _mm_min_ps(_mm_mul_ps(far, _mm_set1_ps(robust)), tmax);
+	}
+	_mm_storeu_ps(tNear, tmin);
+	return _mm_movemask_ps(_mm_cmple_ps(tmin, tmax));
+#else
+	int mask = 0;
+	for (int i=0; i<4; ++i) {
+		Float tmin = mint, tmax = maxt;
+		for (int axis=0; axis<3; ++axis) {
+			Float near = (bounds[ray.neg[axis]][axis][i] - ray.o[axis]) * ray.dRcp[axis];
+			Float far = (bounds[1-ray.neg[axis]][axis][i] - ray.o[axis]) * ray.dRcp[axis] * robust;
+			tmin = near > tmin ? near : tmin;
+			tmax = far < tmax ? far : tmax;
+		}
+		tNear[i] = tmin;
+		if (tmin <= tmax)
+			mask |= 1 << i;
+	}
+	return mask;
+#endif
+}
+
+InstanceBVH::InstanceBVH() : Shape(Properties()), m_nodes(NULL),
+	m_nodeCount(0), m_nodeCapacity(0), m_timeStart(0), m_timeEnd(0),
+	m_timeScale(0), m_timeSegments(1) { }
+
+InstanceBVH::~InstanceBVH() {
+	for (size_t i=0; i<m_shapes.size(); ++i)
+		m_shapes[i]->decRef();
+	if (m_nodes)
+		freeAligned(m_nodes);
+}
+
+void InstanceBVH::addShape(const Shape *shape) {
+	Assert(!isBuilt());
+	shape->incRef();
+	m_shapes.push_back(shape);
+}
+
+void InstanceBVH::setTimeRange(Float start, Float end) {
+	Assert(!isBuilt());
+	m_timeStart = start;
+	m_timeEnd = end;
+}
+
+void InstanceBVH::computeShapeBounds() {
+	int shapeCount = (int) m_shapes.size();
+	m_shapeAABBs.resize(shapeCount);
+	m_centroids.resize(shapeCount);
+
+	#if defined(MTS_OPENMP)
+		#pragma omp parallel for
+	#endif
+	for (int i=0; i<shapeCount; ++i) {
+		m_shapeAABBs[i] = m_shapes[i]->getAABB();
+		m_centroids[i] = m_shapeAABBs[i].getCenter();
+	}
+}
+
+bool InstanceBVH::computeSegmentBounds() {
+	int shapeCount = (int) m_shapes.size(), segments = m_timeSegments;
+	Float length = (m_timeEnd - m_timeStart) / segments;
+	m_segmentAABBs.resize((size_t) shapeCount * segments);
+
+	#if defined(MTS_OPENMP)
+		#pragma omp parallel for
+	#endif
+	for (int i=0; i<shapeCount; ++i) {
+		for (int j=0; j<segments; ++j) {
+			/* The outer segments also cover rays outside of the time range */
+			Float start = j == 0 ? -std::numeric_limits<Float>::infinity()
+				: m_timeStart + j * length;
+			Float end = j == segments - 1 ? std::numeric_limits<Float>::infinity()
+				: m_timeStart + (j + 1) * length;
+			m_segmentAABBs[(size_t) j * shapeCount + i] = m_shapes[i]->getMotionAABB(start, end);
+		}
+	}
+
+	for (size_t i=0; i<m_segmentAABBs.size(); ++i) {
+		if (!(m_segmentAABBs[i] == m_shapeAABBs[i % shapeCount]))
+			return true;
+	}
+	return false;
+}
+
+void InstanceBVH::build() {
+	Assert(!isBuilt());
+	ref<Timer> timer = new Timer();
+
+	computeShapeBounds();
+
+	/* Shapes without geometry are left out */
+	m_indices.reserve(m_shapes.size());
+	AABB aabb;
+	for (size_t i=0; i<m_shapes.size(); ++i) {
+		if (!m_shapeAABBs[i].isValid())
+			continue;
+		m_indices.push_back((uint32_t) i);
+		aabb.expandBy(m_shapeAABBs[i]);
+	}
+
+	/* A 4-wide tree needs fewer nodes than it has shapes */
+	m_nodeCapacity = std::max((size_t) 1, m_indices.size() / 2);
+	m_nodes = static_cast<Node *>(allocAligned(sizeof(Node) * m_nodeCapacity));
+	m_nodeCount = 1;
+	buildNode(0, BuildRange(0, (uint32_t) m_indices.size(), aabb), 0);
+
+	/* The centroids are only needed during construction */
+	std::vector<Point>().swap(m_centroids);
+
+	if (m_timeEnd > m_timeStart) {
+		m_timeSegments = MTS_IBVH_TIME_SEGMENTS;
+		m_timeScale = m_timeSegments / (m_timeEnd - m_timeStart);
+
+		if (computeSegmentBounds()) {
+			/* Replicate the nodes for each time segment and compute their bounds */
+			Node *nodes = static_cast<Node *>(allocAligned(
+				sizeof(Node) * m_nodeCount * m_timeSegments));
+			for (size_t i=0; i<m_nodeCount; ++i)
+				for (int j=0; j<m_timeSegments; ++j)
+					nodes[i * m_timeSegments + j] = m_nodes[i];
+			freeAligned(m_nodes);
+			m_nodes = nodes;
+			m_nodeCapacity = m_nodeCount * m_timeSegments;
+			for (int j=0; j<m_timeSegments; ++j)
+				refitNodes(j);
+		} else {
+			/* Nothing moves -- a single set of bounds suffices */
+			m_timeSegments = 1;
+			m_timeScale = 0;
+			std::vector<AABB>().swap(m_segmentAABBs);
+		}
+	}
+
+	m_aabb.reset();
+	for (int i=0; i<m_timeSegments; ++i)
+		m_aabb.expandBy(m_nodes[i].getBounds());
+
+	Log(EDebug, "Built a BVH over " SIZE_T_FMT " shapes (" SIZE_T_FMT " nodes, %i time "
+		"segment%s, %s) in %i ms", m_indices.size(), m_nodeCount, m_timeSegments,
+		m_timeSegments > 1 ? "s" : "", memString(sizeof(Node) * m_nodeCount * m_timeSegments).c_str(),
+		timer->getMilliseconds());
+}
+
+void InstanceBVH::buildNode(uint32_t nodeIndex, const BuildRange &range, int depth) {
+	/* Repeatedly split the child with the largest surface area until there are
+	   four of them. Nodes at the maximum depth turn their children into leaves */
+	BuildRange children[4];
+	children[0] = range;
+	int childCount = 1;
+
+	while (childCount < 4) {
+		int best = -1;
+		Float bestArea = -1;
+		for (int i=0; i<childCount; ++i) {
+			if (children[i].size() <= MTS_IBVH_LEAF_SIZE)
+				continue;
+			Float area = children[i].aabb.getSurfaceArea();
+			if (area > bestArea) {
+				best = i;
+				bestArea = area;
+			}
+		}
+		if (best < 0)
+			break;
+		BuildRange left, right;
+		split(children[best], left, right);
+		children[best] = left;
+		children[childCount++] = right;
+	}
+
+	for (int i=0; i<4; ++i) {
+		if (i >= childCount || children[i].size() == 0) {
+			m_nodes[nodeIndex].setEmpty(i);
+		} else if (children[i].size() <= MTS_IBVH_LEAF_SIZE || depth + 1 >= MTS_IBVH_MAX_DEPTH) {
+			m_nodes[nodeIndex].setBounds(i, children[i].aabb);
+			m_nodes[nodeIndex].child[i] = children[i].start;
+			m_nodes[nodeIndex].count[i] = children[i].size();
+		} else {
+			if (m_nodeCount == m_nodeCapacity) {
+				size_t capacity = m_nodeCapacity * 2;
+				Node *nodes = static_cast<Node *>(allocAligned(sizeof(Node) * capacity));
+				memcpy(nodes, m_nodes, sizeof(Node) * m_nodeCount);
+				freeAligned(m_nodes);
+				m_nodes = nodes;
+				m_nodeCapacity = capacity;
+			}
+			uint32_t childIndex = (uint32_t) m_nodeCount++;
+			m_nodes[nodeIndex].setBounds(i, children[i].aabb);
+			m_nodes[nodeIndex].child[i] = childIndex;
+			m_nodes[nodeIndex].count[i] = 0;
+			buildNode(childIndex, children[i], depth + 1);
+		}
+	}
+}
+
+/// Predicate used to partition shape indices according to their SAH bin
+struct BinPredicate {
+	const std::vector<Point> &centroids;
+	int axis, split;
+	Float min, scale;
+
+	inline BinPredicate(const std::vector<Point> &centroids, int axis,
+		int split, Float min, Float scale) : centroids(centroids),
+		axis(axis), split(split), min(min), scale(scale) { }
+
+	inline bool operator()(uint32_t index) const {
+		int bin = std::min(MTS_IBVH_BINS - 1,
+			(int) ((centroids[index][axis] - min) * scale));
+		return bin <= split;
+	}
+};
+
+/// Orders shape indices by their centroid along an axis
+struct CentroidOrder {
+	const std::vector<Point> &centroids;
+	int axis;
+
+	inline CentroidOrder(const std::vector<Point> &centroids, int axis)
+		: centroids(centroids), axis(axis) { }
+
+	inline bool operator()(uint32_t a, uint32_t b) const {
+		return centroids[a][axis] < centroids[b][axis];
+	}
+};
+
+bool InstanceBVH::split(const BuildRange &range, BuildRange &left, BuildRange &right) {
+	if (range.size() < 2)
+		return false;
+
+	uint32_t *indices = &m_indices[0];
+	AABB centroidBounds;
+	for (uint32_t i=range.start; i<range.end; ++i)
+		centroidBounds.expandBy(m_centroids[indices[i]]);
+	int axis = centroidBounds.getLargestAxis();
+	Float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+
+	uint32_t middle = range.start;
+	if (extent > 0) {
+		/* Binned SAH split along the axis of largest centroid extent */
+		AABB binAABBs[MTS_IBVH_BINS];
+		uint32_t binCounts[MTS_IBVH_BINS];
+		memset(binCounts, 0, sizeof(binCounts));
+		Float scale = MTS_IBVH_BINS / extent;
+
+		for (uint32_t i=range.start; i<range.end; ++i) {
+			uint32_t index = indices[i];
+			int bin = std::min(MTS_IBVH_BINS - 1,
+				(int) ((m_centroids[index][axis] - centroidBounds.min[axis]) * scale));
+			binAABBs[bin].expandBy(m_shapeAABBs[index]);
+			binCounts[bin]++;
+		}
+
+		Float rightCost[MTS_IBVH_BINS];
+		AABB aabb;
+		uint32_t count = 0;
+		for (int i=MTS_IBVH_BINS-1; i>0; --i) {
+			aabb.expandBy(binAABBs[i]);
+			count += binCounts[i];
+			rightCost[i] = count > 0 ? aabb.getSurfaceArea() * count : 0;
+		}
+
+		int bestSplit = -1;
+		Float bestCost = std::numeric_limits<Float>::infinity();
+		aabb.reset();
+		count = 0;
+		for (int i=0; i<MTS_IBVH_BINS-1; ++i) {
+			aabb.expandBy(binAABBs[i]);
+			count += binCounts[i];
+			if (count == 0 || count == range.size())
+				continue;
+			Float cost = aabb.getSurfaceArea() * count + rightCost[i+1];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestSplit = i;
+			}
+		}
+
+		if (bestSplit >= 0)
+			middle = (uint32_t) (std::partition(indices + range.start, indices + range.end,
+				BinPredicate(m_centroids, axis, bestSplit, centroidBounds.min[axis], scale))
+				- indices);
+	}
+
+	if (middle == range.start || middle == range.end) {
+		/* Coincident centroids or a failed partition -- fall back to a median split */
+		middle = range.start + range.size() / 2;
+		std::nth_element(indices + range.start, indices + middle,
+			indices + range.end, CentroidOrder(m_centroids, axis));
+	}
+
+	left = BuildRange(range.start, middle, AABB());
+	right = BuildRange(middle, range.end, AABB());
+	for (uint32_t i=left.start; i<left.end; ++i)
+		left.aabb.expandBy(m_shapeAABBs[indices[i]]);
+	for (uint32_t i=right.start; i<right.end; ++i)
+		right.aabb.expandBy(m_shapeAABBs[indices[i]]);
+	return true;
+}
+
+void InstanceBVH::refit() {
+	Assert(isBuilt());
+	computeShapeBounds();
+	std::vector<Point>().swap(m_centroids);
+	if (m_timeSegments > 1)
+		computeSegmentBounds();
+
+	m_aabb.reset();
+	for (int i=0; i<m_timeSegments; ++i) {
+		refitNodes(i);
+		m_aabb.expandBy(m_nodes[i].getBounds());
+	}
+}
+
+void InstanceBVH::refitNodes(int segment) {
+	const std::vector<AABB> &aabbs = m_timeSegments > 1 ? m_segmentAABBs : m_shapeAABBs;
+	size_t offset = (size_t) segment * m_shapes.size();
+	if (m_timeSegments == 1)
+		offset = 0;
+
+	/* Children are always stored after their parents */
+	for (size_t i=m_nodeCount; i-- > 0; ) {
+		Node &node = m_nodes[i * m_timeSegments + segment];
+		for (int j=0; j<4; ++j) {
+			if (node.count[j] > 0) {
+				AABB aabb;
+				for (uint32_t k=0; k<node.count[j]; ++k)
+					aabb.expandBy(aabbs[offset + m_indices[node.child[j] + k]]);
+				node.setBounds(j, aabb);
+			} else if (node.child[j] != Node::EEmpty) {
+				node.setBounds(j, m_nodes[node.child[j] * m_timeSegments + segment].getBounds());
+			}
+		}
+	}
+}
+
+AABB InstanceBVH::getAABB() const {
+	return m_aabb;
+}
+
+bool InstanceBVH::rayIntersect(const Ray &ray, Float mint,
+		Float maxt, Float &t, void *temp) const {
+	struct StackEntry {
+		uint32_t child, count;
+		Float tNear;
+	};
+
+	StackEntry stack[3 * MTS_IBVH_MAX_DEPTH + 4];
+	int stackPos = 0;
+	stack[stackPos].child = 0;
+	stack[stackPos].count = 0;
+	stack[stackPos++].tNear = mint;
+
+	BVHRay bvhRay(ray);
+	const Node *nodes = m_nodes + getTimeSegment(ray.time);
+	uint8_t *shapeTemp = static_cast<uint8_t *>(temp) + 2*sizeof(uint32_t);
+	bool foundIntersection = false;
+
+	while (stackPos > 0) {
+		StackEntry entry = stack[--stackPos];
+		if (entry.tNear > maxt)
+			continue;
+
+		if (entry.count > 0) {
+			for (uint32_t i=0; i<entry.count; ++i) {
+				uint32_t index = m_indices[entry.child + i];
+				Float tempT;
+				if (m_shapes[index]->rayIntersect(ray, mint, maxt, tempT, shapeTemp)) {
+					*static_cast<uint32_t *>(temp) = index;
+					t = maxt = tempT;
+					foundIntersection = true;
+				}
+			}
+			continue;
+		}
+
+		const Node &node = nodes[entry.child * m_timeSegments];
+		Float tNear[4];
+		int mask = intersectNode(node.bounds, bvhRay, mint, maxt, tNear);
+		if (mask == 0)
+			continue;
+
+		/* Push the children so that the closest one is visited first */
+		int order[4], hitCount = 0;
+		for (int i=0; i<4; ++i) {
+			if (!(mask & (1 << i)))
+				continue;
+			int j = hitCount++;
+			while (j > 0 && tNear[order[j-1]] < tNear[i]) {
+				order[j] = order[j-1];
+				--j;
+			}
+			order[j] = i;
+		}
+		for (int i=0; i<hitCount; ++i) {
+			StackEntry &newEntry = stack[stackPos++];
+			newEntry.child = node.child[order[i]];
+			newEntry.count = node.count[order[i]];
+			newEntry.tNear = tNear[order[i]];
+		}
+	}
+
+	return foundIntersection;
+}
+
+bool InstanceBVH::rayIntersect(const Ray &ray, Float mint, Float maxt) const {
+	uint32_t stack[3 * MTS_IBVH_MAX_DEPTH + 4];
+	int stackPos = 0;
+	stack[stackPos++] = 0;
+	BVHRay bvhRay(ray);
+	const Node *nodes = m_nodes + getTimeSegment(ray.time);
+
+	while (stackPos > 0) {
+		const Node &node = nodes[stack[--stackPos] * m_timeSegments];
+		Float tNear[4];
+		int mask = intersectNode(node.bounds, bvhRay, mint, maxt, tNear);
+
+		for (int i=0; i<4; ++i) {
+			if (!(mask & (1 << i)))
+				continue;
+			if (node.count[i] == 0) {
+				stack[stackPos++] = node.child[i];
+				continue;
+			}
+			for (uint32_t j=0; j<node.count[i]; ++j) {
+				if (m_shapes[m_indices[node.child[i] + j]]->rayIntersect(ray, mint, maxt))
+					return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+void InstanceBVH::fillIntersectionRecord(const Ray &ray,
+		const void *temp, Intersection &its) const {
+	uint32_t index = *static_cast<const uint32_t *>(temp);
+	m_shapes[index]->fillIntersectionRecord(ray,
+		static_cast<const uint8_t *>(temp) + 2*sizeof(uint32_t), its);
+}
+
+size_t InstanceBVH::getPrimitiveCount() const {
+	return 0;
+}
+
+size_t InstanceBVH::getEffectivePrimitiveCount() const {
+	size_t result = 0;
+	for (size_t i=0; i<m_shapes.size(); ++i)
+		result += m_shapes[i]->getEffectivePrimitiveCount();
+	return result;
+}
+
+std::string InstanceBVH::toString() const {
+	std::ostringstream oss;
+	oss << "InstanceBVH[" << endl
+		<< "  shapeCount = " << m_shapes.size() << "," << endl
+		<< "  nodeCount = " << m_nodeCount << "," << endl
+		<< "  timeSegments = " << m_timeSegments << "," << endl
+		<< "  aabb = " << m_aabb.toString() << endl
+		<< "]";
+	return oss.str();
+}
+
+MTS_IMPLEMENT_CLASS(InstanceBVH, false, Shape)
+MTS_NAMESPACE_END
@@ -42,6 +42,17 @@ ImageBlock::~ImageBlock() {
 		delete[] m_weightsX;
 }
 
+void ImageBlock::setVarianceTracking(bool enabled) {
+	if (!enabled) {
+		m_variance = NULL;
+	} else if (!m_variance) {
+		/* Sample count, followed by sums and sums of squares (RGB) */
+		m_variance = new Bitmap(Bitmap::EMultiChannel, Bitmap::EFloat,
+			m_bitmap->getSize() - Vector2i(2 * m_borderSize), 7);
+		m_variance->clear();
+	}
+}
+
 void ImageBlock::load(Stream *stream) {
 	m_offset = Point2i(stream);
 	m_size = Vector2i(stream);
@@ -49,6 +60,9 @@ void ImageBlock::load(Stream *stream) {
 		m_bitmap->getFloatData(),
 		(size_t) m_bitmap->getSize().x *
 		(size_t) m_bitmap->getSize().y * m_bitmap->getChannelCount());
+	if (hasVariance())
+		stream->readFloatArray(m_variance->getFloatData(),
+			m_variance->getPixelCount() * m_variance->getChannelCount());
 }
 
 void ImageBlock::save(Stream *stream) const {
@@ -58,6 +72,9 @@ void ImageBlock::save(Stream *stream) const {
 		m_bitmap->getFloatData(),
 		(size_t) m_bitmap->getSize().x *
 		(size_t) m_bitmap->getSize().y * m_bitmap->getChannelCount());
+	if (hasVariance())
+		stream->writeFloatArray(m_variance->getFloatData(),
+			m_variance->getPixelCount() * m_variance->getChannelCount());
 }
 
 
@@ -66,7 +83,8 @@ std::string ImageBlock::toString() const {
 	oss << "ImageBlock[" << endl
 		<< "  offset = " << m_offset.toString() << "," << endl
 		<< "  size = " << m_size.toString() << "," << endl
-		<< "  borderSize = " << m_borderSize << endl
+		<< "  borderSize = " << m_borderSize << "," << endl
+		<< "  variance = " << (hasVariance() ? "yes" : "no") << endl
 		<< "]";
 	return oss.str();
 }
@@ -33,7 +33,8 @@ void BlockedImageProcess::init(const Point2i &offset, const Vector2i &size, uint
 	m_numBlocks = Vector2i(
 		(int) std::ceil((Float) size.x / (Float) blockSize),
 		(int) std::ceil((Float) size.y / (Float) blockSize));
-	m_numBlocksTotal = m_numBlocks.x * m_numBlocks.y;
+	m_numBlocksTotal = m_blockList.empty() ? (m_numBlocks.x * m_numBlocks.y)
+		: (int) m_blockList.size();
 	m_numBlocksGenerated = 0;
 	m_curBlock = Point2i(m_numBlocks / 2);
 	m_stepsLeft = 1;
@@ -47,6 +48,15 @@ ParallelProcess::EStatus BlockedImageProcess::generateWork(WorkUnit *unit, int w
 	if (m_numBlocksTotal == m_numBlocksGenerated)
 		return EFailure;
 
+	if (!m_blockList.empty()) {
+		Point2i pos = m_blockList[m_numBlocksGenerated++] * m_blockSize;
+		rect.setOffset(pos + m_offset);
+		rect.setSize(Vector2i(
+			std::min(m_size.x-pos.x, m_blockSize),
+			std::min(m_size.y-pos.y, m_blockSize)));
+		return ESuccess;
+	}
+
 	Point2i pos = m_curBlock * m_blockSize;
 	rect.setOffset(pos + m_offset);
 	rect.setSize(Vector2i(
@@ -77,5 +87,9 @@ ParallelProcess::EStatus BlockedImageProcess::generateWork(WorkUnit *unit, int w
 	return ESuccess;
 }
 
+void BlockedImageProcess::setBlockList(const std::vector<Point2i> &blocks) {
+	m_blockList = blocks;
+}
+
 MTS_IMPLEMENT_CLASS(BlockedImageProcess, true, ParallelProcess)
 MTS_NAMESPACE_END
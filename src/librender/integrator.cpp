@@ -17,9 +17,15 @@
 */
 
 #include <mitsuba/core/statistics.h>
+#include <mitsuba/core/fstream.h>
+#include <mitsuba/core/timer.h>
 #include <mitsuba/render/integrator.h>
 #include <mitsuba/render/renderproc.h>
 
+/// Identifies checkpoint files of progressive renderings
+#define MTS_CHECKPOINT_HEADER  0x0C4B
+#define MTS_CHECKPOINT_VERSION 2
+
 MTS_NAMESPACE_BEGIN
 
 Integrator::Integrator(const Properties &props)
@@ -43,10 +49,28 @@ void Integrator::configureSampler(const Scene *scene, Sampler *sampler) {
 const Integrator *Integrator::getSubIntegrator(int idx) const { return NULL; }
 
 SamplingIntegrator::SamplingIntegrator(const Properties &props)
- : Integrator(props) { }
+ : Integrator(props) {
+	/* Number of progressive passes over the image (1 = disabled) */
+	int passCount = props.getInteger("passes", 1);
+	/* Wall-clock time budget for progressive rendering in seconds (0 = unlimited) */
+	m_timeBudget = props.getFloat("timeBudget", 0.0f);
+	/* Minimum time between checkpoints in seconds */
+	m_checkpointInterval = props.getFloat("checkpointInterval", 60.0f);
+	/* Checkpoint file (default: destination file with a '.checkpoint' extension) */
+	m_checkpointFile = props.getString("checkpointFile", "");
+	/* Resume from an existing checkpoint? */
+	m_resume = props.getBoolean("resume", true);
+
+	if (passCount <= 0)
+		Log(EError, "'passes' must be set to a value greater than zero!");
+	if (m_timeBudget < 0 || m_checkpointInterval < 0)
+		Log(EError, "'timeBudget' and 'checkpointInterval' must be nonnegative!");
+	m_passCount = (size_t) passCount;
+}
 
 SamplingIntegrator::SamplingIntegrator(Stream *stream, InstanceManager *manager)
- : Integrator(stream, manager) { }
+ : Integrator(stream, manager), m_passCount(1), m_timeBudget(0),
+   m_checkpointInterval(0), m_resume(false) { }
 
 void SamplingIntegrator::serialize(Stream *stream, InstanceManager *manager) const {
 	Integrator::serialize(stream, manager);
@@ -92,6 +116,88 @@ void SamplingIntegrator::cancel() {
 		Scheduler::getInstance()->cancel(m_process);
 }
 
+/**
+ * \brief Write the state of a progressive rendering to disk
+ *
+ * The file is first written to a temporary location and then moved
+ * into place so that an interruption never leaves a truncated checkpoint.
+ */
+static void saveCheckpoint(const fs::path &filename, const ImageBlock *storage,
+		uint64_t sceneHash, size_t sampleCount, size_t passCount,
+		size_t completedPasses) {
+	fs::path tempFile = filename.string()
+		+ fs::unique_path(".%%%%-%%%%-%%%%-%%%%.tmp").string();
+
+	ref<Timer> timer = new Timer();
+	{
+		ref<FileStream> stream = new FileStream(tempFile, FileStream::ETruncWrite);
+		stream->setByteOrder(Stream::ELittleEndian);
+		stream->writeShort(MTS_CHECKPOINT_HEADER);
+		stream->writeShort(MTS_CHECKPOINT_VERSION);
+		stream->writeULong(sceneHash);
+		stream->writeSize(sampleCount);
+		stream->writeSize(passCount);
+		stream->writeSize(completedPasses);
+		storage->getBitmap()->getSize().serialize(stream);
+		stream->writeInt(storage->getChannelCount());
+		storage->save(stream);
+		stream->close();
+	}
+	fs::rename(tempFile, filename);
+
+	SLog(EInfo, "Wrote checkpoint \"%s\" after " SIZE_T_FMT "/" SIZE_T_FMT
+		" passes (took %s)", filename.string().c_str(), completedPasses,
+		passCount, timeString(timer->getSeconds()).c_str());
+}
+
+/**
+ * \brief Restore the state of a progressive rendering from disk
+ *
+ * \return The number of passes that have already been completed
+ *    (or zero if the checkpoint does not match the current render job,
+ *    e.g. because the scene was edited since it was written)
+ */
+static size_t loadCheckpoint(const fs::path &filename, ImageBlock *storage,
+		uint64_t sceneHash, size_t sampleCount, size_t passCount) {
+	ref<FileStream> stream = new FileStream(filename, FileStream::EReadOnly);
+	stream->setByteOrder(Stream::ELittleEndian);
+
+	if (stream->getSize() < 2 * sizeof(short) + sizeof(uint64_t) + 3 * sizeof(size_t)
+			|| stream->readShort() != MTS_CHECKPOINT_HEADER
+			|| stream->readShort() != MTS_CHECKPOINT_VERSION) {
+		SLog(EWarn, "\"%s\" is not a valid checkpoint file -- ignoring it.",
+			filename.string().c_str());
+		return 0;
+	}
+
+	if (stream->readULong() != sceneHash) {
+		SLog(EWarn, "The checkpoint \"%s\" was created for a different version "
+			"of the scene -- ignoring it.", filename.string().c_str());
+		return 0;
+	}
+
+	size_t fileSampleCount = stream->readSize();
+	size_t filePassCount = stream->readSize();
+	size_t completedPasses = stream->readSize();
+	Vector2i size(stream);
+	int channelCount = stream->readInt();
+
+	if (fileSampleCount != sampleCount || filePassCount != passCount
+			|| completedPasses > passCount
+			|| size != storage->getBitmap()->getSize()
+			|| channelCount != storage->getChannelCount()) {
+		SLog(EWarn, "The checkpoint \"%s\" was created with a different "
+			"configuration -- ignoring it.", filename.string().c_str());
+		return 0;
+	}
+
+	storage->load(stream);
+	SLog(EInfo, "Resuming from checkpoint \"%s\" after " SIZE_T_FMT "/"
+		SIZE_T_FMT " passes", filename.string().c_str(), completedPasses, passCount);
+
+	return completedPasses;
+}
+
 bool SamplingIntegrator::render(Scene *scene,
 		RenderQueue *queue, const RenderJob *job,
 		int sceneResID, int sensorResID, int samplerResID) {
@@ -108,24 +214,109 @@ bool SamplingIntegrator::render(Scene *scene,
 		sampleCount, sampleCount == 1 ? "sample" : "samples", nCores,
 		nCores == 1 ? "core" : "cores");
 
-	/* This is a sampling-based integrator - parallelize */
-	ref<ParallelProcess> proc = new BlockedRenderProcess(job,
-		queue, scene->getBlockSize());
+	/* Set up progressive rendering and checkpointing */
+	size_t passCount = std::max((size_t) 1, std::min(m_passCount, sampleCount));
+	ImageBlock *storage = film->getImageBlock();
+	size_t completedPasses = 0;
+	fs::path checkpointFile;
+	uint64_t sceneHash = 0;
+
+	if (passCount > 1) {
+		if (!m_checkpointFile.empty()) {
+			checkpointFile = m_checkpointFile;
+		} else if (!scene->getDestinationFile().empty()) {
+			checkpointFile = scene->getDestinationFile();
+			checkpointFile.replace_extension(".checkpoint");
+		}
+
+		if (!storage && !checkpointFile.empty()) {
+			Log(EWarn, "The film does not keep the image in memory -- "
+				"disabling checkpoints.");
+			checkpointFile = fs::path();
+		}
+
+		if (!checkpointFile.empty()) {
+			/* Identifies the scene and viewpoint that a checkpoint belongs to */
+			std::string sensorStr = sensor->getWorldTransform()->toString();
+			sceneHash = hashBuffer(sensorStr.c_str(), sensorStr.length(),
+				scene->computeContentHash());
+		}
+
+		if (m_resume && !checkpointFile.empty() && fs::exists(checkpointFile))
+			completedPasses = loadCheckpoint(checkpointFile, storage,
+				sceneHash, sampleCount, passCount);
+	}
+
 	int integratorResID = sched->registerResource(this);
-	proc->bindResource("integrator", integratorResID);
-	proc->bindResource("scene", sceneResID);
-	proc->bindResource("sensor", sensorResID);
-	proc->bindResource("sampler", samplerResID);
-	scene->bindUsedResources(proc);
-	bindUsedResources(proc);
-	sched->schedule(proc);
-
-	m_process = proc;
-	sched->wait(proc);
-	m_process = NULL;
+	size_t firstPass = completedPasses;
+	ref<Timer> timer = new Timer();
+	Float lastCheckpoint = 0;
+	bool success = true, outOfTime = false;
+
+	for (size_t pass = firstPass; pass < passCount; ++pass) {
+		if (m_timeBudget > 0 && pass > firstPass) {
+			/* Don't start a pass that is not expected to finish in time */
+			Float elapsed = timer->getSeconds();
+			if (elapsed + elapsed / (pass - firstPass) > m_timeBudget) {
+				outOfTime = true;
+				break;
+			}
+		}
+
+		size_t start = pass * sampleCount / passCount,
+		       end = (pass + 1) * sampleCount / passCount;
+
+		if (passCount > 1)
+			Log(EInfo, "Rendering pass " SIZE_T_FMT "/" SIZE_T_FMT " ("
+				SIZE_T_FMT " %s per pixel) ..", pass + 1, passCount,
+				end - start, end - start == 1 ? "sample" : "samples");
+
+		/* This is a sampling-based integrator - parallelize */
+		ref<BlockedRenderProcess> proc = new BlockedRenderProcess(job,
+			queue, scene->getBlockSize());
+		proc->setSampleRange(start, end - start);
+		proc->bindResource("integrator", integratorResID);
+		proc->bindResource("scene", sceneResID);
+		proc->bindResource("sensor", sensorResID);
+		proc->bindResource("sampler", samplerResID);
+		scene->bindUsedResources(proc);
+		bindUsedResources(proc);
+		sched->schedule(proc);
+
+		m_process = proc;
+		sched->wait(proc);
+		m_process = NULL;
+
+		if (proc->getReturnStatus() != ParallelProcess::ESuccess) {
+			success = false;
+			break;
+		}
+
+		completedPasses = pass + 1;
+
+		if (!checkpointFile.empty() && completedPasses < passCount
+				&& timer->getSeconds() - lastCheckpoint >= m_checkpointInterval) {
+			saveCheckpoint(checkpointFile, storage, sceneHash, sampleCount,
+				passCount, completedPasses);
+			lastCheckpoint = timer->getSeconds();
+		}
+	}
+
 	sched->unregisterResource(integratorResID);
 
-	return proc->getReturnStatus() == ParallelProcess::ESuccess;
+	if (outOfTime) {
+		Log(EInfo, "Exhausted the time budget of %s after " SIZE_T_FMT "/"
+			SIZE_T_FMT " passes", timeString(m_timeBudget).c_str(),
+			completedPasses, passCount);
+		if (!checkpointFile.empty())
+			saveCheckpoint(checkpointFile, storage, sceneHash, sampleCount,
+				passCount, completedPasses);
+	} else if (success && !checkpointFile.empty() && fs::exists(checkpointFile)) {
+		/* The rendering is complete -- the checkpoint is no longer needed */
+		fs::remove(checkpointFile);
+	}
+
+	return success;
 }
 
 void SamplingIntegrator::bindUsedResources(ParallelProcess *) const {
@@ -152,6 +343,13 @@ void SamplingIntegrator::renderBlock(const Scene *scene,
 	Float timeSample = 0.5f;
 	RayDifferential sensorRay;
 
+	/* The 2D sensor dimensions of all samples in a pixel are requested
+	   from the sampler at once (if supported). The time sample is a 1D
+	   quantity and is drawn afterwards, so that both code paths consume
+	   the same sample dimensions */
+	size_t sensorDims = 1 + (needsApertureSample ? 1 : 0);
+	std::vector<Point2> sensorSamples(sampler->getSampleCount() * sensorDims);
+
 	block->clear();
 
 	uint32_t queryType = RadianceQueryRecord::ESensorRay;
@@ -159,19 +357,39 @@ void SamplingIntegrator::renderBlock(const Scene *scene,
 	if (!sensor->getFilm()->hasAlpha()) /* Don't compute an alpha channel if we don't have to */
 		queryType &= ~RadianceQueryRecord::EOpacity;
 
+	bool trackVariance = block->hasVariance();
+
+	/* Progressive rendering may restrict the set of rendered samples. The
+	   block is still generated for all samples of the pixel, so that a
+	   pass renders exactly the samples of a single-pass rendering */
+	size_t rangeStart = sampler->getSampleRangeStart(),
+	       rangeEnd = sampler->getSampleRangeEnd();
+
 	for (size_t i = 0; i<points.size(); ++i) {
 		Point2i offset = Point2i(points[i]) + Vector2i(block->getOffset());
 		if (stop)
 			break;
 
 		sampler->generate(offset);
+		bool haveBlock = sampler->generate2DBlock(&sensorSamples[0], sensorDims);
+		if (rangeStart > 0)
+			sampler->setSampleIndex(rangeStart);
 
-		for (size_t j = 0; j<sampler->getSampleCount(); j++) {
+		for (size_t j = rangeStart; j<rangeEnd; j++) {
 			rRec.newQuery(queryType, sensor->getMedium());
-			Point2 samplePos(Point2(offset) + Vector2(rRec.nextSample2D()));
+			Point2 samplePos;
+
+			if (haveBlock) {
+				const Point2 *sample = &sensorSamples[j * sensorDims];
+				samplePos = Point2(offset) + Vector2(*sample++);
+				if (needsApertureSample)
+					apertureSample = *sample;
+			} else {
+				samplePos = Point2(offset) + Vector2(rRec.nextSample2D());
+				if (needsApertureSample)
+					apertureSample = rRec.nextSample2D();
+			}
 
-			if (needsApertureSample)
-				apertureSample = rRec.nextSample2D();
 			if (needsTimeSample)
 				timeSample = rRec.nextSample1D();
 
@@ -182,6 +400,8 @@ void SamplingIntegrator::renderBlock(const Scene *scene,
 
 			spec *= Li(sensorRay, rRec);
 			block->put(samplePos, spec, rRec.alpha);
+			if (trackVariance)
+				block->putVariance(samplePos, spec);
 			sampler->advance();
 		}
 	}
@@ -18,6 +18,8 @@
 
 #include <mitsuba/render/irrcache.h>
 #include <mitsuba/core/statistics.h>
+#include <mitsuba/core/mmap.h>
+#include <mitsuba/core/mstream.h>
 
 MTS_NAMESPACE_BEGIN
 
@@ -251,9 +253,41 @@ IrradianceCache::IrradianceCache(Stream *stream, InstanceManager *manager) :
 	}
 }
 
+/// Number of records that are staged per thread before taking the lock
+static const size_t IRRCACHE_BATCH_SIZE = 64;
+
 IrradianceCache::~IrradianceCache() {
 	for (size_t i=0; i<m_records.size(); ++i)
 		delete m_records[i];
+	for (size_t i=0; i<m_stagingBuffers.size(); ++i) {
+		StagingBuffer *buffer = m_stagingBuffers[i];
+		for (size_t j=0; j<buffer->records.size(); ++j)
+			delete buffer->records[j];
+		delete buffer;
+	}
+}
+
+void IrradianceCache::getRecords(std::vector<const Record *> &records) const {
+	LockGuard lock(m_mutex);
+	records.clear();
+	records.insert(records.end(), m_records.begin(), m_records.end());
+	for (size_t i=0; i<m_stagingBuffers.size(); ++i) {
+		const StagingBuffer *buffer = m_stagingBuffers[i];
+		LockGuard bufferLock(buffer->mutex);
+		records.insert(records.end(), buffer->records.begin(),
+			buffer->records.end());
+	}
+}
+
+size_t IrradianceCache::size() const {
+	LockGuard lock(m_mutex);
+	size_t count = m_records.size();
+	for (size_t i=0; i<m_stagingBuffers.size(); ++i) {
+		const StagingBuffer *buffer = m_stagingBuffers[i];
+		LockGuard bufferLock(buffer->mutex);
+		count += buffer->records.size();
+	}
+	return count;
 }
 
 void IrradianceCache::serialize(Stream *stream, InstanceManager *manager) const {
@@ -263,9 +297,160 @@ void IrradianceCache::serialize(Stream *stream, InstanceManager *manager) const
 	stream->writeBool(m_clampScreen);
 	stream->writeBool(m_clampNeighbor);
 	stream->writeBool(m_useGradients);
-	stream->writeSize(m_records.size());
-	for (uint32_t i=0; i<m_records.size(); ++i)
-		m_records[i]->serialize(stream);
+	std::vector<const Record *> records;
+	getRecords(records);
+	stream->writeSize(records.size());
+	for (size_t i=0; i<records.size(); ++i)
+		records[i]->serialize(stream);
+}
+
+/**
+ * \brief Header of an irradiance cache file created by \ref IrradianceCache::writeCache()
+ *
+ * The header is written field by field in little endian byte order. The
+ * records that follow it are stored in the host's native layout, which
+ * is why the byte order of the writing host is recorded as well.
+ */
+struct IrradianceCacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t recordSize;
+	uint64_t hash;
+	uint64_t recordCount;
+	AABB aabb;
+	Float kappa;
+	uint8_t clampScreen, clampNeighbor, useGradients;
+
+	/// Size of the serialized header in bytes
+	static const size_t serializedSize = 4 * sizeof(char)
+		+ 3 * sizeof(uint32_t) + 2 * sizeof(uint64_t) + 7 * sizeof(Float)
+		+ 3 * sizeof(uint8_t);
+
+	inline IrradianceCacheHeader() : version(0), byteOrder(0), recordSize(0),
+		hash(0), recordCount(0), kappa(0), clampScreen(0), clampNeighbor(0),
+		useGradients(0) {
+		memset(magic, 0, sizeof(magic));
+	}
+
+	/// Unserialize a header from a binary data stream
+	inline IrradianceCacheHeader(Stream *stream) {
+		stream->read(magic, sizeof(magic));
+		version = stream->readUInt();
+		byteOrder = stream->readUInt();
+		recordSize = stream->readUInt();
+		hash = stream->readULong();
+		recordCount = stream->readULong();
+		aabb = AABB(stream);
+		kappa = stream->readFloat();
+		clampScreen = stream->readUChar();
+		clampNeighbor = stream->readUChar();
+		useGradients = stream->readUChar();
+	}
+
+	/// Serialize the header to a binary data stream
+	inline void serialize(Stream *stream) const {
+		stream->write(magic, sizeof(magic));
+		stream->writeUInt(version);
+		stream->writeUInt(byteOrder);
+		stream->writeUInt(recordSize);
+		stream->writeULong(hash);
+		stream->writeULong(recordCount);
+		aabb.serialize(stream);
+		stream->writeFloat(kappa);
+		stream->writeUChar(clampScreen);
+		stream->writeUChar(clampNeighbor);
+		stream->writeUChar(useGradients);
+	}
+};
+
+static const char *IRRCACHE_CACHE_MAGIC = "MTSI";
+static const uint32_t IRRCACHE_CACHE_VERSION = 2;
+
+void IrradianceCache::writeCache(const fs::path &filename, uint64_t hash) const {
+	std::vector<const Record *> records;
+	getRecords(records);
+
+	IrradianceCacheHeader header;
+	memcpy(header.magic, IRRCACHE_CACHE_MAGIC, 4);
+	header.version = IRRCACHE_CACHE_VERSION;
+	header.byteOrder = (uint32_t) Stream::getHostByteOrder();
+	header.recordSize = (uint32_t) sizeof(Record);
+	header.hash = hash;
+	header.recordCount = records.size();
+	header.aabb = m_octree.getAABB();
+	header.kappa = m_kappa;
+	header.clampScreen = m_clampScreen;
+	header.clampNeighbor = m_clampNeighbor;
+	header.useGradients = m_useGradients;
+
+	ref<MemoryMappedFile> mmap = new MemoryMappedFile(filename,
+		IrradianceCacheHeader::serializedSize + records.size() * sizeof(Record));
+	uint8_t *ptr = (uint8_t *) mmap->getData();
+	ref<MemoryStream> mstream = new MemoryStream(ptr, IrradianceCacheHeader::serializedSize);
+	mstream->setByteOrder(Stream::ELittleEndian);
+	header.serialize(mstream);
+	ptr += IrradianceCacheHeader::serializedSize;
+	for (size_t i=0; i<records.size(); ++i) {
+		memcpy(ptr, records[i], sizeof(Record));
+		ptr += sizeof(Record);
+	}
+
+	Log(EDebug, "Wrote an irradiance cache with " SIZE_T_FMT " records to \"%s\" (%s)",
+		records.size(), filename.string().c_str(), memString(mmap->getSize()).c_str());
+}
+
+ref<IrradianceCache> IrradianceCache::readCache(const fs::path &filename, uint64_t hash) {
+	if (!fs::exists(filename))
+		return NULL;
+
+	ref<MemoryMappedFile> mmap = new MemoryMappedFile(filename);
+	uint8_t *ptr = (uint8_t *) mmap->getData();
+	if (mmap->getSize() < IrradianceCacheHeader::serializedSize) {
+		Log(EWarn, "Irradiance cache \"%s\" is truncated, ignoring it",
+			filename.string().c_str());
+		return NULL;
+	}
+	ref<MemoryStream> mstream = new MemoryStream(ptr, IrradianceCacheHeader::serializedSize);
+	mstream->setByteOrder(Stream::ELittleEndian);
+	IrradianceCacheHeader header(mstream);
+
+	if (memcmp(header.magic, IRRCACHE_CACHE_MAGIC, 4) != 0
+		|| header.version != IRRCACHE_CACHE_VERSION
+		|| header.byteOrder != (uint32_t) Stream::getHostByteOrder()
+		|| header.recordSize != sizeof(Record)) {
+		Log(EWarn, "Irradiance cache \"%s\" was created by an incompatible "
+			"build, ignoring it", filename.string().c_str());
+		return NULL;
+	}
+
+	if (header.hash != hash) {
+		Log(EInfo, "Irradiance cache \"%s\" is out of date, ignoring it",
+			filename.string().c_str());
+		return NULL;
+	}
+
+	size_t recordCount = (size_t) header.recordCount;
+	if (mmap->getSize() != IrradianceCacheHeader::serializedSize + recordCount * sizeof(Record)) {
+		Log(EWarn, "Irradiance cache \"%s\" is truncated, ignoring it",
+			filename.string().c_str());
+		return NULL;
+	}
+
+	ref<IrradianceCache> cache = new IrradianceCache(header.aabb);
+	cache->m_kappa = header.kappa;
+	cache->m_clampScreen = header.clampScreen != 0;
+	cache->m_clampNeighbor = header.clampNeighbor != 0;
+	cache->m_useGradients = header.useGradients != 0;
+	cache->m_records.reserve(recordCount);
+
+	const Record *records = (const Record *) (ptr + IrradianceCacheHeader::serializedSize);
+	for (size_t i=0; i<recordCount; ++i)
+		cache->insert(new Record(&records[i]));
+
+	Log(EDebug, "Loaded " SIZE_T_FMT " irradiance records from the cache \"%s\"",
+		recordCount, filename.string().c_str());
+	return cache;
 }
 
 IrradianceCache::Record *IrradianceCache::put(const RayDifferential &ray, const Intersection &its,
@@ -348,8 +533,30 @@ void IrradianceCache::insert(Record *record) {
 		record->p-Vector(1,1,1)*validRadius,
 		record->p+Vector(1,1,1)*validRadius
 	));
-	LockGuard lock(m_mutex);
-	m_records.push_back(record);
+
+	/* The octree supports concurrent insertion. To avoid contention on
+	   the mutex, the record list is updated in batches from per-thread
+	   staging buffers. Each buffer has its own lock so that readers
+	   (which acquire m_mutex first) never observe a partial append */
+	StagingBuffer *&buffer = m_staging.get();
+	if (EXPECT_NOT_TAKEN(buffer == NULL)) {
+		buffer = new StagingBuffer();
+		buffer->records.reserve(IRRCACHE_BATCH_SIZE);
+		LockGuard lock(m_mutex);
+		m_stagingBuffers.push_back(buffer);
+	}
+
+	if (buffer->records.size() + 1 < IRRCACHE_BATCH_SIZE) {
+		LockGuard bufferLock(buffer->mutex);
+		buffer->records.push_back(record);
+	} else {
+		LockGuard lock(m_mutex);
+		LockGuard bufferLock(buffer->mutex);
+		m_records.insert(m_records.end(), buffer->records.begin(),
+			buffer->records.end());
+		m_records.push_back(record);
+		buffer->records.clear();
+	}
 }
 
 static StatsCounter irradHits("Irradiance cache", "Hits");
@@ -373,7 +580,7 @@ bool IrradianceCache::get(const Intersection &its, Spectrum &E) const {
 std::string IrradianceCache::toString() const {
 	std::ostringstream oss;
 	oss << "IrradianceCache[" << endl
-		<< "  records = " << m_records.size() << "," << endl
+		<< "  records = " << size() << "," << endl
 		<< "  quality = " << m_kappa << "," << endl
 		<< "  sceneSize = " << m_sceneSize << "," << endl
 		<< "  clampScreen = " << m_clampScreen << "," << endl
@@ -19,6 +19,9 @@
 #include <mitsuba/render/photonmap.h>
 #include <mitsuba/render/scene.h>
 #include <mitsuba/render/phase.h>
+#include <mitsuba/core/atomic.h>
+#include <mitsuba/core/mmap.h>
+#include <mitsuba/core/mstream.h>
 #include <fstream>
 
 MTS_NAMESPACE_BEGIN
@@ -55,6 +58,139 @@ void PhotonMap::serialize(Stream *stream, InstanceManager *manager) const {
 PhotonMap::~PhotonMap() {
 }
 
+/**
+ * \brief Header of a photon map cache file created by \ref PhotonMap::writeCache()
+ *
+ * The header is written field by field in little endian byte order. The
+ * photon records that follow it are stored in the host's native layout,
+ * which is why the byte order of the writing host is recorded as well.
+ */
+struct PhotonMapCacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t photonSize;
+	uint64_t hash;
+	uint64_t photonCount;
+	uint64_t depth;
+	AABB aabb;
+	Float scale;
+
+	/// Size of the serialized header in bytes
+	static const size_t serializedSize = 4 * sizeof(char)
+		+ 3 * sizeof(uint32_t) + 3 * sizeof(uint64_t) + 7 * sizeof(Float);
+
+	inline PhotonMapCacheHeader() : version(0), byteOrder(0), photonSize(0),
+		hash(0), photonCount(0), depth(0), scale(0) {
+		memset(magic, 0, sizeof(magic));
+	}
+
+	/// Unserialize a header from a binary data stream
+	inline PhotonMapCacheHeader(Stream *stream) {
+		stream->read(magic, sizeof(magic));
+		version = stream->readUInt();
+		byteOrder = stream->readUInt();
+		photonSize = stream->readUInt();
+		hash = stream->readULong();
+		photonCount = stream->readULong();
+		depth = stream->readULong();
+		aabb = AABB(stream);
+		scale = stream->readFloat();
+	}
+
+	/// Serialize the header to a binary data stream
+	inline void serialize(Stream *stream) const {
+		stream->write(magic, sizeof(magic));
+		stream->writeUInt(version);
+		stream->writeUInt(byteOrder);
+		stream->writeUInt(photonSize);
+		stream->writeULong(hash);
+		stream->writeULong(photonCount);
+		stream->writeULong(depth);
+		aabb.serialize(stream);
+		stream->writeFloat(scale);
+	}
+};
+
+static const char *PHOTONMAP_CACHE_MAGIC = "MTSP";
+static const uint32_t PHOTONMAP_CACHE_VERSION = 2;
+
+void PhotonMap::writeCache(const fs::path &filename, uint64_t hash) const {
+	PhotonMapCacheHeader header;
+	memcpy(header.magic, PHOTONMAP_CACHE_MAGIC, 4);
+	header.version = PHOTONMAP_CACHE_VERSION;
+	header.byteOrder = (uint32_t) Stream::getHostByteOrder();
+	header.photonSize = (uint32_t) sizeof(Photon);
+	header.hash = hash;
+	header.photonCount = m_kdtree.size();
+	header.depth = m_kdtree.getDepth();
+	header.aabb = m_kdtree.getAABB();
+	header.scale = m_scale;
+
+	size_t dataSize = m_kdtree.size() * sizeof(Photon);
+	ref<MemoryMappedFile> mmap = new MemoryMappedFile(filename,
+		PhotonMapCacheHeader::serializedSize + dataSize);
+	uint8_t *ptr = (uint8_t *) mmap->getData();
+	ref<MemoryStream> mstream = new MemoryStream(ptr, PhotonMapCacheHeader::serializedSize);
+	mstream->setByteOrder(Stream::ELittleEndian);
+	header.serialize(mstream);
+	if (dataSize > 0)
+		memcpy(ptr + PhotonMapCacheHeader::serializedSize, &m_kdtree[0], dataSize);
+
+	Log(EDebug, "Wrote a photon map cache to \"%s\" (%s)",
+		filename.string().c_str(), memString(mmap->getSize()).c_str());
+}
+
+ref<PhotonMap> PhotonMap::readCache(const fs::path &filename, uint64_t hash) {
+	if (!fs::exists(filename))
+		return NULL;
+
+	ref<MemoryMappedFile> mmap = new MemoryMappedFile(filename);
+	uint8_t *ptr = (uint8_t *) mmap->getData();
+	if (mmap->getSize() < PhotonMapCacheHeader::serializedSize) {
+		Log(EWarn, "Photon map cache \"%s\" is truncated, ignoring it",
+			filename.string().c_str());
+		return NULL;
+	}
+	ref<MemoryStream> mstream = new MemoryStream(ptr, PhotonMapCacheHeader::serializedSize);
+	mstream->setByteOrder(Stream::ELittleEndian);
+	PhotonMapCacheHeader header(mstream);
+
+	if (memcmp(header.magic, PHOTONMAP_CACHE_MAGIC, 4) != 0
+		|| header.version != PHOTONMAP_CACHE_VERSION
+		|| header.byteOrder != (uint32_t) Stream::getHostByteOrder()
+		|| header.photonSize != sizeof(Photon)) {
+		Log(EWarn, "Photon map cache \"%s\" was created by an incompatible "
+			"build, ignoring it", filename.string().c_str());
+		return NULL;
+	}
+
+	if (header.hash != hash) {
+		Log(EInfo, "Photon map cache \"%s\" is out of date, ignoring it",
+			filename.string().c_str());
+		return NULL;
+	}
+
+	size_t dataSize = (size_t) header.photonCount * sizeof(Photon);
+	if (mmap->getSize() != PhotonMapCacheHeader::serializedSize + dataSize) {
+		Log(EWarn, "Photon map cache \"%s\" is truncated, ignoring it",
+			filename.string().c_str());
+		return NULL;
+	}
+
+	ref<PhotonMap> photonMap = new PhotonMap();
+	photonMap->m_scale = header.scale;
+	photonMap->m_kdtree.resize((size_t) header.photonCount);
+	photonMap->m_kdtree.setDepth((size_t) header.depth);
+	photonMap->m_kdtree.setAABB(header.aabb);
+	if (dataSize > 0)
+		memcpy(&photonMap->m_kdtree[0], ptr + PhotonMapCacheHeader::serializedSize, dataSize);
+
+	Log(EDebug, "Loaded " SIZE_T_FMT " photons from the cache \"%s\"",
+		photonMap->size(), filename.string().c_str());
+	return photonMap;
+}
+
 std::string PhotonMap::toString() const {
 	std::ostringstream oss;
 	oss << "PhotonMap[" << endl
@@ -192,5 +328,81 @@ size_t PhotonMap::estimateRadianceRaw(const Intersection &its,
 	return count;
 }
 
+PhotonHashGrid::PhotonHashGrid()
+	: m_cellSize(0.0f), m_invCellSize(0.0f), m_tableMask(0) {
+}
+
+PhotonHashGrid::~PhotonHashGrid() {
+}
+
+void PhotonHashGrid::build(const PhotonMap *photonMap, Float cellSize) {
+	int photonCount = (int) photonMap->size();
+
+	m_photons.resize(photonCount);
+	m_cellSize = cellSize;
+	m_invCellSize = 1.0f / cellSize;
+	if (photonCount == 0) {
+		m_cellStarts.clear();
+		m_tableMask = 0;
+		return;
+	}
+
+	/* Cell coordinates are relative to an arbitrary photon, which
+	   avoids an extra pass to compute the bounding box */
+	m_origin = (*photonMap)[0].getPosition();
+
+	uint32_t tableSize = math::roundToPowerOfTwo((uint32_t) photonCount);
+	m_tableMask = tableSize - 1;
+	m_cellStarts.resize(tableSize + 1);
+	memset(&m_cellStarts[0], 0, m_cellStarts.size() * sizeof(uint32_t));
+
+	/* Determine the hash table entry of every photon and count
+	   how many photons fall into each entry */
+	std::vector<uint32_t> entries(photonCount);
+	#if defined(MTS_OPENMP)
+		#pragma omp parallel for
+	#endif
+	for (int i=0; i<photonCount; ++i) {
+		Point3i cell = getCell((*photonMap)[i].getPosition());
+		uint32_t entry = hash(cell.x, cell.y, cell.z);
+		entries[i] = entry;
+		atomicAdd((volatile int32_t *) &m_cellStarts[entry+1], 1);
+	}
+
+	/* Turn the counts into offsets */
+	for (uint32_t i=0; i<tableSize; ++i)
+		m_cellStarts[i+1] += m_cellStarts[i];
+
+	/* Scatter the photons into their final positions */
+	std::vector<uint32_t> cursor(m_cellStarts.begin(), m_cellStarts.end() - 1);
+	#if defined(MTS_OPENMP)
+		#pragma omp parallel for
+	#endif
+	for (int i=0; i<photonCount; ++i) {
+		uint32_t index = (uint32_t) atomicAdd(
+			(volatile int32_t *) &cursor[entries[i]], 1) - 1;
+		m_photons[index] = (*photonMap)[i];
+	}
+}
+
+size_t PhotonHashGrid::estimateRadianceRaw(const Intersection &its,
+		Float searchRadius, Spectrum &result, int maxDepth) const {
+	RawRadianceQuery query(its, maxDepth);
+	size_t count = executeQuery(its.p, searchRadius, query);
+	result = query.result;
+	return count;
+}
+
+std::string PhotonHashGrid::toString() const {
+	std::ostringstream oss;
+	oss << "PhotonHashGrid[" << endl
+		<< "  size = " << m_photons.size() << "," << endl
+		<< "  tableSize = " << getTableSize() << "," << endl
+		<< "  cellSize = " << m_cellSize << endl
+		<< "]";
+	return oss.str();
+}
+
 MTS_IMPLEMENT_CLASS_S(PhotonMap, false, SerializableObject)
+MTS_IMPLEMENT_CLASS(PhotonHashGrid, false, Object)
 MTS_NAMESPACE_END
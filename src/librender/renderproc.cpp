@@ -26,9 +26,12 @@ MTS_NAMESPACE_BEGIN
 class BlockRenderer : public WorkProcessor {
 public:
 	BlockRenderer(Bitmap::EPixelFormat pixelFormat, int channelCount, int blockSize,
-		int borderSize, bool warnInvalid) : m_pixelFormat(pixelFormat),
+		int borderSize, bool warnInvalid, bool variance, size_t sampleRangeStart,
+		size_t sampleRangeCount) : m_pixelFormat(pixelFormat),
 		m_channelCount(channelCount), m_blockSize(blockSize),
-		m_borderSize(borderSize), m_warnInvalid(warnInvalid) { }
+		m_borderSize(borderSize), m_warnInvalid(warnInvalid),
+		m_variance(variance), m_sampleRangeStart(sampleRangeStart),
+		m_sampleRangeCount(sampleRangeCount) { }
 
 	BlockRenderer(Stream *stream, InstanceManager *manager) {
 		m_pixelFormat = (Bitmap::EPixelFormat) stream->readInt();
@@ -36,6 +39,9 @@ public:
 		m_blockSize = stream->readInt();
 		m_borderSize = stream->readInt();
 		m_warnInvalid = stream->readBool();
+		m_variance = stream->readBool();
+		m_sampleRangeStart = stream->readSize();
+		m_sampleRangeCount = stream->readSize();
 	}
 
 	ref<WorkUnit> createWorkUnit() const {
@@ -43,10 +49,12 @@ public:
 	}
 
 	ref<WorkResult> createWorkResult() const {
-		return new ImageBlock(m_pixelFormat,
+		ref<ImageBlock> block = new ImageBlock(m_pixelFormat,
 			Vector2i(m_blockSize),
 			m_sensor->getFilm()->getReconstructionFilter(),
 			m_channelCount, m_warnInvalid);
+		block->setVarianceTracking(m_variance);
+		return block.get();
 	}
 
 	void prepare() {
@@ -76,6 +84,7 @@ public:
 
 		block->setOffset(rect->getOffset());
 		block->setSize(rect->getSize());
+		m_sampler->setSampleRange(m_sampleRangeStart, m_sampleRangeCount);
 		m_hilbertCurve.initialize(TVector2<uint8_t>(rect->getSize()));
 		m_integrator->renderBlock(m_scene, m_sensor, m_sampler,
 			block, stop, m_hilbertCurve.getPoints());
@@ -91,11 +100,15 @@ public:
 		stream->writeInt(m_blockSize);
 		stream->writeInt(m_borderSize);
 		stream->writeBool(m_warnInvalid);
+		stream->writeBool(m_variance);
+		stream->writeSize(m_sampleRangeStart);
+		stream->writeSize(m_sampleRangeCount);
 	}
 
 	ref<WorkProcessor> clone() const {
 		return new BlockRenderer(m_pixelFormat, m_channelCount,
-			m_blockSize, m_borderSize, m_warnInvalid);
+			m_blockSize, m_borderSize, m_warnInvalid, m_variance,
+			m_sampleRangeStart, m_sampleRangeCount);
 	}
 
 	MTS_DECLARE_CLASS()
@@ -111,6 +124,8 @@ private:
 	int m_blockSize;
 	int m_borderSize;
 	bool m_warnInvalid;
+	bool m_variance;
+	size_t m_sampleRangeStart, m_sampleRangeCount;
 	HilbertCurve2D<uint8_t> m_hilbertCurve;
 };
 
@@ -121,6 +136,8 @@ BlockedRenderProcess::BlockedRenderProcess(const RenderJob *parent, RenderQueue
 	m_pixelFormat = Bitmap::ESpectrumAlphaWeight;
 	m_channelCount = -1;
 	m_warnInvalid = true;
+	m_sampleRangeStart = 0;
+	m_sampleRangeCount = std::numeric_limits<size_t>::max();
 }
 
 BlockedRenderProcess::~BlockedRenderProcess() {
@@ -134,15 +151,28 @@ void BlockedRenderProcess::setPixelFormat(Bitmap::EPixelFormat pixelFormat, int
 	m_warnInvalid = warnInvalid;
 }
 
+void BlockedRenderProcess::setVarianceBuffer(Bitmap *variance) {
+	m_variance = variance;
+}
+
+void BlockedRenderProcess::setSampleRange(size_t start, size_t count) {
+	m_sampleRangeStart = start;
+	m_sampleRangeCount = count;
+}
+
 ref<WorkProcessor> BlockedRenderProcess::createWorkProcessor() const {
 	return new BlockRenderer(m_pixelFormat, m_channelCount,
-			m_blockSize, m_borderSize, m_warnInvalid);
+			m_blockSize, m_borderSize, m_warnInvalid, m_variance.get() != NULL,
+			m_sampleRangeStart, m_sampleRangeCount);
 }
 
 void BlockedRenderProcess::processResult(const WorkResult *result, bool cancelled) {
 	const ImageBlock *block = static_cast<const ImageBlock *>(result);
 	UniqueLock lock(m_resultMutex);
 	m_film->put(block);
+	if (m_variance && block->hasVariance())
+		m_variance->accumulate(block->getVarianceBitmap(), Point2i(0),
+			block->getOffset(), block->getSize());
 	m_progress->update(++m_resultCount);
 	lock.unlock();
 	m_queue->signalWorkEnd(m_parent, block, cancelled);
@@ -21,10 +21,12 @@
 MTS_NAMESPACE_BEGIN
 
 Sampler::Sampler(const Properties &props)
- : ConfigurableObject(props), m_sampleCount(0), m_sampleIndex(0) { }
+ : ConfigurableObject(props), m_sampleCount(0), m_sampleIndex(0),
+   m_sampleRangeStart(0), m_sampleRangeEnd(std::numeric_limits<size_t>::max()) { }
 
 Sampler::Sampler(Stream *stream, InstanceManager *manager)
- : ConfigurableObject(stream, manager) {
+ : ConfigurableObject(stream, manager), m_sampleIndex(0),
+   m_sampleRangeStart(0), m_sampleRangeEnd(std::numeric_limits<size_t>::max()) {
 	m_sampleCount = stream->readSize();
 	size_t n1DArrays = stream->readSize();
 	for (size_t i=0; i<n1DArrays; ++i)
@@ -79,6 +81,10 @@ void Sampler::request2DArray(size_t size) {
 	m_sampleArrays2D.push_back(new Point2[m_sampleCount * size]);
 }
 
+bool Sampler::generate2DBlock(Point2 *, size_t) {
+	return false;
+}
+
 Point2 *Sampler::next2DArray(size_t size) {
 	Assert(m_sampleIndex < m_sampleCount);
 	if (m_dimension2DArray < m_req2D.size()) {
@@ -20,9 +20,13 @@
 #include <mitsuba/render/renderjob.h>
 #include <mitsuba/core/plugin.h>
 #include <mitsuba/core/statistics.h>
+#include <mitsuba/core/mstream.h>
 
 #define DEFAULT_BLOCKSIZE 32
 
+/* Minimum number of instances to collect them in a separate BVH */
+#define DEFAULT_INSTANCE_BVH_THRESHOLD 1024
+
 MTS_NAMESPACE_BEGIN
 
 // ===========================================================================
@@ -30,15 +34,25 @@ MTS_NAMESPACE_BEGIN
 // ===========================================================================
 
 Scene::Scene()
- : NetworkedObject(Properties()), m_blockSize(DEFAULT_BLOCKSIZE) {
+ : NetworkedObject(Properties()),
+   m_instanceBVHThreshold(DEFAULT_INSTANCE_BVH_THRESHOLD),
+   m_blockSize(DEFAULT_BLOCKSIZE), m_incremental(false), m_dirty(false), m_rebuild(false) {
 	m_kdtree = new ShapeKDTree();
 	m_sourceFile = new fs::path();
 	m_destinationFile = new fs::path();
 }
 
 Scene::Scene(const Properties &props)
- : NetworkedObject(props), m_blockSize(DEFAULT_BLOCKSIZE) {
+ : NetworkedObject(props), m_blockSize(DEFAULT_BLOCKSIZE), m_dirty(false),
+   m_rebuild(false) {
 	m_kdtree = new ShapeKDTree();
+	/* Keep a separate kd-tree per shape, so that individual shapes can
+	   be moved, added or removed without a full rebuild */
+	m_incremental = props.getBoolean("incremental", false);
+	/* Scenes with at least this many instances place them into a separate
+	   BVH, which is much faster to build and can be refit after updates */
+	m_instanceBVHThreshold = props.getSize("instanceBVHThreshold",
+		DEFAULT_INSTANCE_BVH_THRESHOLD);
 	/* kd-tree construction: Enable primitive clipping? Generally leads to a
 	  significant improvement of the resulting tree. */
 	if (props.hasProperty("kdClip"))
@@ -101,10 +115,18 @@ Scene::Scene(Scene *scene) : NetworkedObject(Properties()) {
 	m_specialShapes = scene->m_specialShapes;
 	m_degenerateSensor = scene->m_degenerateSensor;
 	m_degenerateEmitters = scene->m_degenerateEmitters;
+	m_instances = scene->m_instances;
+	m_instanceBVH = scene->m_instanceBVH;
+	m_instanceBVHBounds = scene->m_instanceBVHBounds;
+	m_instanceBVHThreshold = scene->m_instanceBVHThreshold;
+	m_incremental = scene->m_incremental;
+	m_dirty = scene->m_dirty;
+	m_rebuild = scene->m_rebuild;
 }
 
 Scene::Scene(Stream *stream, InstanceManager *manager)
- : NetworkedObject(stream, manager) {
+ : NetworkedObject(stream, manager), m_instanceBVHThreshold(DEFAULT_INSTANCE_BVH_THRESHOLD),
+   m_incremental(false), m_dirty(false), m_rebuild(false) {
 	m_kdtree = new ShapeKDTree();
 	m_kdtree->setQueryCost(stream->readFloat());
 	m_kdtree->setTraversalCost(stream->readFloat());
@@ -342,9 +364,12 @@ void Scene::initialize() {
 		}
 
 		/* Build the kd-tree */
-		m_kdtree->build();
+		buildKDTree(m_kdtree);
 
 		m_aabb = m_kdtree->getAABB();
+		m_dirty = m_rebuild = false;
+	} else if (m_dirty) {
+		rebuildKDTree();
 	}
 
 	/* Make sure that there are no duplicates */
@@ -586,9 +611,228 @@ void Scene::addShape(Shape *shape) {
 		if (shape->getClass()->derivesFrom(MTS_CLASS(TriMesh)))
 			m_meshes.push_back(static_cast<TriMesh *>(shape));
 
-		m_kdtree->addShape(shape);
-		m_shapes.push_back(shape);
+		if (m_incremental)
+			m_shapes.push_back(createInstance(shape));
+		else
+			m_shapes.push_back(shape);
+	}
+}
+
+ref<Shape> Scene::createInstance(Shape *shape) {
+	const Class *cClass = shape->getClass();
+	if (shape->isEmitter() || shape->isSensor() || shape->hasSubsurface()
+		|| cClass->getName() == "ShapeGroup" || cClass->getName() == "Instance"
+		|| !shape->getAABB().isValid())
+		return shape;
+
+	PluginManager *pluginManager = PluginManager::getInstance();
+	ref<Shape> group = static_cast<Shape *> (pluginManager->createObject(
+		MTS_CLASS(Shape), Properties("shapegroup")));
+	group->addChild(shape);
+	group->configure();
+
+	ref<Shape> instance = static_cast<Shape *> (pluginManager->createObject(
+		MTS_CLASS(Shape), Properties("instance")));
+	instance->addChild(group);
+	instance->configure();
+
+	m_instances[shape] = instance;
+	return instance;
+}
+
+Shape *Scene::getTopLevelShape(Shape *shape) {
+	std::map<const Shape *, Shape *>::iterator it = m_instances.find(shape);
+	if (it != m_instances.end())
+		return it->second;
+	return m_shapes.contains(shape) ? shape : NULL;
+}
+
+void Scene::setShapeTransform(Shape *shape, const AnimatedTransform *trafo) {
+	Shape *topLevel = getTopLevelShape(shape);
+	if (topLevel == NULL || topLevel->getClass()->getName() != "Instance")
+		Log(EError, "setShapeTransform(): the shape \"%s\" is not instanced. Set the "
+			"scene's 'incremental' parameter before initialization to move it.",
+			shape->getName().c_str());
+	topLevel->setWorldTransform(trafo);
+	m_dirty = true;
+}
+
+void Scene::setShapeTransform(Shape *shape, const Transform &trafo) {
+	setShapeTransform(shape, new AnimatedTransform(trafo));
+}
+
+void Scene::insertShape(Shape *shape) {
+	if (!m_kdtree->isBuilt()) {
+		/* Not initialized yet -- initialize() will take care of it */
+		addChild(shape);
+		return;
+	}
+	if (shape->isEmitter() || shape->isSensor() || shape->hasSubsurface())
+		Log(EError, "insertShape(): shapes with attached emitters, sensors "
+			"or subsurface integrators require a full re-initialization");
+	addShape(shape);
+	m_dirty = m_rebuild = true;
+}
+
+void Scene::removeShape(Shape *shape) {
+	ref<Shape> topLevel = getTopLevelShape(shape);
+	if (topLevel == NULL)
+		Log(EError, "removeShape(): the shape \"%s\" is not part of the scene",
+			shape->getName().c_str());
+	if (shape->isEmitter() || shape->isSensor() || shape->hasSubsurface())
+		Log(EError, "removeShape(): shapes with attached emitters, sensors "
+			"or subsurface integrators require a full re-initialization");
+
+	m_shapes.erase(std::remove(m_shapes.begin(), m_shapes.end(), topLevel), m_shapes.end());
+	m_meshes.erase(std::remove(m_meshes.begin(), m_meshes.end(), shape), m_meshes.end());
+	m_instances.erase(shape);
+	m_dirty = m_rebuild = true;
+}
+
+void Scene::update() {
+	if (!m_dirty)
+		return;
+
+	/* When only instances moved, refitting their BVH suffices as long as it
+	   stays within the region where the kd-tree expects to find it */
+	if (!m_rebuild && m_instanceBVH != NULL) {
+		m_instanceBVH->refit();
+		if (m_instanceBVHBounds.contains(m_instanceBVH->getAABB()))
+			m_dirty = false;
+	}
+
+	if (m_dirty)
+		rebuildKDTree();
+	initializeBidirectional();
+}
+
+void Scene::rebuildKDTree() {
+	ref<ShapeKDTree> kdtree = new ShapeKDTree();
+	kdtree->setQueryCost(m_kdtree->getQueryCost());
+	kdtree->setTraversalCost(m_kdtree->getTraversalCost());
+	kdtree->setEmptySpaceBonus(m_kdtree->getEmptySpaceBonus());
+	kdtree->setStopPrims(m_kdtree->getStopPrims());
+	kdtree->setClip(m_kdtree->getClip());
+	kdtree->setMaxDepth(m_kdtree->getMaxDepth());
+	kdtree->setExactPrimitiveThreshold(m_kdtree->getExactPrimitiveThreshold());
+	kdtree->setParallelBuild(m_kdtree->getParallelBuild());
+	kdtree->setRetract(m_kdtree->getRetract());
+	kdtree->setMaxBadRefines(m_kdtree->getMaxBadRefines());
+	/* This happens on every interactive update -- don't flood the log */
+	kdtree->setLogLevel(EDebug);
+
+	buildKDTree(kdtree);
+
+	m_kdtree = kdtree;
+	m_aabb = m_kdtree->getAABB();
+	m_dirty = m_rebuild = false;
+}
+
+void Scene::buildKDTree(ShapeKDTree *kdtree) {
+	size_t instanceCount = 0;
+	for (size_t i=0; i<m_shapes.size(); ++i) {
+		if (m_shapes[i]->getClass()->getName() == "Instance")
+			++instanceCount;
 	}
+
+	m_instanceBVH = NULL;
+	if (instanceCount > 0 && instanceCount >= m_instanceBVHThreshold) {
+		m_instanceBVH = new InstanceBVH();
+
+		/* Bound moving instances separately for parts of the shutter interval */
+		if (m_sensor && m_sensor->needsTimeSample())
+			m_instanceBVH->setTimeRange(m_sensor->getShutterOpen(),
+				m_sensor->getShutterOpen() + m_sensor->getShutterOpenTime());
+	}
+
+	for (size_t i=0; i<m_shapes.size(); ++i) {
+		Shape *shape = m_shapes[i];
+		if (m_instanceBVH && shape->getClass()->getName() == "Instance")
+			m_instanceBVH->addShape(shape);
+		else
+			kdtree->addShape(shape);
+	}
+
+	if (m_instanceBVH) {
+		m_instanceBVH->build();
+		m_instanceBVHBounds = m_instanceBVH->getAABB();
+		if (m_instanceBVHBounds.isValid())
+			kdtree->addShape(m_instanceBVH);
+	}
+
+	kdtree->build();
+}
+
+/// Hash a shape along with its material, geometry and instanced contents
+static uint64_t hashShape(const Shape *shape, uint64_t hash) {
+	std::string str = shape->toString();
+	if (shape->getBSDF())
+		str += shape->getBSDF()->toString();
+	hash = hashBuffer(str.c_str(), str.length(), hash);
+
+	/* The string representation of a mesh does not cover its contents */
+	if (shape->getClass()->derivesFrom(MTS_CLASS(TriMesh))) {
+		const TriMesh *mesh = static_cast<const TriMesh *>(shape);
+		size_t vertexCount = mesh->getVertexCount();
+		hash = hashBuffer(mesh->getVertexPositions(),
+			vertexCount * sizeof(Point), hash);
+		hash = hashBuffer(mesh->getTriangles(),
+			mesh->getTriangleCount() * sizeof(Triangle), hash);
+
+		if (mesh->hasVertexNormals() && vertexCount > 0) {
+			std::vector<Normal> normals(vertexCount);
+			for (size_t i=0; i<vertexCount; ++i)
+				normals[i] = mesh->getVertexNormal((uint32_t) i);
+			hash = hashBuffer(&normals[0], vertexCount * sizeof(Normal), hash);
+		}
+
+		if (mesh->hasVertexTexcoords() && vertexCount > 0) {
+			std::vector<Point2> uvs(vertexCount);
+			for (size_t i=0; i<vertexCount; ++i)
+				uvs[i] = mesh->getVertexTexcoord((uint32_t) i);
+			hash = hashBuffer(&uvs[0], vertexCount * sizeof(Point2), hash);
+		}
+	}
+
+	/* Instances: hash the keyframes of the transformation and the group */
+	const AnimatedTransform *trafo = shape->getWorldTransform();
+	if (trafo) {
+		ref<MemoryStream> mstream = new MemoryStream();
+		trafo->serialize(mstream);
+		hash = hashBuffer(mstream->getData(), mstream->getSize(), hash);
+	}
+
+	if (shape->getShapeGroup())
+		hash = hashShape(shape->getShapeGroup(), hash);
+
+	if (shape->getClass()->getName() == "ShapeGroup") {
+		const std::vector<const Shape *> &shapes =
+			static_cast<const ShapeKDTree *>(shape->getKDTree())->getShapes();
+		for (size_t i=0; i<shapes.size(); ++i)
+			hash = hashShape(shapes[i], hash);
+	}
+
+	return hash;
+}
+
+uint64_t Scene::computeContentHash() const {
+	size_t shapeCount = m_shapes.size();
+	uint64_t hash = hashBuffer(&shapeCount, sizeof(size_t));
+
+	for (size_t i=0; i<shapeCount; ++i)
+		hash = hashShape(m_shapes[i].get(), hash);
+
+	for (size_t i=0; i<m_emitters.size(); ++i) {
+		std::string str = m_emitters[i]->toString();
+		hash = hashBuffer(str.c_str(), str.length(), hash);
+	}
+
+	for (size_t i=0; i<m_media.size(); ++i) {
+		std::string str = m_media[i]->toString();
+		hash = hashBuffer(str.c_str(), str.length(), hash);
+	}
+
+	return hash;
 }
 
 std::string Scene::toString() const {
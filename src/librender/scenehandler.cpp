@@ -31,14 +31,22 @@
 #include <mitsuba/render/scenehandler.h>
 #include <mitsuba/core/fresolver.h>
 #include <mitsuba/render/scene.h>
+#include <mitsuba/core/lock.h>
+#include <mitsuba/core/fstream.h>
 #include <boost/algorithm/string.hpp>
 #include <boost/unordered_set.hpp>
+#include <deque>
+#include <set>
 
 MTS_NAMESPACE_BEGIN
 XERCES_CPP_NAMESPACE_USE
 
 #define TRANSCODE_BLOCKSIZE 2048
 
+/* Identifier and version of binary scene cache files */
+#define MTS_SCENECACHE_HEADER  0x0C5C
+#define MTS_SCENECACHE_VERSION 1
+
 #define XMLLog(level, fmt, ...) Thread::getThread()->getLogger()->log(\
 	level, NULL, __FILE__, __LINE__, "In file \"%s\" (near line %i): " fmt, \
 	m_locator ? transcode(m_locator->getSystemId()).c_str() : "<unknown>", \
@@ -49,9 +57,318 @@ typedef void (*CleanupFun) ();
 typedef boost::unordered_set<CleanupFun> CleanupSet;
 static PrimitiveThreadLocal<CleanupSet> __cleanup_tls;
 
+/// Call the cleanup handlers that were registered by the current thread
+static void runSceneCleanupHandlers() {
+	CleanupSet &cleanup = __cleanup_tls.get();
+	for (CleanupSet::iterator it = cleanup.begin();
+			it != cleanup.end(); ++it)
+		(*it)();
+	cleanup.clear();
+}
+
+bool SceneHandler::m_parallelLoading = true;
+
+/**
+ * An object whose construction (which includes loading its data
+ * from disk) has been handed to a worker thread. Attaching children
+ * and calling configure() happens on the parser thread once the
+ * object is needed.
+ */
+class SceneHandler::DeferredObject : public Object {
+public:
+	DeferredObject(const Class *cls, const Properties &properties)
+		: cls(cls), props(properties), constructionTime(0),
+		  finished(false), done(new WaitFlag()) {
+		/* Objects that load the same file are not constructed
+		   concurrently (e.g. to avoid racing on MIP map caches) */
+		if (properties.hasProperty("filename"))
+			key = properties.getAsString("filename");
+	}
+
+	/// Construct the object (called by a worker thread)
+	void construct() {
+		ref<Timer> timer = new Timer();
+		try {
+			result = PluginManager::getInstance()->createObject(cls, props);
+		} catch (const std::exception &ex) {
+			error = ex.what();
+		}
+		constructionTime = timer->getSeconds();
+		done->set(true);
+	}
+
+	/* Set up when the object is submitted */
+	const Class *cls;
+	Properties props;
+	std::string key, name, id, location;
+	std::vector<std::pair<std::string, ConfigurableObject *> > children;
+
+	/* Written by the worker thread */
+	ref<ConfigurableObject> result;
+	std::string error;
+	Float constructionTime;
+
+	/// Set once the parser thread has configured the object
+	bool finished;
+	ref<WaitFlag> done;
+};
+
+/**
+ * Queue of deferred objects, which is processed by up to \c threadCount
+ * worker threads. Workers are started on demand and exit once they run
+ * out of work, hence an abandoned parse never leaves idle threads behind.
+ */
+class SceneHandler::WorkerPool : public Object {
+public:
+	WorkerPool(int threadCount) : m_threadCount(threadCount),
+		m_running(0), m_mutex(new Mutex()) { }
+
+	void submit(DeferredObject *obj) {
+		LockGuard lock(m_mutex);
+		m_queue.push_back(obj);
+		if (m_running < m_threadCount) {
+			++m_running;
+			ref<Worker> worker = new Worker(this);
+			worker->start();
+			worker->detach();
+		}
+	}
+
+	inline int getThreadCount() const { return m_threadCount; }
+
+private:
+	class Worker : public Thread {
+	public:
+		Worker(WorkerPool *pool) : Thread("load"), m_pool(pool) { }
+
+		void run() {
+			ref<DeferredObject> obj;
+			while ((obj = m_pool->next(obj)) != NULL)
+				obj->construct();
+
+			/* Release thread-local caches of the loaders */
+			runSceneCleanupHandlers();
+		}
+	private:
+		ref<WorkerPool> m_pool;
+	};
+
+	/// Mark \c prev as completed and fetch the next unit of work
+	ref<DeferredObject> next(DeferredObject *prev) {
+		LockGuard lock(m_mutex);
+		if (prev && !prev->key.empty())
+			m_active.erase(prev->key);
+
+		for (std::deque<ref<DeferredObject> >::iterator it = m_queue.begin();
+				it != m_queue.end(); ++it) {
+			ref<DeferredObject> obj = *it;
+			if (!obj->key.empty()) {
+				if (m_active.find(obj->key) != m_active.end())
+					continue;
+				m_active.insert(obj->key);
+			}
+			m_queue.erase(it);
+			return obj;
+		}
+
+		/* Anything left in the queue is blocked by an object that
+		   another worker is constructing -- that worker will pick it up */
+		--m_running;
+		return NULL;
+	}
+
+	int m_threadCount, m_running;
+	ref<Mutex> m_mutex;
+	std::deque<ref<DeferredObject> > m_queue;
+	std::set<std::string> m_active;
+};
+
+/**
+ * Recorded sequence of the elements in a scene description and in the
+ * files that it includes. Attributes are stored before the substitution
+ * of parameters, which is performed again when the elements are replayed.
+ *
+ * On disk, all strings are kept in a table that is referenced by index.
+ */
+class SceneHandler::SceneCache : public Object {
+public:
+	enum EEventType {
+		EStartTag = 0,
+		EEndTag,
+		EIncludeBegin,
+		EIncludeEnd
+	};
+
+	struct Event {
+		uint8_t type;
+		std::string name;
+		AttributeVector attributes;
+	};
+
+	SceneCache() : m_cursor(0) { }
+
+	void append(EEventType type, const std::string &name,
+			const AttributeVector &attributes = AttributeVector()) {
+		m_events.push_back(Event());
+		Event &event = m_events.back();
+		event.type = (uint8_t) type;
+		event.name = name;
+		event.attributes = attributes;
+	}
+
+	inline void addSourceFile(const fs::path &path) { m_files.push_back(path); }
+
+	inline void setParameters(const ParameterMap &params) { m_params = params; }
+
+	/// Return the next recorded event, or \c NULL at the end
+	inline const Event *next() {
+		return m_cursor < m_events.size() ? &m_events[m_cursor++] : NULL;
+	}
+
+	/// Consume the next event and verify that it has the expected type and name
+	void expect(EEventType type, const std::string &name) {
+		const Event *event = next();
+		if (!event || event->type != type || event->name != name)
+			SLog(EError, "The scene cache is inconsistent!");
+	}
+
+	void save(const fs::path &filename) const {
+		/* Build the string table */
+		std::map<std::string, uint32_t> indices;
+		std::vector<const std::string *> strings;
+		for (size_t i=0; i<m_events.size(); ++i) {
+			const Event &event = m_events[i];
+			addString(indices, strings, event.name);
+			for (size_t j=0; j<event.attributes.size(); ++j) {
+				addString(indices, strings, event.attributes[j].first);
+				addString(indices, strings, event.attributes[j].second);
+			}
+		}
+
+		/* Write to a uniquely named file in the same directory and rename it
+		   afterwards, since several processes may load the same scene */
+		fs::path tempFile = filename.string()
+			+ fs::unique_path(".%%%%-%%%%-%%%%-%%%%.tmp").string();
+		{
+			ref<FileStream> stream = new FileStream(tempFile, FileStream::ETruncWrite);
+			stream->setByteOrder(Stream::ELittleEndian);
+			stream->writeShort(MTS_SCENECACHE_HEADER);
+			stream->writeShort(MTS_SCENECACHE_VERSION);
+			stream->writeString(MTS_VERSION);
+
+			stream->writeUInt((uint32_t) m_params.size());
+			for (ParameterMap::const_iterator it = m_params.begin(); it != m_params.end(); ++it) {
+				stream->writeString(it->first);
+				stream->writeString(it->second);
+			}
+
+			stream->writeUInt((uint32_t) m_files.size());
+			for (size_t i=0; i<m_files.size(); ++i) {
+				stream->writeString(m_files[i].string());
+				stream->writeLong((int64_t) fs::last_write_time(m_files[i]));
+				stream->writeULong((uint64_t) fs::file_size(m_files[i]));
+			}
+
+			stream->writeUInt((uint32_t) strings.size());
+			for (size_t i=0; i<strings.size(); ++i)
+				stream->writeString(*strings[i]);
+
+			stream->writeUInt((uint32_t) m_events.size());
+			for (size_t i=0; i<m_events.size(); ++i) {
+				const Event &event = m_events[i];
+				stream->writeUChar(event.type);
+				stream->writeUInt(indices[event.name]);
+				stream->writeUInt((uint32_t) event.attributes.size());
+				for (size_t j=0; j<event.attributes.size(); ++j) {
+					stream->writeUInt(indices[event.attributes[j].first]);
+					stream->writeUInt(indices[event.attributes[j].second]);
+				}
+			}
+			stream->close();
+		}
+		fs::rename(tempFile, filename);
+	}
+
+	/**
+	 * \brief Load a cache file
+	 *
+	 * \return \c false if the file was created by a different version of
+	 *    Mitsuba, for a different scene file or set of parameters, or when
+	 *    one of the source files has been modified since.
+	 */
+	bool load(const fs::path &filename, const fs::path &sceneFile, const ParameterMap &params) {
+		ref<FileStream> stream = new FileStream(filename, FileStream::EReadOnly);
+		stream->setByteOrder(Stream::ELittleEndian);
+
+		if (stream->getSize() < 2 * sizeof(short)
+			|| stream->readShort() != MTS_SCENECACHE_HEADER
+			|| stream->readShort() != MTS_SCENECACHE_VERSION
+			|| stream->readString() != MTS_VERSION)
+			return false;
+
+		m_params.clear();
+		uint32_t paramCount = stream->readUInt();
+		for (uint32_t i=0; i<paramCount; ++i) {
+			std::string name = stream->readString();
+			m_params[name] = stream->readString();
+		}
+		if (m_params != params)
+			return false;
+
+		m_files.resize(stream->readUInt());
+		for (size_t i=0; i<m_files.size(); ++i) {
+			m_files[i] = stream->readString();
+			int64_t timestamp = stream->readLong();
+			uint64_t size = stream->readULong();
+			if ((i == 0 && m_files[i] != sceneFile)
+				|| !fs::exists(m_files[i])
+				|| (int64_t) fs::last_write_time(m_files[i]) != timestamp
+				|| (uint64_t) fs::file_size(m_files[i]) != size) {
+				SLog(EInfo, "The scene cache \"%s\" is out of date",
+					filename.string().c_str());
+				return false;
+			}
+		}
+
+		std::vector<std::string> strings(stream->readUInt());
+		for (size_t i=0; i<strings.size(); ++i)
+			strings[i] = stream->readString();
+
+		m_events.resize(stream->readUInt());
+		for (size_t i=0; i<m_events.size(); ++i) {
+			Event &event = m_events[i];
+			event.type = stream->readUChar();
+			event.name = strings.at(stream->readUInt());
+			event.attributes.resize(stream->readUInt());
+			for (size_t j=0; j<event.attributes.size(); ++j) {
+				event.attributes[j].first = strings.at(stream->readUInt());
+				event.attributes[j].second = strings.at(stream->readUInt());
+			}
+		}
+		m_cursor = 0;
+		return true;
+	}
+
+private:
+	static void addString(std::map<std::string, uint32_t> &indices,
+			std::vector<const std::string *> &strings, const std::string &value) {
+		std::map<std::string, uint32_t>::iterator it = indices.find(value);
+		if (it == indices.end()) {
+			it = indices.insert(std::make_pair(value, (uint32_t) strings.size())).first;
+			strings.push_back(&it->first);
+		}
+	}
+
+	std::vector<Event> m_events;
+	size_t m_cursor;
+	std::vector<fs::path> m_files;
+	ParameterMap m_params;
+};
+
 SceneHandler::SceneHandler(const ParameterMap &params,
 	NamedObjectMap *namedObjects, bool isIncludedFile) : m_params(params),
-		m_namedObjects(namedObjects), m_isIncludedFile(isIncludedFile) {
+		m_namedObjects(namedObjects), m_isIncludedFile(isIncludedFile),
+		m_deferredNamed(&m_localDeferredNamed), m_stats(&m_localStats) {
 	m_pluginManager = PluginManager::getInstance();
 	m_locator = NULL;
 
@@ -159,17 +476,36 @@ std::string SceneHandler::transcode(const XMLCh * input) const {
 
 void SceneHandler::startDocument() {
 	clear();
+
+	/* Included files share the worker pool, the pending named objects
+	   and the statistics of their parent */
+	if (!m_isIncludedFile) {
+		m_localStats = LoadStatistics();
+		m_timer = new Timer();
+		if (m_parallelLoading && getCoreCount() > 1)
+			m_pool = new WorkerPool(getCoreCount());
+	}
 }
 
 void SceneHandler::endDocument() {
 	SAssert(m_scene != NULL);
+	if (!m_isIncludedFile)
+		SAssert(m_deferredNamed->empty());
 
 	/* Call cleanup handlers */
-	CleanupSet &cleanup = __cleanup_tls.get();
-	for (CleanupSet::iterator it = cleanup.begin();
-			it != cleanup.end(); ++it)
-		(*it)();
-	cleanup.clear();
+	runSceneCleanupHandlers();
+
+	if (!m_isIncludedFile) {
+		SLog(EInfo, "Scene loaded in %s: constructed %i objects (%i of them on up to %i "
+			"worker threads, %s in constructors), waited %s for workers, %s in configure()",
+			timeString(m_timer->getSeconds(), true).c_str(),
+			(int) m_stats->objectCount, (int) m_stats->deferredCount,
+			m_pool ? m_pool->getThreadCount() : 0,
+			timeString(m_stats->constructionTime, true).c_str(),
+			timeString(m_stats->waitTime, true).c_str(),
+			timeString(m_stats->configureTime, true).c_str());
+		m_pool = NULL;
+	}
 }
 
 void SceneHandler::characters(const XMLCh* const name,
@@ -196,7 +532,19 @@ Float SceneHandler::parseFloat(const std::string &name,
 
 void SceneHandler::startElement(const XMLCh* const xmlName,
 	AttributeList &xmlAttributes) {
-	std::string name = transcode(xmlName);
+	AttributeVector attributes(xmlAttributes.getLength());
+	for (size_t i=0; i<xmlAttributes.getLength(); i++) {
+		attributes[i].first = transcode(xmlAttributes.getName(i));
+		attributes[i].second = transcode(xmlAttributes.getValue(i));
+	}
+	processStartElement(transcode(xmlName), attributes);
+}
+
+void SceneHandler::processStartElement(const std::string &name,
+		const AttributeVector &attributes) {
+	if (m_recording)
+		m_recording->append(SceneCache::EStartTag, name, attributes);
+
 	TagMap::const_iterator it = m_tags.find(name);
 
 	if (it == m_tags.end())
@@ -205,8 +553,8 @@ void SceneHandler::startElement(const XMLCh* const xmlName,
 	const TagEntry &tag = it->second;
 	ParseContext context((name == "scene") ? NULL : &m_context.top(), tag.first);
 
-	for (size_t i=0; i<xmlAttributes.getLength(); i++) {
-		std::string attrValue = transcode(xmlAttributes.getValue(i));
+	for (size_t i=0; i<attributes.size(); i++) {
+		std::string attrValue = attributes[i].second;
 		if (attrValue.length() > 0 && attrValue.find('$') != attrValue.npos) {
 			for (ParameterMap::const_reverse_iterator it = m_params.rbegin(); it != m_params.rend(); ++it) {
 				std::string::size_type pos = 0;
@@ -220,7 +568,7 @@ void SceneHandler::startElement(const XMLCh* const xmlName,
 				XMLLog(EError, "The scene referenced an undefined parameter: \"%s\"", attrValue.c_str());
 		}
 
-		context.attributes[transcode(xmlAttributes.getName(i))] = attrValue;
+		context.attributes[attributes[i].first] = attrValue;
 	}
 
 	switch (tag.first) {
@@ -270,9 +618,107 @@ void pushSceneCleanupHandler(void (*cleanup)()) {
 	__cleanup_tls.get().insert(cleanup);
 }
 
+bool SceneHandler::isDeferrable(const TagEntry &tag, const Properties &props) const {
+	if (!m_pool)
+		return false;
+
+	const std::string &plugin = props.getPluginName();
+	if (tag.first == EShape) {
+		/* Shapes with an animated transformation are rewritten into instances */
+		if (props.hasProperty("toWorld") &&
+			props.getType("toWorld") == Properties::EAnimatedTransform)
+			return false;
+		return plugin == "obj" || plugin == "ply" || plugin == "serialized";
+	} else if (tag.first == ETexture) {
+		return plugin == "bitmap";
+	}
+	return false;
+}
+
+void SceneHandler::setupObject(ref<ConfigurableObject> &object, const std::string &name,
+		std::vector<std::pair<std::string, ConfigurableObject *> > &children) {
+	/* If the object has children, append them */
+	for (std::vector<std::pair<std::string, ConfigurableObject *> >
+			::iterator it = children.begin(); it != children.end(); ++it) {
+		if (it->second != NULL) {
+			object->addChild(it->first, it->second);
+			it->second->setParent(object);
+			it->second->decRef();
+		}
+	}
+	children.clear();
+
+	/* Don't configure a scene object if it is from an included file */
+	if (name != "include" && (!m_isIncludedFile || !object->getClass()->derivesFrom(MTS_CLASS(Scene)))) {
+		ref<Timer> timer = new Timer();
+		object->configure();
+		m_stats->configureTime += timer->getSeconds();
+	}
+}
+
+ConfigurableObject *SceneHandler::finishDeferred(DeferredObject *deferred) {
+	if (deferred->finished)
+		return deferred->result;
+
+	ref<Timer> timer = new Timer();
+	deferred->done->wait();
+	m_stats->waitTime += timer->getSeconds();
+	m_stats->constructionTime += deferred->constructionTime;
+
+	if (!deferred->error.empty())
+		SLog(EError, "%s: Error while creating object: %s",
+			deferred->location.c_str(), deferred->error.c_str());
+
+	setupObject(deferred->result, deferred->name, deferred->children);
+
+	/* Warn about unqueried properties */
+	std::vector<std::string> unq = deferred->props.getUnqueried();
+	for (unsigned int i=0; i<unq.size(); ++i)
+		SLog(EWarn, "%s: Unqueried attribute \"%s\" in element \"%s\"",
+			deferred->location.c_str(), unq[i].c_str(), deferred->name.c_str());
+
+	if (!deferred->id.empty()) {
+		/* As in endElement(), the parent receives the object itself,
+		   while references resolve to its expanded version */
+		ref<ConfigurableObject> object = deferred->result;
+		if (object->getClass()->derivesFrom(MTS_CLASS(Texture)))
+			object = static_cast<Texture *>(object.get())->expand();
+		(*m_namedObjects)[deferred->id] = object;
+		object->incRef();
+		m_deferredNamed->erase(deferred->id);
+	}
+
+	deferred->finished = true;
+	return deferred->result;
+}
+
+void SceneHandler::resolveDeferred(ParseContext &context) {
+	for (size_t i=0; i<context.deferred.size(); ++i) {
+		ConfigurableObject *object = finishDeferred(context.deferred[i].second);
+		object->incRef();
+		context.children[context.deferred[i].first].second = object;
+	}
+	context.deferred.clear();
+}
+
+void SceneHandler::resolveNamedObject(const std::string &id) {
+	std::map<std::string, ref<DeferredObject> >::iterator it = m_deferredNamed->find(id);
+	if (it != m_deferredNamed->end()) {
+		ref<DeferredObject> deferred = it->second;
+		finishDeferred(deferred);
+	}
+}
+
 void SceneHandler::endElement(const XMLCh* const xmlName) {
-	std::string name = transcode(xmlName);
+	processEndElement(transcode(xmlName));
+}
+
+void SceneHandler::processEndElement(const std::string &name) {
+	if (m_recording)
+		m_recording->append(SceneCache::EEndTag, name);
+
 	ParseContext &context = m_context.top();
+	resolveDeferred(context);
 	std::string type = boost::to_lower_copy(context.attributes["type"]);
 	context.properties.setPluginName(type);
 	if (context.attributes.find("id") != context.attributes.end())
@@ -297,6 +743,7 @@ void SceneHandler::endElement(const XMLCh* const xmlName) {
 
 		case EReference: {
 				std::string id = context.attributes["id"];
+				resolveNamedObject(id);
 				if (m_namedObjects->find(id) == m_namedObjects->end())
 					XMLLog(EError, "Referenced object '%s' not found!", id.c_str());
 				object = (*m_namedObjects)[id];
@@ -645,10 +1092,12 @@ void SceneHandler::endElement(const XMLCh* const xmlName) {
 
 		case EAlias: {
 				std::string id = context.attributes["id"], as = context.attributes["as"];
+				resolveNamedObject(id);
 				if (m_namedObjects->find(id) == m_namedObjects->end())
 					XMLLog(EError, "Referenced object '%s' not found!", id.c_str());
 				ConfigurableObject *obj = (*m_namedObjects)[id];
-				if (m_namedObjects->find(as) != m_namedObjects->end())
+				if (m_namedObjects->find(as) != m_namedObjects->end() ||
+					m_deferredNamed->find(as) != m_deferredNamed->end())
 					XMLLog(EError, "Duplicate ID '%s' used in scene description!", id.c_str());
 				obj->incRef();
 				(*m_namedObjects)[as] = obj;
@@ -656,27 +1105,51 @@ void SceneHandler::endElement(const XMLCh* const xmlName) {
 			break;
 
 		case EInclude: {
-				SAXParser* parser = new SAXParser();
 				FileResolver *resolver = Thread::getThread()->getFileResolver();
-				fs::path schemaPath = resolver->resolveAbsolute("data/schema/scene.xsd");
+				fs::path path = resolver->resolve(context.attributes["filename"]);
+				SceneHandler *handler = new SceneHandler(m_params, m_namedObjects, true);
+				handler->m_pool = m_pool;
+				handler->m_stats = m_stats;
+				/* Objects of the parent file may still be under construction */
+				handler->m_deferredNamed = m_deferredNamed;
+
+				if (m_replay) {
+					/* The recorded elements of the included file follow */
+					m_replay->expect(SceneCache::EIncludeBegin, path.string());
+					handler->m_replay = m_replay;
+					handler->startDocument();
+					handler->replay();
+					handler->endDocument();
+				} else {
+					SAXParser* parser = new SAXParser();
+					fs::path schemaPath = resolver->resolveAbsolute("data/schema/scene.xsd");
+
+					/* Check against the 'scene.xsd' XML Schema */
+					parser->setDoSchema(true);
+					parser->setValidationSchemaFullChecking(true);
+					parser->setValidationScheme(SAXParser::Val_Always);
+					parser->setExternalNoNamespaceSchemaLocation(schemaPath.c_str());
+
+					/* Set the handler and start parsing */
+					parser->setDoNamespaces(true);
+					parser->setDocumentHandler(handler);
+					parser->setErrorHandler(handler);
+					XMLLog(EInfo, "Parsing included file \"%s\" ..", path.filename().string().c_str());
+
+					if (m_recording) {
+						m_recording->addSourceFile(path);
+						m_recording->append(SceneCache::EIncludeBegin, path.string());
+						handler->m_recording = m_recording;
+					}
 
-				/* Check against the 'scene.xsd' XML Schema */
-				parser->setDoSchema(true);
-				parser->setValidationSchemaFullChecking(true);
-				parser->setValidationScheme(SAXParser::Val_Always);
-				parser->setExternalNoNamespaceSchemaLocation(schemaPath.c_str());
+					parser->parse(path.c_str());
 
-				/* Set the handler and start parsing */
-				SceneHandler *handler = new SceneHandler(m_params, m_namedObjects, true);
-				parser->setDoNamespaces(true);
-				parser->setDocumentHandler(handler);
-				parser->setErrorHandler(handler);
-				fs::path path = resolver->resolve(context.attributes["filename"]);
-				XMLLog(EInfo, "Parsing included file \"%s\" ..", path.filename().string().c_str());
-				parser->parse(path.c_str());
+					if (m_recording)
+						m_recording->append(SceneCache::EIncludeEnd, "");
+					delete parser;
+				}
 
 				object = handler->getScene();
-				delete parser;
 				delete handler;
 			}
 			break;
@@ -738,13 +1211,45 @@ void SceneHandler::endElement(const XMLCh* const xmlName) {
 						object->addChild(shapeGroup);
 
 					}
+				} else if (isDeferrable(tag, props)) {
+					/* Construct the object on a worker thread. It is inserted
+					   into the parent's list of children as a placeholder and
+					   finished once the parent (or a reference) needs it */
+					ref<DeferredObject> deferred = new DeferredObject(tag.second, props);
+					deferred->name = name;
+					deferred->id = context.attributes["id"];
+					deferred->location = formatString("In file \"%s\" (near line %i)",
+						m_locator ? transcode(m_locator->getSystemId()).c_str() : "<unknown>",
+						m_locator ? (int) m_locator->getLineNumber() : -1);
+					deferred->children.swap(context.children);
+
+					if (!deferred->id.empty()) {
+						if (m_namedObjects->find(deferred->id) != m_namedObjects->end() ||
+							m_deferredNamed->find(deferred->id) != m_deferredNamed->end())
+							XMLLog(EError, "Duplicate ID '%s' used in scene description!", deferred->id.c_str());
+						(*m_deferredNamed)[deferred->id] = deferred;
+					}
+
+					ParseContext *parent = context.parent;
+					parent->deferred.push_back(std::make_pair(parent->children.size(), deferred));
+					parent->children.push_back(std::pair<std::string, ConfigurableObject *>(
+						context.attributes["name"], NULL));
+
+					m_stats->objectCount++;
+					m_stats->deferredCount++;
+					m_pool->submit(deferred);
+					m_context.pop();
+					return;
 				} else {
 					try {
+						ref<Timer> timer = new Timer();
 						object = m_pluginManager->createObject(tag.second, props);
+						m_stats->constructionTime += timer->getSeconds();
 					} catch (const std::exception &ex) {
 						XMLLog(EError, "Error while creating object: %s", ex.what());
 					}
 				}
+				m_stats->objectCount++;
 			}
 			break;
 	}
@@ -761,27 +1266,15 @@ void SceneHandler::endElement(const XMLCh* const xmlName) {
 					std::pair<std::string, ConfigurableObject *>(nodeName, object));
 			}
 
-			/* If the object has children, append them */
-			for (std::vector<std::pair<std::string, ConfigurableObject *> >
-					::iterator it = context.children.begin();
-					it != context.children.end(); ++it) {
-				if (it->second != NULL) {
-					object->addChild(it->first, it->second);
-					it->second->setParent(object);
-					it->second->decRef();
-				}
-			}
-
-			/* Don't configure a scene object if it is from an included file */
-			if (name != "include" && (!m_isIncludedFile || !object->getClass()->derivesFrom(MTS_CLASS(Scene))))
-				object->configure();
+			setupObject(object, name, context.children);
 
 			if (object->getClass()->derivesFrom(MTS_CLASS(Texture)))
 				object = static_cast<Texture *>(object.get())->expand();
 		}
 
 		if (id != "" && name != "ref") {
-			if (m_namedObjects->find(id) != m_namedObjects->end())
+			if (m_namedObjects->find(id) != m_namedObjects->end() ||
+				m_deferredNamed->find(id) != m_deferredNamed->end())
 				XMLLog(EError, "Duplicate ID '%s' used in scene description!", id.c_str());
 			(*m_namedObjects)[id] = object;
 			if (object)
@@ -797,6 +1290,25 @@ void SceneHandler::endElement(const XMLCh* const xmlName) {
 	m_context.pop();
 }
 
+void SceneHandler::replay() {
+	const SceneCache::Event *event;
+	while ((event = m_replay->next()) != NULL) {
+		switch (event->type) {
+			case SceneCache::EStartTag:
+				processStartElement(event->name, event->attributes);
+				break;
+			case SceneCache::EEndTag:
+				processEndElement(event->name);
+				break;
+			case SceneCache::EIncludeEnd:
+				/* Done with an included file */
+				return;
+			default:
+				SLog(EError, "The scene cache is inconsistent!");
+		}
+	}
+}
+
 // -----------------------------------------------------------------------
 //  Implementation of the SAX ErrorHandler interface
 // -----------------------------------------------------------------------
@@ -879,6 +1391,68 @@ ref<Scene> SceneHandler::loadSceneFromString(const std::string &content, const P
 	return scene;
 }
 
+ref<Scene> SceneHandler::loadSceneCached(const fs::path &filename,
+		const fs::path &cacheFile, const ParameterMap &params) {
+	ref<SceneCache> cache = new SceneCache();
+	bool valid = false;
+	if (fs::exists(cacheFile)) {
+		try {
+			valid = cache->load(cacheFile, filename, params);
+		} catch (const std::exception &ex) {
+			SLog(EWarn, "Could not read the scene cache \"%s\": %s",
+				cacheFile.string().c_str(), ex.what());
+		}
+	}
+
+	SceneHandler *handler = new SceneHandler(params);
+	ref<Scene> scene;
+
+	if (valid) {
+		SLog(EDebug, "Loading scene \"%s\" from the cache \"%s\" ..",
+			filename.string().c_str(), cacheFile.string().c_str());
+		handler->m_replay = cache;
+		handler->startDocument();
+		handler->replay();
+		handler->endDocument();
+		scene = handler->getScene();
+	} else {
+		/* Prepare for parsing scene descriptions */
+		FileResolver *resolver = Thread::getThread()->getFileResolver();
+		SAXParser* parser = new SAXParser();
+		fs::path schemaPath = resolver->resolveAbsolute("data/schema/scene.xsd");
+		SLog(EDebug, "Loading scene \"%s\" ..", filename.string().c_str());
+
+		/* Check against the 'scene.xsd' XML Schema */
+		parser->setDoSchema(true);
+		parser->setValidationSchemaFullChecking(true);
+		parser->setValidationScheme(SAXParser::Val_Always);
+		parser->setExternalNoNamespaceSchemaLocation(schemaPath.c_str());
+
+		parser->setDoNamespaces(true);
+		parser->setDocumentHandler(handler);
+		parser->setErrorHandler(handler);
+
+		cache = new SceneCache();
+		cache->setParameters(params);
+		cache->addSourceFile(filename);
+		handler->m_recording = cache;
+
+		parser->parse(filename.c_str());
+		scene = handler->getScene();
+		delete parser;
+
+		try {
+			cache->save(cacheFile);
+		} catch (const std::exception &ex) {
+			SLog(EWarn, "Could not write the scene cache \"%s\": %s",
+				cacheFile.string().c_str(), ex.what());
+		}
+	}
+
+	delete handler;
+
+	return scene;
+}
 
 void SceneHandler::staticInitialization() {
 	/* Initialize Xerces-C */
@@ -894,6 +1468,14 @@ void SceneHandler::staticShutdown() {
 	XMLPlatformUtils::Terminate();
 }
 
+void SceneHandler::setParallelLoading(bool value) {
+	m_parallelLoading = value;
+}
+
+bool SceneHandler::getParallelLoading() {
+	return m_parallelLoading;
+}
+
 VersionException::~VersionException() throw () {}
 
 MTS_NAMESPACE_END
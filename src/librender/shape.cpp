@@ -99,6 +99,10 @@ AABB Shape::getClippedAABB(const AABB &box) const {
 	return result;
 }
 
+AABB Shape::getMotionAABB(Float, Float) const {
+	return getAABB();
+}
+
 void Shape::sampleDirect(DirectSamplingRecord &dRec,
 			const Point2 &sample) const {
 	/* Piggyback on sampleArea() */
@@ -184,6 +188,14 @@ const KDTreeBase<AABB> *Shape::getKDTree() const {
 	return NULL;
 }
 
+const AnimatedTransform *Shape::getWorldTransform() const {
+	return NULL;
+}
+
+const Shape *Shape::getShapeGroup() const {
+	return NULL;
+}
+
 void Shape::serialize(Stream *stream, InstanceManager *manager) const {
 	ConfigurableObject::serialize(stream, manager);
 	stream->writeString(m_name);
@@ -196,6 +208,7 @@ void Shape::serialize(Stream *stream, InstanceManager *manager) const {
 }
 
 Float Shape::getSurfaceArea() const { NotImplementedError("getSurfaceArea"); }
+void Shape::setWorldTransform(const AnimatedTransform *) { NotImplementedError("setWorldTransform"); }
 bool Shape::rayIntersect(const Ray &ray, Float mint,
 		Float maxt, Float &t, void *temp) const { NotImplementedError("rayIntersect"); }
 bool Shape::rayIntersect(const Ray &ray, Float mint,
@@ -168,18 +168,17 @@ bool ShapeKDTree::rayIntersect(const Ray &ray, Float &t, ConstShapePtr &shape,
 					const TriMesh *trimesh = static_cast<const TriMesh *>(shape);
 					const Triangle &tri = trimesh->getTriangles()[cache->primIndex];
 					const Point *vertexPositions = trimesh->getVertexPositions();
-					const Point2 *vertexTexcoords = trimesh->getVertexTexcoords();
 					const uint32_t idx0 = tri.idx[0], idx1 = tri.idx[1], idx2 = tri.idx[2];
 					const Point &p0 = vertexPositions[idx0];
 					const Point &p1 = vertexPositions[idx1];
 					const Point &p2 = vertexPositions[idx2];
 					n = normalize(cross(p1-p0, p2-p0));
 
-					if (EXPECT_TAKEN(vertexTexcoords)) {
+					if (EXPECT_TAKEN(trimesh->hasVertexTexcoords())) {
 						const Vector b(1 - cache->u - cache->v, cache->u, cache->v);
-						const Point2 &t0 = vertexTexcoords[idx0];
-						const Point2 &t1 = vertexTexcoords[idx1];
-						const Point2 &t2 = vertexTexcoords[idx2];
+						const Point2 t0 = trimesh->getVertexTexcoord(idx0);
+						const Point2 t1 = trimesh->getVertexTexcoord(idx1);
+						const Point2 t2 = trimesh->getVertexTexcoord(idx2);
 						uv = t0 * b.x + t1 * b.y + t2 * b.z;
 					} else {
 						uv = Point2(0.0f);
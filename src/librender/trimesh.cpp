@@ -34,6 +34,7 @@
 #define MTS_FILEFORMAT_HEADER     0x041C
 #define MTS_FILEFORMAT_VERSION_V3 0x0003
 #define MTS_FILEFORMAT_VERSION_V4 0x0004
+#define MTS_FILEFORMAT_VERSION_V5 0x0005
 
 MTS_NAMESPACE_BEGIN
 
@@ -49,15 +50,18 @@ TriMesh::TriMesh(const std::string &name, size_t triangleCount,
 	m_normals = hasNormals ? new Normal[m_vertexCount] : NULL;
 	m_texcoords = hasTexcoords ? new Point2[m_vertexCount] : NULL;
 	m_colors = hasVertexColors ? new Color3[m_vertexCount] : NULL;
+	m_packedNormals = NULL;
+	m_packedTexcoords = NULL;
 	m_tangents = NULL;
+	m_quantize = false;
 	m_surfaceArea = m_invSurfaceArea = -1;
 	m_mutex = new Mutex();
 }
 
 TriMesh::TriMesh(const Properties &props)
  : Shape(props), m_triangles(NULL), m_positions(NULL),
-	m_normals(NULL), m_texcoords(NULL), m_tangents(NULL),
-	m_colors(NULL) {
+	m_normals(NULL), m_texcoords(NULL), m_packedNormals(NULL),
+	m_packedTexcoords(NULL), m_tangents(NULL), m_colors(NULL) {
 
 	/* By default, any existing normals will be used for
 	   rendering. If no normals are found, Mitsuba will
@@ -71,6 +75,9 @@ TriMesh::TriMesh(const Properties &props)
 	/* Causes all normals to be flipped */
 	m_flipNormals = props.getBoolean("flipNormals", false);
 
+	/* Store normals and texture coordinates in a compact quantized form */
+	m_quantize = props.getBoolean("quantize", false);
+
 	m_triangles = NULL;
 	m_surfaceArea = m_invSurfaceArea = -1;
 	m_mutex = new Mutex();
@@ -79,7 +86,8 @@ TriMesh::TriMesh(const Properties &props)
 TriMesh::TriMesh(Stream *stream, int index)
 		: Shape(Properties()), m_triangles(NULL),
 	m_positions(NULL), m_normals(NULL), m_texcoords(NULL),
-	m_tangents(NULL), m_colors(NULL) {
+	m_packedNormals(NULL), m_packedTexcoords(NULL),
+	m_tangents(NULL), m_colors(NULL), m_quantize(false) {
 
 	m_mutex = new Mutex();
 	loadCompressed(stream, index);
@@ -92,12 +100,14 @@ enum ETriMeshFlags {
 	EHasTangents     = 0x0004, // unused
 	EHasColors       = 0x0008,
 	EFaceNormals     = 0x0010,
+	EQuantized       = 0x0020,
 	ESinglePrecision = 0x1000,
 	EDoublePrecision = 0x2000
 };
 
 TriMesh::TriMesh(Stream *stream, InstanceManager *manager)
-	: Shape(stream, manager), m_tangents(NULL) {
+	: Shape(stream, manager), m_normals(NULL), m_texcoords(NULL),
+	  m_packedNormals(NULL), m_packedTexcoords(NULL), m_tangents(NULL) {
 	m_name = stream->readString();
 	m_aabb = AABB(stream);
 
@@ -110,21 +120,30 @@ TriMesh::TriMesh(Stream *stream, InstanceManager *manager)
 		m_vertexCount * sizeof(Point)/sizeof(Float));
 
 	m_faceNormals = flags & EFaceNormals;
+	m_quantize = flags & EQuantized;
 
 	if (flags & EHasNormals) {
-		m_normals = new Normal[m_vertexCount];
-		stream->readFloatArray(reinterpret_cast<Float *>(m_normals),
-			m_vertexCount * sizeof(Normal)/sizeof(Float));
-	} else {
-		m_normals = NULL;
+		if (m_quantize) {
+			m_packedNormals = new uint32_t[m_vertexCount];
+			stream->readUIntArray(m_packedNormals, m_vertexCount);
+		} else {
+			m_normals = new Normal[m_vertexCount];
+			stream->readFloatArray(reinterpret_cast<Float *>(m_normals),
+				m_vertexCount * sizeof(Normal)/sizeof(Float));
+		}
 	}
 
 	if (flags & EHasTexcoords) {
-		m_texcoords = new Point2[m_vertexCount];
-		stream->readFloatArray(reinterpret_cast<Float *>(m_texcoords),
-			m_vertexCount * sizeof(Point2)/sizeof(Float));
-	} else {
-		m_texcoords = NULL;
+		if (m_quantize) {
+			m_uvOffset = Point2(stream);
+			m_uvScale = Vector2(stream);
+			m_packedTexcoords = new uint32_t[m_vertexCount];
+			stream->readUIntArray(m_packedTexcoords, m_vertexCount);
+		} else {
+			m_texcoords = new Point2[m_vertexCount];
+			stream->readFloatArray(reinterpret_cast<Float *>(m_texcoords),
+				m_vertexCount * sizeof(Point2)/sizeof(Float));
+		}
 	}
 
 	if (flags & EHasColors) {
@@ -187,11 +206,13 @@ void TriMesh::loadCompressed(Stream *_stream, int index) {
 		stream->skip(sizeof(short) * 2); // Skip the header
 	}
 
+	/* Version 5 files use a block-compressed stream, which
+	   ZStream recognizes automatically */
 	stream = new ZStream(stream);
 	stream->setByteOrder(Stream::ELittleEndian);
 
 	uint32_t flags = stream->readUInt();
-	if (version == MTS_FILEFORMAT_VERSION_V4)
+	if (version >= MTS_FILEFORMAT_VERSION_V4)
 		m_name = stream->readString();
 	m_vertexCount = stream->readSize();
 	m_triangleCount = stream->readSize();
@@ -263,7 +284,8 @@ short TriMesh::readHeader(Stream *stream) {
 	}
 	short version = stream->readShort();
 	if (version != MTS_FILEFORMAT_VERSION_V3 &&
-	    version != MTS_FILEFORMAT_VERSION_V4) {
+	    version != MTS_FILEFORMAT_VERSION_V4 &&
+	    version != MTS_FILEFORMAT_VERSION_V5) {
 		Log(EError, "Encountered an incompatible file version!");
 	}
 	return version;
@@ -283,7 +305,7 @@ size_t TriMesh::readOffset(Stream *stream, short version, int idx) {
 	}
 
 	// Seek to the correct position
-	if (version == MTS_FILEFORMAT_VERSION_V4) {
+	if (version >= MTS_FILEFORMAT_VERSION_V4) {
 		stream->seek(stream->getSize() - sizeof(uint64_t) * (count-idx) - sizeof(uint32_t));
 		return stream->readSize();
 	} else {
@@ -310,7 +332,7 @@ int TriMesh::readOffsetDictionary(Stream *stream, short version,
 
 	if (streamSize >= minSize) {
 		outOffsets.resize(count);
-		if (version == MTS_FILEFORMAT_VERSION_V4) {
+		if (version >= MTS_FILEFORMAT_VERSION_V4) {
 			stream->seek(stream->getSize() - sizeof(uint64_t) * count - sizeof(uint32_t));
 			if (typeid(size_t) == typeid(uint64_t)) {
 				stream->readArray(&outOffsets[0], count);
@@ -343,6 +365,10 @@ TriMesh::~TriMesh() {
 		delete[] m_normals;
 	if (m_texcoords)
 		delete[] m_texcoords;
+	if (m_packedNormals)
+		delete[] m_packedNormals;
+	if (m_packedTexcoords)
+		delete[] m_packedTexcoords;
 	if (m_tangents)
 		delete[] m_tangents;
 	if (m_colors)
@@ -383,6 +409,105 @@ void TriMesh::configure() {
 	/* For manifold exploration: always compute UV tangents when a glossy material
 	   is involved. TODO: find a way to avoid this expense (compute on demand?) */
 	computeUVTangents();
+
+	if (m_quantize)
+		quantize();
+}
+
+uint32_t TriMesh::encodeNormal(const Normal &n) {
+	/* Project onto the octahedron and fold the lower hemisphere over */
+	Float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	Float x = n.x / l1, y = n.y / l1;
+	if (n.z < 0) {
+		Float tmp = x;
+		x = math::signum(x) * (1.0f - std::abs(y));
+		y = math::signum(y) * (1.0f - std::abs(tmp));
+	}
+
+	/* Rounding to the nearest grid point is not optimal -- try
+	   all four neighbors and keep the one closest to 'n' */
+	Float fx = std::floor(math::clamp(x, (Float) -1, (Float) 1) * 32767.0f),
+	      fy = std::floor(math::clamp(y, (Float) -1, (Float) 1) * 32767.0f);
+	uint32_t best = 0;
+	Float bestDot = -std::numeric_limits<Float>::infinity();
+	for (int i=0; i<4; ++i) {
+		int ix = std::min((int) fx + (i & 1), 32767),
+		    iy = std::min((int) fy + (i >> 1), 32767);
+		uint32_t value = (uint32_t) (uint16_t) (int16_t) ix
+			| ((uint32_t) (uint16_t) (int16_t) iy << 16);
+		Float d = dot(decodeNormal(value), n);
+		if (d > bestDot) {
+			bestDot = d;
+			best = value;
+		}
+	}
+	return best;
+}
+
+void TriMesh::quantize() {
+	if (m_normals) {
+		m_packedNormals = new uint32_t[m_vertexCount];
+		for (size_t i=0; i<m_vertexCount; ++i)
+			m_packedNormals[i] = encodeNormal(m_normals[i]);
+		delete[] m_normals;
+		m_normals = NULL;
+	}
+
+	if (m_texcoords) {
+		/* Quantize relative to the range of texture coordinates,
+		   which is more accurate than half precision */
+		Point2 uvMin(std::numeric_limits<Float>::infinity()),
+		       uvMax(-std::numeric_limits<Float>::infinity());
+		for (size_t i=0; i<m_vertexCount; ++i) {
+			for (int j=0; j<2; ++j) {
+				uvMin[j] = std::min(uvMin[j], m_texcoords[i][j]);
+				uvMax[j] = std::max(uvMax[j], m_texcoords[i][j]);
+			}
+		}
+		m_uvOffset = uvMin;
+		m_uvScale = (uvMax - uvMin) / 65535.0f;
+		Vector2 invScale;
+		for (int j=0; j<2; ++j)
+			invScale[j] = m_uvScale[j] != 0 ? 1.0f / m_uvScale[j] : 0.0f;
+
+		m_packedTexcoords = new uint32_t[m_vertexCount];
+		for (size_t i=0; i<m_vertexCount; ++i) {
+			Vector2 uv = m_texcoords[i] - m_uvOffset;
+			uint32_t u = (uint32_t) std::min(uv.x * invScale.x + 0.5f, 65535.0f),
+			         v = (uint32_t) std::min(uv.y * invScale.y + 0.5f, 65535.0f);
+			m_packedTexcoords[i] = u | (v << 16);
+		}
+		delete[] m_texcoords;
+		m_texcoords = NULL;
+
+		/* Recomputed on demand from the quantized texture coordinates */
+		if (m_tangents) {
+			delete[] m_tangents;
+			m_tangents = NULL;
+		}
+	}
+
+	m_quantize = true;
+}
+
+size_t TriMesh::getMemoryUsage() const {
+	size_t perVertex = sizeof(Point);
+	if (m_normals)
+		perVertex += sizeof(Normal);
+	else if (m_packedNormals)
+		perVertex += sizeof(uint32_t);
+	if (m_texcoords)
+		perVertex += sizeof(Point2);
+	else if (m_packedTexcoords)
+		perVertex += sizeof(uint32_t);
+	if (m_colors)
+		perVertex += sizeof(Color3);
+
+	size_t perTriangle = sizeof(Triangle);
+	if (m_tangents)
+		perTriangle += sizeof(TangentSpace);
+
+	return perVertex * m_vertexCount + perTriangle * m_triangleCount;
 }
 
 void TriMesh::prepareSamplingTable() {
@@ -416,8 +541,29 @@ void TriMesh::samplePosition(PositionSamplingRecord &pRec,
 
 	Point2 sample(_sample);
 	size_t index = m_areaDistr.sampleReuse(sample.y);
-	pRec.p = m_triangles[index].sample(m_positions, m_normals,
-		m_texcoords, pRec.n, pRec.uv, sample);
+	if (EXPECT_TAKEN(!isQuantized())) {
+		pRec.p = m_triangles[index].sample(m_positions, m_normals,
+			m_texcoords, pRec.n, pRec.uv, sample);
+	} else {
+		/* Sample barycentric coordinates and decode the vertex attributes
+		   that are stored in packed form. Attributes that are kept at full
+		   precision (e.g. normals recomputed after quantization) are used
+		   directly */
+		const Triangle &tri = m_triangles[index];
+		Point2 bary;
+		pRec.p = tri.sample(m_positions, m_normals, NULL, pRec.n, bary, sample);
+		Float b0 = 1.0f - bary.x - bary.y;
+		if (m_packedNormals)
+			pRec.n = normalize(getVertexNormal(tri.idx[0]) * b0
+				+ getVertexNormal(tri.idx[1]) * bary.x
+				+ getVertexNormal(tri.idx[2]) * bary.y);
+		if (m_packedTexcoords || m_texcoords)
+			pRec.uv = getVertexTexcoord(tri.idx[0]) * b0
+				+ getVertexTexcoord(tri.idx[1]) * bary.x
+				+ getVertexTexcoord(tri.idx[2]) * bary.y;
+		else
+			pRec.uv = bary;
+	}
 	pRec.pdf = m_invSurfaceArea;
 	pRec.measure = EArea;
 }
@@ -471,6 +617,10 @@ void TriMesh::rebuildTopology(Float maxAngle) {
 	const Float dpThresh = std::cos(degToRad(maxAngle));
 	size_t degenerateTriangles = 0;
 
+	if (isQuantized())
+		Log(EError, "\"%s\": rebuildTopology() cannot be applied to "
+			"a quantized mesh!", m_name.c_str());
+
 	if (m_normals) {
 		delete[] m_normals;
 		m_normals = NULL;
@@ -612,6 +762,10 @@ void TriMesh::computeNormals(bool force) {
 			delete[] m_normals;
 			m_normals = NULL;
 		}
+		if (m_packedNormals) {
+			delete[] m_packedNormals;
+			m_packedNormals = NULL;
+		}
 
 		if (m_flipNormals) {
 			/* Change the winding order */
@@ -621,14 +775,23 @@ void TriMesh::computeNormals(bool force) {
 			}
 		}
 	} else {
-		if (m_normals && !force) {
+		if (hasVertexNormals() && !force) {
 			if (m_flipNormals) {
-				for (size_t i=0; i<m_vertexCount; i++)
-					m_normals[i] *= -1;
+				if (m_normals) {
+					for (size_t i=0; i<m_vertexCount; i++)
+						m_normals[i] *= -1;
+				} else {
+					for (size_t i=0; i<m_vertexCount; i++)
+						m_packedNormals[i] = encodeNormal(-decodeNormal(m_packedNormals[i]));
+				}
 			} else {
 				/* Do nothing */
 			}
 		} else {
+			if (m_packedNormals) {
+				delete[] m_packedNormals;
+				m_packedNormals = NULL;
+			}
 			if (!m_normals)
 				m_normals = new Normal[m_vertexCount];
 			memset(m_normals, 0, sizeof(Normal)*m_vertexCount);
@@ -681,8 +844,7 @@ void TriMesh::computeNormals(bool force) {
 }
 
 void TriMesh::computeUVTangents() {
-	// int degenerate = 0;
-	if (!m_texcoords) {
+	if (!hasVertexTexcoords()) {
 		bool anisotropic = hasBSDF() && m_bsdf->getType() & BSDF::EAnisotropic;
 		if (anisotropic)
 			Log(EError, "\"%s\": computeUVTangents(): texture coordinates "
@@ -692,59 +854,55 @@ void TriMesh::computeUVTangents() {
 		return;
 	}
 
-	if (m_tangents)
+	/* Quantized meshes compute the tangents on demand */
+	if (m_tangents || m_packedTexcoords)
 		return;
 
 	m_tangents = new TangentSpace[m_triangleCount];
-	memset(m_tangents, 0, sizeof(TangentSpace)*m_triangleCount);
-
-	for (size_t i=0; i<m_triangleCount; i++) {
-		uint32_t idx0 = m_triangles[i].idx[0],
-				 idx1 = m_triangles[i].idx[1],
-				 idx2 = m_triangles[i].idx[2];
 
-		const Point
-			  &v0 = m_positions[idx0],
-			  &v1 = m_positions[idx1],
-			  &v2 = m_positions[idx2];
-
-		const Point2
-			&uv0 = m_texcoords[idx0],
-			&uv1 = m_texcoords[idx1],
-			&uv2 = m_texcoords[idx2];
-
-		Vector dP1 = v1 - v0, dP2 = v2 - v0;
-		Vector2 dUV1 = uv1 - uv0, dUV2 = uv2 - uv0;
-		Normal n = Normal(cross(dP1, dP2));
-		Float length = n.length();
-		if (length == 0) {
-			// ++degenerate;
-			continue;
-		}
+	for (size_t i=0; i<m_triangleCount; i++)
+		m_tangents[i] = computeUVTangent(i);
+}
 
-		Float determinant = dUV1.x * dUV2.y - dUV1.y * dUV2.x;
-		if (determinant == 0) {
-			/* The user-specified parameterization is degenerate. Pick
-			   arbitrary tangents that are perpendicular to the geometric normal */
-			coordinateSystem(n/length, m_tangents[i].dpdu, m_tangents[i].dpdv);
-		} else {
-			Float invDet = 1.0f / determinant;
-			m_tangents[i].dpdu = ( dUV2.y * dP1 - dUV1.y * dP2) * invDet;
-			m_tangents[i].dpdv = (-dUV2.x * dP1 + dUV1.x * dP2) * invDet;
-		}
+TangentSpace TriMesh::computeUVTangent(size_t index) const {
+	uint32_t idx0 = m_triangles[index].idx[0],
+			 idx1 = m_triangles[index].idx[1],
+			 idx2 = m_triangles[index].idx[2];
+
+	const Point
+		  &v0 = m_positions[idx0],
+		  &v1 = m_positions[idx1],
+		  &v2 = m_positions[idx2];
+
+	const Point2
+		uv0 = getVertexTexcoord(idx0),
+		uv1 = getVertexTexcoord(idx1),
+		uv2 = getVertexTexcoord(idx2);
+
+	Vector dP1 = v1 - v0, dP2 = v2 - v0;
+	Vector2 dUV1 = uv1 - uv0, dUV2 = uv2 - uv0;
+	Normal n = Normal(cross(dP1, dP2));
+	Float length = n.length();
+	TangentSpace result(Vector(0.0f), Vector(0.0f));
+	if (length == 0)
+		return result;
+
+	Float determinant = dUV1.x * dUV2.y - dUV1.y * dUV2.x;
+	if (determinant == 0) {
+		/* The user-specified parameterization is degenerate. Pick
+		   arbitrary tangents that are perpendicular to the geometric normal */
+		coordinateSystem(n/length, result.dpdu, result.dpdv);
+	} else {
+		Float invDet = 1.0f / determinant;
+		result.dpdu = ( dUV2.y * dP1 - dUV1.y * dP2) * invDet;
+		result.dpdv = (-dUV2.x * dP1 + dUV1.x * dP2) * invDet;
 	}
-
-	#if 0
-		/* Don't be so noisy -- this isn't usually a problem.. */
-		if (degenerate > 0)
-			Log(EWarn, "\"%s\": computeTangentSpace(): Mesh contains %i "
-				"degenerate triangles!", getName().c_str(), degenerate);
-	#endif
+	return result;
 }
 
 void TriMesh::getNormalDerivative(const Intersection &its,
 		Vector &dndu, Vector &dndv, bool shadingFrame) const {
-	if (!shadingFrame || !m_normals) {
+	if (!shadingFrame || !hasVertexNormals()) {
 		dndu = dndv = Vector(0.0f);
 	} else {
 		Assert(its.primIndex < m_triangleCount);
@@ -780,9 +938,9 @@ void TriMesh::getNormalDerivative(const Intersection &its,
 		      w = 1 - u - v;
 
 		const Normal
-			&n0 = m_normals[idx0],
-			&n1 = m_normals[idx1],
-			&n2 = m_normals[idx2];
+			n0 = getVertexNormal(idx0),
+			n1 = getVertexNormal(idx1),
+			n2 = getVertexNormal(idx2);
 
 		/* Now compute the derivative of "normalize(u*n1 + v*n2 + (1-u-v)*n0)"
 		   with respect to [u, v] in the local triangle parameterization.
@@ -797,13 +955,13 @@ void TriMesh::getNormalDerivative(const Intersection &its,
 		dndu = (n1 - n0) * il; dndu -= N * dot(N, dndu);
 		dndv = (n2 - n0) * il; dndv -= N * dot(N, dndv);
 
-		if (m_texcoords) {
+		if (hasVertexTexcoords()) {
 			/* Compute derivatives with respect to a specified texture
 			   UV parameterization.  */
 			const Point2
-				&uv0 = m_texcoords[idx0],
-				&uv1 = m_texcoords[idx1],
-				&uv2 = m_texcoords[idx2];
+				uv0 = getVertexTexcoord(idx0),
+				uv1 = getVertexTexcoord(idx1),
+				uv2 = getVertexTexcoord(idx2);
 
 			Vector2 duv1 = uv1 - uv0, duv2 = uv2 - uv0;
 
@@ -829,14 +987,16 @@ ref<TriMesh> TriMesh::createTriMesh() {
 void TriMesh::serialize(Stream *stream, InstanceManager *manager) const {
 	Shape::serialize(stream, manager);
 	uint32_t flags = 0;
-	if (m_normals)
+	if (hasVertexNormals())
 		flags |= EHasNormals;
-	if (m_texcoords)
+	if (hasVertexTexcoords())
 		flags |= EHasTexcoords;
 	if (m_colors)
 		flags |= EHasColors;
 	if (m_faceNormals)
 		flags |= EFaceNormals;
+	if (isQuantized())
+		flags |= EQuantized;
 	stream->writeString(m_name);
 	m_aabb.serialize(stream);
 	stream->writeUInt(flags);
@@ -845,12 +1005,31 @@ void TriMesh::serialize(Stream *stream, InstanceManager *manager) const {
 
 	stream->writeFloatArray(reinterpret_cast<Float *>(m_positions),
 		m_vertexCount * sizeof(Point)/sizeof(Float));
-	if (m_normals)
-		stream->writeFloatArray(reinterpret_cast<Float *>(m_normals),
-			m_vertexCount * sizeof(Normal)/sizeof(Float));
-	if (m_texcoords)
-		stream->writeFloatArray(reinterpret_cast<Float *>(m_texcoords),
-			m_vertexCount * sizeof(Point2)/sizeof(Float));
+	if (isQuantized()) {
+		/* Transmit the compact representation, which stays quantized
+		   on the receiving side */
+		if (m_packedNormals) {
+			stream->writeUIntArray(m_packedNormals, m_vertexCount);
+		} else if (m_normals) {
+			/* (the normals were recomputed after quantization) */
+			std::vector<uint32_t> normals(m_vertexCount);
+			for (size_t i=0; i<m_vertexCount; ++i)
+				normals[i] = encodeNormal(m_normals[i]);
+			stream->writeUIntArray(&normals[0], m_vertexCount);
+		}
+		if (m_packedTexcoords) {
+			m_uvOffset.serialize(stream);
+			m_uvScale.serialize(stream);
+			stream->writeUIntArray(m_packedTexcoords, m_vertexCount);
+		}
+	} else {
+		if (m_normals)
+			stream->writeFloatArray(reinterpret_cast<Float *>(m_normals),
+				m_vertexCount * sizeof(Normal)/sizeof(Float));
+		if (m_texcoords)
+			stream->writeFloatArray(reinterpret_cast<Float *>(m_texcoords),
+				m_vertexCount * sizeof(Point2)/sizeof(Float));
+	}
 	if (m_colors)
 		stream->writeFloatArray(reinterpret_cast<Float *>(m_colors),
 			m_vertexCount * sizeof(Color3)/sizeof(Float));
@@ -1015,20 +1194,17 @@ void TriMesh::writeOBJ(const fs::path &path) const {
 			<< m_positions[i].z << endl;
 	}
 
-	if (m_texcoords) {
+	if (hasVertexTexcoords()) {
 		for (size_t i=0; i<m_vertexCount; ++i) {
-			os << "vt "
-				<< m_texcoords[i].x << " "
-				<< m_texcoords[i].y << endl;
+			Point2 uv = getVertexTexcoord((uint32_t) i);
+			os << "vt " << uv.x << " " << uv.y << endl;
 		}
 	}
 
-	if (m_normals) {
+	if (hasVertexNormals()) {
 		for (size_t i=0; i<m_vertexCount; ++i) {
-			os << "vn "
-				<< m_normals[i].x << " "
-				<< m_normals[i].y << " "
-				<< m_normals[i].z << endl;
+			Normal n = getVertexNormal((uint32_t) i);
+			os << "vn " << n.x << " " << n.y << " " << n.z << endl;
 		}
 	}
 
@@ -1037,11 +1213,11 @@ void TriMesh::writeOBJ(const fs::path &path) const {
 		         i1 = m_triangles[i].idx[1] + 1,
 		         i2 = m_triangles[i].idx[2] + 1;
 
-		if (m_normals && m_texcoords) {
+		if (hasVertexNormals() && hasVertexTexcoords()) {
 			os << "f " << i0 << "/" << i0 << "/" << i0 << " "
 			   <<  i1 << "/" << i1 << "/" << i1 << " "
 			   <<  i2 << "/" << i2 << "/" << i2 << endl;
-		} else if (m_normals) {
+		} else if (hasVertexNormals()) {
 			os << "f " << i0 << "//" << i0 << " "
 			   <<  i1 << "//" << i1 << " "
 			   <<  i2 << "//" << i2 << endl;
@@ -1069,14 +1245,14 @@ void TriMesh::writePLY(const fs::path &path) const {
 	os << "property float y\n";
 	os << "property float z\n";
 
-	if (m_normals) {
+	if (hasVertexNormals()) {
 		os << "property float nx\n";
 		os << "property float ny\n";
 		os << "property float nz\n";
 		storagePerVertex += 3 * sizeof(float);
 	}
 
-	if (m_texcoords) {
+	if (hasVertexTexcoords()) {
 		os << "property float u\n";
 		os << "property float v\n";
 		storagePerVertex += 2 * sizeof(float);
@@ -1098,11 +1274,11 @@ void TriMesh::writePLY(const fs::path &path) const {
 
 	for (size_t i=0; i< getVertexCount(); ++i) {
 		Vector3f p(m_positions[i]); memcpy(ptr, &p, sizeof(Vector3f)); ptr += sizeof(Vector3f);
-		if (m_normals) {
-			Vector3f n(m_normals[i]); memcpy(ptr, &n, sizeof(Vector3f)); ptr += sizeof(Vector3f);
+		if (hasVertexNormals()) {
+			Vector3f n(getVertexNormal((uint32_t) i)); memcpy(ptr, &n, sizeof(Vector3f)); ptr += sizeof(Vector3f);
 		}
-		if (m_texcoords) {
-			Vector2f uv(m_texcoords[i]); memcpy(ptr, &uv, sizeof(Vector2f)); ptr += sizeof(Vector2f);
+		if (hasVertexTexcoords()) {
+			Vector2f uv(getVertexTexcoord((uint32_t) i)); memcpy(ptr, &uv, sizeof(Vector2f)); ptr += sizeof(Vector2f);
 		}
 		if (m_colors) {
 			*ptr += (uint8_t) std::max(0.0f, std::min(255.0f, (float) m_colors[i][0] * 255.0f + 0.5f));
@@ -1136,8 +1312,8 @@ void TriMesh::serialize(Stream *_stream) const {
 			"which was not previously set to little endian byte order!");
 
 	stream->writeShort(MTS_FILEFORMAT_HEADER);
-	stream->writeShort(MTS_FILEFORMAT_VERSION_V4);
-	stream = new ZStream(stream);
+	stream->writeShort(MTS_FILEFORMAT_VERSION_V5);
+	stream = new ZStream(stream, ZStream::EBlockStream);
 
 #if defined(SINGLE_PRECISION)
 	uint32_t flags = ESinglePrecision;
@@ -1145,9 +1321,9 @@ void TriMesh::serialize(Stream *_stream) const {
 	uint32_t flags = EDoublePrecision;
 #endif
 
-	if (m_normals)
+	if (hasVertexNormals())
 		flags |= EHasNormals;
-	if (m_texcoords)
+	if (hasVertexTexcoords())
 		flags |= EHasTexcoords;
 	if (m_colors)
 		flags |= EHasColors;
@@ -1161,12 +1337,28 @@ void TriMesh::serialize(Stream *_stream) const {
 
 	stream->writeFloatArray(reinterpret_cast<Float *>(m_positions),
 		m_vertexCount * sizeof(Point)/sizeof(Float));
-	if (m_normals)
+
+	/* The file format always stores full precision data */
+	if (m_normals) {
 		stream->writeFloatArray(reinterpret_cast<Float *>(m_normals),
 			m_vertexCount * sizeof(Normal)/sizeof(Float));
-	if (m_texcoords)
+	} else if (m_packedNormals) {
+		std::vector<Normal> normals(m_vertexCount);
+		for (size_t i=0; i<m_vertexCount; ++i)
+			normals[i] = decodeNormal(m_packedNormals[i]);
+		stream->writeFloatArray(reinterpret_cast<Float *>(&normals[0]),
+			m_vertexCount * sizeof(Normal)/sizeof(Float));
+	}
+	if (m_texcoords) {
 		stream->writeFloatArray(reinterpret_cast<Float *>(m_texcoords),
 			m_vertexCount * sizeof(Point2)/sizeof(Float));
+	} else if (m_packedTexcoords) {
+		std::vector<Point2> texcoords(m_vertexCount);
+		for (size_t i=0; i<m_vertexCount; ++i)
+			texcoords[i] = getVertexTexcoord((uint32_t) i);
+		stream->writeFloatArray(reinterpret_cast<Float *>(&texcoords[0]),
+			m_vertexCount * sizeof(Point2)/sizeof(Float));
+	}
 	if (m_colors)
 		stream->writeFloatArray(reinterpret_cast<Float *>(m_colors),
 			m_vertexCount * sizeof(Color3)/sizeof(Float));
@@ -1189,8 +1381,9 @@ std::string TriMesh::toString() const {
 		<< "  triangleCount = " << m_triangleCount << "," << endl
 		<< "  vertexCount = " << m_vertexCount << "," << endl
 		<< "  faceNormals = " << (m_faceNormals ? "true" : "false") << "," << endl
-		<< "  hasNormals = " << (m_normals ? "true" : "false") << "," << endl
-		<< "  hasTexcoords = " << (m_texcoords ? "true" : "false") << "," << endl
+		<< "  hasNormals = " << (hasVertexNormals() ? "true" : "false") << "," << endl
+		<< "  hasTexcoords = " << (hasVertexTexcoords() ? "true" : "false") << "," << endl
+		<< "  quantized = " << (isQuantized() ? "true" : "false") << "," << endl
 		<< "  hasTangents = " << (m_tangents ? "true" : "false") << "," << endl
 		<< "  hasColors = " << (m_colors ? "true" : "false") << "," << endl
 		<< "  surfaceArea = " << m_surfaceArea << "," << endl
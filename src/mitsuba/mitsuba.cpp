@@ -71,12 +71,20 @@ void help() {
 	cout <<  "                       out -- by default, \"~/mitsuba\" is used)" << endl << endl;
 	cout <<  "   -s file     Connect to additional Mitsuba servers specified in a file" << endl;
 	cout <<  "               with one name per line (same format as in -c)" << endl<< endl;
+	cout <<  "   -W count    Number of work units kept in flight per remote core. Larger" << endl;
+	cout <<  "               values hide more network latency (default: " << MTS_BACKLOG_FACTOR << ")" << endl << endl;
+	cout <<  "   -T secs     Hand work units to other workers when a remote server has not" << endl;
+	cout <<  "               returned them within this many seconds (default: disabled)" << endl << endl;
 	cout <<  "   -j count    Simultaneously schedule several scenes. Can sometimes accelerate" << endl;
 	cout <<  "               rendering when large amounts of processing power are available" << endl;
 	cout <<  "               (e.g. when running Mitsuba on a cluster. Default: 1)" << endl << endl;
 	cout <<  "   -n name     Assign a node name to this instance (Default: host name)" << endl << endl;
 	cout <<  "   -x          Skip rendering of files where output already exists" << endl << endl;
+	cout <<  "   -C          Keep a pre-parsed binary copy of each scene next to it" << endl;
+	cout <<  "               (\"<scene>.cache\") and load it on subsequent runs" << endl << endl;
 	cout <<  "   -r sec      Write (partial) output images every 'sec' seconds" << endl << endl;
+	cout <<  "   -A          Write output images in the background, so that the next scene" << endl;
+	cout <<  "               can already start rendering (overrides the film's 'asyncWrite')" << endl << endl;
 	cout <<  "   -b res      Specify the block resolution used to split images into parallel" << endl;
 	cout <<  "               workloads (default: 32). Only applies to some integrators." << endl << endl;
 	cout <<  "   -v          Be more verbose (can be specified twice)" << endl << endl;
@@ -136,12 +144,15 @@ int mitsuba_app(int argc, char **argv) {
 		int numParallelScenes = 1;
 		std::string nodeName = getHostName(),
 					networkHosts = "", destFile="";
-		bool quietMode = false, progressBars = true, skipExisting = false;
+		bool quietMode = false, progressBars = true, skipExisting = false,
+			useSceneCache = false, asyncWrite = false;
 		ELogLevel logLevel = EInfo;
 		ref<FileResolver> fileResolver = Thread::getThread()->getFileResolver();
 		bool treatWarningsAsErrors = false;
 		std::map<std::string, std::string, SimpleStringOrdering> parameters;
 		int blockSize = 32;
+		int windowFactor = MTS_BACKLOG_FACTOR;
+		Float remoteTimeout = 0;
 		int flushTimer = -1;
 
 		if (argc < 2) {
@@ -151,7 +162,7 @@ int mitsuba_app(int argc, char **argv) {
 
 		optind = 1;
 		/* Parse command-line arguments */
-		while ((optchar = getopt(argc, argv, "a:c:D:s:j:n:o:r:b:p:L:qhzvtwx")) != -1) {
+		while ((optchar = getopt(argc, argv, "a:c:D:s:j:n:o:r:b:p:L:W:T:qhzvtwxCA")) != -1) {
 			switch (optchar) {
 				case 'a': {
 						std::vector<std::string> paths = tokenize(optarg, ";");
@@ -215,6 +226,12 @@ int mitsuba_app(int argc, char **argv) {
 				case 'x':
 					skipExisting = true;
 					break;
+				case 'C':
+					useSceneCache = true;
+					break;
+				case 'A':
+					asyncWrite = true;
+					break;
 				case 'p':
 					nprocs = strtol(optarg, &end_ptr, 10);
 					if (*end_ptr != '\0')
@@ -237,6 +254,16 @@ int mitsuba_app(int argc, char **argv) {
 					if (blockSize < 2 || blockSize > 128)
 						SLog(EError, "Invalid block size (should be in the range 2-128)");
 					break;
+				case 'W':
+					windowFactor = strtol(optarg, &end_ptr, 10);
+					if (*end_ptr != '\0' || windowFactor < 1)
+						SLog(EError, "Could not parse the in-flight window size!");
+					break;
+				case 'T':
+					remoteTimeout = (Float) strtod(optarg, &end_ptr);
+					if (*end_ptr != '\0' || remoteTimeout < 0)
+						SLog(EError, "Could not parse the work unit timeout!");
+					break;
 				case 'z':
 					progressBars = false;
 					break;
@@ -311,7 +338,10 @@ int mitsuba_app(int argc, char **argv) {
 				stream = new SSHStream(tokens[0], tokens[1], cmdLine);
 			}
 			try {
-				scheduler->registerWorker(new RemoteWorker(formatString("net%i", i), stream));
+				ref<RemoteWorker> worker = new RemoteWorker(formatString("net%i", i), stream);
+				worker->setWindowSize(windowFactor * worker->getCoreCount());
+				worker->setTimeout(remoteTimeout);
+				scheduler->registerWorker(worker);
 			} catch (std::runtime_error &e) {
 				if (hostName.find("@") != std::string::npos) {
 #if defined(__WINDOWS__)
@@ -376,14 +406,25 @@ int mitsuba_app(int argc, char **argv) {
 
 			SLog(EInfo, "Parsing scene description from \"%s\" ..", argv[i]);
 
-			parser->parse(filename.c_str());
-			ref<Scene> scene = handler->getScene();
+			ref<Scene> scene;
+			if (useSceneCache) {
+				scene = SceneHandler::loadSceneCached(filename,
+					filename.string() + ".cache", parameters);
+			} else {
+				parser->parse(filename.c_str());
+				scene = handler->getScene();
+			}
 
 			scene->setSourceFile(filename);
 			scene->setDestinationFile(destFile.length() > 0 ?
 				fs::path(destFile) : (filePath / baseName));
 			scene->setBlockSize(blockSize);
 
+			/* Write the image in the background if requested on the command
+			   line (otherwise, the film's 'asyncWrite' parameter decides) */
+			if (asyncWrite)
+				scene->getFilm()->setAsyncWrite(true);
+
 			if (scene->destinationExists() && skipExisting)
 				continue;
 
@@ -400,6 +441,7 @@ int mitsuba_app(int argc, char **argv) {
 		renderQueue->waitLeft(0);
 		if (flushThread)
 			flushThread->quit();
+		Bitmap::waitAsyncWrites();
 		renderQueue = NULL;
 
 		delete handler;
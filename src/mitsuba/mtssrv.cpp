@@ -100,8 +100,9 @@ int mtssrv(int argc, char **argv) {
 		int nprocs = getCoreCount(),
 			listenPort = MTS_DEFAULT_PORT;
 		std::string nodeName = getHostName(),
-					networkHosts = "";
+					networkHosts = "", blobCacheDir = "";
 		bool quietMode = false;
+		uint64_t blobCacheSize = 0;
 		ELogLevel logLevel = EInfo;
 		std::string hostName = getFQDN();
 		FileResolver *fileResolver = Thread::getThread()->getFileResolver();
@@ -109,7 +110,7 @@ int mtssrv(int argc, char **argv) {
 
 		optind = 1;
 		/* Parse command-line arguments */
-		while ((optchar = getopt(argc, argv, "a:c:s:n:p:i:l:L:qhv")) != -1) {
+		while ((optchar = getopt(argc, argv, "a:b:B:c:s:n:p:i:l:L:qhv")) != -1) {
 			switch (optchar) {
 				case 'a': {
 						std::vector<std::string> paths = tokenize(optarg, ";");
@@ -117,6 +118,14 @@ int mtssrv(int argc, char **argv) {
 							fileResolver->prependPath(paths[i]);
 					}
 					break;
+				case 'b':
+					blobCacheDir = optarg;
+					break;
+				case 'B':
+					blobCacheSize = (uint64_t) strtol(optarg, &end_ptr, 10) * 1024 * 1024;
+					if (*end_ptr != '\0')
+						SLog(EError, "Could not parse the blob cache size!");
+					break;
 				case 'c':
 					networkHosts = networkHosts + std::string(";") + std::string(optarg);
 					break;
@@ -184,6 +193,10 @@ int mtssrv(int argc, char **argv) {
 					cout <<  "Options/Arguments:" << endl;
 					cout <<  "   -h          Display this help text" << endl << endl;
 					cout <<  "   -a p1;p2;.. Add one or more entries to the resource search path" << endl << endl;
+					cout <<  "   -b dir      Cache resources received from clients in the given directory," << endl;
+					cout <<  "               so that unchanged data need not be transmitted again" << endl << endl;
+					cout <<  "   -B MiB      Limit the size of the resource cache (default: unlimited)." << endl;
+					cout <<  "               The least recently used entries are evicted on startup" << endl << endl;
 					cout <<  "   -p count    Override the detected number of processors. Useful for reducing" << endl;
 					cout <<  "               the load or creating scheduling-only nodes in conjunction with"  << endl;
 					cout <<  "               the -c and -s parameters, e.g. -p 0 -c host1;host2;host3,..." << endl << endl;
@@ -285,6 +298,11 @@ int mtssrv(int argc, char **argv) {
 		}
 		scheduler->start();
 
+		if (!blobCacheDir.empty()) {
+			StreamBackend::setBlobCacheDirectory(blobCacheDir, blobCacheSize);
+			SLog(EInfo, "Caching received resources in \"%s\"", blobCacheDir.c_str());
+		}
+
 		if (listenPort == -1) {
 			ref<StreamBackend> backend = new StreamBackend("con0",
 					scheduler, nodeName, new ConsoleStream(), false);
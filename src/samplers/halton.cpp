@@ -126,6 +126,7 @@ public:
 
 		setFilmResolution(Vector2i(1), false);
 		m_arrayStartDim = m_arrayEndDim = 5;
+		m_blockDimension = 0;
 	}
 
 	HaltonSampler(Stream *stream, InstanceManager *manager)
@@ -140,6 +141,7 @@ public:
 		m_primePowers = Vector2i(stream);
 		m_primeExponents = Vector2i(stream);
 		m_pixelPosition = Point2i(0);
+		m_blockDimension = 0;
 		configure();
 	}
 
@@ -161,6 +163,7 @@ public:
 		sampler->m_sampleCount = m_sampleCount;
 		sampler->m_sampleIndex = m_sampleIndex;
 		sampler->m_dimension = m_dimension;
+		sampler->m_blockDimension = m_blockDimension;
 		sampler->m_arrayStartDim = m_arrayStartDim;
 		sampler->m_arrayEndDim = m_arrayEndDim;
 		sampler->m_permutations = m_permutations;
@@ -325,21 +328,67 @@ public:
 			dim += 2;
 		}
 
+		m_blockDimension = 0;
 		setSampleIndex(0);
 	}
 
 	void advance() {
 		m_sampleIndex++;
-		m_dimension = 0;
+		m_dimension = m_blockDimension;
 		m_dimension1DArray = m_dimension2DArray = 0;
 	}
 
 	void setSampleIndex(size_t sampleIndex) {
-		m_dimension = 0;
+		m_dimension = m_blockDimension;
 		m_sampleIndex = sampleIndex;
 		m_dimension1DArray = m_dimension2DArray = 0;
 	}
 
+	bool generate2DBlock(Point2 *dest, size_t dimCount) {
+		uint32_t dim = 0;
+		for (size_t j=0; j<dimCount; ++j) {
+			/* Skip over dimensions that were reserved to arrays (as in next2D()) */
+			if (dim + 1 >= m_arrayStartDim && dim < m_arrayEndDim)
+				dim = m_arrayEndDim;
+
+			if (dim + 1 >= primeTableSize)
+				Log(EError, "Lookup dimension exceeds the prime number table size! "
+					"You may have to reduce the 'maxDepth' parameter of your integrator.");
+
+			/* Process this dimension for all samples of the pixel */
+			if (m_permutations.get()) {
+				uint16_t *perm1 = m_permutations->getPermutation(dim);
+				uint16_t *perm2 = m_permutations->getPermutation(dim+1);
+				for (size_t i=0; i<m_sampleCount; ++i) {
+					uint64_t index = m_offset + m_stride * i;
+					dest[i*dimCount + j] = Point2(
+						scrambledRadicalInverseFast(dim,   index, perm1),
+						scrambledRadicalInverseFast(dim+1, index, perm2));
+				}
+			} else {
+				for (size_t i=0; i<m_sampleCount; ++i) {
+					uint64_t index = m_offset + m_stride * i;
+					dest[i*dimCount + j] = Point2(
+						radicalInverseFast(dim,   index),
+						radicalInverseFast(dim+1, index));
+				}
+			}
+
+			if (dim == 0) {
+				for (size_t i=0; i<m_sampleCount; ++i) {
+					Point2 &p = dest[i*dimCount + j];
+					p.x = p.x * m_primePowers.x - m_pixelPosition.x;
+					p.y = p.y * m_primePowers.y - m_pixelPosition.y;
+				}
+			}
+			dim += 2;
+		}
+
+		m_blockDimension = dim;
+		m_dimension = m_blockDimension;
+		return true;
+	}
+
 	inline Float nextFloat(uint64_t idx) {
 		uint32_t dim = m_dimension++;
 		if (m_permutations != NULL)
@@ -400,6 +449,7 @@ public:
 	MTS_DECLARE_CLASS()
 private:
 	uint32_t m_dimension;
+	uint32_t m_blockDimension;
 	uint32_t m_arrayStartDim;
 	uint32_t m_arrayEndDim;
 	int m_scramble;
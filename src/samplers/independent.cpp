@@ -17,6 +17,7 @@
 */
 
 #include <mitsuba/render/sampler.h>
+#include <mitsuba/core/pcg32.h>
 
 MTS_NAMESPACE_BEGIN
 
@@ -26,6 +27,9 @@ MTS_NAMESPACE_BEGIN
  *     \parameter{sampleCount}{\Integer}{
  *       Number of samples per pixel \default{4}
  *     }
+ *     \parameter{seed}{\Integer}{
+ *       Seed value of the pseudorandom number generator \default{0}
+ *     }
  * }
  *
  * \renderings{
@@ -34,8 +38,9 @@ MTS_NAMESPACE_BEGIN
  * }
  *
  * The independent sampler produces a stream of independent and uniformly
- * distributed pseudorandom numbers. Internally, it relies on a fast SIMD version
- * of the Mersenne Twister random number generator \cite{Saito2008SIMD}.
+ * distributed pseudorandom numbers. Internally, it relies on the PCG32 random
+ * number generator, whose state consists of only two 64-bit integers. This makes
+ * it cheap to create a separately seeded sampler for every rendering thread.
  *
  * This is the most basic sample generator; because no precautions are taken to avoid
  * sample clumping, images produced using this plugin will usually take longer to converge.
@@ -55,23 +60,34 @@ public:
 	IndependentSampler(const Properties &props) : Sampler(props) {
 		/* Number of samples per pixel when used with a sampling-based integrator */
 		m_sampleCount = props.getSize("sampleCount", 4);
-		m_random = new Random();
+		m_seed = PCG32_DEFAULT_STATE + props.getSize("seed", 0);
+		m_stream = 1;
+		m_random.seed(m_seed);
 	}
 
 	IndependentSampler(Stream *stream, InstanceManager *manager)
 	 : Sampler(stream, manager) {
-		m_random = static_cast<Random *>(manager->getInstance(stream));
+		m_random.state = stream->readULong();
+		m_random.inc = stream->readULong();
+		m_seed = stream->readULong();
+		m_stream = stream->readULong();
 	}
 
 	void serialize(Stream *stream, InstanceManager *manager) const {
 		Sampler::serialize(stream, manager);
-		manager->serialize(stream, m_random.get());
+		stream->writeULong(m_random.state);
+		stream->writeULong(m_random.inc);
+		stream->writeULong(m_seed);
+		stream->writeULong(m_stream);
 	}
 
 	ref<Sampler> clone() {
 		ref<IndependentSampler> sampler = new IndependentSampler();
 		sampler->m_sampleCount = m_sampleCount;
-		sampler->m_random = new Random(m_random);
+		/* Derive a new state and stream from this generator */
+		sampler->m_seed = m_random.nextULong();
+		sampler->m_stream = m_random.nextULong();
+		sampler->m_random.seed(sampler->m_seed, sampler->m_stream);
 		for (size_t i=0; i<m_req1D.size(); ++i)
 			sampler->request1DArray(m_req1D[i]);
 		for (size_t i=0; i<m_req2D.size(); ++i)
@@ -81,27 +97,39 @@ public:
 
 	void generate(const Point2i &) {
 		for (size_t i=0; i<m_req1D.size(); i++)
-			for (size_t j=0; j<m_sampleCount * m_req1D[i]; ++j)
-				m_sampleArrays1D[i][j] = m_random->nextFloat();
+			m_random.nextFloats(m_sampleArrays1D[i], m_sampleCount * m_req1D[i]);
 		for (size_t i=0; i<m_req2D.size(); i++)
-			for (size_t j=0; j<m_sampleCount * m_req2D[i]; ++j)
-				m_sampleArrays2D[i][j] = Point2(
-					m_random->nextFloat(),
-					m_random->nextFloat());
+			m_random.nextFloats(reinterpret_cast<Float *>(m_sampleArrays2D[i]),
+				2 * m_sampleCount * m_req2D[i]);
 		m_sampleIndex = 0;
 		m_dimension1DArray = m_dimension2DArray = 0;
 	}
 
+	void setSampleRange(size_t start, size_t count) {
+		/* Every progressive pass draws from its own stream. Otherwise,
+		   a rendering that is resumed from a checkpoint would repeat
+		   the random numbers of the first pass */
+		if (start != m_sampleRangeStart)
+			m_random.seed(m_seed, m_stream + start);
+		Sampler::setSampleRange(start, count);
+	}
+
 	Float next1D() {
-		return m_random->nextFloat();
+		return m_random.nextFloat();
 	}
 
 	Point2 next2D() {
-		Float value1 = m_random->nextFloat();
-		Float value2 = m_random->nextFloat();
+		Float value1 = m_random.nextFloat();
+		Float value2 = m_random.nextFloat();
 		return Point2(value1, value2);
 	}
 
+	bool generate2DBlock(Point2 *dest, size_t dimCount) {
+		m_random.nextFloats(reinterpret_cast<Float *>(dest),
+			2 * m_sampleCount * dimCount);
+		return true;
+	}
+
 	std::string toString() const {
 		std::ostringstream oss;
 		oss << "IndependentSampler[" << endl
@@ -112,7 +140,8 @@ public:
 
 	MTS_DECLARE_CLASS()
 private:
-	ref<Random> m_random;
+	PCG32 m_random;
+	uint64_t m_seed, m_stream;
 };
 
 MTS_IMPLEMENT_CLASS_S(IndependentSampler, false, Sampler)
@@ -18,6 +18,7 @@
 
 #include <mitsuba/render/sampler.h>
 #include <mitsuba/core/qmc.h>
+#include <mitsuba/core/pcg32.h>
 
 MTS_NAMESPACE_BEGIN
 
@@ -55,7 +56,7 @@ MTS_NAMESPACE_BEGIN
  *
  * Roughly, the idea of this sampler is that all of the individual 2D sample dimensions are
  * first filled using the same (0, 2)-sequence, which is then randomly scrambled and permuted
- * using numbers generated by a Mersenne Twister pseudorandom number generator \cite{Saito2008SIMD}.
+ * using numbers generated by a PCG32 pseudorandom number generator.
  * Note that due to internal storage costs, low discrepancy samples are only provided
  * up to a certain dimension, after which independent sampling takes over.
  * The name of this plugin stems from the fact that (0, 2) sequences minimize the so-called
@@ -94,13 +95,15 @@ public:
 			m_samples2D[i] = new Point2[m_sampleCount];
 		}
 
-		m_random = new Random();
+		m_blockDimension = 0;
 	}
 
 	LowDiscrepancySampler(Stream *stream, InstanceManager *manager)
 	 : Sampler(stream, manager) {
-		m_random = static_cast<Random *>(manager->getInstance(stream));
+		m_random.state = stream->readULong();
+		m_random.inc = stream->readULong();
 		m_maxDimension = stream->readSize();
+		m_blockDimension = 0;
 
 		m_samples1D = new Float*[m_maxDimension];
 		m_samples2D = new Point2*[m_maxDimension];
@@ -121,7 +124,8 @@ public:
 
 	void serialize(Stream *stream, InstanceManager *manager) const {
 		Sampler::serialize(stream, manager);
-		manager->serialize(stream, m_random.get());
+		stream->writeULong(m_random.state);
+		stream->writeULong(m_random.inc);
 		stream->writeSize(m_maxDimension);
 	}
 
@@ -130,7 +134,10 @@ public:
 
 		sampler->m_sampleCount = m_sampleCount;
 		sampler->m_maxDimension = m_maxDimension;
-		sampler->m_random = new Random(m_random);
+		sampler->m_blockDimension = 0;
+		/* Derive a new state and stream from this generator */
+		uint64_t state = m_random.nextULong(), stream = m_random.nextULong();
+		sampler->m_random.seed(state, stream);
 		sampler->m_samples1D = new Float*[m_maxDimension];
 		sampler->m_samples2D = new Point2*[m_maxDimension];
 		for (size_t i=0; i<m_maxDimension; i++) {
@@ -147,16 +154,16 @@ public:
 
 	inline void generate1D(Float *samples, size_t sampleCount) {
 		#if defined(SINGLE_PRECISION)
-			uint32_t scramble = m_random->nextULong() & 0xFFFFFFFF;
+			uint32_t scramble = m_random.nextULong() & 0xFFFFFFFF;
 			for (size_t i = 0; i < sampleCount; ++i)
 				samples[i] = radicalInverse2Single((uint32_t) i, scramble);
 		#else
-			uint64_t scramble = m_random->nextULong();
+			uint64_t scramble = m_random.nextULong();
 			for (size_t i = 0; i < sampleCount; ++i)
 				samples[i] = radicalInverse2Double(i, scramble);
 		#endif
 
-		m_random->shuffle(samples, samples + sampleCount);
+		m_random.shuffle(samples, samples + sampleCount);
 	}
 
 	inline void generate2D(Point2 *samples, size_t sampleCount) {
@@ -166,20 +173,20 @@ public:
 				uint32_t dword[2];
 			} scramble;
 
-			scramble.qword = m_random->nextULong();
+			scramble.qword = m_random.nextULong();
 
 			for (size_t i = 0; i < sampleCount; ++i)
 				samples[i] = sample02Single((uint32_t) i, scramble.dword);
 		#else
 			uint64_t scramble[2];
-			scramble[0] = m_random->nextULong();
-			scramble[1] = m_random->nextULong();
+			scramble[0] = m_random.nextULong();
+			scramble[1] = m_random.nextULong();
 
 			for (size_t i = 0; i < sampleCount; ++i)
 				samples[i] = sample02Double(i, scramble);
 		#endif
 
-		m_random->shuffle(samples, samples + sampleCount);
+		m_random.shuffle(samples, samples + sampleCount);
 	}
 
 	void generate(const Point2i &) {
@@ -195,28 +202,51 @@ public:
 			generate2D(m_sampleArrays2D[i], m_sampleCount * m_req2D[i]);
 
 		m_sampleIndex = 0;
+		m_blockDimension = 0;
 		m_dimension1D = m_dimension2D = 0;
 		m_dimension1DArray = m_dimension2DArray = 0;
 	}
 
 	void advance() {
 		m_sampleIndex++;
-		m_dimension1D = m_dimension2D = 0;
+		m_dimension1D = 0;
+		m_dimension2D = m_blockDimension;
 		m_dimension1DArray = m_dimension2DArray = 0;
 	}
 
 	void setSampleIndex(size_t sampleIndex) {
 		m_sampleIndex = sampleIndex;
-		m_dimension1D = m_dimension2D = 0;
+		m_dimension1D = 0;
+		m_dimension2D = m_blockDimension;
 		m_dimension1DArray = m_dimension2DArray = 0;
 	}
 
+	bool generate2DBlock(Point2 *dest, size_t dimCount) {
+		/* The samples are already available in per-dimension tables */
+		for (size_t j=0; j<dimCount; ++j) {
+			if (j < m_maxDimension) {
+				const Point2 *samples = m_samples2D[j];
+				for (size_t i=0; i<m_sampleCount; ++i)
+					dest[i*dimCount + j] = samples[i];
+			} else {
+				for (size_t i=0; i<m_sampleCount; ++i) {
+					Float value1 = m_random.nextFloat();
+					Float value2 = m_random.nextFloat();
+					dest[i*dimCount + j] = Point2(value1, value2);
+				}
+			}
+		}
+		m_blockDimension = dimCount;
+		m_dimension2D = m_blockDimension;
+		return true;
+	}
+
 	Float next1D() {
 		Assert(m_sampleIndex < m_sampleCount);
 		if (m_dimension1D < m_maxDimension)
 			return m_samples1D[m_dimension1D++][m_sampleIndex];
 		else
-			return m_random->nextFloat();
+			return m_random.nextFloat();
 	}
 
 	Point2 next2D() {
@@ -224,7 +254,7 @@ public:
 		if (m_dimension2D < m_maxDimension)
 			return m_samples2D[m_dimension2D++][m_sampleIndex];
 		else
-			return Point2(m_random->nextFloat(), m_random->nextFloat());
+			return Point2(m_random.nextFloat(), m_random.nextFloat());
 	}
 
 	std::string toString() const {
@@ -238,10 +268,11 @@ public:
 
 	MTS_DECLARE_CLASS()
 private:
-	ref<Random> m_random;
+	PCG32 m_random;
 	size_t m_maxDimension;
 	size_t m_dimension1D;
 	size_t m_dimension2D;
+	size_t m_blockDimension;
 	Float **m_samples1D;
 	Point2 **m_samples2D;
 };
@@ -0,0 +1,339 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/sampler.h>
+#include <mitsuba/core/qmc.h>
+#include "sobolseq.h"
+
+/// Number of Sobol dimensions that are used before the sequence is padded
+#define MTS_OWENSOBOL_DIMENSIONS 4
+
+/// Number of samples that are generated together when filling sample arrays
+#define MTS_OWENSOBOL_LANES 8
+
+MTS_NAMESPACE_BEGIN
+
+namespace {
+	/// Reverse the bits of a 32-bit integer
+	inline uint32_t reverseBits(uint32_t n) {
+#if (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 2))) || defined(__clang__)
+		n = __builtin_bswap32(n);
+#else
+		n = (n << 16) | (n >> 16);
+		n = ((n & 0x00ff00ff) << 8) | ((n & 0xff00ff00) >> 8);
+#endif
+		n = ((n & 0x0f0f0f0f) << 4) | ((n & 0xf0f0f0f0) >> 4);
+		n = ((n & 0x33333333) << 2) | ((n & 0xcccccccc) >> 2);
+		n = ((n & 0x55555555) << 1) | ((n & 0xaaaaaaaa) >> 1);
+		return n;
+	}
+
+	/// Integer hash with good avalanche behavior (C. Wellons' "lowbias32")
+	inline uint32_t hash(uint32_t x) {
+		x ^= x >> 16;
+		x *= 0x7feb352dU;
+		x ^= x >> 15;
+		x *= 0x846ca68bU;
+		x ^= x >> 16;
+		return x;
+	}
+
+	inline uint32_t hashCombine(uint32_t seed, uint32_t value) {
+		return hash(seed ^ (value + 0x9e3779b9U + (seed << 6) + (seed >> 2)));
+	}
+
+	/**
+	 * \brief Nested uniform (Owen) scrambling of a 32-bit fixed point value
+	 *
+	 * Uses the hash-based formulation by Burley ("Practical Hash-based
+	 * Owen Scrambling", JCGT 2020), which builds on a permutation due to
+	 * Laine and Karras. Every bit is only affected by bits of higher
+	 * significance, which (after reversal) makes this equivalent to a
+	 * random permutation of each elementary interval.
+	 */
+	inline uint32_t nestedUniformScramble(uint32_t x, uint32_t seed) {
+		x = reverseBits(x);
+		x += seed;
+		x ^= x * 0x6c50b47cU;
+		x ^= x * 0xb82f1e52U;
+		x ^= x * 0xc7afe638U;
+		x ^= x * 0x8d22f6e6U;
+		return reverseBits(x);
+	}
+
+	/// Evaluate a dimension of the Sobol sequence as a 32-bit fixed point value
+	inline uint32_t sobol32(uint32_t index, uint32_t dimension) {
+		uint32_t result = 0;
+		for (uint32_t i = dimension * sobol::Matrices::size; index; index >>= 1, ++i) {
+			if (index & 1)
+				result ^= sobol::Matrices::matrices32[i];
+		}
+		return result;
+	}
+
+	/// Convert a 32-bit fixed point value into a floating point value in [0, 1)
+	inline Float toFloat(uint32_t value) {
+#if defined(SINGLE_PRECISION)
+		return std::min(value * (1.0f / 4294967296.0f), ONE_MINUS_EPS_FLT);
+#else
+		return value * (1.0 / 4294967296.0);
+#endif
+	}
+}
+
+/*!\plugin{owensobol}{Owen-scrambled Sobol QMC sampler}
+ * \order{7}
+ * \parameters{
+ *     \parameter{sampleCount}{\Integer}{
+ *       Number of samples per pixel \default{4}
+ *     }
+ *     \parameter{scramble}{\Integer}{
+ *       Seed value for the random scrambling. When rendering
+ *       an animation, simply set it to the current frame index. \default{0}
+ *     }
+ * }
+ *
+ * This plugin implements a randomized Quasi-Monte Carlo (QMC) sample generator
+ * based on the Sobol sequence with nested uniform (``Owen'') scrambling. The
+ * scrambling is realized using the hash-based construction by Burley, and
+ * each pixel receives its own independently scrambled sequence.
+ *
+ * In comparison to \pluginref{sobol}, this has several advantages:
+ * \begin{itemize}
+ * \item The error behaves like noise instead of manifesting as grid or
+ * moir\'e patterns, and for smooth integrands it converges faster than
+ * with the XOR-scrambling used by \pluginref{sobol}.
+ * \item Samples are generated in constant time, since the sequence does not
+ * have to be enumerated across the whole image. Sample arrays are generated
+ * several samples at a time.
+ * \item Only the first four Sobol dimensions are used; further dimensions
+ * are padded by randomly shuffling the sample index of each group of four
+ * dimensions. Hence, there is no limit on the path depth of the integrator.
+ * \end{itemize}
+ * Like the other QMC samplers, this sampler is completely deterministic,
+ * and best results are obtained when the number of samples per pixel is a
+ * power of two.
+ * \remarks{
+ *   \item This sampler is incompatible with Metropolis Light Transport (all variants).
+ * }
+ */
+class OwenSobolSampler : public Sampler {
+public:
+	OwenSobolSampler() : Sampler(Properties()) { }
+
+	OwenSobolSampler(const Properties &props) : Sampler(props) {
+		/* Number of samples per pixel when used with a sampling-based integrator */
+		m_sampleCount = props.getSize("sampleCount", 4);
+
+		/* Seed value, which can be used to obtain different
+		   scrambles when rendering the frames of an animation. */
+		m_scramble = hash((uint32_t) props.getSize("scramble", 0));
+
+		m_seed = m_scramble;
+		m_dimension = m_blockDimension = 0;
+	}
+
+	OwenSobolSampler(Stream *stream, InstanceManager *manager)
+	 : Sampler(stream, manager) {
+		m_scramble = stream->readUInt();
+		m_seed = m_scramble;
+		m_dimension = m_blockDimension = 0;
+	}
+
+	void serialize(Stream *stream, InstanceManager *manager) const {
+		Sampler::serialize(stream, manager);
+		stream->writeUInt(m_scramble);
+	}
+
+	ref<Sampler> clone() {
+		ref<OwenSobolSampler> sampler = new OwenSobolSampler();
+		sampler->m_sampleCount = m_sampleCount;
+		sampler->m_sampleIndex = m_sampleIndex;
+		sampler->m_scramble = m_scramble;
+		sampler->m_seed = m_seed;
+		sampler->m_dimension = m_dimension;
+		sampler->m_blockDimension = m_blockDimension;
+		for (size_t i=0; i<m_req1D.size(); ++i)
+			sampler->request1DArray(m_req1D[i]);
+		for (size_t i=0; i<m_req2D.size(); ++i)
+			sampler->request2DArray(m_req2D[i]);
+		return sampler.get();
+	}
+
+	void generate(const Point2i &pos) {
+		/* Every pixel uses an independently scrambled sequence */
+		m_seed = hashCombine(hashCombine(m_scramble, (uint32_t) pos.x), (uint32_t) pos.y);
+
+		/* Each array is stratified over all samples of the pixel and
+		   occupies its own padding group, which is numbered from the top
+		   so that it never coincides with the groups of next1D/next2D */
+		uint32_t group = 0xFFFFFFFFU;
+		for (size_t i=0; i<m_req1D.size(); i++)
+			generateArray(group--, m_sampleCount * m_req1D[i], m_sampleArrays1D[i], NULL);
+		for (size_t i=0; i<m_req2D.size(); i++)
+			generateArray(group--, m_sampleCount * m_req2D[i], NULL, m_sampleArrays2D[i]);
+
+		m_blockDimension = 0;
+		setSampleIndex(0);
+	}
+
+	void advance() {
+		setSampleIndex(m_sampleIndex + 1);
+	}
+
+	void setSampleIndex(size_t sampleIndex) {
+		m_sampleIndex = sampleIndex;
+		m_dimension1DArray = m_dimension2DArray = 0;
+		m_dimension = m_blockDimension;
+	}
+
+	bool generate2DBlock(Point2 *dest, size_t dimCount) {
+		uint32_t dimension = 0;
+		for (size_t j=0; j<dimCount; ++j) {
+			/* Don't let the two dimensions straddle a padding group (as in next2D()) */
+			if ((dimension % MTS_OWENSOBOL_DIMENSIONS) == MTS_OWENSOBOL_DIMENSIONS - 1)
+				++dimension;
+
+			const uint32_t group = dimension / MTS_OWENSOBOL_DIMENSIONS,
+			      dim = dimension % MTS_OWENSOBOL_DIMENSIONS,
+			      seed1 = hashCombine(m_seed, dimension),
+			      seed2 = hashCombine(m_seed, dimension + 1);
+
+			for (size_t i=0; i<m_sampleCount; ++i) {
+				uint32_t index = shuffledIndex(group, (uint32_t) i);
+				dest[i*dimCount + j] = Point2(
+					toFloat(nestedUniformScramble(sobol32(index, dim), seed1)),
+					toFloat(nestedUniformScramble(sobol32(index, dim + 1), seed2)));
+			}
+			dimension += 2;
+		}
+
+		m_blockDimension = dimension;
+		m_dimension = m_blockDimension;
+		return true;
+	}
+
+	Float next1D() {
+		return toFloat(sample(m_dimension++));
+	}
+
+	Point2 next2D() {
+		/* Don't let the two dimensions straddle a padding group */
+		if ((m_dimension % MTS_OWENSOBOL_DIMENSIONS) == MTS_OWENSOBOL_DIMENSIONS - 1)
+			++m_dimension;
+
+		uint32_t group = m_dimension / MTS_OWENSOBOL_DIMENSIONS,
+		         dim = m_dimension % MTS_OWENSOBOL_DIMENSIONS,
+		         index = shuffledIndex(group, (uint32_t) m_sampleIndex);
+
+		Point2 result(
+			toFloat(nestedUniformScramble(sobol32(index, dim),
+				hashCombine(m_seed, m_dimension))),
+			toFloat(nestedUniformScramble(sobol32(index, dim + 1),
+				hashCombine(m_seed, m_dimension + 1))));
+		m_dimension += 2;
+		return result;
+	}
+
+	std::string toString() const {
+		std::ostringstream oss;
+		oss << "OwenSobolSampler[" << endl
+			<< "  sampleCount = " << m_sampleCount << "," << endl
+			<< "  sampleIndex = " << m_sampleIndex << "," << endl
+			<< "  scramble = " << m_scramble << endl
+			<< "]";
+		return oss.str();
+	}
+
+	MTS_DECLARE_CLASS()
+protected:
+	/**
+	 * Randomly permute the sample indices of a padding group. This is
+	 * itself an Owen scramble, hence power-of-two prefixes of the
+	 * sequence keep their stratification.
+	 */
+	inline uint32_t shuffledIndex(uint32_t group, uint32_t index) const {
+		return nestedUniformScramble(index, hashCombine(m_seed, ~group));
+	}
+
+	/// Compute a single dimension of the current sample
+	inline uint32_t sample(uint32_t dimension) const {
+		uint32_t group = dimension / MTS_OWENSOBOL_DIMENSIONS,
+		         dim = dimension % MTS_OWENSOBOL_DIMENSIONS;
+		uint32_t index = shuffledIndex(group, (uint32_t) m_sampleIndex);
+		return nestedUniformScramble(sobol32(index, dim),
+			hashCombine(m_seed, dimension));
+	}
+
+	/**
+	 * Fill a 1D or 2D sample array using the first one or two dimensions
+	 * of the given padding group. The samples are processed in batches,
+	 * where every step is a simple loop over independent lanes that the
+	 * compiler can map onto SIMD instructions.
+	 */
+	void generateArray(uint32_t group, size_t count, Float *array1D, Point2 *array2D) const {
+		const uint32_t indexSeed = hashCombine(m_seed, ~group),
+		      seed0 = hashCombine(m_seed, hashCombine(group, 0)),
+		      seed1 = hashCombine(m_seed, hashCombine(group, 1));
+
+		uint32_t index[MTS_OWENSOBOL_LANES], v0[MTS_OWENSOBOL_LANES], v1[MTS_OWENSOBOL_LANES];
+
+		for (size_t base = 0; base < count; base += MTS_OWENSOBOL_LANES) {
+			const size_t lanes = std::min(count - base, (size_t) MTS_OWENSOBOL_LANES);
+
+			for (int j=0; j<MTS_OWENSOBOL_LANES; ++j)
+				index[j] = nestedUniformScramble((uint32_t) (base + j), indexSeed);
+
+			/* Accumulate the generator matrix columns bit by bit */
+			for (int j=0; j<MTS_OWENSOBOL_LANES; ++j)
+				v0[j] = v1[j] = 0;
+			for (uint32_t bit=0; bit<32; ++bit) {
+				const uint32_t c0 = sobol::Matrices::matrices32[bit],
+				               c1 = sobol::Matrices::matrices32[sobol::Matrices::size + bit];
+				for (int j=0; j<MTS_OWENSOBOL_LANES; ++j) {
+					uint32_t mask = 0U - ((index[j] >> bit) & 1);
+					v0[j] ^= c0 & mask;
+					v1[j] ^= c1 & mask;
+				}
+			}
+
+			for (int j=0; j<MTS_OWENSOBOL_LANES; ++j) {
+				v0[j] = nestedUniformScramble(v0[j], seed0);
+				v1[j] = nestedUniformScramble(v1[j], seed1);
+			}
+
+			if (array1D) {
+				for (size_t j=0; j<lanes; ++j)
+					array1D[base + j] = toFloat(v0[j]);
+			} else {
+				for (size_t j=0; j<lanes; ++j)
+					array2D[base + j] = Point2(toFloat(v0[j]), toFloat(v1[j]));
+			}
+		}
+	}
+
+private:
+	uint32_t m_scramble;
+	uint32_t m_seed;
+	uint32_t m_dimension;
+	uint32_t m_blockDimension;
+};
+
+MTS_IMPLEMENT_CLASS_S(OwenSobolSampler, false, Sampler)
+MTS_EXPORT_PLUGIN(OwenSobolSampler, "Owen-scrambled Sobol QMC sampler");
+MTS_NAMESPACE_END
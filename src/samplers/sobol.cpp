@@ -104,6 +104,7 @@ public:
 		m_resolution = 1; m_logResolution = 0;
 		m_arrayStartDim = m_arrayEndDim = 5;
 		m_pixelPosition = Point2i(0);
+		m_blockDimension = 0;
 	}
 
 	SobolSampler(Stream *stream, InstanceManager *manager)
@@ -114,6 +115,7 @@ public:
 		m_arrayStartDim = stream->readUInt();
 		m_arrayEndDim = stream->readUInt();
 		m_pixelPosition = Point2i(0);
+		m_blockDimension = 0;
 	}
 
 	void serialize(Stream *stream, InstanceManager *manager) const {
@@ -131,6 +133,7 @@ public:
 		sampler->m_sampleIndex = m_sampleIndex;
 		sampler->m_sobolSampleIndex = m_sobolSampleIndex;
 		sampler->m_dimension = m_dimension;
+		sampler->m_blockDimension = m_blockDimension;
 		sampler->m_scramble = m_scramble;
 		sampler->m_resolution = m_resolution;
 		sampler->m_logResolution = m_logResolution;
@@ -170,6 +173,8 @@ public:
 
 	void generate(const Point2i &pos) {
 		m_pixelPosition = pos;
+		m_blockDimension = 0;
+		m_blockIndices.clear();
 		setSampleIndex(0);
 
 		/* Dimensions reserved to sample array requests */
@@ -202,11 +207,14 @@ public:
 	}
 
 	void setSampleIndex(size_t sampleIndex) {
-		m_dimension = 0;
+		m_dimension = m_blockDimension;
 		m_dimension1DArray = m_dimension2DArray = 0;
 		m_sampleIndex = sampleIndex;
 
-		if (m_logResolution > 1 && m_pixelPosition.x >= 0) {
+		if (m_sampleIndex < m_blockIndices.size()) {
+			/* Reuse the index found by generate2DBlock() */
+			m_sobolSampleIndex = m_blockIndices[m_sampleIndex];
+		} else if (m_logResolution > 1 && m_pixelPosition.x >= 0) {
 			/* Find the next sample that is located in the current pixel */
 			m_sobolSampleIndex = sobol::look_up(m_logResolution, (uint32_t) m_sampleIndex,
 					m_pixelPosition.x, m_pixelPosition.y, m_scramble);
@@ -215,6 +223,44 @@ public:
 		}
 	}
 
+	bool generate2DBlock(Point2 *dest, size_t dimCount) {
+		/* Look up the sequence index of every sample only once. The
+		   indices are kept until the next call to generate(), so that
+		   setSampleIndex() and advance() can reuse them */
+		m_blockIndices.resize(m_sampleCount);
+		bool lookUp = m_logResolution > 1 && m_pixelPosition.x >= 0;
+		for (size_t i=0; i<m_sampleCount; ++i)
+			m_blockIndices[i] = lookUp ? sobol::look_up(m_logResolution, (uint32_t) i,
+				m_pixelPosition.x, m_pixelPosition.y, m_scramble) : (uint64_t) i;
+
+		uint32_t dim = 0;
+		for (size_t j=0; j<dimCount; ++j) {
+			/* Skip over dimensions that were reserved to arrays (as in next2D()) */
+			if (dim + 1 >= m_arrayStartDim && dim < m_arrayEndDim)
+				dim = m_arrayEndDim;
+
+			if (dim + 1 >= sobol::Matrices::num_dimensions)
+				Log(EError, "Lookup dimension exceeds the direction number table size! You "
+					"may have to reduce the 'maxDepth' parameter of your integrator.");
+
+			for (size_t i=0; i<m_sampleCount; ++i) {
+				uint64_t index = m_blockIndices[i];
+				Float value1 = sobol::sample(index, dim, m_scramble),
+				      value2 = sobol::sample(index, dim+1, m_scramble);
+				if (dim == 0 && index != (uint64_t) i) {
+					value1 = value1 * m_resolution - m_pixelPosition.x;
+					value2 = value2 * m_resolution - m_pixelPosition.y;
+				}
+				dest[i*dimCount + j] = Point2(value1, value2);
+			}
+			dim += 2;
+		}
+
+		m_blockDimension = dim;
+		m_dimension = m_blockDimension;
+		return true;
+	}
+
 	Float next1D() {
 		/* Skip over dimensions that were reserved to arrays */
 		if (m_dimension >= m_arrayStartDim && m_dimension < m_arrayEndDim)
@@ -263,6 +309,8 @@ public:
 	MTS_DECLARE_CLASS()
 private:
 	uint32_t m_dimension;
+	uint32_t m_blockDimension;
+	std::vector<uint64_t> m_blockIndices;
 	uint64_t m_scramble;
 	uint64_t m_sobolSampleIndex;
 	Float m_resolution;
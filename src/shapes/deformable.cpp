@@ -24,9 +24,6 @@
 #include <mitsuba/core/mstream.h>
 #include <mitsuba/core/mmap.h>
 
-#define SHAPE_PER_SEGMENT 1
-#define NO_CLIPPING_SUPPORT 1
-
 MTS_NAMESPACE_BEGIN
 
 class SpaceTimeKDTree : public SAHKDTree4D<SpaceTimeKDTree> {
@@ -178,86 +175,137 @@ public:
 		return (IndexType) (it - m_shapeMap.begin());
 	}
 
+	/// Return the index of a sub-mesh referenced by an intersection record
+	inline IndexType findMesh(const Shape *shape) const {
+		const std::vector<const TriMesh *> &meshes = m_meshes[0];
+		return (IndexType) (std::find(meshes.begin(), meshes.end(), shape) - meshes.begin());
+	}
+
 	inline IndexType findFrame(Float time) const {
 		return (IndexType) std::min(std::max((int) (std::lower_bound(
-			m_times.begin(), m_times.end(), time) - m_times.begin()) - 1, 0), (int) m_times.size()-1);
+			m_times.begin(), m_times.end(), time) - m_times.begin()) - 1, 0), (int) m_times.size()-2);
 	}
 
 	// ========================================================================
 	//    Implementation of functions required by the parent class
 	// ========================================================================
 
-	/// Return the total number of primitives that are organized in the tree
+	/**
+	 * \brief Return the total number of primitives that are organized in the tree
+	 *
+	 * Every triangle is split into one primitive per time segment
+	 * between two frames. Their 4D bounding boxes only cover the
+	 * motion during that segment, which allows the construction
+	 * to separate the frames using time splits.
+	 */
 	inline SizeType getPrimitiveCount() const {
+		return getTriangleCount() * (SizeType) (m_times.size() - 1);
+	}
+
+	/// Return the number of animated triangles
+	inline SizeType getTriangleCount() const {
 		return m_shapeMap[m_shapeMap.size()-1];
 	}
 
+	/// Turn a primitive index into a triangle index and return its time segment
+	inline IndexType findSegment(IndexType &index) const {
+		IndexType segment = index / getTriangleCount();
+		index -= segment * getTriangleCount();
+		return segment;
+	}
+
 	/// Return the 4D extents for one of the primitives contained in the tree
 	AABB4 getAABB(IndexType index) const {
+		IndexType segment = findSegment(index);
 		IndexType shapeIndex = findShape(index);
 		const Triangle &tri = m_meshes[0][shapeIndex]->getTriangles()[index];
 
 		AABB aabb;
-		for (size_t frame=0; frame<m_times.size(); ++frame) {
+		for (IndexType frame=segment; frame<=segment+1; ++frame) {
 			const Point *pos = m_meshes[frame][shapeIndex]->getVertexPositions();
 			for (int j=0; j<3; ++j)
 				aabb.expandBy(pos[tri.idx[j]]);
 		}
 
 		return AABB4(
-			Point4(aabb.min.x, aabb.min.y, aabb.min.z, m_times[0]),
-			Point4(aabb.max.x, aabb.max.y, aabb.max.z, m_times[m_times.size()-1])
+			Point4(aabb.min.x, aabb.min.y, aabb.min.z, m_times[segment]),
+			Point4(aabb.max.x, aabb.max.y, aabb.max.z, m_times[segment+1])
 		);
 	}
 
-	/// Return a clipped 4D AABB for one of the primitives contained in the tree
+	/**
+	 * \brief Return a clipped 4D AABB for one of the primitives contained in the tree
+	 *
+	 * Since the vertices move linearly during a time segment, the
+	 * triangle is contained in the bounds of its interpolated positions
+	 * at the ends of the time interval of \c box. The triangles
+	 * themselves are not clipped, since this would not bound the
+	 * volume swept between the two ends.
+	 */
 	AABB4 getClippedAABB(IndexType index, const AABB4 &box) const {
-		AABB clip(
-			Point(box.min.x, box.min.y, box.min.z),
-			Point(box.max.x, box.max.y, box.max.z)
-		);
-#if 0
-		int startIndex = findFrame(box.min.w),
-			endIndex   = findFrameUpperBound(box.max.w);
-
-		AABB4 result;
+		IndexType segment = findSegment(index);
 		IndexType shapeIndex = findShape(index);
 		const Triangle &tri = m_meshes[0][shapeIndex]->getTriangles()[index];
+		Float start = std::max(box.min.w, m_times[segment]),
+		      end   = std::min(box.max.w, m_times[segment+1]);
+		if (start > end)
+			return AABB4();
 
-		for (int frame=startIndex; frame<=endIndex; ++frame) {
-			const Point *pos = m_meshes[frame][shapeIndex]->getVertexPositions();
-			AABB aabb = tri.getClippedAABB(pos, clip);
-			if (aabb.isValid()) {
-				result.expandBy(Point4(aabb.min.x, aabb.min.y, aabb.min.z, m_times[frame]));
-				result.expandBy(Point4(aabb.max.x, aabb.max.y, aabb.max.z, m_times[frame]));
-			}
+		AABB aabb;
+		Point p[3];
+		for (int i=0; i<2; ++i) {
+			interpolate(segment, shapeIndex, tri, getAlpha(segment, i == 0 ? start : end), p);
+			for (int j=0; j<3; ++j)
+				aabb.expandBy(p[j]);
 		}
-#endif
 
-		AABB4 result = getAABB(index);
+		AABB4 result(
+			Point4(aabb.min.x, aabb.min.y, aabb.min.z, start),
+			Point4(aabb.max.x, aabb.max.y, aabb.max.z, end)
+		);
 		result.clip(box);
 		return result;
 	}
 
+	/// Return the interpolation weight of the second frame of a time segment
+	inline Float getAlpha(IndexType segment, Float time) const {
+		return std::max((Float) 0.0f, std::min((Float) 1.0f,
+			(time - m_times[segment]) / (m_times[segment + 1] - m_times[segment])));
+	}
+
+	/**
+	 * \brief Check whether a ray's time value lies within a time segment
+	 *
+	 * The first and last segments also handle the times before
+	 * and after the animation, respectively.
+	 */
+	inline bool containsTime(IndexType segment, Float time) const {
+		return (segment == 0 || time >= m_times[segment]) &&
+			(segment + 2 == m_times.size() || time <= m_times[segment + 1]);
+	}
+
+	/// Compute the positions of an animated triangle at the given time
+	inline void interpolate(IndexType segment, IndexType shapeIndex,
+			const Triangle &tri, Float alpha, Point *p) const {
+		const Point *pos0 = m_meshes[segment  ][shapeIndex]->getVertexPositions();
+		const Point *pos1 = m_meshes[segment+1][shapeIndex]->getVertexPositions();
+		for (int i=0; i<3; ++i)
+			p[i] = (1 - alpha) * pos0[tri.idx[i]] + alpha * pos1[tri.idx[i]];
+	}
+
 	/// Cast a normal (i.e. non-shadow) ray against a specific animated triangle
 	inline bool intersect(const Ray &ray, IndexType index,
 			Float mint, Float maxt, Float &t, void *tmp) const {
 		IntersectionCache *cache = static_cast<IntersectionCache *>(tmp);
+		IndexType frameIndex = findSegment(index);
+		if (!containsTime(frameIndex, ray.time))
+			return false;
 		IndexType shapeIndex = findShape(index);
-		IndexType frameIndex = findFrame(ray.time);
-		Float alpha = std::max((Float) 0.0f, std::min((Float) 1.0f,
-			(ray.time - m_times[frameIndex])
-			/ (m_times[frameIndex + 1] - m_times[frameIndex])));
+		Float alpha = getAlpha(frameIndex, ray.time);
 
 		const Triangle &tri = m_meshes[0][shapeIndex]->getTriangles()[index];
-
-		const Point *pos0 = m_meshes[frameIndex  ][shapeIndex]->getVertexPositions();
-		const Point *pos1 = m_meshes[frameIndex+1][shapeIndex]->getVertexPositions();
-
-		/* Compute interpolated positions */
 		Point p[3];
-		for (int i=0; i<3; ++i)
-			p[i] = (1 - alpha) * pos0[tri.idx[i]] + alpha * pos1[tri.idx[i]];
+		interpolate(frameIndex, shapeIndex, tri, alpha, p);
 
 		Float tempU, tempV, tempT;
 		if (!Triangle::rayIntersect(p[0], p[1], p[2], ray, tempU, tempV, tempT))
@@ -278,21 +326,15 @@ public:
 
 	/// Cast a shadow ray against a specific triangle
 	inline bool intersect(const Ray &ray, IndexType index, Float mint, Float maxt) const {
+		IndexType frameIndex = findSegment(index);
+		if (!containsTime(frameIndex, ray.time))
+			return false;
 		IndexType shapeIndex = findShape(index);
-		const Triangle &tri = m_meshes[0][shapeIndex]->getTriangles()[index];
-
-		IndexType frameIndex = findFrame(ray.time);
-		Float alpha = std::max((Float) 0.0f, std::min((Float) 1.0f,
-			(ray.time - m_times[frameIndex])
-			/ (m_times[frameIndex + 1] - m_times[frameIndex])));
-
-		const Point *pos0 = m_meshes[frameIndex  ][shapeIndex]->getVertexPositions();
-		const Point *pos1 = m_meshes[frameIndex+1][shapeIndex]->getVertexPositions();
+		Float alpha = getAlpha(frameIndex, ray.time);
 
-		/* Compute interpolated positions */
+		const Triangle &tri = m_meshes[0][shapeIndex]->getTriangles()[index];
 		Point p[3];
-		for (int i=0; i<3; ++i)
-			p[i] = (1 - alpha) * pos0[tri.idx[i]] + alpha * pos1[tri.idx[i]];
+		interpolate(frameIndex, shapeIndex, tri, alpha, p);
 
 		Float tempU, tempV, tempT;
 		if (!Triangle::rayIntersect(p[0], p[1], p[2], ray, tempU, tempV, tempT))
@@ -508,7 +550,6 @@ public:
 		its.shape = m_kdtree->getMesh(0, cache->shapeIndex);
 		its.hasUVPartials = false;
 		its.primIndex = cache->primIndex;
-		its.other = cache->shapeIndex;
 		its.instance = this;
 		its.time = ray.time;
 	}
@@ -522,7 +563,7 @@ public:
 			(its.time - times[frameIndex])
 			/ (times[frameIndex + 1] - times[frameIndex])));
 
-		uint32_t primIndex = its.primIndex, shapeIndex = its.other;
+		uint32_t primIndex = its.primIndex, shapeIndex = m_kdtree->findMesh(its.shape);
 		const TriMesh *trimesh0 = m_kdtree->getMesh(frameIndex,   shapeIndex);
 		const TriMesh *trimesh1 = m_kdtree->getMesh(frameIndex+1, shapeIndex);
 		const Point *vertexPositions0 = trimesh0->getVertexPositions();
@@ -614,7 +655,7 @@ public:
 		const std::vector<Float> &times = m_kdtree->getTimes();
 
 		cache.primIndex = its.primIndex;
-		cache.shapeIndex = its.other;
+		cache.shapeIndex = m_kdtree->findMesh(its.shape);
 		cache.frameIndex = m_kdtree->findFrame(its.time);
 		cache.alpha = std::max((Float) 0.0f, std::min((Float) 1.0f,
 			(its.time - times[cache.frameIndex])
@@ -655,11 +696,11 @@ public:
 	}
 
 	size_t getPrimitiveCount() const {
-		return m_kdtree->getPrimitiveCount();
+		return m_kdtree->getTriangleCount();
 	}
 
 	size_t getEffectivePrimitiveCount() const {
-		return m_kdtree->getPrimitiveCount();
+		return m_kdtree->getTriangleCount();
 	}
 
 	void addChild(const std::string &name, ConfigurableObject *child) {
@@ -676,7 +717,7 @@ public:
 	std::string toString() const {
 		std::ostringstream oss;
 		oss << "Deformable[" << endl
-			<< "   primitiveCount = " << m_kdtree->getPrimitiveCount() << "," << endl
+			<< "   primitiveCount = " << m_kdtree->getTriangleCount() << "," << endl
 			<< "   timeCount = " << m_kdtree->getTimeCount() << "," << endl
 			<< "   aabb = " << indent(m_kdtree->getSpatialAABB().toString()) << endl
 			<< "]";
@@ -25,9 +25,23 @@
 #include <mitsuba/core/properties.h>
 #include <mitsuba/core/fstream.h>
 #include <mitsuba/core/fresolver.h>
+#include <mitsuba/core/timer.h>
+
+#if defined(MTS_SSE)
+#include <mitsuba/core/sse.h>
+#endif
 
 #define MTS_HAIR_USE_FANCY_CLIPPING 1
 
+/// Maximum number of consecutive segments of a strand stored in a BVH leaf
+#define MTS_HAIR_MAX_BUNDLE_SIZE 4
+
+/// Number of bins used to find SAH splits of the hair BVH
+#define MTS_HAIR_BVH_BINS 16
+
+/// Maximum depth of the 4-wide hair BVH (limits the traversal stack)
+#define MTS_HAIR_BVH_MAX_DEPTH 64
+
 MTS_NAMESPACE_BEGIN
 
 /*!\plugin{hair}{Hair intersection shape}
@@ -59,6 +73,18 @@ MTS_NAMESPACE_BEGIN
  *        Note that non-uniform scales are not permitted!
  *        \default{none, i.e. object space $=$ world space}
  *     }
+ *     \parameter{accel}{\String}{
+ *       Acceleration data structure used to find intersections with the
+ *       hair segments. Must be one of \texttt{kdtree} and \texttt{bvh}
+ *       (see below). \default{\texttt{kdtree}}
+ *     }
+ *     \parameter{bundleSize}{\Integer}{
+ *       Maximum number of consecutive segments of a strand that are
+ *       stored in a leaf of the BVH (between 1 and 4). Larger values
+ *       further reduce the memory usage and construction time at
+ *       the cost of slower intersection queries. Only used with
+ *       \texttt{accel=bvh}. \default{2}
+ *     }
  * }
  * \renderings{
  *     \centering
@@ -96,6 +122,14 @@ MTS_NAMESPACE_BEGIN
  * single-precision XYZ coordinates (again in little-endian byte ordering).
  * To mark the beginning of a new hair strand, a single $+\infty$ floating
  * point value can be inserted between the vertex data.
+ *
+ * By default, the segments are stored in a kd-tree with tightly clipped
+ * bounds, which leads to fast rendering but is expensive to construct.
+ * For groomed characters with millions of strands, \texttt{accel=bvh}
+ * selects a 4-wide bounding volume hierarchy over bundles of consecutive
+ * segments instead. It is built in a fraction of the time, needs
+ * considerably less memory, and tests the segments of a bundle
+ * against the ray simultaneously. Both find the same intersections.
  */
 
 class HairKDTree : public SAHKDTree3D<HairKDTree> {
@@ -105,23 +139,38 @@ public:
 	using SAHKDTree3D<HairKDTree>::IndexType;
 	using SAHKDTree3D<HairKDTree>::SizeType;
 
+	/**
+	 * \brief Take the supplied vertex & start fiber arrays and build
+	 * a kd-tree over the hair segments
+	 *
+	 * When \c build is \c false, only the geometry is stored and the
+	 * intersection routines are used by a different acceleration
+	 * structure (see \ref HairBVH).
+	 */
 	HairKDTree(std::vector<Point> &vertices,
-			std::vector<bool> &vertexStartsFiber, Float radius)
-			: m_radius(radius) {
+			std::vector<bool> &vertexStartsFiber, Float radius,
+			bool build = true) : m_radius(radius) {
 		/* Take the supplied vertex & start fiber arrays (without copying) */
 		m_vertices.swap(vertices);
 		m_vertexStartsFiber.swap(vertexStartsFiber);
 		m_hairCount = 0;
+		m_segmentCount = 0;
 
 		/* Compute the index of the first vertex in each segment. */
-		m_segIndex.reserve(m_vertices.size());
+		if (build)
+			m_segIndex.reserve(m_vertices.size());
 		for (size_t i=0; i<m_vertices.size()-1; i++) {
 			if (m_vertexStartsFiber[i])
 				m_hairCount++;
-			if (!m_vertexStartsFiber[i+1])
-				m_segIndex.push_back((IndexType) i);
+			if (!m_vertexStartsFiber[i+1]) {
+				if (build)
+					m_segIndex.push_back((IndexType) i);
+				m_segmentCount++;
+			}
 		}
-		m_segmentCount = m_segIndex.size();
+
+		if (!build)
+			return;
 
 		Log(EDebug, "Building a kd-tree for " SIZE_T_FMT " hair vertices, "
 			SIZE_T_FMT " segments, " SIZE_T_FMT " hairs",
@@ -145,8 +194,8 @@ public:
 		Log(EDebug, "Total amount of storage (kd-tree & vertex data): %s",
 			memString(m_nodeCount * sizeof(KDNode)
 			+ m_indexCount * sizeof(IndexType)
-			+ vertices.size() * sizeof(Point)
-			+ vertexStartsFiber.size() / 8).c_str());
+			+ m_vertices.size() * sizeof(Point)
+			+ m_vertexStartsFiber.size() / 8).c_str());
 
 		/* Optimization: replace all primitive indices by the
 		   associated vertex indices (this avoids an extra
@@ -472,6 +521,28 @@ public:
 	}
 #endif
 
+	/**
+	 * \brief Compute a conservative AABB of the segment starting
+	 * at vertex \c iv, including the parts up to the miter planes
+	 */
+	AABB getSegmentAABB(IndexType iv) const {
+		/* Cosine of the steepest miter angle. Nearly reversing
+		   strands have degenerate miter planes, clamp to keep
+		   the box finite */
+		Float minCos = std::min(dot(firstMiterNormal(iv), tangent(iv)),
+			dot(secondMiterNormal(iv), tangent(iv)));
+		if (!(minCos > Epsilon))
+			minCos = Epsilon;
+		const Vector expandVec(m_radius * (1 + Epsilon) / minCos);
+
+		AABB aabb;
+		aabb.expandBy(firstVertex(iv) - expandVec);
+		aabb.expandBy(firstVertex(iv) + expandVec);
+		aabb.expandBy(secondVertex(iv) - expandVec);
+		aabb.expandBy(secondVertex(iv) + expandVec);
+		return aabb;
+	}
+
 	/// Return the total number of segments
 	inline SizeType getPrimitiveCount() const {
 		return (SizeType) m_segIndex.size();
@@ -606,10 +677,738 @@ protected:
 	Float m_radius;
 };
 
+/// Ray data shared by all node and segment tests of a hair BVH query
+struct HairBVHRay {
+#if defined(MTS_SSE)
+	__m128 o[3], d[3], dRcp[3];
+#else
+	Float o[3], d[3], dRcp[3];
+#endif
+	int neg[3];
+
+	inline HairBVHRay(const Ray &ray) {
+		for (int axis=0; axis<3; ++axis) {
+#if defined(MTS_SSE)
+			o[axis] = _mm_set1_ps(ray.o[axis]);
+			d[axis] = _mm_set1_ps(ray.d[axis]);
+			dRcp[axis] = _mm_set1_ps(ray.dRcp[axis]);
+#else
+			o[axis] = ray.o[axis];
+			d[axis] = ray.d[axis];
+			dRcp[axis] = ray.dRcp[axis];
+#endif
+			neg[axis] = ray.d[axis] < 0 ? 1 : 0;
+		}
+	}
+};
+
+/**
+ * \brief 4-wide bounding volume hierarchy over bundles of hair segments
+ *
+ * The kd-tree above produces very tight bounds, but its construction
+ * clips every segment against every node it overlaps, which is slow for
+ * groomed characters with millions of strands, and it stores one index
+ * per segment and node reference. This hierarchy instead groups up to
+ * \ref MTS_HAIR_MAX_BUNDLE_SIZE consecutive segments of a strand into a
+ * bundle and builds a binned SAH BVH over the bundles. Each leaf holds a
+ * single bundle, which is referenced by the index of its first vertex,
+ * so that no primitive index list is needed at all, and the child bounds
+ * of every node are quantized to 8 bits. Larger bundles need fewer nodes
+ * but have looser bounds.
+ *
+ * The bundle's segments are first tested against the ray all at once
+ * in single precision (using SSE when available), using their cylinders
+ * bounded by the largest extension of any miter joint, and only the
+ * remaining candidates are intersected with
+ * the exact double precision routine of \ref HairKDTree. The geometry
+ * and the resulting intersections are thus identical for both
+ * structures.
+ */
+class HairBVH : public Object {
+public:
+	typedef HairKDTree::IndexType IndexType;
+
+	/**
+	 * \brief Build a hierarchy over the segments stored in \c geometry
+	 * using bundles of up to \c bundleSize segments
+	 */
+	HairBVH(const HairKDTree *geometry, int bundleSize);
+
+	/// Return the maximum number of segments per leaf
+	inline int getBundleSize() const { return m_bundleSize; }
+
+	/// Return the AABB of all segments
+	inline const AABB &getAABB() const { return m_aabb; }
+
+	/// Return the number of 4-wide nodes
+	inline size_t getNodeCount() const { return m_nodeCount; }
+
+	/// Return the amount of memory used by the hierarchy (excluding the vertices)
+	inline size_t getMemoryUsage() const { return m_nodeCount * sizeof(Node); }
+
+	/// Intersect a ray with all segments stored in the hierarchy
+	bool rayIntersect(const Ray &ray, Float mint, Float maxt,
+			Float &t, void *temp) const;
+
+	/// Visibility query version of \ref rayIntersect()
+	bool rayIntersect(const Ray &ray, Float mint, Float maxt) const;
+
+	MTS_DECLARE_CLASS()
+protected:
+	/// Virtual destructor
+	virtual ~HairBVH();
+
+	/// Consecutive segments of a strand that are stored in a single leaf
+	struct Bundle {
+		IndexType iv;
+		uint32_t count;
+	};
+
+	/// Build range of bundle indices
+	struct BuildRange {
+		uint32_t start, end;
+		AABB aabb;
+
+		inline BuildRange() { }
+		inline BuildRange(uint32_t start, uint32_t end, const AABB &aabb)
+			: start(start), end(end), aabb(aabb) { }
+		inline uint32_t size() const { return end - start; }
+	};
+
+	/**
+	 * \brief A node with four children, whose bounding boxes are
+	 * quantized to 8 bits relative to the bounds of the node, so
+	 * that it fits into a single cache line
+	 *
+	 * A child with \c ELeafFlag set is a leaf containing
+	 * <tt>(child \& 3) + 1</tt> segments starting at vertex
+	 * <tt>(child \& ~ELeafFlag) >> 2</tt>. Otherwise, \c child
+	 * is the index of an interior node or \c EEmpty.
+	 */
+	struct Node {
+		enum {
+			ELeafFlag = 0x80000000,
+			EEmpty = 0xFFFFFFFF
+		};
+
+		/// Quantization grid of the child bounds
+		float origin[3], scale[3];
+		/// Quantized bounding boxes indexed by [min/max][axis][child]
+		uint8_t bounds[2][3][4];
+		uint32_t child[4];
+
+		/// Quantize the bounds of the four children (invalid boxes mark empty children)
+		void setBounds(const AABB *aabbs);
+
+		/// Return the position of a quantized bound along an axis
+		inline float dequantize(int axis, int value) const {
+			return origin[axis] + (float) value * scale[axis];
+		}
+	};
+
+	/**
+	 * Intersect a ray segment against the four child boxes of a node. Returns
+	 * a bit mask of the children that were hit and their entry distances.
+	 */
+	static int intersectNode(const Node &node, const HairBVHRay &ray,
+		Float mint, Float maxt, Float *tNear);
+
+	/**
+	 * \brief Find a binned SAH split (or a median split when
+	 * \c median is set) of the given range of bundles
+	 */
+	void split(const BuildRange &range, bool median,
+		BuildRange &left, BuildRange &right);
+
+	/// Recursively build the subtree for the given range
+	void buildNode(uint32_t nodeIndex, const BuildRange &range, int depth);
+
+	/**
+	 * \brief Return a mask of the segments of a bundle whose
+	 * (slightly enlarged) cylinders may be hit by the ray within
+	 * the given interval. \c tNear is the entry distance of the
+	 * ray into the leaf's bounding box.
+	 */
+	int intersectBundle(const HairBVHRay &ray, IndexType iv, uint32_t count,
+		Float tNear, Float mint, Float maxt) const;
+private:
+	const HairKDTree *m_geometry;
+	std::vector<Bundle> m_bundles;
+	std::vector<AABB> m_bundleAABBs;
+	std::vector<Point> m_centroids;
+	std::vector<uint32_t> m_indices;
+	Node *m_nodes;
+	size_t m_nodeCount, m_nodeCapacity;
+	AABB m_aabb;
+	Float m_radius;
+	Float m_miterExtent;
+	int m_bundleSize;
+};
+
+/* Node bounds are stored in single precision -- round them outwards */
+static inline float roundDown(Float value) {
+	float result = (float) value;
+	if ((Float) result > value)
+		result = std::nextafter(result, -std::numeric_limits<float>::infinity());
+	return result;
+}
+
+static inline float roundUp(Float value) {
+	float result = (float) value;
+	if ((Float) result < value)
+		result = std::nextafter(result, std::numeric_limits<float>::infinity());
+	return result;
+}
+
+void HairBVH::Node::setBounds(const AABB *aabbs) {
+	AABB aabb;
+	for (int i=0; i<4; ++i) {
+		if (aabbs[i].isValid())
+			aabb.expandBy(aabbs[i]);
+	}
+
+	for (int axis=0; axis<3; ++axis) {
+		/* Choose a grid that is guaranteed to cover the whole node */
+		float max = roundUp(aabb.max[axis]);
+		origin[axis] = roundDown(aabb.min[axis]);
+		scale[axis] = (max - origin[axis]) / 255;
+		while (dequantize(axis, 255) < max)
+			scale[axis] = std::nextafter(scale[axis], std::numeric_limits<float>::infinity());
+
+		/* Round the child bounds outwards, the decoded values are checked
+		   since the above divisions are not exact */
+		for (int i=0; i<4; ++i) {
+			if (!aabbs[i].isValid()) {
+				bounds[0][axis][i] = 255;
+				bounds[1][axis][i] = 0;
+				continue;
+			}
+			int qmin = 0, qmax = 0;
+			if (scale[axis] > 0) {
+				qmin = std::max(0, std::min(255, (int) std::floor(
+					(aabbs[i].min[axis] - origin[axis]) / scale[axis])));
+				qmax = std::max(0, std::min(255, (int) std::ceil(
+					(aabbs[i].max[axis] - origin[axis]) / scale[axis])));
+			}
+			while (qmin > 0 && dequantize(axis, qmin) > aabbs[i].min[axis])
+				--qmin;
+			while (qmax < 255 && dequantize(axis, qmax) < aabbs[i].max[axis])
+				++qmax;
+			bounds[0][axis][i] = (uint8_t) qmin;
+			bounds[1][axis][i] = (uint8_t) qmax;
+		}
+	}
+}
+
+#if defined(MTS_SSE)
+/// Decode the quantized bounds of four children along an axis
+static FINLINE __m128 dequantize4(const uint8_t *values, __m128 origin, __m128 scale) {
+	int32_t packed;
+	memcpy(&packed, values, sizeof(int32_t));
+	__m128i zero = _mm_setzero_si128();
+	__m128i ints = _mm_unpacklo_epi16(_mm_unpacklo_epi8(
+		_mm_cvtsi32_si128(packed), zero), zero);
+	return _mm_add_ps(origin, _mm_mul_ps(_mm_cvtepi32_ps(ints), scale));
+}
+#endif
+
+int HairBVH::intersectNode(const Node &node, const HairBVHRay &ray,
+		Float mint, Float maxt, Float *tNear) {
+	/* NaNs due to rays in the plane of a box face are resolved conservatively */
+	const float robust = 1.0f + 4 * std::numeric_limits<float>::epsilon();
+#if defined(MTS_SSE)
+	__m128 tmin = _mm_set1_ps(mint), tmax = _mm_set1_ps(maxt);
+	for (int axis=0; axis<3; ++axis) {
+		__m128 origin = _mm_set1_ps(node.origin[axis]);
+		__m128 scale = _mm_set1_ps(node.scale[axis]);
+		__m128 near = _mm_mul_ps(_mm_sub_ps(dequantize4(node.bounds[ray.neg[axis]][axis],
+			origin, scale), ray.o[axis]), ray.dRcp[axis]);
+		__m128 far = _mm_mul_ps(_mm_sub_ps(dequantize4(node.bounds[1-ray.neg[axis]][axis],
+			origin, scale), ray.o[axis]), ray.dRcp[axis]);
+		tmin = _mm_max_ps(near, tmin);
+		tmax = _mm_min_ps(_mm_mul_ps(far, _mm_set1_ps(robust)), tmax);
+	}
+	_mm_storeu_ps(tNear, tmin);
+	return _mm_movemask_ps(_mm_cmple_ps(tmin, tmax));
+#else
+	int mask = 0;
+	for (int i=0; i<4; ++i) {
+		Float tmin = mint, tmax = maxt;
+		for (int axis=0; axis<3; ++axis) {
+			Float near = (node.dequantize(axis, node.bounds[ray.neg[axis]][axis][i])
+				- ray.o[axis]) * ray.dRcp[axis];
+			Float far = (node.dequantize(axis, node.bounds[1-ray.neg[axis]][axis][i])
+				- ray.o[axis]) * ray.dRcp[axis] * robust;
+			tmin = near > tmin ? near : tmin;
+			tmax = far < tmax ? far : tmax;
+		}
+		tNear[i] = tmin;
+		if (tmin <= tmax)
+			mask |= 1 << i;
+	}
+	return mask;
+#endif
+}
+
+HairBVH::HairBVH(const HairKDTree *geometry, int bundleSize) : m_geometry(geometry),
+		m_nodes(NULL), m_nodeCount(0), m_nodeCapacity(0), m_bundleSize(bundleSize) {
+	ref<Timer> timer = new Timer();
+	const std::vector<bool> &vertexStartsFiber = geometry->getStartFiber();
+	size_t vertexCount = geometry->getVertexCount();
+
+	/* Leaves store the index of their first vertex using 29 bits */
+	if (vertexCount >= (1 << 29))
+		Log(EError, "The hair BVH supports at most %i vertices, use "
+			"the kd-tree for larger data sets!", (1 << 29) - 1);
+
+	/* Group consecutive segments of each strand into bundles */
+	m_bundles.reserve(geometry->getSegmentCount() / bundleSize + geometry->getHairCount());
+	for (size_t i=0; i+1<vertexCount; ++i) {
+		if (vertexStartsFiber[i+1])
+			continue;
+		if (m_bundles.empty() || vertexStartsFiber[i] ||
+				m_bundles.back().count == (uint32_t) bundleSize) {
+			Bundle bundle;
+			bundle.iv = (IndexType) i;
+			bundle.count = 1;
+			m_bundles.push_back(bundle);
+		} else {
+			m_bundles.back().count++;
+		}
+	}
+
+	int bundleCount = (int) m_bundles.size();
+	m_bundleAABBs.resize(bundleCount);
+	m_centroids.resize(bundleCount);
+
+	#if defined(MTS_OPENMP)
+		#pragma omp parallel for
+	#endif
+	for (int i=0; i<bundleCount; ++i) {
+		AABB aabb;
+		for (uint32_t j=0; j<m_bundles[i].count; ++j)
+			aabb.expandBy(geometry->getSegmentAABB(m_bundles[i].iv + j));
+		m_bundleAABBs[i] = aabb;
+		m_centroids[i] = aabb.getCenter();
+	}
+
+	m_indices.resize(bundleCount);
+	m_aabb.reset();
+	for (int i=0; i<bundleCount; ++i) {
+		m_indices[i] = (uint32_t) i;
+		m_aabb.expandBy(m_bundleAABBs[i]);
+	}
+	m_radius = geometry->getRadius();
+
+	/* The miter planes cut the cylinder of a segment at most
+	   radius * tan(theta) beyond its end points, where theta is
+	   half the angle between adjacent tangents. Find the largest
+	   such extension to bound the hits along the segment axes */
+	Float maxTan = 0;
+	#if defined(MTS_OPENMP)
+		#pragma omp parallel
+	#endif
+	{
+		Float localMaxTan = 0;
+		#if defined(MTS_OPENMP)
+			#pragma omp for
+		#endif
+		for (int i=0; i<bundleCount; ++i) {
+			for (uint32_t j=0; j<m_bundles[i].count; ++j) {
+				IndexType iv = m_bundles[i].iv + j;
+				if (!geometry->prevSegmentExists(iv))
+					continue;
+				Float cosPhi = dot(geometry->prevTangent(iv), geometry->tangent(iv));
+				Float tanTheta = std::sqrt(std::max((Float) 0, 1 - cosPhi) / (1 + cosPhi));
+				/* Reversing strands have no valid miter plane and cannot be hit there */
+				if (std::isfinite(tanTheta))
+					localMaxTan = std::max(localMaxTan, tanTheta);
+			}
+		}
+		#if defined(MTS_OPENMP)
+			#pragma omp critical
+		#endif
+		maxTan = std::max(maxTan, localMaxTan);
+	}
+	m_miterExtent = m_radius * maxTan;
+
+	/* A 4-wide tree with single-bundle leaves needs fewer nodes than bundles */
+	m_nodeCapacity = std::max((size_t) 1, m_bundles.size() / 2);
+	m_nodes = static_cast<Node *>(allocAligned(sizeof(Node) * m_nodeCapacity));
+	m_nodeCount = 1;
+	if (bundleCount > 0) {
+		buildNode(0, BuildRange(0, (uint32_t) bundleCount, m_aabb), 0);
+	} else {
+		AABB aabbs[4];
+		m_nodes[0].setBounds(aabbs);
+		for (int i=0; i<4; ++i)
+			m_nodes[0].child[i] = Node::EEmpty;
+	}
+
+	/* The bundles are referenced by the leaves, the remaining data
+	   is only needed during construction */
+	std::vector<Bundle>().swap(m_bundles);
+	std::vector<AABB>().swap(m_bundleAABBs);
+	std::vector<Point>().swap(m_centroids);
+	std::vector<uint32_t>().swap(m_indices);
+
+	Log(EDebug, "Built a BVH over " SIZE_T_FMT " hair segments (%i bundles, "
+		SIZE_T_FMT " nodes) in %i ms", geometry->getSegmentCount(), bundleCount,
+		m_nodeCount, timer->getMilliseconds());
+
+	Log(EDebug, "Total amount of storage (BVH & vertex data): %s",
+		memString(getMemoryUsage()
+		+ vertexCount * sizeof(Point)
+		+ vertexStartsFiber.size() / 8).c_str());
+}
+
+HairBVH::~HairBVH() {
+	if (m_nodes)
+		freeAligned(m_nodes);
+}
+
+void HairBVH::buildNode(uint32_t nodeIndex, const BuildRange &range, int depth) {
+	/* Repeatedly split the child with the largest surface area until there
+	   are four of them. Deep subtrees resort to median splits, which bounds
+	   the depth, since every leaf must contain exactly one bundle */
+	bool median = depth >= MTS_HAIR_BVH_MAX_DEPTH / 2;
+	BuildRange children[4];
+	children[0] = range;
+	int childCount = 1;
+
+	while (childCount < 4) {
+		int best = -1;
+		Float bestArea = -1;
+		for (int i=0; i<childCount; ++i) {
+			if (children[i].size() <= 1)
+				continue;
+			Float area = children[i].aabb.getSurfaceArea();
+			if (area > bestArea) {
+				best = i;
+				bestArea = area;
+			}
+		}
+		if (best < 0)
+			break;
+		BuildRange left, right;
+		split(children[best], median, left, right);
+		children[best] = left;
+		children[childCount++] = right;
+	}
+
+	AABB aabbs[4];
+	for (int i=0; i<childCount; ++i)
+		aabbs[i] = children[i].aabb;
+	m_nodes[nodeIndex].setBounds(aabbs);
+
+	for (int i=0; i<4; ++i) {
+		if (i >= childCount) {
+			m_nodes[nodeIndex].child[i] = Node::EEmpty;
+		} else if (children[i].size() == 1) {
+			const Bundle &bundle = m_bundles[m_indices[children[i].start]];
+			m_nodes[nodeIndex].child[i] = Node::ELeafFlag
+				| (bundle.iv << 2) | (bundle.count - 1);
+		} else {
+			if (m_nodeCount == m_nodeCapacity) {
+				size_t capacity = m_nodeCapacity * 2;
+				Node *nodes = static_cast<Node *>(allocAligned(sizeof(Node) * capacity));
+				memcpy(nodes, m_nodes, sizeof(Node) * m_nodeCount);
+				freeAligned(m_nodes);
+				m_nodes = nodes;
+				m_nodeCapacity = capacity;
+			}
+			uint32_t childIndex = (uint32_t) m_nodeCount++;
+			m_nodes[nodeIndex].child[i] = childIndex;
+			buildNode(childIndex, children[i], depth + 1);
+		}
+	}
+}
+
+/// Predicate used to partition bundle indices according to their SAH bin
+struct HairBinPredicate {
+	const std::vector<Point> &centroids;
+	int axis, split;
+	Float min, scale;
+
+	inline HairBinPredicate(const std::vector<Point> &centroids, int axis,
+		int split, Float min, Float scale) : centroids(centroids),
+		axis(axis), split(split), min(min), scale(scale) { }
+
+	inline bool operator()(uint32_t index) const {
+		int bin = std::min(MTS_HAIR_BVH_BINS - 1,
+			(int) ((centroids[index][axis] - min) * scale));
+		return bin <= split;
+	}
+};
+
+/// Orders bundle indices by their centroid along an axis
+struct HairCentroidOrder {
+	const std::vector<Point> &centroids;
+	int axis;
+
+	inline HairCentroidOrder(const std::vector<Point> &centroids, int axis)
+		: centroids(centroids), axis(axis) { }
+
+	inline bool operator()(uint32_t a, uint32_t b) const {
+		return centroids[a][axis] < centroids[b][axis];
+	}
+};
+
+void HairBVH::split(const BuildRange &range, bool median,
+		BuildRange &left, BuildRange &right) {
+	uint32_t *indices = &m_indices[0];
+	AABB centroidBounds;
+	for (uint32_t i=range.start; i<range.end; ++i)
+		centroidBounds.expandBy(m_centroids[indices[i]]);
+	int axis = centroidBounds.getLargestAxis();
+	Float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+
+	uint32_t middle = range.start;
+	if (extent > 0 && !median) {
+		/* Binned SAH split along the axis of largest centroid extent */
+		AABB binAABBs[MTS_HAIR_BVH_BINS];
+		uint32_t binCounts[MTS_HAIR_BVH_BINS];
+		memset(binCounts, 0, sizeof(binCounts));
+		Float scale = MTS_HAIR_BVH_BINS / extent;
+
+		for (uint32_t i=range.start; i<range.end; ++i) {
+			uint32_t index = indices[i];
+			int bin = std::min(MTS_HAIR_BVH_BINS - 1,
+				(int) ((m_centroids[index][axis] - centroidBounds.min[axis]) * scale));
+			binAABBs[bin].expandBy(m_bundleAABBs[index]);
+			binCounts[bin]++;
+		}
+
+		Float rightCost[MTS_HAIR_BVH_BINS];
+		AABB aabb;
+		uint32_t count = 0;
+		for (int i=MTS_HAIR_BVH_BINS-1; i>0; --i) {
+			aabb.expandBy(binAABBs[i]);
+			count += binCounts[i];
+			rightCost[i] = count > 0 ? aabb.getSurfaceArea() * count : 0;
+		}
+
+		int bestSplit = -1;
+		Float bestCost = std::numeric_limits<Float>::infinity();
+		aabb.reset();
+		count = 0;
+		for (int i=0; i<MTS_HAIR_BVH_BINS-1; ++i) {
+			aabb.expandBy(binAABBs[i]);
+			count += binCounts[i];
+			if (count == 0 || count == range.size())
+				continue;
+			Float cost = aabb.getSurfaceArea() * count + rightCost[i+1];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestSplit = i;
+			}
+		}
+
+		if (bestSplit >= 0)
+			middle = (uint32_t) (std::partition(indices + range.start, indices + range.end,
+				HairBinPredicate(m_centroids, axis, bestSplit, centroidBounds.min[axis], scale))
+				- indices);
+	}
+
+	if (middle == range.start || middle == range.end) {
+		/* Coincident centroids or a failed partition -- fall back to a median split */
+		middle = range.start + range.size() / 2;
+		std::nth_element(indices + range.start, indices + middle,
+			indices + range.end, HairCentroidOrder(m_centroids, axis));
+	}
+
+	left = BuildRange(range.start, middle, AABB());
+	right = BuildRange(middle, range.end, AABB());
+	for (uint32_t i=left.start; i<left.end; ++i)
+		left.aabb.expandBy(m_bundleAABBs[indices[i]]);
+	for (uint32_t i=right.start; i<right.end; ++i)
+		right.aabb.expandBy(m_bundleAABBs[indices[i]]);
+}
+
+int HairBVH::intersectBundle(const HairBVHRay &ray, IndexType iv, uint32_t count,
+		Float tNear, Float mint, Float maxt) const {
+#if defined(MTS_SSE)
+	/* Gather the segment end points in a structure-of-arrays layout
+	   (unused lanes repeat the last segment and are masked out) */
+	const Point *vertices = &m_geometry->getVertices()[iv];
+	MM_ALIGN16 float a[3][4], b[3][4];
+	for (int i=0; i<4; ++i) {
+		uint32_t j = std::min((uint32_t) i, count - 1);
+		for (int axis=0; axis<3; ++axis) {
+			a[axis][i] = vertices[j][axis];
+			b[axis][i] = vertices[j+1][axis];
+		}
+	}
+
+	/* Move the ray origin to the entry point of the leaf box. This keeps
+	   the round-off error proportional to the size of the scene instead
+	   of the distance to the ray origin */
+	__m128 tOffset = _mm_set1_ps(tNear);
+	__m128 axis[3], rel[3], dir[3];
+	for (int i=0; i<3; ++i) {
+		__m128 ai = _mm_load_ps(a[i]);
+		axis[i] = _mm_sub_ps(_mm_load_ps(b[i]), ai);
+		rel[i] = _mm_sub_ps(_mm_add_ps(ray.o[i], _mm_mul_ps(ray.d[i], tOffset)), ai);
+		dir[i] = ray.d[i];
+	}
+	__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(axis[0], axis[0]),
+		_mm_mul_ps(axis[1], axis[1])), _mm_mul_ps(axis[2], axis[2])));
+	__m128 invLength = _mm_div_ps(_mm_set1_ps(1.0f), length);
+	for (int i=0; i<3; ++i)
+		axis[i] = _mm_mul_ps(axis[i], invLength);
+
+	/* Project the ray onto the plane normal to each segment axis */
+	__m128 relDot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(axis[0], rel[0]),
+		_mm_mul_ps(axis[1], rel[1])), _mm_mul_ps(axis[2], rel[2]));
+	__m128 dirDot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(axis[0], dir[0]),
+		_mm_mul_ps(axis[1], dir[1])), _mm_mul_ps(axis[2], dir[2]));
+	__m128 projO[3], projD[3];
+	for (int i=0; i<3; ++i) {
+		projO[i] = _mm_sub_ps(rel[i], _mm_mul_ps(relDot, axis[i]));
+		projD[i] = _mm_sub_ps(dir[i], _mm_mul_ps(dirDot, axis[i]));
+	}
+
+	/* Closest approach of the projected ray to the axis */
+	__m128 A = _mm_add_ps(_mm_add_ps(_mm_mul_ps(projD[0], projD[0]),
+		_mm_mul_ps(projD[1], projD[1])), _mm_mul_ps(projD[2], projD[2]));
+	__m128 B = _mm_add_ps(_mm_add_ps(_mm_mul_ps(projO[0], projD[0]),
+		_mm_mul_ps(projO[1], projD[1])), _mm_mul_ps(projO[2], projD[2]));
+	__m128 tClosest = negate_ps(_mm_div_ps(B, A));
+	__m128 dist2 = _mm_setzero_ps();
+	for (int i=0; i<3; ++i) {
+		__m128 c = _mm_add_ps(projO[i], _mm_mul_ps(tClosest, projD[i]));
+		dist2 = _mm_add_ps(dist2, _mm_mul_ps(c, c));
+	}
+
+	/* Conservatively enlarged radius to account for round-off errors */
+	__m128 radius2 = _mm_set1_ps(m_radius * m_radius * 1.0201f);
+	__m128 halfWidth = _mm_sqrt_ps(_mm_div_ps(_mm_max_ps(
+		_mm_sub_ps(radius2, dist2), _mm_setzero_ps()), A));
+	__m128 t0 = _mm_add_ps(_mm_sub_ps(tClosest, halfWidth), tOffset);
+	__m128 t1 = _mm_add_ps(_mm_add_ps(tClosest, halfWidth), tOffset);
+
+	__m128 hit = _mm_and_ps(_mm_cmple_ps(dist2, radius2), _mm_and_ps(
+		_mm_cmple_ps(t0, _mm_set1_ps(maxt)), _mm_cmpge_ps(t1, _mm_set1_ps(mint))));
+
+	/* The hits must lie between the miter planes, which are found within
+	   a bounded distance of the end points along the segment axis */
+	__m128 s0 = _mm_add_ps(relDot, _mm_mul_ps(_mm_sub_ps(t0, tOffset), dirDot));
+	__m128 s1 = _mm_add_ps(relDot, _mm_mul_ps(_mm_sub_ps(t1, tOffset), dirDot));
+	__m128 extent = _mm_set1_ps(m_miterExtent * 1.01f + m_radius * 0.01f);
+	hit = _mm_and_ps(hit, _mm_and_ps(
+		_mm_cmpge_ps(_mm_max_ps(s0, s1), negate_ps(extent)),
+		_mm_cmple_ps(_mm_min_ps(s0, s1), _mm_add_ps(length, extent))));
+	return _mm_movemask_ps(hit) & ((1 << count) - 1);
+#else
+	/* Without SIMD support, all segments are handed to the exact test */
+	return (1 << count) - 1;
+#endif
+}
+
+bool HairBVH::rayIntersect(const Ray &ray, Float mint,
+		Float maxt, Float &t, void *temp) const {
+	struct StackEntry {
+		uint32_t child;
+		Float tNear;
+	};
+
+	StackEntry stack[3 * MTS_HAIR_BVH_MAX_DEPTH + 4];
+	int stackPos = 0;
+	stack[stackPos].child = 0;
+	stack[stackPos++].tNear = mint;
+
+	HairBVHRay bvhRay(ray);
+	bool foundIntersection = false;
+
+	while (stackPos > 0) {
+		StackEntry entry = stack[--stackPos];
+		if (entry.tNear > maxt)
+			continue;
+
+		if (entry.child & Node::ELeafFlag) {
+			IndexType iv = (entry.child & ~Node::ELeafFlag) >> 2;
+			int mask = intersectBundle(bvhRay, iv, (entry.child & 3) + 1,
+				entry.tNear, mint, maxt);
+			for (IndexType i=0; mask != 0; ++i, mask >>= 1) {
+				Float tempT;
+				if ((mask & 1) && m_geometry->intersect(ray, iv + i,
+						mint, maxt, tempT, temp)) {
+					t = maxt = tempT;
+					foundIntersection = true;
+				}
+			}
+			continue;
+		}
+
+		const Node &node = m_nodes[entry.child];
+		Float tNear[4];
+		int mask = intersectNode(node, bvhRay, mint, maxt, tNear);
+
+		/* Push the children so that the closest one is visited first */
+		int order[4], hitCount = 0;
+		for (int i=0; i<4; ++i) {
+			if (!(mask & (1 << i)) || node.child[i] == Node::EEmpty)
+				continue;
+			int j = hitCount++;
+			while (j > 0 && tNear[order[j-1]] < tNear[i]) {
+				order[j] = order[j-1];
+				--j;
+			}
+			order[j] = i;
+		}
+		for (int i=0; i<hitCount; ++i) {
+			StackEntry &newEntry = stack[stackPos++];
+			newEntry.child = node.child[order[i]];
+			newEntry.tNear = tNear[order[i]];
+		}
+	}
+
+	return foundIntersection;
+}
+
+bool HairBVH::rayIntersect(const Ray &ray, Float mint, Float maxt) const {
+	uint32_t stack[3 * MTS_HAIR_BVH_MAX_DEPTH + 4];
+	int stackPos = 0;
+	stack[stackPos++] = 0;
+	HairBVHRay bvhRay(ray);
+
+	while (stackPos > 0) {
+		const Node &node = m_nodes[stack[--stackPos]];
+		Float tNear[4];
+		int mask = intersectNode(node, bvhRay, mint, maxt, tNear);
+
+		for (int i=0; i<4; ++i) {
+			uint32_t child = node.child[i];
+			if (!(mask & (1 << i)) || child == Node::EEmpty)
+				continue;
+			if (!(child & Node::ELeafFlag)) {
+				stack[stackPos++] = child;
+				continue;
+			}
+			IndexType iv = (child & ~Node::ELeafFlag) >> 2;
+			int segments = intersectBundle(bvhRay, iv, (child & 3) + 1,
+				tNear[i], mint, maxt);
+			for (IndexType j=0; segments != 0; ++j, segments >>= 1) {
+				if ((segments & 1) && m_geometry->intersect(ray, iv + j, mint, maxt))
+					return true;
+			}
+		}
+	}
+
+	return false;
+}
+
 HairShape::HairShape(const Properties &props) : Shape(props) {
 	fs::path path = Thread::getThread()->getFileResolver()->resolve(
 		props.getString("filename"));
 	Float radius = props.getFloat("radius", 0.025f);
+	std::string accel = props.getString("accel", "kdtree");
+	if (accel != "kdtree" && accel != "bvh")
+		Log(EError, "The 'accel' parameter must be equal to \"kdtree\" or \"bvh\"!");
+	int bundleSize = props.getInteger("bundleSize", 2);
+	if (bundleSize < 1 || bundleSize > MTS_HAIR_MAX_BUNDLE_SIZE)
+		Log(EError, "The 'bundleSize' parameter must be between 1 and %i!",
+			MTS_HAIR_MAX_BUNDLE_SIZE);
 	/* Skip segments, whose tangent differs by less than one degree
 	   compared to the previous one */
 	Float angleThreshold = degToRad(props.getFloat("angleThreshold", 1.0f));
@@ -637,6 +1436,7 @@ HairShape::HairShape(const Properties &props) : Shape(props) {
 
 	ref<FileStream> binaryStream = new FileStream(path, FileStream::EReadOnly);
 	binaryStream->setByteOrder(Stream::ELittleEndian);
+	binaryStream->setReadAhead();
 
 	const char *binaryHeader = "BINARY_HAIR";
 	char temp[11];
@@ -781,7 +1581,10 @@ HairShape::HairShape(const Properties &props) : Shape(props) {
 
 	vertexStartsFiber.push_back(true);
 
-	m_kdtree = new HairKDTree(vertices, vertexStartsFiber, radius);
+	bool useBVH = accel == "bvh";
+	m_kdtree = new HairKDTree(vertices, vertexStartsFiber, radius, !useBVH);
+	if (useBVH)
+		m_bvh = new HairBVH(m_kdtree, bundleSize);
 }
 
 HairShape::HairShape(Stream *stream, InstanceManager *manager)
@@ -796,8 +1599,12 @@ HairShape::HairShape(Stream *stream, InstanceManager *manager)
 	for (size_t i=0; i<vertexCount; ++i)
 		vertexStartsFiber[i] = stream->readBool();
 	vertexStartsFiber[vertexCount] = true;
+	/* Zero selects the kd-tree, otherwise the bundle size of the BVH */
+	int bundleSize = stream->readInt();
 
-	m_kdtree = new HairKDTree(vertices, vertexStartsFiber, radius);
+	m_kdtree = new HairKDTree(vertices, vertexStartsFiber, radius, bundleSize == 0);
+	if (bundleSize > 0)
+		m_bvh = new HairBVH(m_kdtree, bundleSize);
 }
 
 void HairShape::serialize(Stream *stream, InstanceManager *manager) const {
@@ -811,14 +1618,19 @@ void HairShape::serialize(Stream *stream, InstanceManager *manager) const {
 	stream->writeFloatArray((Float *) &vertices[0], vertices.size() * 3);
 	for (size_t i=0; i<vertices.size(); ++i)
 		stream->writeBool(vertexStartsFiber[i]);
+	stream->writeInt(m_bvh.get() ? m_bvh->getBundleSize() : 0);
 }
 
 bool HairShape::rayIntersect(const Ray &ray, Float mint,
 		Float maxt, Float &t, void *temp) const {
+	if (m_bvh.get())
+		return m_bvh->rayIntersect(ray, mint, maxt, t, temp);
 	return m_kdtree->rayIntersect(ray, mint, maxt, t, temp);
 }
 
 bool HairShape::rayIntersect(const Ray &ray, Float mint, Float maxt) const {
+	if (m_bvh.get())
+		return m_bvh->rayIntersect(ray, mint, maxt);
 	return m_kdtree->rayIntersect(ray, mint, maxt);
 }
 
@@ -920,6 +1732,9 @@ ref<TriMesh> HairShape::createTriMesh() {
 }
 
 const KDTreeBase<AABB> *HairShape::getKDTree() const {
+	/* The kd-tree is not built when the BVH is used */
+	if (m_bvh.get())
+		return NULL;
 	return m_kdtree.get();
 }
 
@@ -932,6 +1747,8 @@ const std::vector<bool> &HairShape::getStartFiber() const {
 }
 
 AABB HairShape::getAABB() const {
+	if (m_bvh.get())
+		return m_bvh->getAABB();
 	return m_kdtree->getAABB();
 }
 
@@ -954,12 +1771,14 @@ std::string HairShape::toString() const {
 		<< "   numVertices = " << m_kdtree->getVertexCount() << ","
 		<< "   numSegments = " << m_kdtree->getSegmentCount() << ","
 		<< "   numHairs = " << m_kdtree->getHairCount() << ","
-		<< "   radius = " << m_kdtree->getRadius()
+		<< "   radius = " << m_kdtree->getRadius() << ","
+		<< "   accel = " << (m_bvh.get() ? "bvh" : "kdtree")
 		<< "]";
 	return oss.str();
 }
 
 MTS_IMPLEMENT_CLASS(HairKDTree, false, KDTreeBase)
+MTS_IMPLEMENT_CLASS(HairBVH, false, Object)
 MTS_IMPLEMENT_CLASS_S(HairShape, false, Shape)
 MTS_EXPORT_PLUGIN(HairShape, "Hair intersection shape");
 MTS_NAMESPACE_END
@@ -24,6 +24,7 @@
 MTS_NAMESPACE_BEGIN
 
 class HairKDTree;
+class HairBVH;
 
 /**
  * \brief Intersection shape structure for cylindrical hair
@@ -92,6 +93,7 @@ public:
 	MTS_DECLARE_CLASS()
 private:
 	ref<HairKDTree> m_kdtree;
+	ref<HairBVH> m_bvh;
 };
 
 MTS_NAMESPACE_END
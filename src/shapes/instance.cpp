@@ -95,6 +95,32 @@ AABB Instance::getAABB() const {
 	return result;
 }
 
+AABB Instance::getMotionAABB(Float start, Float end) const {
+	const ShapeKDTree *kdtree = m_shapeGroup->getKDTree();
+	const AABB &aabb = kdtree->getAABB();
+	if (!aabb.isValid())
+		return aabb;
+
+	/* Like getAABB(), consider the keyframes within the
+	   interval as well as the transformations at its ends */
+	std::set<Float> times;
+	m_transform->collectKeyframes(times);
+	times.erase(times.begin(), times.upper_bound(start));
+	times.erase(times.lower_bound(end), times.end());
+	times.insert(start);
+	times.insert(end);
+
+	AABB result;
+	for (std::set<Float>::iterator it = times.begin(); it != times.end(); ++it) {
+		const Transform &trafo = m_transform->eval(*it);
+
+		for (int i=0; i<8; ++i)
+			result.expandBy(trafo(aabb.getCorner(i)));
+	}
+
+	return result;
+}
+
 void Instance::addChild(const std::string &name, ConfigurableObject *child) {
 	const Class *cClass = child->getClass();
 	if (cClass->getName() == "ShapeGroup") {
@@ -104,6 +130,10 @@ void Instance::addChild(const std::string &name, ConfigurableObject *child) {
 	}
 }
 
+void Instance::setWorldTransform(const AnimatedTransform *trafo) {
+	m_transform = trafo;
+}
+
 size_t Instance::getPrimitiveCount() const {
 	return 0;
 }
@@ -54,12 +54,17 @@ public:
 	/// Return the underlying animated transformation
 	inline const AnimatedTransform *getAnimatedTransform() const { return m_transform.get(); }
 
+	/// Replace the object-to-world transformation used by this instance
+	void setWorldTransform(const AnimatedTransform *trafo);
+
 	// =============================================================
 	//! @{ \name Implementation of the Shape interface
 	// =============================================================
 
 	AABB getAABB() const;
 
+	AABB getMotionAABB(Float start, Float end) const;
+
 	bool rayIntersect(const Ray &_ray, Float mint,
 			Float maxt, Float &t, void *temp) const;
 
@@ -50,6 +50,11 @@ MTS_NAMESPACE_BEGIN
  *       Optional flag to flip all normals. \default{\code{false}, i.e.
  *       the normals are left unchanged}.
  *	   }
+ *     \parameter{quantize}{\Boolean}{
+ *       Store vertex normals and texture coordinates in a compact quantized
+ *       form (32 bits each), which reduces the memory usage of large meshes.
+ *       \default{\code{false}}
+ *	   }
  *     \parameter{flipTexCoords}{\Boolean}{
  *       Treat the vertical component of the texture as inverted? Most OBJ files use
  *       this convention. \default{\code{true}}
@@ -204,6 +209,9 @@ public:
 		/* Causes all normals to be flipped */
 		m_flipNormals = props.getBoolean("flipNormals", false);
 
+		/* Store normals and texture coordinates in a compact quantized form */
+		m_quantize = props.getBoolean("quantize", false);
+
 		/* Collapse all contained shapes / groups into a single object? */
 		m_collapse = props.getBoolean("collapse", false);
 
@@ -349,6 +357,8 @@ public:
 	}
 
 	WavefrontOBJ(Stream *stream, InstanceManager *manager) : Shape(stream, manager) {
+		/* (the meshes are transmitted in quantized form if necessary) */
+		m_quantize = false;
 		m_aabb = AABB(stream);
 		uint32_t meshCount = stream->readUInt();
 		m_meshes.resize(meshCount);
@@ -725,6 +735,8 @@ public:
 		m_aabb.reset();
 		for (size_t i=0; i<m_meshes.size(); ++i) {
 			m_meshes[i]->configure();
+			if (m_quantize)
+				m_meshes[i]->quantize();
 			m_aabb.expandBy(m_meshes[i]->getAABB());
 		}
 	}
@@ -833,7 +845,7 @@ public:
 private:
 	std::vector<TriMesh *> m_meshes;
 	std::vector<std::string> m_materialAssignment;
-	bool m_flipNormals, m_faceNormals;
+	bool m_flipNormals, m_faceNormals, m_quantize;
 	AABB m_aabb;
 	bool m_collapse;
 };
@@ -62,6 +62,11 @@ MTS_NAMESPACE_BEGIN
  *       Optional flag to flip all normals. \default{\code{false}, i.e.
  *       the normals are left unchanged}.
  *	   }
+ *     \parameter{quantize}{\Boolean}{
+ *       Store vertex normals and texture coordinates in a compact quantized
+ *       form (32 bits each), which reduces the memory usage of large meshes.
+ *       \default{\code{false}}
+ *	   }
  *     \parameter{toWorld}{\Transform\Or\Animation}{
  *	      Specifies an optional linear object-to-world transformation.
  *        \default{none (i.e. object space $=$ world space)}
@@ -57,6 +57,11 @@ extern MTS_EXPORT_RENDER void pushSceneCleanupHandler(void (*cleanup)());
  *       Optional flag to flip all normals. \default{\code{false}, i.e.
  *       the normals are left unchanged}.
  *	   }
+ *     \parameter{quantize}{\Boolean}{
+ *       Store vertex normals and texture coordinates in a compact quantized
+ *       form (32 bits each), which reduces the memory usage of large meshes.
+ *       \default{\code{false}}
+ *	   }
  *     \parameter{toWorld}{\Transform\Or\Animation}{
  *	      Specifies an optional linear object-to-world transformation.
  *        \default{none (i.e. object space $=$ world space)}
@@ -79,12 +84,14 @@ extern MTS_EXPORT_RENDER void pushSceneCleanupHandler(void (*cleanup)());
  * Type & Content\\
  * \midrule
  * \code{uint16}&   File format identifier: \ \  \code{0x041C}\\
- * \code{uint16}&   File version identifier. Currently set to \ \  \code{0x0004}\\
+ * \code{uint16}&   File version identifier. Currently set to \ \  \code{0x0005}\\
  * \midrule
  * \multicolumn{2}{|c|}{\emph{From this point on, the stream is
  * compressed by the \code{DEFLATE} algorithm.}}\\
- * \multicolumn{2}{|c|}{\emph{The used encoding is that of
- * the \code{zlib} library.}}\\
+ * \multicolumn{2}{|c|}{\emph{Version 4 uses a single \code{zlib} stream,
+ * version 5 a sequence of}}\\
+ * \multicolumn{2}{|c|}{\emph{independently compressed blocks
+ * (see \code{ZStream::EBlockStream}).}}\\
  * \midrule
  * \code{uint32}&An 32-bit integer whose bits can be used
  * to specify the following flags:\\[-4mm]
@@ -229,6 +236,7 @@ private:
 		MeshLoader(const fs::path& filePath) {
 			m_fstream = new FileStream(filePath, FileStream::EReadOnly);
 			m_fstream->setByteOrder(Stream::ELittleEndian);
+			m_fstream->setReadAhead();
 			const short version = SerializedMesh::readHeader(m_fstream);
 			if (SerializedMesh::readOffsetDictionary(m_fstream,
 				version, m_offsets) < 0) {
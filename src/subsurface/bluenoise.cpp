@@ -64,7 +64,7 @@ struct Cell {
 
 void blueNoisePointSet(const Scene *scene, const std::vector<Shape *> &shapes,
 		Float radius, PositionSampleVector *target, Float &sa, AABB &aabb,
-		const void *data) {
+		const void *data, std::vector<uint32_t> *shards) {
 	int kmax = 8; /* Perform 8 trial runs */
 
 	#if defined(MTS_OPENMP)
@@ -260,15 +260,56 @@ void blueNoisePointSet(const Scene *scene, const std::vector<Shape *> &shapes,
 	SLog(EInfo, "    done (took %i ms)" , timer->getMilliseconds());
 	timer->reset();
 
+	SLog(EInfo, "  phase 6: sorting into octree shards ..");
+	std::vector<int> selected;
+	selected.reserve(cells.size());
 	for (CellMap::const_iterator it = cells.begin();
 			it != cells.end(); ++it) {
-		const Cell &cell = it->second;
-		if (cell.sample == -1)
-			continue;
-		const UniformSample &sample = samples[cell.sample];
-		target->put(PositionSample(sample.p, sample.n, sample.shapeIndex));
+		if (it->second.sample != -1)
+			selected.push_back(it->second.sample);
 	}
 
+	/* Counting sort by the octree shard, computed in parallel */
+	std::vector<uint32_t> shardIndex(selected.size());
+	std::vector<uint32_t> t_counts(nproc * MTS_OCTREE_SHARD_COUNT, 0);
+
+	#if defined(MTS_OPENMP)
+		#pragma omp parallel for schedule(static)
+	#endif
+	for (int i=0; i<(int) selected.size(); ++i) {
+		#if defined(MTS_OPENMP)
+			int tid = mts_omp_get_thread_num();
+		#else
+			int tid = 0;
+		#endif
+		uint32_t shard = getOctreeShard(aabb, samples[selected[i]].p);
+		shardIndex[i] = shard;
+		t_counts[tid * MTS_OCTREE_SHARD_COUNT + shard]++;
+	}
+
+	std::vector<uint32_t> offsets(MTS_OCTREE_SHARD_COUNT + 1, 0);
+	for (int shard=0; shard<MTS_OCTREE_SHARD_COUNT; ++shard) {
+		uint32_t count = 0;
+		for (int i=0; i<nproc; ++i)
+			count += t_counts[i * MTS_OCTREE_SHARD_COUNT + shard];
+		offsets[shard+1] = offsets[shard] + count;
+	}
+
+	std::vector<PositionSample> &result = target->get();
+	size_t base = result.size();
+	result.resize(base + selected.size());
+	std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+	for (size_t i=0; i<selected.size(); ++i) {
+		const UniformSample &sample = samples[selected[i]];
+		result[base + cursor[shardIndex[i]]++] =
+			PositionSample(sample.p, sample.n, sample.shapeIndex);
+	}
+
+	if (shards)
+		shards->swap(offsets);
+
+	SLog(EInfo, "    done (took %i ms)" , timer->getMilliseconds());
+
 	SLog(EInfo, "Sampling finished (obtained %i blue noise samples)", (int) target->size());
 }
 
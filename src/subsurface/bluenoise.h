@@ -19,6 +19,7 @@
 #if !defined(__BLUENOISE_H)
 #define __BLUENOISE_H
 
+#include <mitsuba/core/octree.h>
 #include "irrproc.h"
 
 MTS_NAMESPACE_BEGIN
@@ -45,11 +46,15 @@ MTS_NAMESPACE_BEGIN
  * \param data
  *    Custom pointer that will be sent along with progress messages
  *    (usually contains a pointer to the \ref RenderJob instance)
+ * \param shards
+ *    Optional. The samples are always emitted sorted by the \ref StaticOctree
+ *    shard (relative to \c aabb) they fall into; when specified, this vector
+ *    is used to return the <tt>MTS_OCTREE_SHARD_COUNT+1</tt> shard offsets.
  */
 extern void blueNoisePointSet(const Scene *scene,
 	const std::vector<Shape *> &shapes, Float radius,
 	PositionSampleVector *target, Float &sa, AABB &aabb,
-	const void *data);
+	const void *data, std::vector<uint32_t> *shards = NULL);
 
 MTS_NAMESPACE_END
 
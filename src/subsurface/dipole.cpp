@@ -107,8 +107,7 @@ struct IsotropicDipoleQuery {
 	Point p;
 };
 
-static ref<Mutex> irrOctreeMutex = new Mutex();
-static int irrOctreeIndex = 0;
+static volatile int32_t irrOctreeIndex = 0;
 
 /*!\plugin{dipole}{Dipole-based subsurface scattering model}
  * \parameters{
@@ -269,10 +268,7 @@ class IsotropicDipole : public Subsurface {
 public:
 	IsotropicDipole(const Properties &props)
 		: Subsurface(props) {
-		{
-			LockGuard lock(irrOctreeMutex);
-			m_octreeIndex = irrOctreeIndex++;
-		}
+		m_octreeIndex = atomicAdd(&irrOctreeIndex, 1) - 1;
 
 		/* How many samples should be taken when estimating
 		   the irradiance at a given point in the scene? */
@@ -392,7 +388,12 @@ public:
 		/* It is necessary to increase the sampling resolution to
 		   prevent low-frequency noise in the output */
 		Float actualRadius = m_radius / std::sqrt(m_sampleMultiplier * 20);
-		blueNoisePointSet(scene, m_shapes, actualRadius, points, sa, aabb, job);
+		std::vector<uint32_t> shards;
+		blueNoisePointSet(scene, m_shapes, actualRadius, points, sa, aabb, job, &shards);
+
+		Log(EDebug, "Done generating sample positions (took %i ms), gathering irradiance ..",
+			timer->getMilliseconds());
+		timer->reset();
 
 		/* 2. Gather irradiance in parallel */
 		const Sensor *sensor = scene->getSensor();
@@ -439,9 +440,12 @@ public:
 		for (size_t i=0; i<samples.size(); ++i)
 			samples[i].area = sa;
 
-		m_octree = new IrradianceOctree(aabb, m_quality, samples);
+		size_t sampleCount = samples.size();
+		/* The irradiance samples retain the shard ordering of the point set */
+		m_octree = new IrradianceOctree(aabb, m_quality, samples, &shards[0]);
 
-		Log(EDebug, "Done clustering (took %i ms).", timer->getMilliseconds());
+		Log(EDebug, "Done clustering " SIZE_T_FMT " samples (took %i ms).",
+			sampleCount, timer->getMilliseconds());
 		m_octreeResID = Scheduler::getInstance()->registerResource(m_octree);
 
 		return true;
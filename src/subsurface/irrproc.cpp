@@ -65,6 +65,7 @@ public:
 		const SamplingIntegrator *integrator = m_integrator.get();
 
 		result->clear();
+		result->setOffset(positions.getOffset());
 
 		for (size_t i=0; i<positions.size(); ++i) {
 			/* Create a fake intersection record */
@@ -102,6 +103,7 @@ private:
 
 void PositionSampleVector::load(Stream *stream) {
 	clear();
+	m_offset = stream->readSize();
 	size_t count = stream->readSize();
 	m_samples.resize(count);
 	for (size_t i=0; i<count; ++i)
@@ -109,6 +111,7 @@ void PositionSampleVector::load(Stream *stream) {
 }
 
 void PositionSampleVector::save(Stream *stream) const {
+	stream->writeSize(m_offset);
 	stream->writeSize(m_samples.size());
 	for (size_t i=0; i<m_samples.size(); ++i)
 		m_samples[i].serialize(stream);
@@ -116,6 +119,7 @@ void PositionSampleVector::save(Stream *stream) const {
 
 void PositionSampleVector::set(const WorkUnit *workUnit) {
 	m_samples = ((PositionSampleVector *) workUnit)->m_samples;
+	m_offset = ((PositionSampleVector *) workUnit)->m_offset;
 }
 
 std::string PositionSampleVector::toString() const {
@@ -127,6 +131,7 @@ std::string PositionSampleVector::toString() const {
 
 void IrradianceSampleVector::load(Stream *stream) {
 	clear();
+	m_offset = stream->readSize();
 	size_t count = stream->readSize();
 	m_samples.resize(count);
 	for (size_t i=0; i<count; ++i)
@@ -134,6 +139,7 @@ void IrradianceSampleVector::load(Stream *stream) {
 }
 
 void IrradianceSampleVector::save(Stream *stream) const {
+	stream->writeSize(m_offset);
 	stream->writeSize(m_samples.size());
 	for (size_t i=0; i<m_samples.size(); ++i)
 		m_samples[i].serialize(stream);
@@ -153,8 +159,10 @@ IrradianceSamplingProcess::IrradianceSamplingProcess(PositionSampleVector *posit
 	  m_irrSamples(irrSamples), m_irrIndirect(irrIndirect), m_time(time) {
 	m_resultMutex = new Mutex();
 	m_irradianceSamples = new IrradianceSampleVector();
-	m_irradianceSamples->reserve(positions->size());
-	m_samplesRequested = 0;
+	/* Results are stored at the index of their position sample, which
+	   preserves any ordering (e.g. by octree shard) of the input */
+	m_irradianceSamples->resize(positions->size());
+	m_samplesRequested = m_samplesDone = 0;
 	m_progress = new ProgressReporter("Sampling irradiance", positions->size(), data);
 }
 
@@ -178,6 +186,7 @@ ParallelProcess::EStatus IrradianceSamplingProcess::generateWork(WorkUnit *unit,
 	const std::vector<PositionSample> &source = m_positionSamples->get();
 
 	samples.clear();
+	static_cast<PositionSampleVector *>(unit)->setOffset(m_samplesRequested);
 	samples.insert(samples.begin(),
 			source.begin() + m_samplesRequested,
 			source.begin() + m_samplesRequested + workSize);
@@ -188,10 +197,16 @@ ParallelProcess::EStatus IrradianceSamplingProcess::generateWork(WorkUnit *unit,
 
 void IrradianceSamplingProcess::processResult(const WorkResult *wr, bool cancelled) {
 	const IrradianceSampleVector *result = static_cast<const IrradianceSampleVector *>(wr);
+	std::vector<IrradianceSample> &target = m_irradianceSamples->get();
+	SAssert(result->getOffset() + result->size() <= target.size());
+
+	/* Work units cover disjoint ranges, so no lock is needed for the copy */
+	std::copy(result->get().begin(), result->get().end(),
+		target.begin() + result->getOffset());
+
 	LockGuard lock(m_resultMutex);
-	for (size_t i=0; i<result->size(); ++i)
-		m_irradianceSamples->put((*result)[i]);
-	m_progress->update(m_irradianceSamples->size());
+	m_samplesDone += result->size();
+	m_progress->update(m_samplesDone);
 }
 
 MTS_IMPLEMENT_CLASS(PositionSampleVector, false, WorkUnit);
@@ -61,7 +61,13 @@ public:
  */
 class PositionSampleVector : public WorkUnit {
 public:
-	PositionSampleVector() { }
+	PositionSampleVector() : m_offset(0) { }
+
+	/// Return the index of the first sample within the overall point set
+	inline size_t getOffset() const { return m_offset; }
+
+	/// Set the index of the first sample within the overall point set
+	inline void setOffset(size_t offset) { m_offset = offset; }
 
 	inline void put(const PositionSample &rec) {
 		m_samples.push_back(rec);
@@ -79,6 +85,10 @@ public:
 		return m_samples;
 	}
 
+	inline const std::vector<PositionSample> &get() const {
+		return m_samples;
+	}
+
 	inline void reserve(size_t size) {
 		m_samples.reserve(size);
 	}
@@ -99,6 +109,7 @@ protected:
 	virtual ~PositionSampleVector() { }
 private:
 	std::vector<PositionSample> m_samples;
+	size_t m_offset;
 };
 
 /**
@@ -150,7 +161,13 @@ public:
  */
 class IrradianceSampleVector : public WorkResult {
 public:
-	IrradianceSampleVector() { }
+	IrradianceSampleVector() : m_offset(0) { }
+
+	/// Return the index of the first sample within the overall point set
+	inline size_t getOffset() const { return m_offset; }
+
+	/// Set the index of the first sample within the overall point set
+	inline void setOffset(size_t offset) { m_offset = offset; }
 
 	inline void put(const IrradianceSample &rec) {
 		m_samples.push_back(rec);
@@ -168,10 +185,18 @@ public:
 		return m_samples;
 	}
 
+	inline const std::vector<IrradianceSample> &get() const {
+		return m_samples;
+	}
+
 	inline void reserve(size_t size) {
 		m_samples.reserve(size);
 	}
 
+	inline void resize(size_t size) {
+		m_samples.resize(size);
+	}
+
 	inline const IrradianceSample &operator[](size_t index) const {
 		return m_samples[index];
 	}
@@ -187,6 +212,7 @@ protected:
 	virtual ~IrradianceSampleVector() { }
 private:
 	std::vector<IrradianceSample> m_samples;
+	size_t m_offset;
 };
 
 /**
@@ -222,7 +248,7 @@ protected:
 private:
 	ref<PositionSampleVector> m_positionSamples;
 	ref<IrradianceSampleVector> m_irradianceSamples;
-	size_t m_samplesRequested, m_granularity;
+	size_t m_samplesRequested, m_samplesDone, m_granularity;
 	int m_irrSamples;
 	bool m_irrIndirect;
 	Float m_time;
@@ -24,13 +24,14 @@ MTS_NAMESPACE_BEGIN
 static StatsCounter statsNumSamples("SSS Irradiance Octree", "Created samples");
 static StatsCounter statsNumNodes("SSS Irradiance Octree", "Created nodes");
 
-IrradianceOctree::IrradianceOctree(const AABB &bounds, Float solidAngleThreshold, std::vector<IrradianceSample> &records)
+IrradianceOctree::IrradianceOctree(const AABB &bounds, Float solidAngleThreshold,
+		std::vector<IrradianceSample> &records, const uint32_t *shards)
 	: StaticOctree<IrradianceSample, IrradianceSample>(bounds), m_solidAngleThreshold(solidAngleThreshold) {
 
 	m_items.swap(records);
 
-	build();
-	propagate(m_root);
+	build(shards);
+	propagate();
 }
 
 IrradianceOctree::IrradianceOctree(Stream *stream, InstanceManager *manager) {
@@ -46,7 +47,7 @@ IrradianceOctree::IrradianceOctree(Stream *stream, InstanceManager *manager) {
 		m_items[i] = IrradianceSample(stream);
 
 	build();
-	propagate(m_root);
+	propagate();
 }
 
 void IrradianceOctree::serialize(Stream *stream, InstanceManager *manager) const {
@@ -60,7 +61,61 @@ void IrradianceOctree::serialize(Stream *stream, InstanceManager *manager) const
 		m_items[i].serialize(stream);
 }
 
+void IrradianceOctree::propagate() {
+	if (!m_root)
+		return;
+
+	ref<Timer> timer = new Timer();
+
+	/* Collect the upper levels of the tree in breadth-first order,
+	   along with the roots of the subtrees below them */
+	std::vector<OctreeNode *> upper, subtrees, frontier(1, m_root), next;
+	for (int level=0; level<MTS_OCTREE_PARALLEL_LEVELS; ++level) {
+		next.clear();
+		for (size_t i=0; i<frontier.size(); ++i) {
+			OctreeNode *node = frontier[i];
+			if (node->leaf) {
+				subtrees.push_back(node);
+				continue;
+			}
+			upper.push_back(node);
+			for (int j=0; j<8; ++j) {
+				if (node->children[j])
+					next.push_back(node->children[j]);
+			}
+		}
+		frontier.swap(next);
+	}
+	subtrees.insert(subtrees.end(), frontier.begin(), frontier.end());
+
+	/* The subtrees are independent and can be processed in parallel */
+	#if defined(MTS_OPENMP)
+		#pragma omp parallel for schedule(dynamic)
+	#endif
+	for (int i=0; i<(int) subtrees.size(); ++i)
+		propagate(subtrees[i]);
+
+	/* Finish the upper levels bottom-up */
+	for (std::vector<OctreeNode *>::reverse_iterator it = upper.rbegin();
+			it != upper.rend(); ++it)
+		cluster(*it);
+
+	Log(EDebug, "Propagated irradiance through the octree (took %i ms)",
+		timer->getMilliseconds());
+}
+
 void IrradianceOctree::propagate(OctreeNode *node) {
+	if (!node->leaf) {
+		for (int i=0; i<8; i++) {
+			OctreeNode *child = node->children[i];
+			if (child)
+				propagate(child);
+		}
+	}
+	cluster(node);
+}
+
+void IrradianceOctree::cluster(OctreeNode *node) {
 	IrradianceSample &repr = node->data;
 
 	/* Initialize the cluster values */
@@ -70,7 +125,7 @@ void IrradianceOctree::propagate(OctreeNode *node) {
 	Float weightSum = 0.0f;
 
 	if (node->leaf) {
-		/* Inner node */
+		/* Leaf node */
 		for (uint32_t i=0; i<node->count; ++i) {
 			const IrradianceSample &sample = m_items[i+node->offset];
 			repr.E += sample.E * sample.area;
@@ -81,12 +136,11 @@ void IrradianceOctree::propagate(OctreeNode *node) {
 		}
 		statsNumSamples += node->count;
 	} else {
-		/* Inner node */
+		/* Inner node (children have already been clustered) */
 		for (int i=0; i<8; i++) {
-			OctreeNode *child = node->children[i];
+			const OctreeNode *child = node->children[i];
 			if (!child)
 				continue;
-			propagate(child);
 			repr.E += child->data.E * child->data.area;
 			repr.area += child->data.area;
 			Float weight = child->data.E.getLuminance() * child->data.area;
@@ -27,9 +27,14 @@ MTS_NAMESPACE_BEGIN
 
 class IrradianceOctree : public StaticOctree<IrradianceSample, IrradianceSample>, public SerializableObject {
 public:
-	/// Construct a new irradiance octree
+	/**
+	 * \brief Construct a new irradiance octree
+	 *
+	 * When \c shards is specified, the records must be sorted by
+	 * octree shard (see \ref StaticOctree::build()).
+	 */
 	IrradianceOctree(const AABB &aabb, Float solidAngleThreshold,
-		std::vector<IrradianceSample> &records);
+		std::vector<IrradianceSample> &records, const uint32_t *shards = NULL);
 
 	/// Unserialize an octree from a binary data stream
 	IrradianceOctree(Stream *stream, InstanceManager *manager);
@@ -44,9 +49,15 @@ public:
 
 	MTS_DECLARE_CLASS()
 protected:
-	/// Propagate irradiance approximations througout the tree
+	/// Propagate irradiance approximations througout the tree (in parallel)
+	void propagate();
+
+	/// Recursively propagate irradiance approximations within a subtree
 	void propagate(OctreeNode *node);
 
+	/// Compute the representative of a node from its (already processed) children
+	void cluster(OctreeNode *node);
+
 	/// Query the octree using a customizable functor, while representatives for distant nodes
 	template <typename QueryType> void performQuery(const AABB &aabb, OctreeNode *node, QueryType &query) const {
 		/* Compute the approximate solid angle subtended by samples within this node */
@@ -1489,6 +1489,9 @@ public:
 			const TriMesh *triMesh = static_cast<const TriMesh *>(its.shape);
 			const Point *positions = triMesh->getVertexPositions();
 			const Vector *normals = triMesh->getVertexNormals();
+			if (EXPECT_NOT_TAKEN(!normals))
+				Log(EError, "The slow single scattering mode requires full "
+					"precision vertex normals (is the mesh quantized?)");
 
 			size_t numTriangles = triMesh->getTriangleCount();
 			bool *doneThisTriangleBefore = new bool[numTriangles];
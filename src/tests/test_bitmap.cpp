@@ -0,0 +1,151 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/testcase.h>
+#include <mitsuba/core/bitmap.h>
+#include <mitsuba/core/random.h>
+#include <mitsuba/core/timer.h>
+
+MTS_NAMESPACE_BEGIN
+
+class TestBitmap : public TestCase {
+public:
+	MTS_BEGIN_TESTCASE()
+	MTS_DECLARE_TEST(test01_kernels)
+	MTS_DECLARE_TEST(test02_parallel)
+	MTS_DECLARE_TEST(test03_benchmark)
+	MTS_END_TESTCASE()
+
+	/// Create an RGBA test image with values in [-0.25, 1.75] and a few special values
+	ref<Bitmap> createImage(const Vector2i &size) {
+		ref<Bitmap> bitmap = new Bitmap(Bitmap::ERGBA, Bitmap::EFloat32, size);
+		ref<Random> random = new Random();
+		float *data = bitmap->getFloat32Data();
+		size_t count = (size_t) size.x * (size_t) size.y * 4;
+		for (size_t i=0; i<count; ++i)
+			data[i] = (float) (random->nextFloat() * 2 - 0.25f);
+		data[0] = std::numeric_limits<float>::quiet_NaN();
+		data[1] = std::numeric_limits<float>::infinity();
+		data[2] = -std::numeric_limits<float>::infinity();
+		data[4] = 1e-6f;
+		data[5] = 65504.0f;
+		return bitmap;
+	}
+
+	void test01_kernels() {
+		/* Conversions that preserve the pixel layout are handled by
+		   specialized kernels. Compare them against the generic code,
+		   which is used when the target has an extra alpha channel */
+		ref<Bitmap> rgba = createImage(Vector2i(97, 31));
+		ref<Bitmap> rgb = rgba->convert(Bitmap::ERGB, Bitmap::EFloat32, 1.0f);
+		size_t count = (size_t) rgb->getWidth() * (size_t) rgb->getHeight();
+
+		Bitmap::EComponentFormat formats[] = { Bitmap::EUInt8, Bitmap::EFloat16 };
+		Float gammas[] = { 1.0f, -1.0f, 2.2f };
+		Float multipliers[] = { 1.0f, 0.3f, 4.0f };
+
+		for (int i=0; i<2; ++i) {
+			for (int j=0; j<3; ++j) {
+				for (int k=0; k<3; ++k) {
+					Float gamma = formats[i] == Bitmap::EUInt8 ? gammas[j] : 1.0f;
+					ref<Bitmap> fast = rgb->convert(Bitmap::ERGB, formats[i], gamma, multipliers[k]);
+					ref<Bitmap> generic = rgb->convert(Bitmap::ERGBA, formats[i], gamma, multipliers[k]);
+					int bpc = fast->getBytesPerComponent();
+					bool equal = true;
+					for (size_t l=0; l<count; ++l)
+						equal &= memcmp(fast->getUInt8Data() + l * 3 * bpc,
+							generic->getUInt8Data() + l * 4 * bpc, 3 * bpc) == 0;
+					assertTrue(equal);
+
+					/* Alpha must not be affected by gamma or the multiplier */
+					ref<Bitmap> fastAlpha = rgba->convert(Bitmap::ERGBA, formats[i], gamma, multipliers[k]);
+					ref<Bitmap> refAlpha = rgba->convert(Bitmap::ELuminanceAlpha, formats[i], 1.0f, 1.0f);
+					for (size_t l=0; l<count; ++l)
+						equal &= memcmp(fastAlpha->getUInt8Data() + (l * 4 + 3) * bpc,
+							refAlpha->getUInt8Data() + (l * 2 + 1) * bpc, bpc) == 0;
+					assertTrue(equal);
+				}
+			}
+		}
+
+		/* Round trip through half precision */
+		ref<Bitmap> halfImage = rgba->convert(Bitmap::ERGBA, Bitmap::EFloat16, 1.0f);
+		ref<Bitmap> back = halfImage->convert(Bitmap::ERGBA, Bitmap::EFloat32, 1.0f);
+		ref<Bitmap> generic = halfImage->convert(Bitmap::ERGB, Bitmap::EFloat32, 1.0f);
+		bool equal = true;
+		for (size_t l=1; l<count; ++l) /* (skip the NaN in the first pixel) */
+			equal &= memcmp(back->getFloat32Data() + l * 4,
+				generic->getFloat32Data() + l * 3, 3 * sizeof(float)) == 0;
+		assertTrue(equal);
+	}
+
+	void test02_parallel() {
+		/* Large conversions are split into chunks -- check that this
+		   gives the same result as a single call to the converter */
+		ref<Bitmap> bitmap = createImage(Vector2i(1031, 1029));
+		size_t count = (size_t) bitmap->getWidth() * (size_t) bitmap->getHeight();
+
+		ref<Bitmap> result = bitmap->convert(Bitmap::ERGB, Bitmap::EUInt8, -1.0f, 0.5f);
+		ref<Bitmap> expected = new Bitmap(Bitmap::ERGB, Bitmap::EUInt8, bitmap->getSize());
+		const FormatConverter *cvt = FormatConverter::getInstance(
+			std::make_pair(Bitmap::EFloat32, Bitmap::EUInt8));
+		cvt->convert(Bitmap::ERGBA, 1.0f, bitmap->getData(), Bitmap::ERGB, -1.0f,
+			expected->getData(), count, 0.5f);
+		assertTrue(*result == *expected);
+
+		ref<Bitmap> result2 = new Bitmap(Bitmap::ELuminance, Bitmap::EFloat16, bitmap->getSize());
+		bitmap->convert(result2);
+		ref<Bitmap> expected2 = new Bitmap(Bitmap::ELuminance, Bitmap::EFloat16, bitmap->getSize());
+		FormatConverter::getInstance(std::make_pair(Bitmap::EFloat32, Bitmap::EFloat16))->convert(
+			Bitmap::ERGBA, 1.0f, bitmap->getData(), Bitmap::ELuminance, 1.0f,
+			expected2->getData(), count);
+		assertTrue(*result2 == *expected2);
+	}
+
+	void test03_benchmark() {
+		/* Throughput of Bitmap::convert() for the common component formats */
+		ref<Bitmap> source = createImage(Vector2i(2048, 2048));
+		Bitmap::EComponentFormat formats[] = { Bitmap::EUInt8, Bitmap::EFloat16, Bitmap::EFloat32 };
+		const char *names[] = { "uint8", "half", "float" };
+		ref<Timer> timer = new Timer();
+		Float megapixels = source->getPixelCount() * 1e-6f;
+
+		for (int i=0; i<3; ++i) {
+			ref<Bitmap> input = source->convert(Bitmap::ERGBA, formats[i], 1.0f);
+			for (int j=0; j<3; ++j) {
+				for (int k=0; k<2; ++k) {
+					Float gamma = k == 0 ? 1.0f : -1.0f;
+					if (formats[j] != Bitmap::EUInt8 && gamma != 1.0f)
+						continue;
+					ref<Bitmap> output = new Bitmap(Bitmap::ERGBA, formats[j], input->getSize());
+					output->setGamma(gamma);
+					timer->reset();
+					const int runs = 5;
+					for (int l=0; l<runs; ++l)
+						input->convert(output, 0.9f);
+					Float time = timer->getSeconds() / runs;
+					Log(EInfo, "%s -> %s%s: %.1f Mpixel/s", names[i], names[j],
+						gamma == -1.0f ? " (sRGB)" : "", megapixels / time);
+				}
+			}
+		}
+	}
+};
+
+MTS_EXPORT_TESTCASE(TestBitmap, "Testcase for bitmap format conversions")
+MTS_NAMESPACE_END
@@ -18,6 +18,9 @@
 
 #include <mitsuba/core/plugin.h>
 #include <mitsuba/core/kdtree.h>
+#include <mitsuba/core/timer.h>
+#include <mitsuba/core/mstream.h>
+#include <mitsuba/core/fstream.h>
 #include <mitsuba/render/testcase.h>
 #include <mitsuba/render/skdtree.h>
 
@@ -29,6 +32,8 @@ public:
 	MTS_DECLARE_TEST(test01_sutherlandHodgman)
 	MTS_DECLARE_TEST(test02_bunnyBenchmark)
 	MTS_DECLARE_TEST(test03_pointKDTree)
+	MTS_DECLARE_TEST(test04_quantizedMesh)
+	MTS_DECLARE_TEST(test05_hairBVH)
 	MTS_END_TESTCASE()
 
 	void test01_sutherlandHodgman() {
@@ -214,6 +219,235 @@ public:
 		Log(EInfo, "Normal node size = " SIZE_T_FMT " bytes", sizeof(KDTree2::NodeType));
 		Log(EInfo, "Left-balanced node size = " SIZE_T_FMT " bytes", sizeof(KDTree2Left::NodeType));
 	}
+
+	/// Create a tessellated unit sphere with vertex normals and texture coordinates
+	ref<TriMesh> createSphere(int res, bool quantize) {
+		ref<TriMesh> mesh = new TriMesh("sphere", 2 * (size_t) res * res,
+			(size_t) (res+1) * (res+1), true, true);
+		Point *positions = mesh->getVertexPositions();
+		Normal *normals = mesh->getVertexNormals();
+		Point2 *texcoords = mesh->getVertexTexcoords();
+		Triangle *triangles = mesh->getTriangles();
+
+		for (int y=0; y<=res; ++y) {
+			for (int x=0; x<=res; ++x) {
+				Point2 uv(x / (Float) res, y / (Float) res);
+				Float sinTheta, cosTheta, sinPhi, cosPhi;
+				math::sincos(uv.y * M_PI, &sinTheta, &cosTheta);
+				math::sincos(uv.x * 2 * M_PI, &sinPhi, &cosPhi);
+				Normal n(sinTheta * cosPhi, sinTheta * sinPhi, cosTheta);
+				*positions++ = Point(n);
+				*normals++ = n;
+				*texcoords++ = uv;
+			}
+		}
+
+		for (int y=0; y<res; ++y) {
+			for (int x=0; x<res; ++x) {
+				uint32_t i0 = y * (res+1) + x, i1 = i0 + 1,
+				         i2 = i0 + res + 1, i3 = i2 + 1;
+				triangles->idx[0] = i0; triangles->idx[1] = i1; triangles->idx[2] = i3; ++triangles;
+				triangles->idx[0] = i0; triangles->idx[1] = i3; triangles->idx[2] = i2; ++triangles;
+			}
+		}
+		mesh->configure();
+		if (quantize)
+			mesh->quantize();
+		return mesh;
+	}
+
+	void test04_quantizedMesh() {
+		/* Accuracy of the octahedral normal encoding */
+		ref<Random> random = new Random();
+		Float maxError = 0;
+		for (int i=0; i<1000000; ++i) {
+			Normal n(warp::squareToUniformSphere(Point2(random->nextFloat(), random->nextFloat())));
+			maxError = std::max(maxError, unitAngle(n, TriMesh::decodeNormal(TriMesh::encodeNormal(n))));
+		}
+		Log(EInfo, "Maximum angular error of the normal encoding: %e rad", maxError);
+		assertTrue(maxError < 2e-4f);
+		for (int i=0; i<3; ++i) {
+			Normal n(0.0f);
+			n[i] = 1;
+			assertTrue(TriMesh::decodeNormal(TriMesh::encodeNormal(n)) == n);
+			assertTrue(TriMesh::decodeNormal(TriMesh::encodeNormal(-n)) == -n);
+		}
+
+		/* Quantized meshes must produce the same intersections with
+		   slightly perturbed shading normals and texture coordinates */
+		ref<ShapeKDTree> trees[2];
+		for (int k=0; k<2; ++k) {
+			ref<TriMesh> mesh = createSphere(1000, k == 1);
+			assertTrue(mesh->isQuantized() == (k == 1));
+			assertTrue(mesh->hasVertexNormals() && mesh->hasVertexTexcoords());
+			Log(EInfo, "%s mesh: %s", k == 0 ? "Full precision" : "Quantized",
+				memString(mesh->getMemoryUsage()).c_str());
+			trees[k] = new ShapeKDTree();
+			trees[k]->addShape(mesh);
+			trees[k]->build();
+		}
+
+		const int rayCount = 1000000;
+		std::vector<Ray> rays(rayCount);
+		for (int i=0; i<rayCount; ++i) {
+			Point o = Point(warp::squareToUniformSphere(
+				Point2(random->nextFloat(), random->nextFloat())) * 2);
+			Point target = Point(random->nextFloat(), random->nextFloat(), random->nextFloat()) - Vector(0.5f);
+			rays[i] = Ray(o, normalize(target - o), 0.0f);
+		}
+
+		bool equal = true;
+		Float maxNormalError = 0, maxUVError = 0, maxTangentError = 0;
+		for (int i=0; i<rayCount; ++i) {
+			Intersection its1, its2;
+			bool hit1 = trees[0]->rayIntersect(rays[i], its1);
+			bool hit2 = trees[1]->rayIntersect(rays[i], its2);
+			equal &= hit1 == hit2;
+			if (hit1 && hit2) {
+				equal &= its1.t == its2.t && its1.primIndex == its2.primIndex;
+				maxNormalError = std::max(maxNormalError, unitAngle(its1.shFrame.n, its2.shFrame.n));
+				maxUVError = std::max(maxUVError, (its1.uv - its2.uv).length());
+				maxTangentError = std::max(maxTangentError,
+					(its1.dpdu - its2.dpdu).length() / its1.dpdu.length());
+			}
+		}
+		Log(EInfo, "Maximum shading normal error: %e rad, texture coordinate error: %e, "
+			"relative tangent error: %e", maxNormalError, maxUVError, maxTangentError);
+		assertTrue(equal);
+		assertTrue(maxNormalError < 1e-3f);
+		assertTrue(maxUVError < 1e-4f);
+		assertTrue(maxTangentError < 0.05f);
+
+		/* Quantized meshes are transmitted in their compact form */
+		ref<TriMesh> mesh = createSphere(50, true);
+		ref<InstanceManager> manager = new InstanceManager();
+		ref<MemoryStream> mstream = new MemoryStream();
+		mesh->serialize(mstream, manager);
+		mstream->seek(0);
+		ref<TriMesh> mesh2 = new TriMesh(mstream, new InstanceManager());
+		assertTrue(mesh2->isQuantized());
+		for (uint32_t i=0; i<mesh->getVertexCount(); ++i)
+			equal &= mesh->getVertexNormal(i) == mesh2->getVertexNormal(i)
+				&& mesh->getVertexTexcoord(i) == mesh2->getVertexTexcoord(i);
+		assertTrue(equal);
+
+		/* Normals recomputed after quantization are stored at full precision
+		   and must be interpolated when sampling positions */
+		ref<TriMesh> reference = createSphere(50, false);
+		reference->computeNormals(true);
+		mesh->computeNormals(true);
+		assertTrue(mesh->isQuantized() && mesh->getVertexNormals() != NULL);
+		Float maxSampleNormalError = 0;
+		for (int i=0; i<10000; ++i) {
+			Point2 sample(random->nextFloat(), random->nextFloat());
+			PositionSamplingRecord pRec1(0.0f), pRec2(0.0f);
+			reference->samplePosition(pRec1, sample);
+			mesh->samplePosition(pRec2, sample);
+			equal &= pRec1.p == pRec2.p;
+			maxSampleNormalError = std::max(maxSampleNormalError, unitAngle(pRec1.n, pRec2.n));
+		}
+		assertTrue(equal);
+		assertTrue(maxSampleNormalError < 1e-5f);
+
+		/* Throughput of full intersection queries, which decode the vertex data */
+		ref<Timer> timer = new Timer();
+		for (int k=0; k<2; ++k) {
+			timer->reset();
+			for (int i=0; i<rayCount; ++i) {
+				Intersection its;
+				trees[k]->rayIntersect(rays[i], its);
+			}
+			Log(EInfo, "%s mesh: %.2f Mrays/s", k == 0 ? "Full precision" : "Quantized",
+				rayCount / (timer->getSeconds() * 1e6f));
+		}
+	}
+
+	void test05_hairBVH() {
+		/* Write wavy strands growing out of a sphere in the binary hair format */
+		ref<Random> random = new Random();
+		const int strandCount = 50000, strandVertices = 24;
+		ref<FileStream> temp = FileStream::createTemporary();
+		temp->setByteOrder(Stream::ELittleEndian);
+		temp->write("BINARY_HAIR", 11);
+		temp->writeUInt(strandCount * strandVertices);
+		for (int i=0; i<strandCount; ++i) {
+			Vector dir = warp::squareToUniformSphere(Point2(random->nextFloat(), random->nextFloat()));
+			Frame frame(dir);
+			Float phase = random->nextFloat() * 2 * M_PI;
+			temp->writeSingle(std::numeric_limits<float>::infinity());
+			for (int j=0; j<strandVertices; ++j) {
+				Float s = j / (Float) (strandVertices - 1);
+				Point p = Point(dir * (10 + 8 * s)) + frame.s * std::sin(phase + 6*s) * s
+					+ frame.t * std::cos(phase + 6*s) * s;
+				temp->writeSingle(p.x);
+				temp->writeSingle(p.y);
+				temp->writeSingle(p.z);
+			}
+		}
+		temp->flush();
+
+		PluginManager *pmgr = PluginManager::getInstance();
+		ref<Timer> timer = new Timer();
+		/* Compare the kd-tree against BVHs with small and large bundles */
+		const char *names[3] = { "kd-tree", "BVH (2 segments/leaf)", "BVH (4 segments/leaf)" };
+		ref<Shape> shapes[3];
+		Logger *logger = Thread::getThread()->getLogger();
+		ELogLevel logLevel = logger->getLogLevel();
+		logger->setLogLevel(EDebug);
+		for (int k=0; k<3; ++k) {
+			Properties props("hair");
+			props.setString("filename", temp->getPath().string());
+			props.setString("accel", k == 0 ? "kdtree" : "bvh");
+			props.setInteger("bundleSize", k == 2 ? 4 : 2);
+			timer->reset();
+			shapes[k] = static_cast<Shape *>(pmgr->createObject(MTS_CLASS(Shape), props));
+			shapes[k]->configure();
+			Log(EInfo, "Hair %s: loaded and built in %i ms", names[k], timer->getMilliseconds());
+		}
+		logger->setLogLevel(logLevel);
+
+		/* All structures must find exactly the same intersections */
+		const int rayCount = 1000000;
+		std::vector<Ray> rays(rayCount);
+		for (int i=0; i<rayCount; ++i) {
+			Point o = Point(warp::squareToUniformSphere(
+				Point2(random->nextFloat(), random->nextFloat())) * 30);
+			Point target = Point(warp::squareToUniformSphere(
+				Point2(random->nextFloat(), random->nextFloat())) * 18);
+			rays[i] = Ray(o, normalize(target - o), 0.0f);
+		}
+
+		bool equal = true;
+		size_t hitCount = 0;
+		uint8_t storage[MTS_KD_INTERSECTION_TEMP];
+		const Float maxt = std::numeric_limits<Float>::infinity();
+		for (int i=0; i<rayCount; ++i) {
+			Float t[3] = { 0, 0, 0 };
+			bool hit[3];
+			for (int k=0; k<3; ++k) {
+				hit[k] = shapes[k]->rayIntersect(rays[i], 0, maxt, t[k], storage);
+				equal &= hit[k] == shapes[k]->rayIntersect(rays[i], 0, maxt);
+			}
+			for (int k=1; k<3; ++k)
+				equal &= hit[k] == hit[0] && (!hit[0] || t[k] == t[0]);
+			if (hit[0])
+				hitCount++;
+		}
+		Log(EInfo, "Found " SIZE_T_FMT " intersections (%.1f%%)", hitCount,
+			100 * hitCount / (Float) rayCount);
+		assertTrue(equal);
+		assertTrue(hitCount > 0);
+
+		for (int k=0; k<3; ++k) {
+			timer->reset();
+			for (int i=0; i<rayCount; ++i) {
+				Float t;
+				shapes[k]->rayIntersect(rays[i], 0, maxt, t, storage);
+			}
+			Log(EInfo, "Hair %s: %.2f Mrays/s", names[k], rayCount / (timer->getSeconds() * 1e6f));
+		}
+		temp->close();
+	}
 };
 
 MTS_EXPORT_TESTCASE(TestKDTree, "Testcase for kd-tree related code")
@@ -19,6 +19,7 @@
 #include <mitsuba/render/testcase.h>
 #include <mitsuba/core/plugin.h>
 #include <mitsuba/core/random.h>
+#include <mitsuba/core/pcg32.h>
 #include <mitsuba/core/timer.h>
 #include <mitsuba/core/mstream.h>
 
@@ -344,6 +345,8 @@ public:
 	MTS_DECLARE_TEST(test07_uniform_distribution_ks);
 	MTS_DECLARE_TEST(test08_serialize);
 	MTS_DECLARE_TEST(test09_set);
+	MTS_DECLARE_TEST(test10_pcg32);
+	MTS_DECLARE_TEST(test11_bulk);
 	MTS_DECLARE_TEST(benchmark);
 	MTS_END_TESTCASE()
 
@@ -358,6 +361,8 @@ public:
 	void test07_uniform_distribution_ks();
 	void test08_serialize();
 	void test09_set();
+	void test10_pcg32();
+	void test11_bulk();
 	void benchmark();
 
 private:
@@ -817,6 +822,61 @@ void TestRandom::test09_set()
 
 
 
+void TestRandom::test10_pcg32()
+{
+	/* Reference output of the PCG32 demo program for (42, 54) */
+	const uint32_t reference[] = { 0xa15c02b7, 0x7b47f409, 0xba1d3330,
+		0x83d2f293, 0xbfa4784b, 0xcbed606e };
+
+	PCG32 rnd(42u, 54u);
+	for (size_t i = 0; i < array_size(reference); ++i)
+		assertTrue(rnd.nextUInt() == reference[i]);
+
+	// Jumping ahead and back must be consistent with stepping
+	PCG32 rnd1(1234u, 1u), rnd2(1234u, 1u);
+	for (int i = 0; i < 1000; ++i)
+		rnd1.nextUInt();
+	rnd2.advance(1000);
+	assertTrue(rnd1 == rnd2);
+	rnd2.advance(-1000);
+	assertTrue(rnd2 == PCG32(1234u, 1u));
+
+	// Different streams must produce different sequences
+	PCG32 rnd3(1234u, 2u);
+	int equal = 0;
+	for (int i = 0; i < 1000; ++i)
+		equal += (rnd1.nextUInt() == rnd3.nextUInt()) ? 1 : 0;
+	assertTrue(equal < 5);
+
+	// Simple mean test
+	const int N = 1000000;
+	double mean = 0;
+	for (int i = 0; i < N; ++i) {
+		Float value = rnd.nextFloat();
+		assertTrue(value >= 0 && value < 1);
+		mean += value;
+	}
+	assertEqualsEpsilon(static_cast<Float>(mean / N), static_cast<Float>(0.5), 1e-3f);
+}
+
+void TestRandom::test11_bulk()
+{
+	// The bulk interfaces must match repeated calls to nextFloat()
+	const size_t N = 1001;
+	std::vector<Float> values(N);
+
+	ref<Random> rnd1 = new Random(1234), rnd2 = new Random(1234);
+	rnd1->nextFloats(&values[0], N);
+	for (size_t i = 0; i < N; ++i)
+		assertTrue(values[i] == rnd2->nextFloat());
+
+	PCG32 pcg1(1234u, 5u), pcg2(1234u, 5u);
+	pcg1.nextFloats(&values[0], N);
+	for (size_t i = 0; i < N; ++i)
+		assertTrue(values[i] == pcg2.nextFloat());
+	assertTrue(pcg1 == pcg2);
+}
+
 // Simple benchmark based on the mean test
 void TestRandom::benchmark()
 {
@@ -850,6 +910,36 @@ void TestRandom::benchmark()
 		1e-6 * N, seconds, 1e-6 * N / seconds);
 	estimate /= (N1+1);
 	assertEqualsEpsilon(estimate, static_cast<Float>(0.5), epsilon);
+
+	// Compare the throughput of the scalar and bulk interfaces
+	const size_t M = 10 * N2;
+	std::vector<Float> values(1000);
+	PCG32 pcg(1234u, 5u);
+	Float sum = 0;
+	timer->reset();
+	for (size_t i = 0; i < M; ++i)
+		sum += rnd->nextFloat();
+	Float t1 = timer->getSeconds();
+	timer->reset();
+	for (size_t i = 0; i < M; i += values.size()) {
+		rnd->nextFloats(&values[0], values.size());
+		sum += values[0];
+	}
+	Float t2 = timer->getSeconds();
+	timer->reset();
+	for (size_t i = 0; i < M; ++i)
+		sum += pcg.nextFloat();
+	Float t3 = timer->getSeconds();
+	timer->reset();
+	for (size_t i = 0; i < M; i += values.size()) {
+		pcg.nextFloats(&values[0], values.size());
+		sum += values[0];
+	}
+	Float t4 = timer->getSeconds();
+
+	Log(EInfo, "Throughput (M-random/s): SFMT %.1f, SFMT (bulk) %.1f, "
+		"PCG32 %.1f, PCG32 (bulk) %.1f (checksum %f)", 1e-6 * M / t1,
+		1e-6 * M / t2, 1e-6 * M / t3, 1e-6 * M / t4, sum);
 }
 
 
@@ -17,8 +17,14 @@
 */
 
 #include <mitsuba/render/testcase.h>
+#include <mitsuba/render/integrator.h>
+#include <mitsuba/render/imageblock.h>
+#include <mitsuba/render/sensor.h>
 #include <mitsuba/core/plugin.h>
 #include <mitsuba/core/qmc.h>
+#include <mitsuba/core/timer.h>
+#include <set>
+#include <map>
 
 MTS_NAMESPACE_BEGIN
 
@@ -28,6 +34,12 @@ public:
 	MTS_DECLARE_TEST(test01_Halton)
 	MTS_DECLARE_TEST(test02_Hammersley)
 	MTS_DECLARE_TEST(test03_radicalInverseIncr)
+	MTS_DECLARE_TEST(test04_OwenSobolStratification)
+	MTS_DECLARE_TEST(test05_SamplerComparison)
+	MTS_DECLARE_TEST(test06_BlockGeneration)
+	MTS_DECLARE_TEST(test07_PassRepetition)
+	MTS_DECLARE_TEST(test08_ProgressivePasses)
+	MTS_DECLARE_TEST(test09_ResumedPasses)
 	MTS_END_TESTCASE()
 
 	void test01_Halton() {
@@ -84,6 +96,305 @@ public:
 			x = radicalInverseIncremental(2, x);
 		}
 	}
+
+	/**
+	 * Check that the 2^m samples form a (t,m,2)-net, i.e. that every
+	 * elementary interval of volume 2^(t-m) contains exactly 2^t samples
+	 */
+	bool isNet(const std::vector<Point2> &points, int m, int t = 0) {
+		for (int k=0; k<=m-t; ++k) {
+			std::map<int, int> cells;
+			int resX = 1 << k, resY = 1 << (m-t-k);
+			for (size_t i=0; i<points.size(); ++i) {
+				int x = std::min((int) (points[i].x * resX), resX - 1),
+				    y = std::min((int) (points[i].y * resY), resY - 1);
+				cells[x * resY + y]++;
+			}
+			if (cells.size() != ((size_t) 1 << (m-t)))
+				return false;
+			for (std::map<int, int>::const_iterator it = cells.begin(); it != cells.end(); ++it) {
+				if (it->second != (1 << t))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	void test04_OwenSobolStratification() {
+		const int m = 8, sampleCount = 1 << m;
+		Properties props("owensobol");
+		props.setInteger("sampleCount", sampleCount);
+
+		ref<Sampler> sampler = static_cast<Sampler *> (PluginManager::getInstance()->
+				createObject(MTS_CLASS(Sampler), props));
+		sampler->request2DArray(1);
+
+		for (int pixel=0; pixel<4; ++pixel) {
+			sampler->generate(Point2i(pixel, 3*pixel));
+
+			std::vector<Point2> first(sampleCount), second(sampleCount), padded(sampleCount);
+			Point2 *array = sampler->next2DArray(1);
+			std::vector<Point2> arrayPoints(array, array + sampleCount);
+
+			sampler->setSampleIndex(0);
+			for (int i=0; i<sampleCount; ++i) {
+				first[i] = sampler->next2D();
+				second[i] = sampler->next2D();
+				sampler->next1D();
+				sampler->next2D();
+				padded[i] = sampler->next2D(); /* Starts a new padding group */
+				sampler->advance();
+			}
+
+			/* Only the first two Sobol dimensions form a (0,2)-sequence,
+			   the third and fourth one have a t-value of one */
+			assertTrue(isNet(first, m));
+			assertTrue(isNet(second, m, 1));
+			assertTrue(isNet(padded, m));
+			assertTrue(isNet(arrayPoints, m));
+		}
+
+		/* Different pixels must receive different sequences */
+		sampler->generate(Point2i(0, 0));
+		Float v1 = sampler->next1D();
+		sampler->generate(Point2i(1, 0));
+		Float v2 = sampler->next1D();
+		assertTrue(v1 != v2);
+	}
+
+	void test05_SamplerComparison() {
+		/* Integrate a smooth five-dimensional function over many pixels
+		   and compare the timing and RMS error of several samplers */
+		const char *names[] = { "independent", "halton", "ldsampler", "sobol", "owensobol" };
+		const int nSamplers = sizeof(names) / sizeof(names[0]);
+		const int nPixels = 256, nDims = 5;
+
+		/* Integral of exp(-x^2-y^2) (1 + z w) + (1/2 + u) over the unit hypercube */
+		const Float gauss = (Float) 0.746824132812427;
+		const Float reference = gauss * gauss * (Float) 1.25 + 1;
+
+		ref<Timer> timer = new Timer();
+		Float owenError = 0, indepError = 0;
+
+		for (int sampleCount = 16; sampleCount <= 256; sampleCount *= 4) {
+			Log(EInfo, "Integrating using %i samples per pixel:", sampleCount);
+			for (int s=0; s<nSamplers; ++s) {
+				Properties props(names[s]);
+				props.setInteger("sampleCount", sampleCount);
+				ref<Sampler> sampler = static_cast<Sampler *> (PluginManager::getInstance()->
+						createObject(MTS_CLASS(Sampler), props));
+
+				double errorSqr = 0;
+				timer->reset();
+				for (int pixel=0; pixel<nPixels; ++pixel) {
+					sampler->generate(Point2i(pixel % 16, pixel / 16));
+					double sum = 0;
+					for (int i=0; i<sampleCount; ++i) {
+						Point2 xy = sampler->next2D(), zw = sampler->next2D();
+						Float u = sampler->next1D();
+						sum += std::exp(-xy.x*xy.x - xy.y*xy.y)
+							* (1 + zw.x*zw.y) + (0.5f + u);
+						sampler->advance();
+					}
+					double err = sum / sampleCount - reference;
+					errorSqr += err*err;
+				}
+				Float rmse = (Float) std::sqrt(errorSqr / nPixels);
+				Log(EInfo, "  %-12s: RMSE = %e, time = %i ms (%i dimensions)", names[s],
+					rmse, timer->getMilliseconds(), nDims);
+
+				if (sampleCount == 256) {
+					if (s == 0)
+						indepError = rmse;
+					else if (s == nSamplers-1)
+						owenError = rmse;
+				}
+			}
+		}
+
+		/* Randomized QMC should be substantially better than random sampling */
+		assertTrue(owenError < 0.1f * indepError);
+	}
+
+	void test06_BlockGeneration() {
+		/* The block interface must produce the same values as next2D() */
+		const char *names[] = { "halton", "sobol", "owensobol" };
+		const size_t sampleCount = 16, dims = 3;
+
+		for (int s=0; s<3; ++s) {
+			Properties props(names[s]);
+			props.setInteger("sampleCount", (int) sampleCount);
+			ref<Sampler> sampler = static_cast<Sampler *> (PluginManager::getInstance()->
+					createObject(MTS_CLASS(Sampler), props));
+			sampler->setFilmResolution(Vector2i(64, 64), true);
+			sampler->request2DArray(2);
+
+			Point2i pixel(3, 5);
+			std::vector<Point2> reference(sampleCount * (dims + 1)), block(sampleCount * dims);
+
+			sampler->generate(pixel);
+			for (size_t i=0; i<sampleCount; ++i) {
+				for (size_t j=0; j<dims+1; ++j)
+					reference[i*(dims+1) + j] = sampler->next2D();
+				sampler->advance();
+			}
+
+			sampler->generate(pixel);
+			assertTrue(sampler->generate2DBlock(&block[0], dims));
+			for (size_t i=0; i<sampleCount; ++i) {
+				for (size_t j=0; j<dims; ++j)
+					assertEqualsEpsilon(block[i*dims + j], reference[i*(dims+1) + j], 1e-6f);
+				/* Per-sample queries continue after the block */
+				assertEqualsEpsilon(sampler->next2D(), reference[i*(dims+1) + dims], 1e-6f);
+				sampler->advance();
+			}
+		}
+	}
+
+	void test07_PassRepetition() {
+		/* The 'film' mode of the adaptive integrator renders a pixel in
+		   several passes using the same sampler instance. Only samplers
+		   whose samples differ between passes are usable there */
+		const char *names[] = { "independent", "sobol" };
+		const size_t sampleCount = 16;
+
+		for (int s=0; s<2; ++s) {
+			Properties props(names[s]);
+			props.setInteger("sampleCount", (int) sampleCount);
+			ref<Sampler> parent = static_cast<Sampler *> (PluginManager::getInstance()->
+					createObject(MTS_CLASS(Sampler), props));
+			parent->setFilmResolution(Vector2i(64, 64), true);
+			ref<Sampler> sampler = parent->clone();
+
+			Point2i pixel(3, 5);
+			std::vector<Point2> passes[2];
+			for (int pass=0; pass<2; ++pass) {
+				sampler->generate(pixel);
+				for (size_t i=0; i<sampleCount; ++i) {
+					passes[pass].push_back(sampler->next2D());
+					sampler->advance();
+				}
+			}
+
+			int repeated = 0;
+			for (size_t i=0; i<sampleCount; ++i)
+				repeated += passes[0][i] == passes[1][i] ? 1 : 0;
+
+			/* The adaptive integrator rejects samplers that repeat */
+			if (s == 0)
+				assertEquals(repeated, 0);
+			else
+				assertEquals(repeated, (int) sampleCount);
+		}
+	}
+
+	/// Integrator that only records the sample dimensions it receives
+	class DimensionIntegrator : public SamplingIntegrator {
+	public:
+		DimensionIntegrator() : SamplingIntegrator(Properties()) { }
+
+		Spectrum Li(const RayDifferential &ray, RadianceQueryRecord &rRec) const {
+			Spectrum result;
+			result[0] = ray.time;
+			result[1] = rRec.nextSample1D();
+			result[2] = rRec.nextSample1D();
+			return result;
+		}
+	};
+
+	void test08_ProgressivePasses() {
+		/* Rendering a block in several passes must reproduce the samples
+		   of a single-pass rendering, including the time dimension */
+		const char *names[] = { "halton", "sobol", "owensobol" };
+		const size_t sampleCount = 16, passCount = 4;
+
+		Properties sensorProps("perspective");
+		sensorProps.setFloat("shutterOpen", 0.0f);
+		sensorProps.setFloat("shutterClose", 1.0f);
+		ref<Sensor> sensor = static_cast<Sensor *> (PluginManager::getInstance()->
+				createObject(MTS_CLASS(Sensor), sensorProps));
+		sensor->configure();
+		assertTrue(sensor->needsTimeSample());
+
+		ref<DimensionIntegrator> integrator = new DimensionIntegrator();
+		const ReconstructionFilter *filter = sensor->getFilm()->getReconstructionFilter();
+
+		std::vector< TPoint2<uint8_t> > points;
+		for (uint8_t y=0; y<4; ++y)
+			for (uint8_t x=0; x<4; ++x)
+				points.push_back(TPoint2<uint8_t>(x, y));
+		bool stop = false;
+
+		for (int s=0; s<3; ++s) {
+			Properties props(names[s]);
+			props.setInteger("sampleCount", (int) sampleCount);
+			ref<Sampler> sampler = static_cast<Sampler *> (PluginManager::getInstance()->
+					createObject(MTS_CLASS(Sampler), props));
+			sampler->configure();
+			sampler->setFilmResolution(sensor->getFilm()->getCropSize(), true);
+
+			ref<ImageBlock> reference = new ImageBlock(Bitmap::ESpectrumAlphaWeight, Vector2i(4), filter),
+			                pass = new ImageBlock(Bitmap::ESpectrumAlphaWeight, Vector2i(4), filter),
+			                accum = new ImageBlock(Bitmap::ESpectrumAlphaWeight, Vector2i(4), filter);
+			reference->setOffset(Point2i(8, 12));
+			pass->setOffset(Point2i(8, 12));
+			accum->setOffset(Point2i(8, 12));
+
+			integrator->renderBlock(NULL, sensor, sampler, reference, stop, points);
+
+			accum->clear();
+			for (size_t i=0; i<passCount; ++i) {
+				sampler->setSampleRange(i * sampleCount / passCount, sampleCount / passCount);
+				integrator->renderBlock(NULL, sensor, sampler, pass, stop, points);
+				accum->put(pass);
+			}
+			sampler->setSampleRange(0, sampleCount);
+
+			const Float *refData = reference->getBitmap()->getFloatData(),
+			            *acc = accum->getBitmap()->getFloatData();
+			size_t count = reference->getBitmap()->getPixelCount()
+				* reference->getChannelCount();
+			for (size_t i=0; i<count; ++i)
+				assertEqualsEpsilon(acc[i], refData[i], 1e-4f);
+		}
+	}
+
+	/// Draw the samples of one progressive pass for a single pixel
+	std::vector<Point2> renderPass(Sampler *sampler, size_t start, size_t count) {
+		std::vector<Point2> result;
+		sampler->setSampleRange(start, count);
+		sampler->generate(Point2i(0));
+		sampler->setSampleIndex(start);
+		for (size_t i=0; i<count; ++i) {
+			result.push_back(sampler->next2D());
+			sampler->advance();
+		}
+		return result;
+	}
+
+	void test09_ResumedPasses() {
+		/* A rendering that is resumed from a checkpoint starts with freshly
+		   cloned samplers. The independent sampler must not repeat the
+		   random numbers of the first pass in this case */
+		Properties props("independent");
+		props.setInteger("sampleCount", 16);
+
+		ref<Sampler> parent = static_cast<Sampler *> (PluginManager::getInstance()->
+				createObject(MTS_CLASS(Sampler), props));
+		ref<Sampler> sampler = parent->clone();
+		std::vector<Point2> first = renderPass(sampler, 0, 8),
+		                    second = renderPass(sampler, 8, 8);
+
+		ref<Sampler> resumedParent = static_cast<Sampler *> (PluginManager::getInstance()->
+				createObject(MTS_CLASS(Sampler), props));
+		ref<Sampler> resumed = resumedParent->clone();
+		std::vector<Point2> secondResumed = renderPass(resumed, 8, 8);
+
+		for (size_t i=0; i<8; ++i) {
+			assertTrue(secondResumed[i] != first[i]);
+			assertTrue(secondResumed[i] == second[i]);
+		}
+	}
 };
 
 MTS_EXPORT_TESTCASE(TestSamplers, "Testcase for sampling-related code")
@@ -0,0 +1,551 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/testcase.h>
+#include <mitsuba/render/scene.h>
+#include <mitsuba/render/ibvh.h>
+#include <mitsuba/render/bsdf.h>
+#include <mitsuba/core/plugin.h>
+#include <mitsuba/core/random.h>
+#include <mitsuba/core/timer.h>
+#include <mitsuba/core/bitmap.h>
+#include <mitsuba/core/version.h>
+#include <fstream>
+
+MTS_NAMESPACE_BEGIN
+
+class TestScene : public TestCase {
+public:
+	MTS_BEGIN_TESTCASE()
+	MTS_DECLARE_TEST(test01_incrementalUpdate)
+	MTS_DECLARE_TEST(test02_updateBenchmark)
+	MTS_DECLARE_TEST(test03_instanceBVH)
+	MTS_DECLARE_TEST(test04_instanceBenchmark)
+	MTS_DECLARE_TEST(test05_motionBlur)
+	MTS_DECLARE_TEST(test06_motionBenchmark)
+	MTS_DECLARE_TEST(test07_includeReference)
+	MTS_DECLARE_TEST(test08_contentHash)
+	MTS_END_TESTCASE()
+
+	/// Create a unit square in the XY plane at height \c z, tessellated into 2*res*res triangles
+	ref<TriMesh> createGrid(const std::string &name, int res, Float z) {
+		ref<TriMesh> mesh = new TriMesh(name, 2 * (size_t) res * res,
+			(size_t) (res+1) * (res+1));
+		Point *positions = mesh->getVertexPositions();
+		Triangle *triangles = mesh->getTriangles();
+
+		for (int y=0; y<=res; ++y)
+			for (int x=0; x<=res; ++x)
+				*positions++ = Point(x / (Float) res, y / (Float) res, z);
+
+		for (int y=0; y<res; ++y) {
+			for (int x=0; x<res; ++x) {
+				uint32_t i0 = y * (res+1) + x, i1 = i0 + 1,
+				         i2 = i0 + res + 1, i3 = i2 + 1;
+				triangles->idx[0] = i0; triangles->idx[1] = i1; triangles->idx[2] = i3; ++triangles;
+				triangles->idx[0] = i0; triangles->idx[1] = i3; triangles->idx[2] = i2; ++triangles;
+			}
+		}
+		mesh->configure();
+		return mesh;
+	}
+
+	/// Return the shape hit by a vertical ray through (x, y), or \c NULL
+	const Shape *trace(const Scene *scene, Float x, Float y, Float &z) {
+		Intersection its;
+		if (!scene->rayIntersect(Ray(Point(x, y, -100), Vector(0, 0, 1), 0.0f), its))
+			return NULL;
+		z = its.p.z;
+		return its.shape;
+	}
+
+	/// Create a shape group containing a small mesh
+	ref<Shape> createGroup() {
+		ref<Shape> group = static_cast<Shape *> (PluginManager::getInstance()->createObject(
+			MTS_CLASS(Shape), Properties("shapegroup")));
+		group->addChild(createGrid("grid", 2, 0));
+		group->configure();
+		return group;
+	}
+
+	/// Create \c count instances of a small mesh at random positions in [0, 100]^3
+	ref_vector<Shape> createInstances(size_t count, Random *random) {
+		PluginManager *pluginManager = PluginManager::getInstance();
+		ref<Shape> group = createGroup();
+
+		ref_vector<Shape> instances;
+		for (size_t i=0; i<count; ++i) {
+			Properties props("instance");
+			props.setTransform("toWorld", randomTransform(random));
+			ref<Shape> instance = static_cast<Shape *> (pluginManager->createObject(
+				MTS_CLASS(Shape), props));
+			instance->addChild(group);
+			instance->configure();
+			instances.push_back(instance);
+		}
+		return instances;
+	}
+
+	Transform randomTransform(Random *random) {
+		return Transform::translate(Vector(random->nextFloat(),
+				random->nextFloat(), random->nextFloat()) * 100)
+			* Transform::rotate(Vector(0, 0, 1), random->nextFloat() * 360);
+	}
+
+	/// Create a scene with the given shapes, using an instance BVH if \c useBVH is set
+	ref<Scene> createScene(ref_vector<Shape> &shapes, bool useBVH) {
+		Properties props("scene");
+		props.setSize("instanceBVHThreshold", useBVH ? 1 : (size_t) -1);
+		ref<Scene> scene = new Scene(props);
+		for (size_t i=0; i<shapes.size(); ++i)
+			scene->addChild(shapes[i]);
+		scene->initialize();
+		return scene;
+	}
+
+	Ray randomRay(Random *random) {
+		Point o = Point(random->nextFloat(), random->nextFloat(), random->nextFloat()) * 120 - Vector(10.0f);
+		Point target = Point(random->nextFloat(), random->nextFloat(), random->nextFloat()) * 100;
+		return Ray(o, normalize(target - o), 0.0f);
+	}
+
+	/// Check that two scenes produce the same intersections
+	bool compareScenes(const Scene *scene1, const Scene *scene2, Random *random, int rayCount) {
+		bool equal = true;
+		for (int i=0; i<rayCount; ++i) {
+			Ray ray = randomRay(random);
+			Intersection its1, its2;
+			bool hit1 = scene1->rayIntersect(ray, its1);
+			bool hit2 = scene2->rayIntersect(ray, its2);
+			equal &= hit1 == hit2;
+			if (hit1 && hit2)
+				equal &= its1.instance == its2.instance && std::abs(its1.t - its2.t) < 1e-3f;
+			equal &= scene1->rayIntersect(ray) == hit1;
+		}
+		return equal;
+	}
+
+	/// Create an instance that moves by \c motion during the time interval [0, 1]
+	ref<Shape> createMovingInstance(Shape *group, Random *random, const Vector &motion) {
+		Transform trafo = randomTransform(random);
+		ref<AnimatedTransform> atrafo = new AnimatedTransform();
+		atrafo->appendTransform(0, trafo);
+		atrafo->appendTransform(1, Transform::translate(motion) * trafo);
+		Properties props("instance");
+		props.setAnimatedTransform("toWorld", atrafo);
+		ref<Shape> instance = static_cast<Shape *> (PluginManager::getInstance()->createObject(
+			MTS_CLASS(Shape), props));
+		instance->addChild(group);
+		instance->configure();
+		return instance;
+	}
+
+	/**
+	 * Create a deformable wavy grid that moves by \c motion along the X axis during
+	 * the time interval [0, 1]. The vertices of every frame are also randomly
+	 * displaced by up to \c jitter.
+	 */
+	ref<Shape> createDeformable(int res, Float motion, Float jitter,
+			Random *random, ref_vector<TriMesh> &frames) {
+		Properties props("deformable");
+		std::ostringstream times;
+		for (size_t i=0; i<frames.size(); ++i)
+			times << (i > 0 ? ", " : "") << i / (Float) (frames.size() - 1);
+		props.setString("times", times.str());
+		ref<Shape> shape = static_cast<Shape *> (PluginManager::getInstance()->createObject(
+			MTS_CLASS(Shape), props));
+
+		for (size_t i=0; i<frames.size(); ++i) {
+			Float time = i / (Float) (frames.size() - 1);
+			frames[i] = createGrid(formatString("frame" SIZE_T_FMT, i), res, 0);
+			Point *positions = frames[i]->getVertexPositions();
+			for (size_t j=0; j<frames[i]->getVertexCount(); ++j) {
+				Point &p = positions[j];
+				p += Vector(motion * time, 0, 0.05f * std::sin(2 * M_PI * (p.x + time)));
+				p += (Vector(random->nextFloat(), random->nextFloat(),
+					random->nextFloat()) - Vector(0.5f)) * jitter;
+			}
+			shape->addChild(frames[i]);
+		}
+		shape->configure();
+		return shape;
+	}
+
+	/// Brute force intersection with a deformable grid, interpolating its frames at the ray's time
+	Float traceFrames(const ref_vector<TriMesh> &frames, const Ray &ray) {
+		Float scale = (Float) (frames.size() - 1);
+		size_t frame = (size_t) std::max((Float) 0, std::min(scale - 1, std::floor(ray.time * scale)));
+		Float t0 = frame / scale, t1 = (frame + 1) / scale;
+		Float alpha = std::max((Float) 0, std::min((Float) 1, (ray.time - t0) / (t1 - t0)));
+		const Point *p0 = frames[frame]->getVertexPositions(),
+		            *p1 = frames[frame+1]->getVertexPositions();
+
+		Float t = std::numeric_limits<Float>::infinity();
+		for (size_t i=0; i<frames[0]->getTriangleCount(); ++i) {
+			const Triangle &tri = frames[0]->getTriangles()[i];
+			Point p[3];
+			for (int j=0; j<3; ++j)
+				p[j] = (1 - alpha) * p0[tri.idx[j]] + alpha * p1[tri.idx[j]];
+			Float u, v, tempT;
+			if (Triangle::rayIntersect(p[0], p[1], p[2], ray, u, v, tempT) && tempT >= 0 && tempT < t)
+				t = tempT;
+		}
+		return t;
+	}
+
+	/// Return a ray that starts below the XY plane at a random time in [-0.1, 1.1]
+	Ray randomMotionRay(Random *random, Float size) {
+		Point o(random->nextFloat() * size, random->nextFloat() * size, -1);
+		Vector d(random->nextFloat() - 0.5f, random->nextFloat() - 0.5f, 2);
+		return Ray(o, normalize(d), random->nextFloat() * 1.2f - 0.1f);
+	}
+
+	void test01_incrementalUpdate() {
+		Properties props("scene");
+		props.setBoolean("incremental", true);
+		ref<Scene> scene = new Scene(props);
+		ref<TriMesh> mesh1 = createGrid("mesh1", 16, 0), mesh2 = createGrid("mesh2", 16, 1);
+		scene->addChild(mesh1);
+		scene->initialize();
+
+		/* Shapes are wrapped into instances with their own kd-trees */
+		assertTrue(scene->getShapes().size() == 1);
+		assertTrue(scene->getShapes()[0]->getClass()->getName() == "Instance");
+
+		Float z = 0;
+		assertTrue(trace(scene, 0.5f, 0.5f, z) == mesh1);
+		assertEqualsEpsilon(z, (Float) 0.0f, Epsilon);
+
+		/* Moving a shape */
+		scene->setShapeTransform(mesh1, Transform::translate(Vector(2, 0, 3)));
+		assertTrue(scene->isDirty());
+		scene->update();
+		assertFalse(scene->isDirty());
+		assertTrue(trace(scene, 0.5f, 0.5f, z) == NULL);
+		assertTrue(trace(scene, 2.5f, 0.5f, z) == mesh1);
+		assertEqualsEpsilon(z, (Float) 3.0f, Epsilon);
+
+		/* Adding and removing shapes */
+		scene->insertShape(mesh2);
+		scene->update();
+		assertTrue(trace(scene, 0.5f, 0.5f, z) == mesh2);
+		assertEqualsEpsilon(z, (Float) 1.0f, Epsilon);
+
+		scene->removeShape(mesh1);
+		scene->update();
+		assertTrue(trace(scene, 2.5f, 0.5f, z) == NULL);
+		assertTrue(scene->getShapes().size() == 1);
+	}
+
+	void test02_updateBenchmark() {
+		/* Compare the latency of a transformation change against
+		   building the kd-tree of the entire scene from scratch */
+		const int meshCount = 4, res = 512;
+		ref_vector<TriMesh> meshes;
+		for (int i=0; i<meshCount; ++i)
+			meshes.push_back(createGrid(formatString("mesh%i", i), res, (Float) i));
+		size_t triangleCount = meshCount * 2 * (size_t) res * res;
+		ref<Timer> timer = new Timer();
+
+		for (int k=0; k<2; ++k) {
+			ref<Scene> scene = new Scene();
+			scene->setIncremental(k == 1);
+			for (int i=0; i<meshCount; ++i)
+				scene->addChild(meshes[i]);
+			timer->reset();
+			scene->initialize();
+			Log(EInfo, "%s scene with " SIZE_T_FMT " triangles: initialization took %i ms",
+				k == 0 ? "Static" : "Incremental", triangleCount, timer->getMilliseconds());
+
+			if (k == 1) {
+				const int runs = 20;
+				timer->reset();
+				for (int i=0; i<runs; ++i) {
+					scene->setShapeTransform(meshes[0], Transform::translate(Vector(0, 0, (Float) -i)));
+					scene->update();
+				}
+				Log(EInfo, "Incremental scene: transformation change took %.3f ms",
+					timer->getMilliseconds() / (Float) runs);
+			}
+		}
+	}
+
+	void test03_instanceBVH() {
+		/* The instance BVH must agree with the kd-tree, also after refitting it */
+		ref<Random> random = new Random();
+		ref_vector<Shape> instances = createInstances(5000, random);
+		ref<Scene> bvhScene = createScene(instances, true);
+		ref<Scene> kdScene = createScene(instances, false);
+		assertTrue(compareScenes(bvhScene, kdScene, random, 20000));
+
+		for (int k=0; k<2; ++k) {
+			/* Small displacements are handled by refitting, while
+			   the second round moves instances outside of the BVH */
+			for (int i=0; i<100; ++i) {
+				Shape *instance = instances[random->nextUInt((uint32_t) instances.size())];
+				Transform trafo = k == 0 ? randomTransform(random)
+					: Transform::translate(Vector(0, 0, 500 + random->nextFloat()));
+				bvhScene->setShapeTransform(instance, trafo);
+				kdScene->setShapeTransform(instance, trafo);
+			}
+			bvhScene->update();
+			kdScene->update();
+			assertTrue(compareScenes(bvhScene, kdScene, random, 20000));
+		}
+	}
+
+	void test04_instanceBenchmark() {
+		/* Construction, refitting, and ray tracing performance
+		   with a large number of instances */
+		const size_t instanceCount = 1000000;
+		const int rayCount = 100000;
+		ref<Random> random = new Random();
+		ref_vector<Shape> instances = createInstances(instanceCount, random);
+		ref<Timer> timer = new Timer();
+
+		for (int k=0; k<2; ++k) {
+			const char *name = k == 0 ? "BVH" : "kd-tree";
+			timer->reset();
+			ref<Scene> scene = createScene(instances, k == 0);
+			Log(EInfo, "%s over " SIZE_T_FMT " instances: construction took %i ms",
+				name, instanceCount, timer->getMilliseconds());
+
+			ref<Random> rayRandom = new Random();
+			int hits = 0;
+			timer->reset();
+			for (int i=0; i<rayCount; ++i) {
+				Intersection its;
+				if (scene->rayIntersect(randomRay(rayRandom), its))
+					++hits;
+			}
+			Log(EInfo, "%s: %.2f Mrays/s (%i hits)", name,
+				rayCount / (timer->getSeconds() * 1e6f), hits);
+
+			for (int i=0; i<1000; ++i)
+				scene->setShapeTransform(instances[i], randomTransform(random));
+			timer->reset();
+			scene->update();
+			Log(EInfo, "%s: update after moving 1000 instances took %i ms",
+				name, timer->getMilliseconds());
+		}
+	}
+
+	void test05_motionBlur() {
+		/* Time-dependent bounds must not change the intersections */
+		ref<Random> random = new Random();
+		uint8_t temp[MTS_KD_INTERSECTION_TEMP];
+		Float maxt = std::numeric_limits<Float>::infinity();
+		bool equal = true;
+
+		/* Deformable mesh: compare against a brute force search */
+		ref_vector<TriMesh> frames(3);
+		ref<Shape> deformable = createDeformable(8, 0.5f, 0.1f, random, frames);
+		for (int i=0; i<5000; ++i) {
+			Ray ray = randomMotionRay(random, 1.5f);
+			Float t = 0, refT = traceFrames(frames, ray);
+			bool hit = deformable->rayIntersect(ray, 0, maxt, t, temp);
+			equal &= hit == (refT < maxt);
+			if (hit && refT < maxt)
+				equal &= std::abs(t - refT) < 1e-4f;
+			equal &= deformable->rayIntersect(ray, 0, maxt) == hit;
+		}
+		assertTrue(equal);
+
+		/* Moving instances: compare against a BVH without time segments */
+		ref<Shape> group = createGroup();
+		ref<InstanceBVH> bvh1 = new InstanceBVH(), bvh2 = new InstanceBVH();
+		bvh2->setTimeRange(0, 1);
+		for (int i=0; i<2000; ++i) {
+			ref<Shape> instance = createMovingInstance(group, random,
+				Vector(random->nextFloat() - 0.5f, random->nextFloat() - 0.5f, 0) * 40);
+			bvh1->addShape(instance);
+			bvh2->addShape(instance);
+		}
+		bvh1->build();
+		bvh2->build();
+		assertTrue(bvh1->getTimeSegmentCount() == 1);
+		assertTrue(bvh2->getTimeSegmentCount() == MTS_IBVH_TIME_SEGMENTS);
+
+		for (int i=0; i<20000; ++i) {
+			Ray ray = randomRay(random);
+			ray.time = random->nextFloat() * 1.2f - 0.1f;
+			Float t1 = 0, t2 = 0;
+			bool hit1 = bvh1->rayIntersect(ray, 0, maxt, t1, temp);
+			uint32_t index1 = *reinterpret_cast<uint32_t *>(temp);
+			bool hit2 = bvh2->rayIntersect(ray, 0, maxt, t2, temp);
+			uint32_t index2 = *reinterpret_cast<uint32_t *>(temp);
+			equal &= hit1 == hit2;
+			if (hit1 && hit2)
+				equal &= index1 == index2 && std::abs(t1 - t2) < 1e-3f;
+			equal &= bvh2->rayIntersect(ray, 0, maxt) == hit1;
+		}
+		assertTrue(equal);
+	}
+
+	void test06_motionBenchmark() {
+		/* Ray tracing performance of fast-moving geometry */
+		ref<Random> random = new Random();
+		ref<Timer> timer = new Timer();
+		uint8_t temp[MTS_KD_INTERSECTION_TEMP];
+		Float maxt = std::numeric_limits<Float>::infinity();
+		const int rayCount = 100000;
+
+		ref_vector<TriMesh> frames(5);
+		timer->reset();
+		ref<Shape> deformable = createDeformable(256, 0.5f, 0.0f, random, frames);
+		Log(EInfo, "Deformable mesh with " SIZE_T_FMT " triangles: construction took %i ms",
+			deformable->getPrimitiveCount(), timer->getMilliseconds());
+		ref<Random> rayRandom = new Random();
+		int hits = 0;
+		timer->reset();
+		for (int i=0; i<rayCount; ++i) {
+			Float t;
+			if (deformable->rayIntersect(randomMotionRay(rayRandom, 1.25f), 0, maxt, t, temp))
+				++hits;
+		}
+		Log(EInfo, "Deformable mesh: %.3f Mrays/s (%i hits)",
+			rayCount / (timer->getSeconds() * 1e6f), hits);
+
+		ref<Shape> group = createGroup();
+		ref<InstanceBVH> bvhs[2] = { new InstanceBVH(), new InstanceBVH() };
+		bvhs[1]->setTimeRange(0, 1);
+		for (int i=0; i<100000; ++i) {
+			ref<Shape> instance = createMovingInstance(group, random,
+				Vector(random->nextFloat() - 0.5f, random->nextFloat() - 0.5f, 0) * 10);
+			bvhs[0]->addShape(instance);
+			bvhs[1]->addShape(instance);
+		}
+
+		for (int k=0; k<2; ++k) {
+			timer->reset();
+			bvhs[k]->build();
+			Log(EInfo, "Moving instances, %i time segment(s): construction took %i ms",
+				bvhs[k]->getTimeSegmentCount(), timer->getMilliseconds());
+			rayRandom = new Random();
+			hits = 0;
+			timer->reset();
+			for (int i=0; i<rayCount; ++i) {
+				Ray ray = randomRay(rayRandom);
+				ray.time = rayRandom->nextFloat();
+				Float t;
+				if (bvhs[k]->rayIntersect(ray, 0, maxt, t, temp))
+					++hits;
+			}
+			Log(EInfo, "Moving instances, %i time segment(s): %.3f Mrays/s (%i hits)",
+				bvhs[k]->getTimeSegmentCount(), rayCount / (timer->getSeconds() * 1e6f), hits);
+		}
+	}
+
+	/// Write a scene description to \c path
+	void writeFile(const fs::path &path, const std::string &content) {
+		std::ofstream os(path.string().c_str());
+		os << content;
+		os.close();
+		assertFalse(os.fail());
+	}
+
+	void test07_includeReference() {
+		/* An included file may reference bitmap textures of its parent,
+		   which might still be under construction on a worker thread */
+		fs::path dir = fs::temp_directory_path() / fs::unique_path("mts-include-%%%%-%%%%");
+		fs::create_directories(dir);
+
+		ref<Bitmap> bitmap = new Bitmap(Bitmap::ERGB, Bitmap::EUInt8, Vector2i(4));
+		bitmap->clear();
+		bitmap->write(Bitmap::EPNG, dir / "texture.png");
+
+		std::string header = "<?xml version=\"1.0\"?>\n<scene version=\"" MTS_VERSION "\">\n";
+		writeFile(dir / "material.xml", header +
+			"\t<bsdf type=\"diffuse\" id=\"material\">\n"
+			"\t\t<ref name=\"reflectance\" id=\"texture\"/>\n"
+			"\t</bsdf>\n"
+			"</scene>\n");
+		writeFile(dir / "duplicate.xml", header +
+			"\t<texture type=\"checkerboard\" id=\"texture\"/>\n"
+			"</scene>\n");
+
+		std::string parent = header +
+			"\t<texture type=\"bitmap\" id=\"texture\">\n"
+			"\t\t<string name=\"filename\" value=\"" + (dir / "texture.png").string() + "\"/>\n"
+			"\t</texture>\n"
+			"\t<include filename=\"" + (dir / "$file").string() + "\"/>\n"
+			"</scene>\n";
+
+		ParameterMap params;
+		params["file"] = "material.xml";
+		ref<Scene> scene = loadSceneFromString(parent, params);
+		bool foundBSDF = false;
+		const ref_vector<ConfigurableObject> &objects = scene->getReferencedObjects();
+		for (size_t i=0; i<objects.size(); ++i)
+			foundBSDF |= objects[i]->getClass()->derivesFrom(MTS_CLASS(BSDF));
+		assertTrue(foundBSDF);
+
+		/* IDs must also be unique across included files */
+		params["file"] = "duplicate.xml";
+		bool failed = false;
+		try {
+			loadSceneFromString(parent, params);
+		} catch (const std::exception &) {
+			failed = true;
+		}
+		assertTrue(failed);
+
+		fs::remove_all(dir);
+	}
+
+	void test08_contentHash() {
+		/* Moving an instanced shape must change the content hash */
+		Properties props("scene");
+		props.setBoolean("incremental", true);
+		ref<Scene> scene = new Scene(props);
+		ref<TriMesh> mesh = createGrid("mesh", 4, 0);
+		scene->addChild(mesh);
+		scene->initialize();
+
+		uint64_t hash = scene->computeContentHash();
+		assertTrue(scene->computeContentHash() == hash);
+
+		scene->setShapeTransform(mesh, Transform::translate(Vector(2, 0, 3)));
+		scene->update();
+		uint64_t movedHash = scene->computeContentHash();
+		assertTrue(movedHash != hash);
+
+		/* .. as must the transformation and the contents of user-specified instances */
+		ref<TriMesh> grid = createGrid("grid", 2, 0);
+		ref<Shape> group = static_cast<Shape *> (PluginManager::getInstance()->createObject(
+			MTS_CLASS(Shape), Properties("shapegroup")));
+		group->addChild(grid);
+		group->configure();
+
+		ref<Random> random = new Random();
+		ref_vector<Shape> shapes;
+		shapes.push_back(createMovingInstance(group, random, Vector(1, 0, 0)));
+		ref<Scene> instanced = createScene(shapes, false);
+
+		hash = instanced->computeContentHash();
+		shapes[0]->setWorldTransform(new AnimatedTransform(randomTransform(random)));
+		assertTrue(instanced->computeContentHash() != hash);
+
+		hash = instanced->computeContentHash();
+		grid->getVertexPositions()[0] += Vector(0, 0, 1);
+		assertTrue(instanced->computeContentHash() != hash);
+	}
+};
+
+MTS_EXPORT_TESTCASE(TestScene, "Testcase for incremental scene updates")
+MTS_NAMESPACE_END
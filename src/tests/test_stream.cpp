@@ -0,0 +1,299 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/testcase.h>
+#include <mitsuba/core/mstream.h>
+#include <mitsuba/core/fstream.h>
+#include <mitsuba/core/sstream.h>
+#include <mitsuba/core/zstream.h>
+#include <mitsuba/core/random.h>
+#include <mitsuba/core/timer.h>
+
+#if !defined(__WINDOWS__)
+#include <sys/socket.h>
+#endif
+
+MTS_NAMESPACE_BEGIN
+
+/* Amount of data transferred per benchmark run */
+#define BENCHMARK_SIZE (64*1024*1024)
+
+static Stream::EByteOrder swappedByteOrder() {
+	return Stream::getHostByteOrder() == Stream::ELittleEndian
+		? Stream::EBigEndian : Stream::ELittleEndian;
+}
+
+#if !defined(__WINDOWS__)
+/// Writes floating point data into one end of a socket pair
+class SocketWriter : public Thread {
+public:
+	SocketWriter(Stream *stream, const std::vector<float> &data, int runs)
+		: Thread("sockw"), m_stream(stream), m_data(data), m_runs(runs) { }
+
+	void run() {
+		for (int i=0; i<m_runs; ++i)
+			m_stream->writeSingleArray(&m_data[0], m_data.size());
+		m_stream->flush();
+	}
+private:
+	ref<Stream> m_stream;
+	const std::vector<float> &m_data;
+	int m_runs;
+};
+#endif
+
+class TestStream : public TestCase {
+public:
+	MTS_BEGIN_TESTCASE()
+	MTS_DECLARE_TEST(test01_byteOrder)
+	MTS_DECLARE_TEST(test02_benchmark)
+	MTS_DECLARE_TEST(test03_readAhead)
+	MTS_DECLARE_TEST(test04_blockCompression)
+	MTS_END_TESTCASE()
+
+	void test01_byteOrder() {
+		/* Compare the bulk array functions against the scalar ones for
+		   sizes that exercise both the vector code and its remainder */
+		ref<Random> random = new Random();
+		const size_t sizes[] = { 1, 7, 16, 33, 5000 };
+
+		for (int i=0; i<5; ++i) {
+			size_t size = sizes[i];
+			std::vector<short> shorts(size);
+			std::vector<int> ints(size);
+			std::vector<int64_t> longs(size);
+			std::vector<half> halfs(size);
+			std::vector<float> singles(size);
+			std::vector<double> doubles(size);
+			for (size_t j=0; j<size; ++j) {
+				uint64_t value = random->nextULong();
+				shorts[j] = (short) value;
+				ints[j] = (int) value;
+				longs[j] = (int64_t) value;
+				halfs[j] = half(random->nextFloat());
+				singles[j] = random->nextFloat();
+				doubles[j] = (double) random->nextFloat();
+			}
+
+			for (int k=0; k<2; ++k) {
+				Stream::EByteOrder byteOrder = k == 0
+					? Stream::getHostByteOrder() : swappedByteOrder();
+				ref<MemoryStream> bulk = new MemoryStream(), scalar = new MemoryStream();
+				bulk->setByteOrder(byteOrder);
+				scalar->setByteOrder(byteOrder);
+
+				bulk->writeShortArray(&shorts[0], size);
+				bulk->writeIntArray(&ints[0], size);
+				bulk->writeLongArray(&longs[0], size);
+				bulk->writeHalfArray(&halfs[0], size);
+				bulk->writeSingleArray(&singles[0], size);
+				bulk->writeDoubleArray(&doubles[0], size);
+
+				for (size_t j=0; j<size; ++j) scalar->writeShort(shorts[j]);
+				for (size_t j=0; j<size; ++j) scalar->writeInt(ints[j]);
+				for (size_t j=0; j<size; ++j) scalar->writeLong(longs[j]);
+				for (size_t j=0; j<size; ++j) scalar->writeHalf(halfs[j]);
+				for (size_t j=0; j<size; ++j) scalar->writeSingle(singles[j]);
+				for (size_t j=0; j<size; ++j) scalar->writeDouble(doubles[j]);
+
+				assertTrue(bulk->getSize() == scalar->getSize());
+				assertTrue(memcmp(bulk->getData(), scalar->getData(), bulk->getSize()) == 0);
+
+				std::vector<short> shorts2(size);
+				std::vector<int> ints2(size);
+				std::vector<int64_t> longs2(size);
+				std::vector<half> halfs2(size);
+				std::vector<float> singles2(size);
+				std::vector<double> doubles2(size);
+				bulk->seek(0);
+				bulk->readShortArray(&shorts2[0], size);
+				bulk->readIntArray(&ints2[0], size);
+				bulk->readLongArray(&longs2[0], size);
+				bulk->readHalfArray(&halfs2[0], size);
+				bulk->readSingleArray(&singles2[0], size);
+				bulk->readDoubleArray(&doubles2[0], size);
+
+				assertTrue(shorts == shorts2);
+				assertTrue(ints == ints2);
+				assertTrue(longs == longs2);
+				assertTrue(memcmp(&halfs[0], &halfs2[0], size * sizeof(half)) == 0);
+				assertTrue(singles == singles2);
+				assertTrue(doubles == doubles2);
+			}
+		}
+	}
+
+	void test02_benchmark() {
+		/* Throughput of bulk transfers in the native and in the swapped byte order */
+		std::vector<float> data(1024*1024);
+		ref<Random> random = new Random();
+		for (size_t i=0; i<data.size(); ++i)
+			data[i] = random->nextFloat();
+		const int runs = BENCHMARK_SIZE / (int) (data.size() * sizeof(float));
+		ref<Timer> timer = new Timer();
+
+		for (int k=0; k<2; ++k) {
+			Stream::EByteOrder byteOrder = k == 0
+				? Stream::getHostByteOrder() : swappedByteOrder();
+			const char *name = k == 0 ? "native" : "swapped";
+
+			ref<MemoryStream> mstream = new MemoryStream(BENCHMARK_SIZE);
+			mstream->setByteOrder(byteOrder);
+			timer->reset();
+			for (int i=0; i<runs; ++i)
+				mstream->writeSingleArray(&data[0], data.size());
+			mstream->seek(0);
+			for (int i=0; i<runs; ++i)
+				mstream->readSingleArray(&data[0], data.size());
+			report("MemoryStream", name, 2 * BENCHMARK_SIZE, timer->getSeconds());
+
+			ref<FileStream> fstream = FileStream::createTemporary();
+			fstream->setByteOrder(byteOrder);
+			timer->reset();
+			for (int i=0; i<runs; ++i)
+				fstream->writeSingleArray(&data[0], data.size());
+			fstream->seek(0);
+			for (int i=0; i<runs; ++i)
+				fstream->readSingleArray(&data[0], data.size());
+			report("FileStream", name, 2 * BENCHMARK_SIZE, timer->getSeconds());
+			fstream->close();
+
+#if !defined(__WINDOWS__)
+			int sockets[2];
+			if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0)
+				Log(EError, "socketpair() failed!");
+			ref<SocketStream> sender = new SocketStream(sockets[0]);
+			ref<SocketStream> receiver = new SocketStream(sockets[1]);
+			sender->setByteOrder(byteOrder);
+			receiver->setByteOrder(byteOrder);
+			std::vector<float> received(data.size());
+			timer->reset();
+			ref<SocketWriter> writer = new SocketWriter(sender, data, runs);
+			writer->start();
+			for (int i=0; i<runs; ++i)
+				receiver->readSingleArray(&received[0], received.size());
+			writer->join();
+			report("SocketStream", name, BENCHMARK_SIZE, timer->getSeconds());
+			assertTrue(received == data);
+#endif
+		}
+	}
+
+	void test03_readAhead() {
+		/* Sequential reads, seeks and EOF handling with small read-ahead blocks */
+		const size_t size = 3000001;
+		std::vector<uint8_t> data(size), buffer(100000);
+		ref<Random> random = new Random();
+		for (size_t i=0; i<size; ++i)
+			data[i] = (uint8_t) random->nextUInt(256);
+		ref<FileStream> temp = FileStream::createTemporary();
+		temp->write(&data[0], size);
+		temp->flush();
+
+		ref<FileStream> stream = new FileStream(temp->getPath(), FileStream::EReadOnly);
+		stream->setReadAhead(4096);
+		assertTrue(stream->getReadAhead());
+
+		bool equal = true;
+		while (stream->getPos() < size) {
+			size_t pos = stream->getPos();
+			size_t amount = std::min(size - pos, (size_t) random->nextUInt(
+				random->nextFloat() < 0.5f ? 16 : (uint32_t) buffer.size()) + 1);
+			stream->read(&buffer[0], amount);
+			equal &= memcmp(&buffer[0], &data[pos], amount) == 0;
+		}
+		assertTrue(equal);
+
+		for (int i=0; i<1000; ++i) {
+			size_t pos = random->nextUInt((uint32_t) size);
+			size_t amount = std::min(size - pos, (size_t) random->nextUInt((uint32_t) buffer.size()));
+			stream->seek(pos);
+			stream->read(&buffer[0], amount);
+			equal &= memcmp(&buffer[0], &data[pos], amount) == 0
+				&& stream->getPos() == pos + amount;
+		}
+		assertTrue(equal);
+
+		stream->seek(size - 10);
+		bool eof = false;
+		try {
+			stream->read(&buffer[0], 20);
+		} catch (const EOFException &ex) {
+			eof = ex.getCompleted() == 10;
+		}
+		assertTrue(eof);
+
+		/* Switching back to direct reads continues at the same position */
+		stream->seek(1234);
+		stream->setReadAhead(0);
+		assertFalse(stream->getReadAhead());
+		stream->read(&buffer[0], 100);
+		assertTrue(memcmp(&buffer[0], &data[1234], 100) == 0);
+		stream->close();
+		temp->close();
+	}
+
+	void test04_blockCompression() {
+		/* Round trip through block-compressed and plain zlib streams,
+		   which must both be readable by a default ZStream */
+		const size_t size = 5 * ZSTREAM_BLOCKSIZE + 17;
+		std::vector<uint8_t> data(size), buffer(size);
+		ref<Random> random = new Random();
+		for (size_t i=0; i<size; ++i)
+			data[i] = (uint8_t) ((i / 7) % 13 + (random->nextUInt(4) == 0 ? random->nextUInt(256) : 0));
+
+		for (int k=0; k<2; ++k) {
+			ref<MemoryStream> mstream = new MemoryStream();
+			mstream->writeUInt(0xDEADBEEF);
+			{
+				ref<ZStream> zstream = new ZStream(mstream,
+					k == 0 ? ZStream::EBlockStream : ZStream::EDeflateStream);
+				for (size_t pos = 0; pos < size; ) {
+					size_t amount = std::min(size - pos, (size_t) random->nextUInt(1000000) + 1);
+					zstream->write(&data[pos], amount);
+					pos += amount;
+				}
+			}
+			mstream->seek(sizeof(uint32_t));
+			ref<ZStream> zstream = new ZStream(mstream);
+			zstream->read(&buffer[0], size);
+			assertTrue(buffer == data);
+
+			if (k == 0) {
+				bool equal = true;
+				for (int i=0; i<200; ++i) {
+					size_t pos = random->nextUInt((uint32_t) size);
+					size_t amount = std::min(size - pos, (size_t) random->nextUInt(200000));
+					zstream->seek(pos);
+					zstream->read(&buffer[0], amount);
+					equal &= memcmp(&buffer[0], &data[pos], amount) == 0
+						&& zstream->getPos() == pos + amount;
+				}
+				assertTrue(equal);
+			}
+		}
+	}
+
+	void report(const char *stream, const char *byteOrder, size_t bytes, Float seconds) {
+		Log(EInfo, "%s (%s byte order): %.1f MB/s", stream, byteOrder,
+			bytes / (1024.0f * 1024.0f * seconds));
+	}
+};
+
+MTS_EXPORT_TESTCASE(TestStream, "Testcase for stream I/O")
+MTS_NAMESPACE_END
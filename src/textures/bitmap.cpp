@@ -247,6 +247,7 @@ public:
 				/* Load the input image if necessary */
 				ref<Timer> timer = new Timer();
 				ref<FileStream> fs = new FileStream(m_filename, FileStream::EReadOnly);
+				fs->setReadAhead();
 				bitmap = new Bitmap(Bitmap::EAuto, fs);
 				if (m_gamma != 0)
 					bitmap->setGamma(m_gamma);